@@ -309,14 +309,20 @@ void CMDApp::onRecieve() {
         users.clear();
         timeout->stop();
     }
-    if (!recieved.date.empty()) {
+    auto print = [this](const SendData &message) {
         os << "New message:\n\t";
-        os << recieved.from << "("
-           << recieved.date.substr(0, recieved.date.size() - 1) << ") : ";
-        std::copy(recieved.data.begin(), recieved.data.end(),
+        os << message.from << "("
+           << message.date.substr(0, message.date.size() - 1) << ") : ";
+        std::copy(message.data.begin(), message.data.end(),
                   std::ostream_iterator<unsigned char>(os));
         os << '\n';
-
+    };
+    for (const auto &message : client->getMessages()) {
+        if (!message.date.empty()) print(message);
+    }
+    client->getMessages().clear();
+    if (!recieved.date.empty()) {
+        print(recieved);
         recieved = {};    // clear
     }
 }
@@ -1,5 +1,6 @@
 #include "client.h"
 #include <QMetaMethod>
+#include <array>
 #include <chrono>
 #include <ctime>
 #include <tuple>
@@ -7,6 +8,7 @@
 #include "config.h"
 
 #include "../shared/curve_25519.h"
+#include "../shared/keystore.h"
 #include "../shared/responses.h"
 #include "client_utils.h"
 
@@ -75,6 +77,9 @@ void Client::callback(std::stringstream &&data) {
         case Response::Type::RECEIVE_OLD:
             receiveData(response);
             return;
+        case Response::Type::RECEIVE_OLD_BATCH:
+            receiveBatch(response);
+            return;
         case Response::Type::GENERIC_SERVER_ERROR:
             throw Error("Server returned error.");
         default:
@@ -128,10 +133,12 @@ void Client::sendFindUsers(const std::string &query) {
     sendRequest({{Request::Type::FIND_USERS, _userId}, request.serialize()});
 }
 
-void Client::sendGetOnline() { sendGenericRequest(Request::Type::GET_ONLINE); }
+void Client::sendGetOnline() {
+    GetOnline request{0};
+    sendRequest({{Request::Type::GET_ONLINE, _userId}, request.serialize()});
+}
 
 KeyBundle<C25519> Client::updateKeys() {
-    const int numberOfOneTimeKeys = 20;
     KeyBundle<C25519> newKeybundle;
 
     std::ifstream temp(_username + idC25519pub,
@@ -161,16 +168,17 @@ KeyBundle<C25519> Client::updateKeys() {
     identity.loadPrivateKey(_username + idC25519priv, _password);
     newKeybundle.preKeySingiture = identity.sign(newKeybundle.preKey);
 
-    for (int i = 0; i < numberOfOneTimeKeys; ++i) {
-        archiveKey(_username + std::to_string(i) + oneTimeC25519pub);
-        archiveKey(_username + std::to_string(i) + oneTimeC25519priv);
-        C25519KeyGen oneTimeKeygen{};
-        oneTimeKeygen.savePublicKey(_username + std::to_string(i) +
-                                    oneTimeC25519pub);
-        oneTimeKeygen.savePrivateKeyPassword(
-            _username + std::to_string(i) + oneTimeC25519priv, _password);
-        newKeybundle.oneTimeKeys.emplace_back(oneTimeKeygen.getPublicKey());
+    // one keystore file for the whole set, index is the key id
+    archiveKey(_username + oneTimeKeystore);
+    archiveLegacyOneTimeKeys();
+    std::vector<zero::bytes_t> privateKeys;
+    privateKeys.reserve(_oneTimeKeys);
+    for (C25519KeyPair &pair : C25519KeyGen::generate(_oneTimeKeys)) {
+        newKeybundle.oneTimeKeys.push_back(std::move(pair.publicKey));
+        privateKeys.push_back(std::move(pair.privateKey));
     }
+    OneTimeKeystore::save(_username + oneTimeKeystore, _password,
+                          privateKeys);
 
     newKeybundle.generateTimeStamp();
     _x3dh->timestamp = newKeybundle.timestamp;
@@ -201,6 +209,18 @@ void Client::archiveKey(const std::string &keyFileName) {
     }
 }
 
+void Client::archiveLegacyOneTimeKeys() {
+    for (size_t i = 0;; ++i) {
+        std::string pub = _username + std::to_string(i) + oneTimeC25519pub;
+        std::string priv = _username + std::to_string(i) + oneTimeC25519priv;
+        if (!std::ifstream(priv, std::ios::binary | std::ios::in)) return;
+        archiveKey(pub);
+        archiveKey(priv);
+        remove(pub.c_str());
+        remove(priv.c_str());
+    }
+}
+
 void Client::saveState() {
     zero::bytes_t result;
     ClientState clientState;
@@ -221,10 +241,12 @@ void Client::saveState() {
 
     AESGCM aes;
     zero::bytes_t key = Random().getKey(AESGCM::key_size);
-    aes.setIv(to_hex(std::vector<unsigned char>(AESGCM::iv_size, 0)));
-    aes.setKey(to_hex(key));
-    std::vector<unsigned char> encrypted;
-    aes.encryptWithAd(clientState.serialize(), {}, encrypted);
+    // fresh key for each save, the zero iv is never reused with it
+    std::array<unsigned char, AESGCM::iv_size> iv{};
+    aes.setRawKey(key);
+    std::vector<unsigned char> bytes = clientState.serialize();
+    std::vector<unsigned char> encrypted(AESGCM::tag_size + bytes.size());
+    aes.seal({iv.data(), iv.size()}, bytes, {}, encrypted);
 
     write_n(state, encrypted);
 
@@ -253,15 +275,20 @@ void Client::loadState() {
     std::vector<unsigned char> encrypted;
     encrypted.resize(getSize(state));
 
-    AESGCM aes;
-    aes.setIv(to_hex(std::vector<unsigned char>(AESGCM::iv_size, 0)));
-    aes.setKey(to_hex(key));
     read_n(state, encrypted.data(), encrypted.size());
-    std::vector<unsigned char> bytes;
-    aes.decryptWithAd(encrypted, {}, bytes);
+    if (encrypted.size() < AESGCM::tag_size) {
+        throw Error("Invalid state file.");
+    }
+
+    AESGCM aes;
+    std::array<unsigned char, AESGCM::iv_size> iv{};
+    aes.setRawKey(key);
+    std::vector<unsigned char> bytes(encrypted.size() - AESGCM::tag_size);
+    aes.open({iv.data(), iv.size()}, encrypted, {}, bytes);
 
-    uint64_t from = 0;
-    auto clientState = ClientState::deserialize(bytes, from);
+    // state saved before the format change is read as well, it is saved
+    // in the current format on exit
+    auto clientState = ClientState::deserialize(bytes);
 
     std::for_each(clientState.states.begin(), clientState.states.end(),
                   [this](DRStatePair &p) {
@@ -397,9 +424,23 @@ void Client::receiveData(const Response &response) {
     }
 }
 
+void Client::receiveBatch(const Response &response) {
+    MessageBatch batch = MessageBatch::deserialize(response.payload);
+    for (auto &message : batch.messages) {
+        receiveData({Response::Type::RECEIVE_OLD, response.header.userId,
+                     std::move(message)});
+        if (!_incomming.from.empty()) _inbox.push_back(std::move(_incomming));
+        _incomming = {};
+    }
+    if (batch.more) checkForMessages();
+}
+
 void Client::parseUsers(const helloworld::Response &response) {
-    _userList.clear();
     UserListReponse online = UserListReponse::deserialize(response.payload);
+    if (!online.delta) _userList.clear();
+    for (uint32_t id : online.offline) {
+        _userList.erase(id);
+    }
     for (size_t i = 0; i < online.ids.size(); i++) {
         _userList[online.ids[i]] = online.online[i];
     }
@@ -34,6 +34,7 @@ class Client : public QObject, public Callable<void, std::stringstream &&> {
 
     static bool _test;
     static constexpr int SYMMETRIC_KEY_SIZE = 16;
+    static constexpr size_t DEFAULT_ONE_TIME_KEYS = 20;
     Q_OBJECT
     QTimer *_timeout;
 
@@ -61,6 +62,14 @@ class Client : public QObject, public Callable<void, std::stringstream &&> {
     const std::string &name() const { return _username; }
 
     static void setTest(bool isTesting) { _test = isTesting; }
+
+    /**
+     * @brief Set number of one-time keys generated with each key bundle
+     *
+     * @param count number of one-time keys, 0 for none
+     */
+    void setOneTimeKeys(size_t count) { _oneTimeKeys = count; }
+
     /**
      * @brief This function is called when transmission manager discovers new
      *        incoming request
@@ -164,12 +173,26 @@ class Client : public QObject, public Callable<void, std::stringstream &&> {
      */
     void receiveData(const Response &response);
 
+    /**
+     * Receive messages stored on server while offline, asks for the rest
+     * if the server did not send all of them
+     *
+     * @param response batch response obtained by user
+     */
+    void receiveBatch(const Response &response);
+
     /**
      * Get the message parsed by x3dh or ratchet
      * @return last message received
      */
     SendData &getMessage() { return _incomming; }
 
+    /**
+     * Get messages parsed from the last batch of stored messages
+     * @return messages in order of sending, clear when processed
+     */
+    std::vector<SendData> &getMessages() { return _inbox; }
+
     //
     // TESTING PURPOSE METHODS SECTION
     //
@@ -184,9 +207,11 @@ class Client : public QObject, public Callable<void, std::stringstream &&> {
     const std::string _username;
     const zero::str_t _password;
     uint32_t _userId = 0;
+    size_t _oneTimeKeys = DEFAULT_ONE_TIME_KEYS;
 
     // todo think of better way to get incomming message
     SendData _incomming;
+    std::vector<SendData> _inbox;
     std::map<uint32_t, std::string> _userList;
 
     RSA2048 _rsa, _rsa_pub;
@@ -244,6 +269,12 @@ class Client : public QObject, public Callable<void, std::stringstream &&> {
      */
     void archiveKey(const std::string &keyFileName);
 
+    /**
+     * Archives one-time keys generated before the keystore, each key in
+     * its own file; the files are removed so that the keystore is used
+     */
+    void archiveLegacyOneTimeKeys();
+
     bool hasRatchet(uint32_t id) const;
 
     void decryptInitialMessage(SendData &sendData, Response::Type type);
@@ -26,29 +26,13 @@ struct DRStatePair : Serializable<DRStatePair> {
 
     DRStatePair(uint32_t id, DRState state) : id(id), state(std::move(state)) {}
 
-    serialize::structure& serialize(
-        serialize::structure& result) const override {
-        serialize::serialize(id, result);
-        serialize::serialize(state, result);
-        return result;
-    }
-    serialize::structure serialize() const override {
-        serialize::structure result;
-        return serialize(result);
-    }
+    void write(serialize::Writer& out) const override { out << id << state; }
 
-    static DRStatePair deserialize(const serialize::structure& data,
-                                   uint64_t& from) {
+    static DRStatePair read(serialize::Reader& in) {
         DRStatePair result;
-        result.id = serialize::deserialize<decltype(result.id)>(data, from);
-        result.state =
-            serialize::deserialize<decltype(result.state)>(data, from);
+        in >> result.id >> result.state;
         return result;
     }
-    static DRStatePair deserialize(const serialize::structure& data) {
-        uint64_t from = 0;
-        return deserialize(data, from);
-    }
 };
 
 struct X3DHInitialMessage : Serializable<X3DHInitialMessage> {
@@ -60,29 +44,13 @@ struct X3DHInitialMessage : Serializable<X3DHInitialMessage> {
     X3DHInitialMessage(uint32_t id, X3DHRequest<C25519> message)
         : id(id), message(std::move(message)) {}
 
-    serialize::structure& serialize(
-        serialize::structure& result) const override {
-        serialize::serialize(id, result);
-        serialize::serialize(message, result);
-        return result;
-    }
-    serialize::structure serialize() const override {
-        serialize::structure result;
-        return serialize(result);
-    }
+    void write(serialize::Writer& out) const override { out << id << message; }
 
-    static X3DHInitialMessage deserialize(const serialize::structure& data,
-                                          uint64_t& from) {
+    static X3DHInitialMessage read(serialize::Reader& in) {
         X3DHInitialMessage result;
-        result.id = serialize::deserialize<decltype(result.id)>(data, from);
-        result.message =
-            serialize::deserialize<decltype(result.message)>(data, from);
+        in >> result.id >> result.message;
         return result;
     }
-    static X3DHInitialMessage deserialize(const serialize::structure& data) {
-        uint64_t from = 0;
-        return deserialize(data, from);
-    }
 };
 
 struct ClientState : Serializable<ClientState> {
@@ -92,33 +60,15 @@ struct ClientState : Serializable<ClientState> {
 
     ClientState() = default;
 
-    serialize::structure& serialize(
-        serialize::structure& result) const override {
-        serialize::serialize(states, result);
-        serialize::serialize(messages, result);
-        serialize::serialize(timestamp, result);
-        return result;
-    }
-    serialize::structure serialize() const override {
-        serialize::structure result;
-        return serialize(result);
+    void write(serialize::Writer& out) const override {
+        out << states << messages << timestamp;
     }
 
-    static ClientState deserialize(const serialize::structure& data,
-                                   uint64_t& from) {
+    static ClientState read(serialize::Reader& in) {
         ClientState result;
-        result.states =
-            serialize::deserialize<decltype(result.states)>(data, from);
-        result.messages =
-            serialize::deserialize<decltype(result.messages)>(data, from);
-        result.timestamp =
-            serialize::deserialize<decltype(result.timestamp)>(data, from);
+        in >> result.states >> result.messages >> result.timestamp;
         return result;
     }
-    static ClientState deserialize(const serialize::structure& data) {
-        uint64_t from = 0;
-        return deserialize(data, from);
-    }
 };
 
 }    // namespace helloworld
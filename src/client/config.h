@@ -26,5 +26,7 @@ const std::string preC25519priv{"_prekey.key"};
 const std::string preC25519pub{"_prekey.pub"};
 const std::string oneTimeC25519priv{"_onetime.key"};
 const std::string oneTimeC25519pub{"_onetime.pub"};
+// all one-time private keys, replaces the files above
+const std::string oneTimeKeystore{"_onetime.keys"};
 
 #endif //HELLOWORLD_CLIENT_CONFIG_H_
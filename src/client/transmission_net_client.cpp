@@ -5,7 +5,7 @@
 #include <cstdint>
 #include <memory>
 #include <sstream>
-#include "../shared/base_64.h"
+#include "../shared/framing.h"
 #include "../shared/transmission.h"
 #include "../shared/utils.h"
 
@@ -34,15 +34,15 @@ void ClientSocket::setHostAddress(const std::string &address) {
 
 void ClientSocket::setHostPort(uint16_t port) { _port = port; }
 
+void ClientSocket::setProtocol(WireProtocol protocol) { _protocol = protocol; }
+
 void ClientSocket::send(std::iostream &data) {
-    std::stringstream inBase;
-    _base64.fromStream(data, inBase);
-    inBase << '\0';    // to distinguish messages
+    std::stringstream frame;
+    _codec.encode(data, frame);
     if (!wait_connected()) {
         return;
     }
-    QByteArray qdata(inBase.str().data(),
-                     static_cast<int>(inBase.str().size()));
+    QByteArray qdata(frame.str().data(), static_cast<int>(frame.str().size()));
     _socket->write(qdata);
     _socket->flush();
     emit sent();
@@ -60,21 +60,39 @@ void ClientSocket::onError(QAbstractSocket::SocketError /*socketError*/) {
 
 void ClientSocket::receive() {
     QByteArray data = _socket->readAll();
-    std::stringstream ss(data.toStdString());
-    std::string line;
-    while (!std::getline(ss, line, '\0').eof()) {
-        std::stringstream inBase(line), fromBase{};
-        _base64.toStream(inBase, fromBase);
-        callback->callback(std::move(fromBase));
+    _codec.feed(data.data(), static_cast<size_t>(data.size()));
+    std::vector<unsigned char> frame;
+    while (true) {
+        try {
+            if (!_codec.next(frame)) break;
+        } catch (Error & /*invalid frame*/) {
+            // the stream cannot be resynchronized
+            closeConnection();
+            return;
+        }
+        callback->callback(stream_from_vector(frame));
     }
     emit received();
 }
 
 void ClientSocket::init() {
+    _codec = FrameCodec(_protocol);
     _socket->connectToHost(_address, static_cast<quint16>(_port));
-    if (wait_connected()) {
-        _status = OK;
+    if (!wait_connected()) return;
+
+    std::vector<unsigned char> handshake = _codec.handshake();
+    if (!handshake.empty()) {
+        _socket->write(reinterpret_cast<const char *>(handshake.data()),
+                       static_cast<qint64>(handshake.size()));
+        // the announcement would corrupt the first legacy frame
+        if (!wait_acknowledged()) {
+            _socket->abort();
+            _codec = FrameCodec(WireProtocol::LEGACY_BASE64);
+            _socket->connectToHost(_address, static_cast<quint16>(_port));
+            if (!wait_connected()) return;
+        }
     }
+    _status = OK;
 }
 
 void ClientSocket::_state_change(QAbstractSocket::SocketState state) {
@@ -86,6 +104,14 @@ void ClientSocket::_state_change(QAbstractSocket::SocketState state) {
     }
 }
 
+bool ClientSocket::wait_acknowledged() {
+    // readyRead is emitted from the wait, receive() feeds the codec
+    while (!_codec.acknowledged()) {
+        if (!_socket->waitForReadyRead(HANDSHAKE_TIMEOUT)) return false;
+    }
+    return true;
+}
+
 bool ClientSocket::wait_connected() {
     while (_socket->state() == QAbstractSocket::SocketState::ConnectingState &&
            !_socket->waitForConnected())
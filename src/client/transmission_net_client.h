@@ -12,7 +12,7 @@
 #include <cstdint>
 #include <memory>
 #include <sstream>
-#include "../shared/base_64.h"
+#include "../shared/framing.h"
 #include "../shared/transmission.h"
 #include "../shared/utils.h"
 
@@ -20,7 +20,11 @@ namespace helloworld {
 
 class ClientSocket : public QObject, public UserTransmissionManager {
     Q_OBJECT
-    Base64 _base64;
+    WireProtocol _protocol{WireProtocol::BINARY};
+    FrameCodec _codec{_protocol};
+
+    // milliseconds to wait for the server to acknowledge binary frames
+    static constexpr int HANDSHAKE_TIMEOUT = 3000;
 
     qint16 _port{};
     QString _address{};
@@ -55,6 +59,13 @@ class ClientSocket : public QObject, public UserTransmissionManager {
      */
     void setHostPort(uint16_t port);
 
+    /**
+     * Set wire protocol to announce on next init(), legacy base64
+     * is kept for servers that do not support binary frames
+     * @param protocol protocol to use
+     */
+    void setProtocol(WireProtocol protocol);
+
     void send(std::iostream &data) override;
 
     /**
@@ -109,6 +120,12 @@ class ClientSocket : public QObject, public UserTransmissionManager {
 
    private:
     bool wait_connected();
+
+    /**
+     * Wait for the server to answer the protocol announcement
+     * @return false if the server stayed silent (speaks only legacy)
+     */
+    bool wait_acknowledged();
 };
 
 }    // namespace helloworld
@@ -0,0 +1,101 @@
+#include "cached_database.h"
+
+#include <chrono>
+
+namespace helloworld {
+
+CachedDatabase::CachedDatabase(std::unique_ptr<ServerDatabase> database,
+                               size_t capacity)
+    : _database(std::move(database)), _byId(capacity), _byName(capacity) {}
+
+CacheMetrics CachedDatabase::metrics() const {
+    CacheMetrics metrics;
+    metrics.hits = _hits.load();
+    metrics.misses = _misses.load();
+    metrics.hitTime = _hitTime.load();
+    metrics.missTime = _missTime.load();
+    metrics.size = _byId.size();
+    return metrics;
+}
+
+uint32_t CachedDatabase::insert(const UserData &data, bool autoIncrement) {
+    uint32_t id = _database->insert(data, autoIncrement);
+    _invalidate(id, data.name);
+    return id;
+}
+
+UserData CachedDatabase::select(const UserData &query) const {
+    if (query.id == 0 && query.name.empty()) return {};
+
+    if (query.id == 0) return select(query.name);
+
+    return select(query.id);
+}
+
+UserData CachedDatabase::select(uint32_t id) const {
+    return _select(_byId, id);
+}
+
+UserData CachedDatabase::select(const std::string &username) const {
+    return _select(_byName, username);
+}
+
+bool CachedDatabase::remove(const UserData &data) {
+    UserData user = _database->select(data);
+    bool removed = _database->remove(data);
+    _invalidate(data.id, data.name);
+    if (!user.name.empty()) _invalidate(user.id, user.name);
+    return removed;
+}
+
+void CachedDatabase::drop() {
+    _database->drop();
+    _byId.clear();
+    _byName.clear();
+}
+
+void CachedDatabase::drop(const std::string &tablename) {
+    _database->drop(tablename);
+    _byId.clear();
+    _byName.clear();
+}
+
+template <typename Key>
+UserData CachedDatabase::_select(LruCache<Key, UserData> &cache,
+                                 const Key &key) const {
+    using std::chrono::duration_cast;
+    using std::chrono::nanoseconds;
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed = [&start]() {
+        return static_cast<uint64_t>(
+            duration_cast<nanoseconds>(std::chrono::steady_clock::now() -
+                                       start)
+                .count());
+    };
+
+    UserData user;
+    if (cache.find(key, user)) {
+        _hits++;
+        _hitTime += elapsed();
+        return user;
+    }
+
+    uint64_t idGeneration = _byId.generation();
+    uint64_t nameGeneration = _byName.generation();
+    user = _database->select(key);
+    // unknown users are not cached, they are looked up when registering
+    if (!user.name.empty()) {
+        _byId.insert(user.id, user, idGeneration);
+        _byName.insert(user.name, user, nameGeneration);
+    }
+    _misses++;
+    _missTime += elapsed();
+    return user;
+}
+
+void CachedDatabase::_invalidate(uint32_t id, const std::string &name) {
+    if (id != 0) _byId.erase(id);
+    if (!name.empty()) _byName.erase(name);
+}
+
+}    // namespace helloworld
@@ -0,0 +1,173 @@
+/**
+ * @file cached_database.h
+ * @brief Database decorator caching the users directory, id and name
+ *        lookups of users are answered from memory; with capacity larger
+ *        than the number of users the cache holds the whole directory
+ *
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef HELLOWORLD_SERVER_CACHED_DATABASE_H_
+#define HELLOWORLD_SERVER_CACHED_DATABASE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "database_server.h"
+#include "lru_cache.h"
+
+namespace helloworld {
+
+/**
+ * Snapshot of the users cache statistics, times in nanoseconds
+ */
+struct CacheMetrics {
+    uint64_t hits = 0;       /**< lookups answered from the cache */
+    uint64_t misses = 0;     /**< lookups that went to the database */
+    uint64_t hitTime = 0;    /**< time spent in hits, sum over lookups */
+    uint64_t missTime = 0;   /**< time spent in misses, sum over lookups */
+    size_t size = 0;         /**< users cached by id */
+
+    double hitRatio() const {
+        return hits + misses == 0
+                   ? 0
+                   : static_cast<double>(hits) / (hits + misses);
+    }
+};
+
+class CachedDatabase : public ServerDatabase {
+    std::unique_ptr<ServerDatabase> _database;
+    // lookups are const, the caches are not part of the observable state
+    mutable LruCache<uint32_t, UserData> _byId;
+    mutable LruCache<std::string, UserData> _byName;
+
+    mutable std::atomic<uint64_t> _hits{0};
+    mutable std::atomic<uint64_t> _misses{0};
+    mutable std::atomic<uint64_t> _hitTime{0};
+    mutable std::atomic<uint64_t> _missTime{0};
+
+   public:
+    /**
+     * @param database database to cache
+     * @param capacity maximum of users cached
+     */
+    explicit CachedDatabase(std::unique_ptr<ServerDatabase> database,
+                            size_t capacity = 100000);
+
+    CacheMetrics metrics() const;
+
+    /*
+     * CACHED, invalidated by insert() and remove()
+     */
+    uint32_t insert(const UserData &data, bool autoIncrement) override;
+    UserData select(const UserData &query) const override;
+    UserData select(uint32_t id) const override;
+    UserData select(const std::string &username) const override;
+    bool remove(const UserData &data) override;
+    void drop() override;
+    void drop(const std::string &tablename) override;
+
+    /*
+     * PASSED TO THE DATABASE
+     */
+    const std::vector<std::unique_ptr<UserData>> &selectLike(
+        const UserData &query) override {
+        return _database->selectLike(query);
+    }
+    const std::vector<std::unique_ptr<UserData>> &selectLike(
+        const std::string &username) override {
+        return _database->selectLike(username);
+    }
+    std::vector<UserData> searchUsers(const std::string &query,
+                                      uint32_t beforeId,
+                                      size_t limit) const override {
+        return _database->searchUsers(query, beforeId, limit);
+    }
+
+    void insertData(uint32_t userId,
+                    const std::vector<unsigned char> &blob) override {
+        _database->insertData(userId, blob);
+    }
+    std::vector<unsigned char> selectData(uint32_t userId) override {
+        return _database->selectData(userId);
+    }
+    std::vector<std::vector<unsigned char>> selectData(
+        uint32_t userId, size_t maxCount, size_t maxBytes,
+        bool &more) override {
+        return _database->selectData(userId, maxCount, maxBytes, more);
+    }
+    std::vector<std::vector<unsigned char>> peekData(
+        uint32_t userId, size_t maxCount, size_t maxBytes,
+        uint64_t &last, bool &more) override {
+        return _database->peekData(userId, maxCount, maxBytes, last, more);
+    }
+    void deleteData(uint32_t userId, uint64_t last) override {
+        _database->deleteData(userId, last);
+    }
+    void deleteAllData(uint32_t userId) override {
+        _database->deleteAllData(userId);
+    }
+
+    void insertBundle(uint32_t userId, const std::vector<unsigned char> &blob,
+                      uint64_t timestamp = 0) override {
+        _database->insertBundle(userId, blob, timestamp);
+    }
+    std::vector<unsigned char> selectBundle(uint32_t userId) const override {
+        return _database->selectBundle(userId);
+    }
+    uint64_t getBundleTimestamp(uint32_t userId) const override {
+        return _database->getBundleTimestamp(userId);
+    }
+    void updateBundle(uint32_t userId,
+                      const std::vector<unsigned char> &blob) override {
+        _database->updateBundle(userId, blob);
+    }
+    void updateBundle(uint32_t userId, const std::vector<unsigned char> &blob,
+                      uint64_t timestamp) override {
+        _database->updateBundle(userId, blob, timestamp);
+    }
+    bool removeBundle(uint32_t userId) override {
+        return _database->removeBundle(userId);
+    }
+    void insertOneTimeKeys(uint32_t userId,
+                           const std::vector<zero::bytes_t> &keys) override {
+        _database->insertOneTimeKeys(userId, keys);
+    }
+    std::pair<uint32_t, zero::bytes_t> popOneTimeKey(uint32_t userId) override {
+        return _database->popOneTimeKey(userId);
+    }
+    size_t countOneTimeKeys(uint32_t userId) const override {
+        return _database->countOneTimeKeys(userId);
+    }
+    void replaceBundle(uint32_t userId, const std::vector<unsigned char> &blob,
+                       const std::vector<zero::bytes_t> &keys) override {
+        _database->replaceBundle(userId, blob, keys);
+    }
+    ClaimedBundle claimBundle(uint32_t userId,
+                              uint64_t expiredTimestamp) override {
+        return _database->claimBundle(userId, expiredTimestamp);
+    }
+
+   private:
+    /**
+     * Look the user up in the cache, on miss load him from the database
+     * and cache him under both the id and the name
+     */
+    template <typename Key>
+    UserData _select(LruCache<Key, UserData> &cache, const Key &key) const;
+
+    /**
+     * Forget user under both keys
+     */
+    void _invalidate(uint32_t id, const std::string &name);
+};
+
+}    // namespace helloworld
+
+#endif    // HELLOWORLD_SERVER_CACHED_DATABASE_H_
@@ -13,11 +13,23 @@
 #define HELLOWORLD_SERVER_DATABASE_H_
 
 #include <memory>
+#include <utility>
+#include <vector>
 
 #include "../shared/user_data.h"
 
 namespace helloworld {
 
+/**
+ * Key bundle with the one-time key claimed for a sender, read at once
+ */
+struct ClaimedBundle {
+    std::vector<unsigned char> bundle;    // empty if the user has none
+    uint64_t timestamp = 0;
+    uint32_t oneTimeKeyId = 0;
+    zero::bytes_t oneTimeKey;             // empty if none was left
+    size_t oneTimeKeysLeft = 0;
+};
 
 class ServerDatabase {
 
@@ -79,6 +91,18 @@ public:
      */
     virtual const std::vector<std::unique_ptr<UserData>> &selectLike(const std::string& username) = 0;
 
+    /**
+     * Search users whose name contains the query, newest first; only id
+     * and name are read, the public key is left empty
+     *
+     * @param query searched substring, case insensitive for ascii letters
+     * @param beforeId return only users with smaller id, 0 starts from the newest
+     * @param limit maximum number of users returned
+     * @return std::vector<UserData> users matching the query
+     */
+    virtual std::vector<UserData> searchUsers(const std::string& query, uint32_t beforeId,
+                                              size_t limit) const = 0;
+
     /**
      * Delete user from database
      *
@@ -113,6 +137,41 @@ public:
      */
     virtual std::vector<unsigned char> selectData(uint32_t userId) = 0;
 
+    /**
+     * Destructively read the oldest blobs stored for the user with given id,
+     * selected and deleted atomically
+     * @param userId userid to choose
+     * @param maxCount maximum number of blobs to read
+     * @param maxBytes maximum total size of blobs, the first blob is always
+     *        read even if larger
+     * @param more set to whether blobs remain stored after the batch
+     * @return blobs in the order of insertion, the database no longer holds them
+     */
+    virtual std::vector<std::vector<unsigned char>> selectData(uint32_t userId, size_t maxCount,
+                                                               size_t maxBytes, bool &more) = 0;
+
+    /**
+     * Read the oldest blobs stored for the user with given id without
+     * deleting them, delete them by deleteData() once delivered
+     * @param userId userid to choose
+     * @param maxCount maximum number of blobs to read
+     * @param maxBytes maximum total size of blobs, the first blob is always
+     *        read even if larger
+     * @param last id of the last blob read, to pass to deleteData()
+     * @param more set to whether blobs follow the batch
+     * @return blobs in the order of insertion
+     */
+    virtual std::vector<std::vector<unsigned char>> peekData(uint32_t userId, size_t maxCount,
+                                                             size_t maxBytes, uint64_t &last,
+                                                             bool &more) = 0;
+
+    /**
+     * Delete blobs of the user read by peekData()
+     * @param userId userid to choose
+     * @param last id of the last blob to delete
+     */
+    virtual void deleteData(uint32_t userId, uint64_t last) = 0;
+
     /**
      * Delete all inserted data with provided id (userId)
      * @param userId of which to delete all the data
@@ -151,12 +210,53 @@ public:
     virtual void updateBundle(uint32_t userId, const std::vector<unsigned char> &blob, uint64_t timestamp) = 0;
 
     /**
-     * Delete key bundle from database
+     * Delete key bundle and one-time keys from database
      * @param userId userid as primary key
      * @return true if succeeded
      */
     virtual bool removeBundle(uint32_t userId) = 0;
 
+    /**
+     * Replace one-time keys of the user, stored apart from the key bundle
+     * @param userId keys owner
+     * @param keys one-time keys, the key id is the index in the vector
+     */
+    virtual void insertOneTimeKeys(uint32_t userId, const std::vector<zero::bytes_t> &keys) = 0;
+
+    /**
+     * Atomically claim one of the one-time keys, the key is deleted
+     * so no one else can claim it
+     * @param userId keys owner
+     * @return key id and the key, empty key if the user has none
+     */
+    virtual std::pair<uint32_t, zero::bytes_t> popOneTimeKey(uint32_t userId) = 0;
+
+    /**
+     * Number of one-time keys left
+     * @param userId keys owner
+     * @return number of keys
+     */
+    virtual size_t countOneTimeKeys(uint32_t userId) const = 0;
+
+    /**
+     * Store key bundle and replace the one-time keys in one transaction,
+     * a bundle is never read with one-time keys of another one
+     * @param userId bundle owner
+     * @param blob key bundle without one-time keys
+     * @param keys one-time keys, the key id is the index in the vector
+     */
+    virtual void replaceBundle(uint32_t userId, const std::vector<unsigned char> &blob,
+                               const std::vector<zero::bytes_t> &keys) = 0;
+
+    /**
+     * Read key bundle and claim one of its one-time keys in one transaction,
+     * the bundle timestamp is set to expiredTimestamp once no key is left
+     * @param userId bundle owner
+     * @param expiredTimestamp timestamp marking the bundle to be updated
+     * @return bundle with the claimed key, empty bundle if the user has none
+     */
+    virtual ClaimedBundle claimBundle(uint32_t userId, uint64_t expiredTimestamp) = 0;
+
 };
 
 } //  namespace helloworld
@@ -10,6 +10,7 @@
 
 #include <QMutex>
 #include <QObject>
+#include <algorithm>
 #include <memory>
 
 #include "server.h"
@@ -33,8 +34,10 @@ class LogApp : public QObject {
         : QObject(parent),
           os(os),
           server(std::make_unique<Server>(std::move(password))) {
-        server->setTransmissionManager(
-            std::make_unique<ServerTCP>(server.get()));
+        // requests are processed outside of the socket threads
+        server->setTransmissionManager(std::make_unique<ServerTCP>(
+            server.get(),
+            static_cast<size_t>(std::max(1, QThread::idealThreadCount()))));
 
         auto ptr = dynamic_cast<ServerTCP *>(server->getTransmisionManger());
         assert(ptr);
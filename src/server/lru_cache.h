@@ -0,0 +1,143 @@
+/**
+ * @file lru_cache.h
+ * @brief Bounded least recently used cache, sharded by key so that
+ *        concurrent lookups of different keys do not contend
+ *
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef HELLOWORLD_SERVER_LRU_CACHE_H_
+#define HELLOWORLD_SERVER_LRU_CACHE_H_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace helloworld {
+
+template <typename Key, typename Value, size_t SHARDS = 16>
+class LruCache {
+    using Items = std::list<std::pair<Key, Value>>;
+
+    struct Shard {
+        mutable std::mutex mutex;
+        // most recently used first
+        Items items;
+        std::unordered_map<Key, typename Items::iterator> index;
+    };
+
+    std::array<Shard, SHARDS> _shards;
+    size_t _shardCapacity;
+    // bumped by every erase, see insert()
+    std::atomic<uint64_t> _generation{0};
+
+    Shard &_shard(const Key &key) {
+        return _shards[std::hash<Key>{}(key) % SHARDS];
+    }
+
+   public:
+    /**
+     * @param capacity maximum of cached values, split evenly among shards
+     */
+    explicit LruCache(size_t capacity)
+        : _shardCapacity(std::max<size_t>(1, capacity / SHARDS)) {}
+
+    // Copying is not available
+    LruCache(const LruCache &other) = delete;
+
+    LruCache &operator=(const LruCache &other) = delete;
+
+    /**
+     * @brief Generation to pass to insert(), get it before reading
+     *        the value from its source
+     */
+    uint64_t generation() const { return _generation.load(); }
+
+    /**
+     * @brief Find value and mark it as recently used
+     *
+     * @return true if found, the value is copied to result
+     */
+    bool find(const Key &key, Value &result) {
+        Shard &shard = _shard(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(key);
+        if (it == shard.index.end()) return false;
+        shard.items.splice(shard.items.begin(), shard.items, it->second);
+        result = it->second->second;
+        return true;
+    }
+
+    /**
+     * @brief Insert or replace value, the least recently used value
+     *        of the shard is evicted if the shard is full
+     *
+     * @param generation generation() read before the value was loaded,
+     *        nothing is inserted if any key was erased since; the value
+     *        could be loaded before the erase and be stale
+     * @return true if inserted
+     */
+    bool insert(const Key &key, Value value, uint64_t generation) {
+        Shard &shard = _shard(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (_generation.load() != generation) return false;
+
+        auto it = shard.index.find(key);
+        if (it != shard.index.end()) {
+            it->second->second = std::move(value);
+            shard.items.splice(shard.items.begin(), shard.items, it->second);
+            return true;
+        }
+        shard.items.emplace_front(key, std::move(value));
+        shard.index.emplace(key, shard.items.begin());
+        if (shard.items.size() > _shardCapacity) {
+            shard.index.erase(shard.items.back().first);
+            shard.items.pop_back();
+        }
+        return true;
+    }
+
+    void erase(const Key &key) {
+        // before taking the lock, so that insert() under the lock
+        // either comes before the erase or sees the new generation
+        ++_generation;
+        Shard &shard = _shard(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(key);
+        if (it == shard.index.end()) return;
+        shard.items.erase(it->second);
+        shard.index.erase(it);
+    }
+
+    void clear() {
+        ++_generation;
+        for (Shard &shard : _shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.index.clear();
+            shard.items.clear();
+        }
+    }
+
+    size_t size() const {
+        size_t size = 0;
+        for (const Shard &shard : _shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            size += shard.items.size();
+        }
+        return size;
+    }
+};
+
+}    // namespace helloworld
+
+#endif    // HELLOWORLD_SERVER_LRU_CACHE_H_
@@ -9,6 +9,15 @@
 #define NET_UTILS_H
 
 #include <QThread>
+#include <QTcpSocket>
+#include <QReadWriteLock>
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <unordered_map>
+
+#include "../shared/framing.h"
 
 namespace helloworld {
 
@@ -31,6 +40,205 @@ public slots:
     }
 };
 
+/**
+ * @brief The SocketCodec class frame codec bound to the socket lifetime,
+ *        as a child of the socket it moves between threads with it
+ */
+class SocketCodec : public QObject {
+Q_OBJECT
+public:
+    FrameCodec codec;
+
+    explicit SocketCodec(QObject *parent = nullptr)
+            : QObject(parent) {
+    }
+
+    /**
+     * @brief codec attached to the socket, created on first use
+     * @param socket socket to get the codec of
+     * @return socket codec
+     */
+    static FrameCodec &of(QTcpSocket *socket) {
+        auto *holder = socket->findChild<SocketCodec *>(QString(), Qt::FindDirectChildrenOnly);
+        if (!holder)
+            holder = new SocketCodec(socket);
+        return holder->codec;
+    }
+};
+
+/**
+ * @brief The ShardedHashMap class concurrent hash map, keys are split into
+ *        independently locked shards so lookups of different keys do not
+ *        contend and never wait for a writer of another shard
+ */
+template<typename Key, typename Value, size_t SHARDS = 16>
+class ShardedHashMap {
+    struct Shard {
+        mutable QReadWriteLock lock;
+        std::unordered_map<Key, Value> map;
+    };
+    std::array<Shard, SHARDS> _shards;
+
+    Shard &_shard(const Key &key) {
+        return _shards[std::hash<Key>{}(key) % SHARDS];
+    }
+
+    const Shard &_shard(const Key &key) const {
+        return _shards[std::hash<Key>{}(key) % SHARDS];
+    }
+
+public:
+    /**
+     * @brief insert or overwrite value of key
+     */
+    void insert(const Key &key, Value value) {
+        Shard &shard = _shard(key);
+        QWriteLocker locker(&shard.lock);
+        shard.map[key] = std::move(value);
+    }
+
+    /**
+     * @brief insert value only if key is not present yet
+     * @return true if inserted
+     */
+    bool emplace(const Key &key, Value value) {
+        Shard &shard = _shard(key);
+        QWriteLocker locker(&shard.lock);
+        return shard.map.emplace(key, std::move(value)).second;
+    }
+
+    /**
+     * @brief erase key
+     * @return true if key was present
+     */
+    bool erase(const Key &key) {
+        Shard &shard = _shard(key);
+        QWriteLocker locker(&shard.lock);
+        return shard.map.erase(key) > 0;
+    }
+
+    /**
+     * @brief erase key only if it still maps to the expected value
+     * @return true if erased
+     */
+    bool erase(const Key &key, const Value &expected) {
+        Shard &shard = _shard(key);
+        QWriteLocker locker(&shard.lock);
+        auto found = shard.map.find(key);
+        if (found == shard.map.end() || !(found->second == expected))
+            return false;
+        shard.map.erase(found);
+        return true;
+    }
+
+    /**
+     * @brief find value of key
+     * @param key key to look for
+     * @param value set to the found value, untouched otherwise
+     * @return true if found
+     */
+    bool find(const Key &key, Value &value) const {
+        const Shard &shard = _shard(key);
+        QReadLocker locker(&shard.lock);
+        auto found = shard.map.find(key);
+        if (found == shard.map.end())
+            return false;
+        value = found->second;
+        return true;
+    }
+
+    bool contains(const Key &key) const {
+        const Shard &shard = _shard(key);
+        QReadLocker locker(&shard.lock);
+        return shard.map.find(key) != shard.map.end();
+    }
+
+    /**
+     * @brief call function on each entry, one shard locked at a time
+     * @param function callable with (const Key &, const Value &)
+     */
+    template<typename Function>
+    void forEach(Function function) const {
+        for (const Shard &shard : _shards) {
+            QReadLocker locker(&shard.lock);
+            for (const auto &entry : shard.map)
+                function(entry.first, entry.second);
+        }
+    }
+};
+
+/**
+ * @brief The MpscQueue class unbounded lock-free queue, any number of threads
+ *        may push, only one thread (the owner) may pop
+ *        push is wait-free, a single atomic exchange
+ */
+template<typename T>
+class MpscQueue {
+    struct Node {
+        std::atomic<Node *> next{nullptr};
+        T value;
+
+        Node() = default;
+
+        explicit Node(T value) : value(std::move(value)) {}
+    };
+
+    std::atomic<Node *> _head;  // last pushed node, producers side
+    Node *_tail;                // already consumed node, consumer side
+
+public:
+    MpscQueue() : _head(new Node()), _tail(_head.load()) {}
+
+    MpscQueue(const MpscQueue &other) = delete;
+
+    MpscQueue &operator=(const MpscQueue &other) = delete;
+
+    ~MpscQueue() {
+        T ignored;
+        while (pop(ignored));
+        delete _tail;
+    }
+
+    /**
+     * @brief add value to the end of queue, callable from any thread
+     */
+    void push(T value) {
+        Node *node = new Node(std::move(value));
+        Node *previous = _head.exchange(node, std::memory_order_acq_rel);
+        previous->next.store(node, std::memory_order_release);
+    }
+
+    /**
+     * @brief take value from the front of queue, consumer thread only
+     * @param value set to the taken value
+     * @return false if queue empty (or producer not finished pushing yet)
+     */
+    bool pop(T &value) {
+        Node *next = _tail->next.load(std::memory_order_acquire);
+        if (!next)
+            return false;
+        value = std::move(next->value);
+        delete _tail;
+        _tail = next;
+        return true;
+    }
+};
+
+/**
+ * @brief The SocketTask struct work for socket posted to its owning thread
+ */
+struct SocketTask {
+    enum class Action {
+        WRITE,      /**< write data (complete frame) to socket */
+        SEND,       /**< frame data with the socket codec and write it */
+        CLOSE,      /**< disconnect socket */
+        REGISTER    /**< hand socket over to a thread, data holds username */
+    };
+    Action action = Action::WRITE;
+    QTcpSocket *socket = nullptr;
+    QByteArray data;
+};
+
 /**
  * PtrWrap, wraps raw pointer of any type ( made so Qthreaddata doesnt delete ptr content )
  */
@@ -0,0 +1,107 @@
+#include "presence.h"
+
+namespace helloworld {
+
+uint64_t PresenceRegistry::online(const std::string &name, uint32_t id) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _online.find(name);
+    if (it != _online.end() && it->second == id) return _version;
+    _online[name] = id;
+    _record(name, id, true);
+    return _version;
+}
+
+uint64_t PresenceRegistry::offline(const std::string &name) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _online.find(name);
+    if (it == _online.end()) return _version;
+    uint32_t id = it->second;
+    _online.erase(it);
+    _record(name, id, false);
+    return _version;
+}
+
+uint64_t PresenceRegistry::version() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _version;
+}
+
+size_t PresenceRegistry::size() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _online.size();
+}
+
+std::shared_ptr<const std::vector<unsigned char>> PresenceRegistry::snapshot()
+    const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_snapshot == nullptr) {
+        UserListReponse response;
+        response.version = _version;
+        response.ids.reserve(_online.size());
+        response.online.reserve(_online.size());
+        for (const auto &user : _online) {
+            response.online.push_back(user.first);
+            response.ids.push_back(user.second);
+        }
+        _snapshot = std::make_shared<const std::vector<unsigned char>>(
+            response.serialize());
+    }
+    return _snapshot;
+}
+
+UserListReponse PresenceRegistry::page(const std::string &after,
+                                       size_t limit) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    UserListReponse response;
+    response.version = _version;
+    for (auto it = _online.upper_bound(after);
+         it != _online.end() && (limit == 0 || response.ids.size() < limit);
+         ++it) {
+        response.online.push_back(it->first);
+        response.ids.push_back(it->second);
+    }
+    return response;
+}
+
+UserListReponse PresenceRegistry::changes(uint64_t since) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    UserListReponse response;
+    response.version = _version;
+    // changes after since are no longer all kept, send everything
+    if (since > _version ||
+        (!_changes.empty() && _changes.front().version > since + 1) ||
+        (_changes.empty() && since < _version)) {
+        for (const auto &user : _online) {
+            response.online.push_back(user.first);
+            response.ids.push_back(user.second);
+        }
+        return response;
+    }
+
+    response.delta = true;
+    // only the last change of each user counts
+    std::map<std::string, const Change *> last;
+    for (auto it = _changes.rbegin(); it != _changes.rend(); ++it) {
+        if (it->version <= since) break;
+        last.emplace(it->name, &*it);
+    }
+    for (const auto &user : last) {
+        if (user.second->online) {
+            response.online.push_back(user.first);
+            response.ids.push_back(user.second->id);
+        } else {
+            response.offline.push_back(user.second->id);
+        }
+    }
+    return response;
+}
+
+void PresenceRegistry::_record(const std::string &name, uint32_t id,
+                               bool online) {
+    ++_version;
+    _snapshot.reset();
+    _changes.push_back({_version, name, id, online});
+    if (_changes.size() > _maxChanges) _changes.pop_front();
+}
+
+}    // namespace helloworld
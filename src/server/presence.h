@@ -0,0 +1,111 @@
+/**
+ * @file presence.h
+ * @brief Registry of authenticated users, maintained on login and logout
+ *        so that the online list needs no database lookups
+ *        - every change gets a new version, recent changes are kept
+ *          to answer "what changed since version N"
+ *        - the serialized full list is rebuilt only after a change
+ *
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef HELLOWORLD_SERVER_PRESENCE_H_
+#define HELLOWORLD_SERVER_PRESENCE_H_
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../shared/responses.h"
+
+namespace helloworld {
+
+class PresenceRegistry {
+    struct Change {
+        uint64_t version;
+        std::string name;
+        uint32_t id;
+        bool online;
+    };
+
+    mutable std::mutex _mutex;
+    // ordered by name, pages continue after the last name sent
+    std::map<std::string, uint32_t> _online;
+    std::deque<Change> _changes;
+    size_t _maxChanges;
+    uint64_t _version = 0;
+    mutable std::shared_ptr<const std::vector<unsigned char>> _snapshot;
+
+   public:
+    /**
+     * @param maxChanges number of recent changes kept for delta queries,
+     *        older versions get the full list instead
+     */
+    explicit PresenceRegistry(size_t maxChanges = 4096)
+        : _maxChanges(maxChanges) {}
+
+    // Copying is not available
+    PresenceRegistry(const PresenceRegistry &other) = delete;
+
+    PresenceRegistry &operator=(const PresenceRegistry &other) = delete;
+
+    /**
+     * @brief Mark user online
+     *
+     * @return version after the change
+     */
+    uint64_t online(const std::string &name, uint32_t id);
+
+    /**
+     * @brief Mark user offline, nothing changes if the user is not online
+     *
+     * @return version after the change
+     */
+    uint64_t offline(const std::string &name);
+
+    uint64_t version() const;
+
+    size_t size() const;
+
+    /**
+     * @brief Serialized UserListReponse with all online users, shared
+     *        by all callers until the next change
+     */
+    std::shared_ptr<const std::vector<unsigned char>> snapshot() const;
+
+    /**
+     * @brief Online users ordered by name
+     *
+     * @param after return only users with name greater than this,
+     *        empty for the first page
+     * @param limit maximum of users returned, 0 for no limit
+     */
+    UserListReponse page(const std::string &after, size_t limit) const;
+
+    /**
+     * @brief Users that came online or went offline after given version;
+     *        full list if the changes are no longer kept
+     *
+     * @param since version the caller has seen
+     * @return delta with users online and ids of users gone, or full list
+     */
+    UserListReponse changes(uint64_t since) const;
+
+   private:
+    /**
+     * Record change, the caller must hold the lock
+     */
+    void _record(const std::string &name, uint32_t id, bool online);
+};
+
+}    // namespace helloworld
+
+#endif    // HELLOWORLD_SERVER_PRESENCE_H_
@@ -14,7 +14,8 @@ bool Server::_test{false};
 
 Server::Server(zero::str_t password)
     : _genericManager("server_priv.pem", std::move(password)),
-      _database(std::make_unique<ServerSQLite>("test_db1")) {}
+      _database(std::make_unique<CachedDatabase>(
+          std::make_unique<ServerSQLite>("test_db1"))) {}
 
 Response Server::handleUserRequest(const Request &request,
                                    const std::string &username) {
@@ -48,6 +49,12 @@ Response Server::handleUserRequest(const Request &request,
     }
 }
 
+Response Server::handleUserRequest(const RequestView &request,
+                                   const std::string &username) {
+    if (request.header.type == Request::Type::SEND) return forward(request);
+    return handleUserRequest(request.toOwned(), username);
+}
+
 Response Server::registerUser(const Request &request) {
     AuthenticateRequest registerRequest =
         AuthenticateRequest::deserialize(request.payload);
@@ -63,23 +70,12 @@ Response Server::registerUser(const Request &request) {
     std::vector<unsigned char> challengeBytes =
         _random.get(CHALLENGE_SECRET_LENGTH);
 
-    {
-        QWriteLocker lock(&_requestLock);
-        bool inserted =
-            _requestsToConnect
-                .emplace(userData.name,
-                         std::make_pair(std::make_unique<Challenge>(
-                                            userData, challengeBytes,
-                                            registerRequest.sessionKey),
-                                        true))
-                .second;
-        if (!inserted)
-            throw Error("User " + userData.name +
-                        " is already in the process of verification.");
-
-        if (_test)
-            _requestsToConnect[userData.name].first->manager->_testing = _test;
-    }
+    auto challenge = std::make_shared<Challenge>(
+        userData, challengeBytes, registerRequest.sessionKey, true);
+    if (_test) challenge->manager->_testing = _test;
+    if (!_requestsToConnect.emplace(userData.name, challenge))
+        throw Error("User " + userData.name +
+                    " is already in the process of verification.");
 
     log("Registration: " + registerRequest.name);
     _transmission->registerConnection(registerRequest.name);
@@ -95,12 +91,11 @@ Response Server::completeAuthentication(const Request &request) {
     CompleteAuthRequest curRequest =
         CompleteAuthRequest::deserialize(request.payload);
 
-    QReadLocker lock(&_requestLock);
-    auto authentication = _requestsToConnect.find(curRequest.name);
-    if (authentication == _requestsToConnect.end()) {
+    std::shared_ptr<Challenge> authentication;
+    if (!_requestsToConnect.find(curRequest.name, authentication)) {
         throw Error("No pending registration for provided username.");
     }
-    bool newUser = authentication->second.second;
+    bool newUser = authentication->newUser;
 
     RSA2048 rsa;
     uint32_t userId = 0;
@@ -113,36 +108,30 @@ Response Server::completeAuthentication(const Request &request) {
         }
         rsa.setPublicKey(result.publicKey);
     } else {
-        rsa.setPublicKey(authentication->second.first->userData.publicKey);
+        rsa.setPublicKey(authentication->userData.publicKey);
     }
 
-    if (!rsa.verify(curRequest.secret, authentication->second.first->secret)) {
+    if (!rsa.verify(curRequest.secret, authentication->secret)) {
         throw Error("Cannot verify public key owner.");
     }
 
-    QWriteLocker lock2(&_connectionLock);
-    bool emplaced =
-        _connections
-            .emplace(curRequest.name,
-                     std::move(authentication->second.first->manager))
-            .second;
-    lock2.unlock();
-    if (!emplaced)
+    if (!_connections.emplace(curRequest.name, authentication->manager))
         throw Error("Invalid authentication under an online account.");
 
-    if (newUser)
-        userId =
-            _database->insert(authentication->second.first->userData, true);
-    lock.unlock();
-    QWriteLocker lock3(&_requestLock);    // todo better lock.lockForWrite(); ?
-    _requestsToConnect.erase(curRequest.name);
-    lock3.unlock();    // lock.unlock();
+    if (newUser) userId = _database->insert(authentication->userData, true);
+    // a new challenge could be issued meanwhile, erase only this one
+    _requestsToConnect.erase(curRequest.name, authentication);
+    _presence.online(curRequest.name, userId);
+    // the user could disconnect meanwhile, cleanup would not see him online
+    if (!_connections.contains(curRequest.name))
+        _presence.offline(curRequest.name);
 
     Response r = newUser ? Response{Response::Type::USER_REGISTERED, userId}
                          : checkEvent(userId);
     log("Authentification succes: " + curRequest.name);
     r.header.userId = userId;
     sendReponse(curRequest.name, r, getManagerPtr(curRequest.name, true));
+    if (!newUser) pushStoredMessages(curRequest.name, userId);
     return r;
 }
 
@@ -159,24 +148,16 @@ Response Server::authenticateUser(const Request &request) {
     if (result.name.empty())
         throw Error("User with given name is not registered.");
 
-    QReadLocker lock(&_connectionLock);
-    if (_connections.find(authenticateRequest.name) != _connections.end())
+    if (_connections.contains(authenticateRequest.name))
         throw Error("User is online.");
-    lock.unlock();
 
     std::vector<unsigned char> challengeBytes =
         _random.get(CHALLENGE_SECRET_LENGTH);
 
-    QWriteLocker lock2(&_requestLock);
-    bool inserted =
-        _requestsToConnect
-            .emplace(authenticateRequest.name,
-                     std::make_pair(std::make_unique<Challenge>(
-                                        userData, challengeBytes,
-                                        authenticateRequest.sessionKey),
-                                    false))
-            .second;
-    lock2.unlock();
+    bool inserted = _requestsToConnect.emplace(
+        authenticateRequest.name,
+        std::make_shared<Challenge>(userData, challengeBytes,
+                                    authenticateRequest.sessionKey, false));
     if (!inserted) {
         throw Error(
             "User with given name is already in the process of verification.");
@@ -195,16 +176,16 @@ Response Server::getOnline(const Request &request,
                            const std::string &username) {
     log("Get online: " + username);
 
-    const std::set<std::string> &users = _transmission->getOpenConnections();
-    std::vector<uint32_t> ids;
-    for (const auto &user : users) {
-        UserData data = _database->select(user);
-        ids.push_back(data.id);
+    GetOnline curRequest = GetOnline::deserialize(request.payload);
+    Response r = {Response::Type::USERLIST, request.header.userId};
+    if (curRequest.since != 0) {
+        r.payload = _presence.changes(curRequest.since).serialize();
+    } else if (curRequest.limit != 0 || !curRequest.after.empty()) {
+        r.payload =
+            _presence.page(curRequest.after, curRequest.limit).serialize();
+    } else {
+        r.payload = *_presence.snapshot();
     }
-
-    Response r = {
-        Response::Type::USERLIST, request.header.userId,
-        UserListReponse{{users.begin(), users.end()}, ids}.serialize()};
     sendReponse(username, r, getManagerPtr(username, true));
     return r;
 }
@@ -215,6 +196,8 @@ Response Server::checkIncoming(const Request &request,
 
     Response r = checkEvent(request.header.userId);
     sendReponse(username, r, getManagerPtr(username, true));
+    // stored messages go through the guarded push, never twice
+    pushStoredMessages(username, request.header.userId);
     return r;
 }
 
@@ -228,7 +211,11 @@ Response Server::deleteAccount(const Request &request,
     if (!_database->remove({curRequest.id, username, "", {}})) {
         r = {Response::Type::FAILED_TO_DELETE_USER, request.header.userId};
     } else {
-        _database->removeBundle(curRequest.id);
+        {
+            QMutexLocker locker(&_bundleLock);
+            _database->removeBundle(curRequest.id);
+            _bundleInfo.erase(curRequest.id);
+        }
         _database->deleteAllData(curRequest.id);
         r = {Response::Type::OK, 0};
     }
@@ -262,12 +249,17 @@ Response Server::resetSession(const std::string &name) {
 void Server::dropDatabase() { _database->drop(); }
 
 std::vector<std::string> Server::getUsers(const std::string &query) {
-    const auto &users = _database->selectLike({0, query, "", {}});
     std::vector<std::string> names{};
-    for (const auto &user : users) {
-        names.push_back(user->name);
+    uint32_t beforeId = 0;
+    while (true) {
+        std::vector<UserData> users =
+            _database->searchUsers(query, beforeId, MAX_SEARCH_RESULTS);
+        for (const auto &user : users) {
+            names.push_back(user.name);
+        }
+        if (users.size() < MAX_SEARCH_RESULTS) return names;
+        beforeId = users.back().id;
     }
-    return names;
 }
 
 Response Server::findUsers(const Request &request,
@@ -275,11 +267,14 @@ Response Server::findUsers(const Request &request,
     GetUsers curRequest = GetUsers::deserialize(request.payload);
     log("Find User: " + username + " ( query : \"" + curRequest.query + "\" )");
 
+    size_t limit = MAX_SEARCH_RESULTS;
+    if (curRequest.limit != 0 && curRequest.limit < limit)
+        limit = curRequest.limit;
     UserListReponse response;
-    const auto &users = _database->selectLike({0, curRequest.query, "", {}});
-    for (const auto &user : users) {
-        response.online.push_back(user->name);
-        response.ids.push_back(user->id);
+    for (auto &user : _database->searchUsers(curRequest.query,
+                                             curRequest.beforeId, limit)) {
+        response.online.push_back(std::move(user.name));
+        response.ids.push_back(user.id);
     }
     Response r = {{Response::Type::USERLIST, request.header.userId},
                   response.serialize()};
@@ -287,20 +282,32 @@ Response Server::findUsers(const Request &request,
     return r;
 }
 
-Response Server::forward(const Request &request) {
-    Response r = checkEvent(request.header.userId);
+Response Server::forward(const RequestView &request) {
+    // the header holds the receiver, checking his events here would drain
+    // his stored messages without delivering them
+    Response r = {Response::Type::OK, request.header.userId};
 
     // get receiver's name from database
     std::string receiver = _database->select(request.header.userId).name;
     if (receiver.empty()) throw Error("Invalid receiver.");
 
-    const std::set<std::string> &users = _transmission->getOpenConnections();
-    if (users.find(receiver) != users.end()) {
-        r = {Response::Type::RECEIVE, request.header.userId,
-             request.header.fromId, request.payload};
-        sendReponse(receiver, r, getManagerPtr(receiver, true));
+    std::shared_ptr<ServerToClientManager> manager =
+        getManagerPtr(receiver, true);
+    if (manager != nullptr && _transmission->exists(receiver)) {
+        // sealed straight from the sender's decrypted buffer
+        ResponseView message{{Response::Type::RECEIVE, request.header.userId,
+                              request.header.fromId},
+                             request.payload};
+        manager->parseOutgoing(message, [&](std::stringstream &sealed) {
+            _transmission->send(receiver, sealed);
+        });
+        r.header = message.header;
     } else {
-        _database->insertData(request.header.userId, request.payload);
+        _database->insertData(request.header.userId,
+                              request.payload.toVector());
+        // the receiver might have logged in meanwhile, his login push could
+        // be already over
+        pushStoredMessages(receiver, request.header.userId);
     }
     return r;
 }
@@ -309,21 +316,30 @@ Response Server::sendKeyBundle(const Request &request,
                                const std::string &username) {
     // for file transmission manager to use it to sent it back
     log("sendKeyBundle: " + username);
-    std::vector<unsigned char> bundle =
-        _database->selectBundle(request.header.userId);
-    if (bundle.empty())
-        throw Error("Could not find bundle for user " +
-                    std::to_string(request.header.userId));
-
-    KeyBundle<C25519> keys = KeyBundle<C25519>::deserialize(bundle);
-    if (!keys.oneTimeKeys.empty())
-        keys.oneTimeKeys.erase(keys.oneTimeKeys.end() - 1);
-
-    if (keys.oneTimeKeys.empty())
-        _database->updateBundle(request.header.userId, keys.serialize(),
-                                1);    // timestamp to 1 - update needed
-    else
-        _database->updateBundle(request.header.userId, keys.serialize());
+    // the key is claimed from the bundle read, concurrent requests never
+    // get the same key; timestamp to 1 - update needed once none is left
+    ClaimedBundle claimed;
+    {
+        QMutexLocker locker(&_bundleLock);
+        claimed = _database->claimBundle(request.header.userId, 1);
+        if (claimed.bundle.empty())
+            throw Error("Could not find bundle for user " +
+                        std::to_string(request.header.userId));
+
+        BundleInfo info;
+        info.timestamp = claimed.timestamp;
+        info.oneTimeKeys = claimed.oneTimeKeysLeft;
+        _bundleInfo.insert(request.header.userId, info);
+    }
+
+    std::vector<unsigned char> bundle = std::move(claimed.bundle);
+    if (!claimed.oneTimeKey.empty()) {
+        // only the claimed key is sent, along with its id
+        KeyBundle<C25519> keys = KeyBundle<C25519>::deserialize(bundle);
+        keys.oneTimeKeys = {std::move(claimed.oneTimeKey)};
+        keys.firstOneTimeKeyId = claimed.oneTimeKeyId;
+        bundle = keys.serialize();
+    }
 
     Response r{Response::Type::RECEIVER_BUNDLE_SENT, request.header.userId,
                bundle};
@@ -338,61 +354,127 @@ Response Server::checkEvent(uint32_t uid) {
                          // and after fixing check event, it causes segfault
 
     if (uid != 0) {
+        BundleInfo bundle = getBundleInfo(uid);
         // step one: old keys: if time stored + 2 weeks < now
-        uint64_t time = _database->getBundleTimestamp(uid);
-        if (time + 14 * 24 * 3600 < getTimestampOf(nullptr)) {
+        if (bundle.timestamp + 14 * 24 * 3600 < getTimestampOf(nullptr)) {
             log("checking events: #" + std::to_string(uid) +
                 " : update key bundle");
             return {Response::Type::BUNDLE_UPDATE_NEEDED, uid};
         }
         // step two: one-time keys emptied //todo should be implemented or just
         // wait for 2week period?
-        KeyBundle<C25519> keys =
-            KeyBundle<C25519>::deserialize(_database->selectBundle(uid));
-        if (keys.oneTimeKeys.empty()) {
+        if (bundle.oneTimeKeys == 0) {
             log("checking events: #" + std::to_string(uid) + " : new keys");
             return {Response::Type::BUNDLE_UPDATE_NEEDED, uid};
         }
-        // step three: new messages
-        std::vector<unsigned char> msg = _database->selectData(uid);
-        if (!msg.empty()) {
-            log("checking events: #" + std::to_string(uid) + " : new message");
-            return {Response::Type::RECEIVE_OLD, uid, std::move(msg)};
-        }
     }
     log("checking events: #" + std::to_string(uid) + " : no new events");
     return {Response::Type::OK, uid};
 }
 
-ServerToClientManager *Server::getManagerPtr(const std::string &username,
-                                             bool trusted) {
-    ServerToClientManager *mngr = nullptr;
-    if (trusted) {
-        QReadLocker lock(&_connectionLock);
-        auto found = _connections.find(username);
-        if (found != _connections.end()) {
-            mngr = &(*(found->second));
+BundleInfo Server::getBundleInfo(uint32_t uid) {
+    BundleInfo info;
+    if (_bundleInfo.find(uid, info)) return info;
+
+    // a replace running meanwhile would be overwritten by what was read
+    QMutexLocker locker(&_bundleLock);
+    info.timestamp = _database->getBundleTimestamp(uid);
+    if (info.timestamp == 0) return info;    // no bundle
+
+    info.oneTimeKeys = _database->countOneTimeKeys(uid);
+    _bundleInfo.insert(uid, info);
+    return info;
+}
+
+void Server::pushStoredMessages(const std::string &username, uint32_t uid) {
+    {
+        // one push per user at a time, a running push is asked to repeat
+        // so that messages stored meanwhile are not missed
+        QMutexLocker locker(&_pushLock);
+        auto running = _pushing.find(uid);
+        if (running != _pushing.end()) {
+            running->second = true;
+            return;
         }
-    } else {
-        QReadLocker lock(&_requestLock);
-        auto found = _requestsToConnect.find(username);
-        if (found != _requestsToConnect.end() &&
-            found->second.first->manager != nullptr) {
-            mngr = &(*(found->second.first->manager));
+        _pushing[uid] = false;
+    }
+    while (true) {
+        try {
+            _pushStoredMessages(username, uid);
+        } catch (Error &ex) {
+            // not delivered messages stay stored for the next login or poll
+            log(std::string() + "Error: pushing stored messages: " +
+                ex.what());
+        }
+        QMutexLocker locker(&_pushLock);
+        auto running = _pushing.find(uid);
+        if (!running->second) {
+            _pushing.erase(running);
+            return;
         }
+        running->second = false;
+    }
+}
+
+void Server::_pushStoredMessages(const std::string &username, uint32_t uid) {
+    std::shared_ptr<ServerToClientManager> manager =
+        getManagerPtr(username, true);
+    if (manager == nullptr || !_transmission->exists(username)) return;
+
+    std::vector<std::vector<unsigned char>> stored;
+    uint64_t last = 0;
+    bool more = true;
+    while (more && !(stored = _database->peekData(uid, MAX_BATCH_MESSAGES,
+                                                  MAX_BATCH_BYTES, last, more))
+                        .empty()) {
+        log("pushing stored messages: #" + std::to_string(uid) + " : " +
+            std::to_string(stored.size()));
+        sendReponse(username,
+                    {Response::Type::RECEIVE_OLD_BATCH, uid,
+                     MessageBatch(std::move(stored), false).serialize()},
+                    manager);
+        // deleted once handed to the socket, a failed send keeps them
+        _database->deleteData(uid, last);
+    }
+}
+
+std::shared_ptr<ServerToClientManager> Server::getManagerPtr(
+    const std::string &username, bool trusted) {
+    std::shared_ptr<ServerToClientManager> mngr;
+    if (trusted) {
+        _connections.find(username, mngr);
+    } else {
+        std::shared_ptr<Challenge> challenge;
+        if (_requestsToConnect.find(username, challenge))
+            mngr = challenge->manager;
     }
     return mngr;
 }
 
-void Server::sendReponse(const std::string &username, const Response &response,
-                         ServerToClientManager *manager) {
-    std::stringstream result;
+void Server::sendReponse(
+    const std::string &username, const Response &response,
+    const std::shared_ptr<ServerToClientManager> &manager) {
     if (manager == nullptr) {
-        result = _genericManager.returnErrorGeneric();
-    } else {
-        result = manager->parseOutgoing(response);
+        std::stringstream result = _genericManager.returnErrorGeneric();
+        _transmission->send(username, result);
+        return;
+    }
+    manager->parseOutgoing(response, [&](std::stringstream &sealed) {
+        _transmission->send(username, sealed);
+    });
+}
+
+void Server::sendError(const std::string &username, uint32_t userId,
+                       const std::vector<unsigned char> &payload) {
+    try {
+        sendReponse(username,
+                    {{Response::Type::GENERIC_SERVER_ERROR, userId}, payload},
+                    getManagerPtr(username, true));
+    } catch (std::exception &ex) {
+        log(std::string() + "Error reply not sent: " + ex.what());
+    } catch (...) {
+        log("Error reply not sent: unknown error");
     }
-    _transmission->send(username, result);
 }
 
 void Server::sendReponse(const std::string &username, const Response &response,
@@ -402,6 +484,7 @@ void Server::sendReponse(const std::string &username, const Response &response,
         // invalid key
         result = _genericManager.returnErrorGeneric();
     } else {
+        QMutexLocker generic(&_genericLock);
         _genericManager.setKey(sessionKey);
         result = _genericManager.parseOutgoing(response);
     }
@@ -415,7 +498,17 @@ Response Server::updateKeyBundle(const Request &request,
     if (user.name != username)
         throw Error("Key bundle update policy violation.");
 
-    _database->insertBundle(request.header.userId, request.payload);
+    // one-time keys are stored apart, so that one can be claimed at a time
+    KeyBundle<C25519> keys = KeyBundle<C25519>::deserialize(request.payload);
+    std::vector<zero::bytes_t> oneTimeKeys = std::move(keys.oneTimeKeys);
+    keys.oneTimeKeys.clear();
+
+    {
+        QMutexLocker locker(&_bundleLock);
+        _database->replaceBundle(request.header.userId, keys.serialize(),
+                                 oneTimeKeys);
+        _bundleInfo.erase(request.header.userId);
+    }
     log("Update keys: " + username);
     sendReponse(username, r, getManagerPtr(username, true));
     return r;
@@ -12,7 +12,7 @@
 #ifndef HELLOWORLD_SERVER_SERVER_H_
 #define HELLOWORLD_SERVER_SERVER_H_
 
-#include <QReadWriteLock>
+#include <QMutex>
 #include <QtCore/QObject>
 #include <functional>
 #include <map>
@@ -20,13 +20,17 @@
 #include <string>
 #include <cctype>
 
+#include "../shared/buffer_pool.h"
 #include "../shared/connection_manager.h"
 #include "../shared/random.h"
 #include "../shared/request_response.h"
 #include "../shared/requests.h"
 #include "../shared/rsa_2048.h"
 #include "../shared/transmission.h"
+#include "cached_database.h"
 #include "database_server.h"
+#include "net_utils.h"
+#include "presence.h"
 
 namespace helloworld {
 
@@ -34,26 +38,42 @@ namespace helloworld {
  * @brief Stores information about newly registered user,
  * creates -to be- connection manager and stores
  * his key verification challenge. When succesfull,
- * the manager is moved into _connections
+ * the manager is shared with _connections
  */
 struct Challenge {
     UserData userData;
-    std::unique_ptr<ServerToClientManager> manager;
+    std::shared_ptr<ServerToClientManager> manager;
     std::vector<unsigned char> secret;
+    bool newUser;
     Challenge(UserData userData, std::vector<unsigned char> secret,
-              const zero::str_t &sessionKey)
+              const zero::str_t &sessionKey, bool newUser)
         : userData(std::move(userData)),
-          manager(std::make_unique<ServerToClientManager>(sessionKey)),
-          secret(std::move(secret)) {}
+          manager(std::make_shared<ServerToClientManager>(sessionKey)),
+          secret(std::move(secret)),
+          newUser(newUser) {}
+};
+
+/**
+ * @brief Key bundle state checked on every event check, cached
+ * so that the bundle is not loaded and deserialized each time
+ */
+struct BundleInfo {
+    uint64_t timestamp = 0;
+    size_t oneTimeKeys = 0;
 };
 
 class Server
     : public QObject,
-      public Callable<void, bool, const std::string &, std::stringstream &&> {
+      public Callable<void, bool, const std::string &, const ByteSpan &> {
     Q_OBJECT
     static bool _test;
     // rsa maximum encryption length of 126 bytes
     static const size_t CHALLENGE_SECRET_LENGTH = 126;
+    // offline messages delivered in one RECEIVE_OLD_BATCH response
+    static const size_t MAX_BATCH_MESSAGES = 64;
+    static const size_t MAX_BATCH_BYTES = 1024 * 1024;
+    // users in one page of search results
+    static const size_t MAX_SEARCH_RESULTS = 50;
 
     std::function<void(const std::string &)> log{[](const std::string &) {}};
 
@@ -84,66 +104,49 @@ class Server
      * @param username username of incoming connection, empty if not opened
      * (e.g. authentication needed)
      * @param data decoded data, ready to process (if username empty, use server
-     * key to encrypt)
+     * key to encrypt), view into the receive buffer valid during the call
      */
     void callback(bool hasSessionKey, const std::string &username,
-                  std::stringstream &&data) override {
+                  const ByteSpan &data) override {
         Request request;
         Response response;
+        // decrypted request, pooled per worker thread
+        MessageBuffer buffer(data.size);
         try {
-            QReadLocker lock(&_requestLock);
-            QReadLocker lock2(&_connectionLock);
-            if (!hasSessionKey ||
-                (_requestsToConnect.find(username) ==
-                     _requestsToConnect.end() &&
-                 _connections.find(username) == _connections.end())) {
-                QReadLocker lock(&_connectionLock);
-                request = _genericManager.parseIncoming(std::move(data));
-            } else {
-                QReadLocker lock(&_connectionLock);
-                auto existing = _connections.find(username);
-                if (existing == _connections.end()) {
-                    auto pending = _requestsToConnect.find(username);
-                    if (pending == _requestsToConnect.end())
-                        throw Error("No such connection available.");
-
-                    request = pending->second.first->manager->parseIncoming(
-                        std::move(data));
-                } else {
-                    request = existing->second->parseIncoming(std::move(data));
+            std::shared_ptr<ServerToClientManager> manager;
+            if (hasSessionKey) {
+                manager = getManagerPtr(username, true);
+                if (manager == nullptr)
+                    manager = getManagerPtr(username, false);
+            }
+            if (manager == nullptr) {
+                {
+                    QMutexLocker generic(&_genericLock);
+                    request =
+                        _genericManager.parseIncoming(ByteSpanStream(data));
                 }
+                handleUserRequest(request, username);
+            } else {
+                // payload stays in the decrypted buffer, handlers copy it
+                // only if they keep it
+                RequestView view = manager->parseIncoming(data, *buffer);
+                request.header = view.header;
+                handleUserRequest(view, username);
             }
-            lock.unlock();
-            lock2.unlock();
-
-            handleUserRequest(request, username);
         } catch (Error &ex) {
             log(std::string() + "Error: " + ex.what());
-            QReadLocker lock(&_connectionLock);
-            sendReponse(
-                username,
-                {{Response::Type::GENERIC_SERVER_ERROR, request.header.userId},
-                 ex.serialize()},
-                getManagerPtr(username, true));
+            sendError(username, request.header.userId, ex.serialize());
         } catch (std::exception &generic) {
             log(std::string() + "Generic error: " + generic.what());
-            QReadLocker lock(&_connectionLock);
-            sendReponse(
-                username,
-                {{Response::Type::GENERIC_SERVER_ERROR, request.header.userId},
-                 from_string(generic.what())},
-                getManagerPtr(username, true));
+            sendError(username, request.header.userId,
+                      from_string(generic.what()));
         } catch (...) {
             //__cxa_exception_type() does not work with MSVC
             std::exception_ptr p = std::current_exception();
             log(std::string() + "Fatal error: " /*+ (p ? p.__cxa_exception_type()->name() : "unknown")*/);
-            QReadLocker lock(&_connectionLock);
-            sendReponse(
-                username,
-                {{Response::Type::GENERIC_SERVER_ERROR, request.header.userId},
-                 from_string(/*p ? p.__cxa_exception_type()->name() : */
-                             "unknown error")},
-                getManagerPtr(username, true));
+            sendError(username, request.header.userId,
+                      from_string(/*p ? p.__cxa_exception_type()->name() : */
+                                  "unknown error"));
         }
     }
 
@@ -156,6 +159,16 @@ class Server
     Response handleUserRequest(const Request &request,
                                const std::string &username);
 
+    /**
+     * @brief Handle incoming request borrowing its payload, forwarded
+     *        messages are sealed for the receiver without copying it
+     *
+     * @param request request with payload valid during the call
+     * @return Response response data (testing purposes)
+     */
+    Response handleUserRequest(const RequestView &request,
+                               const std::string &username);
+
     //
     // TESTING PURPOSE METHODS SECTION
     //
@@ -173,6 +186,9 @@ class Server
     // to get to database
     const ServerDatabase &getDatabase() { return *_database; }
 
+    // hit ratio and latency of users directory lookups
+    CacheMetrics userCacheMetrics() const { return _database->metrics(); }
+
     // delete connection id (username) to treat new request as new connection
     void simulateNewChannel(const std::string &old) {
         _transmission->removeConnection(old);
@@ -183,14 +199,25 @@ class Server
 
    private:
     Random _random;
+    // requests of unauthenticated users may be processed concurrently
+    QMutex _genericLock;
     GenericServerManager _genericManager;
-    QReadWriteLock _connectionLock;
-    std::map<std::string, std::unique_ptr<ServerToClientManager>> _connections;
-    QReadWriteLock _requestLock;
-    std::map<std::string, std::pair<std::unique_ptr<Challenge>, bool>>
-        _requestsToConnect;
-
-    std::unique_ptr<ServerDatabase> _database;
+    // both tables are sharded by username, each shard has its own lock
+    ShardedHashMap<std::string, std::shared_ptr<ServerToClientManager>>
+        _connections;
+    ShardedHashMap<std::string, std::shared_ptr<Challenge>> _requestsToConnect;
+    // by user id, invalidated whenever the bundle is replaced; filled and
+    // invalidated only together with the database access, under the lock
+    QMutex _bundleLock;
+    ShardedHashMap<uint32_t, BundleInfo> _bundleInfo;
+    // authenticated users, follows _connections
+    PresenceRegistry _presence;
+    // users whose stored messages are being pushed, true to push again
+    QMutex _pushLock;
+    std::map<uint32_t, bool> _pushing;
+
+    // users directory lookups are answered from memory
+    std::unique_ptr<CachedDatabase> _database;
     std::unique_ptr<ServerTransmissionManager> _transmission;
 
     bool validName(const std::string& s) {
@@ -261,10 +288,11 @@ class Server
     /**
      * @brief Called to forward message
      *
-     * @param request request containing data to send
-     * @return Response OK response if stored succesfully
+     * @param request request containing data to send, the payload is only
+     *        read (sealed for the receiver or stored)
+     * @return Response OK response if stored succesfully, header only
      */
-    Response forward(const Request &request);
+    Response forward(const RequestView &request);
 
     /**
      * Uploads to the database new key bundle
@@ -289,7 +317,7 @@ class Server
      * Request any new messages
      *
      * @param request request with user name & id
-     * @return uses checkEvent()
+     * @return uses checkEvent(), stored messages are pushed afterwards
      */
     Response checkIncoming(const Request &request, const std::string &username);
 
@@ -313,10 +341,38 @@ class Server
      *        (e.g. old keys, empty key pool)
      *
      * @param request to get message number & user id
+     * stored messages are not reported here, see pushStoredMessages()
+     *
+     * @param uid user id to check the key bundle of
      * @return OK if nothing needed, specific server response on event
      */
     Response checkEvent(uint32_t uid);
 
+    /**
+     * @brief Get key bundle state of the user, loaded from the database
+     *        on first use
+     *
+     * @param uid id of the bundle owner
+     * @return bundle state, zeroed if user has no bundle
+     */
+    BundleInfo getBundleInfo(uint32_t uid);
+
+    /**
+     * @brief Push all messages stored for the user while offline,
+     *        in batches, without waiting for the user to ask
+     *
+     * @param username user to push the messages to, nothing is done
+     *        unless he is logged in and connected (or being registered)
+     * @param uid id of the user
+     */
+    void pushStoredMessages(const std::string &username, uint32_t uid);
+
+    /**
+     * @brief Push stored messages once, each batch is deleted only after it
+     *        is handed to the user's connection
+     */
+    void _pushStoredMessages(const std::string &username, uint32_t uid);
+
     /**
      * Send reponse to user with manager
      *
@@ -326,7 +382,18 @@ class Server
      * error
      */
     void sendReponse(const std::string &username, const Response &response,
-                     ServerToClientManager *manager);
+                     const std::shared_ptr<ServerToClientManager> &manager);
+
+    /**
+     * Report a failed request to the user, the user may be gone already
+     * (e.g. disconnected meanwhile), in that case the error is only logged
+     *
+     * @param username username to send the error to
+     * @param userId user id of the failed request
+     * @param payload serialized error description
+     */
+    void sendError(const std::string &username, uint32_t userId,
+                   const std::vector<unsigned char> &payload);
 
     /**
      * Send response to user without manager (e.g. auth fails)
@@ -343,25 +410,18 @@ class Server
      *
      * @param username manager to the user
      * @param trusted true if manager is supposed to be in _connections
-     * @return ptr to user manager, nullptr if failed
+     * @return ptr to user manager, nullptr if failed; shared so that
+     *         the manager outlives concurrent logout of the user
      */
-    ServerToClientManager *getManagerPtr(const std::string &username,
+    std::shared_ptr<ServerToClientManager> getManagerPtr(const std::string &username,
                                          bool trusted);
 
    public slots:
     void cleanAfterConenction(QString qname) {
         auto name = qname.toStdString();
-        _requestLock.lockForWrite();
-        auto chalangeIt = _requestsToConnect.find(name);
-        if (chalangeIt != _requestsToConnect.end())
-            _requestsToConnect.erase(chalangeIt);
-        _requestLock.unlock();
-
-        _connectionLock.lockForWrite();
-        auto connectionIt = _connections.find(name);
-        if (connectionIt != _connections.end())
-            _connections.erase(connectionIt);
-        _connectionLock.unlock();
+        _requestsToConnect.erase(name);
+        _connections.erase(name);
+        _presence.offline(name);
         log("cleaning after: " + qname.toStdString());
     }
 };
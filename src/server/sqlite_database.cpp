@@ -1,30 +1,112 @@
 #include "sqlite_database.h"
 
 #include <algorithm>
+#include <limits>
 
 #include "../shared/serializable_error.h"
 #include "../shared/utils.h"
 
 namespace helloworld {
 
-ServerSQLite::ServerSQLite() {
-    if (int res = sqlite3_open(nullptr, &_handler) != SQLITE_OK) {
-        throw Error("Could not create database: " +
-                    _getErrorMsgByReturnType(res));
-    }
+ServerSQLite::ServerSQLite()
+    : _writer(std::make_unique<Connection>(
+          nullptr, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE)) {
     _createTablesIfNExists();
 }
 
-ServerSQLite::ServerSQLite(std::string &&filename) {
-    filename.push_back('\0');
-    if (int res = sqlite3_open(filename.c_str(), &_handler) != SQLITE_OK) {
-        throw Error("Could not create database. " +
-                    _getErrorMsgByReturnType(res));
-    }
+ServerSQLite::ServerSQLite(std::string &&filename, SQLiteOptions options)
+    : _filename(std::move(filename)), _options(std::move(options)) {
+    _writer = std::make_unique<Connection>(
+        _filename.c_str(), SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+    // the journal mode is persistent, readers open the file in WAL already
+    if (_execute("PRAGMA journal_mode = WAL;", nullptr, nullptr) != SQLITE_OK)
+        throw Error("Could not switch database to write-ahead log.");
+    _configure(*_writer);
     _createTablesIfNExists();
 }
 
-ServerSQLite::~ServerSQLite() {
+const std::array<const char *, static_cast<size_t>(ServerSQLite::Query::COUNT)>
+    ServerSQLite::_queries{{
+        "INSERT INTO users (username, pubkey) VALUES (?, ?);",
+        "INSERT INTO users (id, username, pubkey) VALUES (?, ?, ?);",
+        "SELECT id, username, pubkey FROM users WHERE username LIKE ? "
+        "ORDER BY id DESC;",
+        "SELECT id, username, pubkey FROM users WHERE id = ? LIMIT 1;",
+        "SELECT id, username, pubkey FROM users WHERE username = ? LIMIT 1;",
+        "DELETE FROM users WHERE id = ?;",
+        "DELETE FROM users WHERE username = ?;",
+        "SELECT id, username FROM users;",
+        "SELECT id, username FROM users WHERE id < ? "
+        "AND username LIKE ? ESCAPE '\\' ORDER BY id DESC LIMIT ?;",
+        // the trigram index drives the scan in id order, LIKE checks the rest
+        "SELECT users.id, users.username FROM user_trigrams "
+        "CROSS JOIN users ON users.id = user_trigrams.userid "
+        "WHERE user_trigrams.trigram = ? AND user_trigrams.userid < ? "
+        "AND users.username LIKE ? ESCAPE '\\' "
+        "ORDER BY user_trigrams.userid DESC LIMIT ?;",
+        "INSERT INTO user_trigrams VALUES (?, ?);",
+        "DELETE FROM user_trigrams WHERE trigram = ? AND userid = ?;",
+        "SELECT users FROM trigram_counts WHERE trigram = ?;",
+        "INSERT INTO trigram_counts VALUES (?, 1) "
+        "ON CONFLICT (trigram) DO UPDATE SET users = users + 1;",
+        "UPDATE trigram_counts SET users = users - 1 WHERE trigram = ?;",
+        "INSERT INTO messages (userid, data) VALUES (?, ?);",
+        "SELECT id, data FROM messages WHERE userid = ? ORDER BY id;",
+        "DELETE FROM messages WHERE id = ?;",
+        "DELETE FROM messages WHERE userid = ?;",
+        "DELETE FROM messages WHERE userid = ? AND id <= ?;",
+        // todo needs to be checked, also replaces all the data
+        "INSERT OR REPLACE INTO bundles VALUES (?, ?, ?);",
+        "SELECT data FROM bundles WHERE userid = ?;",
+        "SELECT timestamp FROM bundles WHERE userid = ?;",
+        "SELECT timestamp, data FROM bundles WHERE userid = ?;",
+        "UPDATE bundles SET data = ? WHERE userid = ?;",
+        "UPDATE bundles SET timestamp = ?, data = ? WHERE userid = ?;",
+        "UPDATE bundles SET timestamp = ? WHERE userid = ?;",
+        "DELETE FROM bundles WHERE userid = ?;",
+        "INSERT INTO onetime_keys VALUES (?, ?, ?);",
+        "SELECT keyid, key FROM onetime_keys WHERE userid = ? "
+        "ORDER BY keyid DESC LIMIT 1;",
+        "SELECT COUNT(*) FROM onetime_keys WHERE userid = ?;",
+        "DELETE FROM onetime_keys WHERE userid = ? AND keyid = ?;",
+        "DELETE FROM onetime_keys WHERE userid = ?;",
+        "BEGIN IMMEDIATE;",
+        "COMMIT;",
+        "ROLLBACK;",
+    }};
+
+template <typename Function>
+void ServerSQLite::_transaction(Function function) {
+    if (_run(Statement(_writer->statement(Query::BEGIN_TRANSACTION))) !=
+        SQLITE_DONE)
+        throw Error("Failed to start transaction: " +
+                    std::string(sqlite3_errmsg(_writer->handler())));
+    try {
+        function();
+        if (_run(Statement(_writer->statement(Query::COMMIT_TRANSACTION))) !=
+            SQLITE_DONE)
+            throw Error("Failed to commit transaction: " +
+                        std::string(sqlite3_errmsg(_writer->handler())));
+    } catch (...) {
+        _run(Statement(_writer->statement(Query::ROLLBACK_TRANSACTION)));
+        throw;
+    }
+}
+
+ServerSQLite::~ServerSQLite() = default;
+
+ServerSQLite::Connection::Connection(const char *filename, int flags) {
+    if (sqlite3_open_v2(filename, &_handler, flags, nullptr) != SQLITE_OK) {
+        std::string error = _handler == nullptr
+                                ? _getErrorMsgByReturnType(SQLITE_NOMEM)
+                                : sqlite3_errmsg(_handler);
+        sqlite3_close(_handler);
+        throw Error("Could not create database: " + error);
+    }
+}
+
+ServerSQLite::Connection::~Connection() {
+    finalize();
     // todo: can return SQLITE_BUSY when not ready to release (backup) ...
     // solve?
     if (sqlite3_close(_handler) != SQLITE_OK) {
@@ -32,20 +114,55 @@ ServerSQLite::~ServerSQLite() {
     }
 }
 
-uint32_t ServerSQLite::insert(const UserData &data, bool autoIncrement) {
-    std::string query = "INSERT INTO users ";
-    if (autoIncrement) {
-        query += "(username, pubkey) VALUES ('";
-    } else {
-        query += "VALUES (" + std::to_string(data.id) + ", '";
+sqlite3_stmt *ServerSQLite::Connection::statement(Query query) {
+    sqlite3_stmt *&statement = _statements[static_cast<size_t>(query)];
+    if (statement == nullptr) {
+        int res = sqlite3_prepare_v3(
+            _handler, _queries[static_cast<size_t>(query)], -1,
+            SQLITE_PREPARE_PERSISTENT, &statement, nullptr);
+        if (res != SQLITE_OK) {
+            throw Error("Could not prepare statement: " +
+                        std::string(sqlite3_errmsg(_handler)));
+        }
     }
-    query += _sCheck(data.name) + "', '" +
-             std::string(data.publicKey.begin(), data.publicKey.end()) + "');";
+    return statement;
+}
 
-    if (int res = _execute(std::move(query), nullptr, nullptr) != SQLITE_OK) {
-        throw Error("Insert command failed: " + _getErrorMsgByReturnType(res));
+void ServerSQLite::Connection::finalize() {
+    for (sqlite3_stmt *&statement : _statements) {
+        sqlite3_finalize(statement);
+        statement = nullptr;
     }
-    uint32_t id = static_cast<uint32_t>(sqlite3_last_insert_rowid(_handler));
+}
+
+uint32_t ServerSQLite::insert(const UserData &data, bool autoIncrement) {
+    std::lock_guard<std::mutex> lock(_writeLock);
+    uint32_t id = 0;
+    _transaction([&]() {
+        {
+            Statement statement(
+                _writer->statement(autoIncrement ? Query::INSERT_USER
+                                                 : Query::INSERT_USER_WITH_ID));
+            int column = 1;
+            if (!autoIncrement)
+                sqlite3_bind_int64(statement.get(), column++, data.id);
+            sqlite3_bind_text(statement.get(), column++, data.name.data(),
+                              static_cast<int>(data.name.size()),
+                              SQLITE_STATIC);
+            sqlite3_bind_text(
+                statement.get(), column,
+                reinterpret_cast<const char *>(data.publicKey.data()),
+                static_cast<int>(data.publicKey.size()), SQLITE_STATIC);
+
+            if (_run(statement) != SQLITE_DONE) {
+                throw Error("Insert command failed: " +
+                            std::string(sqlite3_errmsg(_writer->handler())));
+            }
+        }
+        id = static_cast<uint32_t>(
+            sqlite3_last_insert_rowid(_writer->handler()));
+        _updateSearchIndex(true, id, data.name);
+    });
     return id;
 }
 
@@ -57,14 +174,86 @@ const std::vector<std::unique_ptr<UserData>> &ServerSQLite::selectLike(
 const std::vector<std::unique_ptr<UserData>> &ServerSQLite::selectLike(
     const std::string &username) {
     _cache.clear();
-    int res = _execute("SELECT * FROM users WHERE username LIKE '%" +
-                           _sCheck(username) + "%' ORDER BY id DESC;",
-                       _fillData, &_cache);
-    if (res != SQLITE_OK)
+    std::string pattern = "%" + _sCheck(username) + "%";
+
+    std::unique_lock<std::mutex> lock;
+    Statement statement(_reader(lock).statement(Query::SELECT_USER_LIKE));
+    sqlite3_bind_text(statement.get(), 1, pattern.data(),
+                      static_cast<int>(pattern.size()), SQLITE_STATIC);
+    int res;
+    while ((res = sqlite3_step(statement.get())) == SQLITE_ROW) {
+        _cache.push_back(
+            std::make_unique<UserData>(_readUser(statement.get())));
+    }
+    if (res != SQLITE_DONE)
         throw Error("Select command failed: " + _getErrorMsgByReturnType(res));
     return _cache;
 }
 
+std::vector<UserData> ServerSQLite::searchUsers(const std::string &query,
+                                                uint32_t beforeId,
+                                                size_t limit) const {
+    std::vector<UserData> users;
+    if (limit == 0) return users;
+
+    std::vector<std::string> trigrams = _trigrams(query);
+    std::string pattern = "%" + _escapeLike(query) + "%";
+    sqlite3_int64 before = beforeId == 0
+                               ? std::numeric_limits<sqlite3_int64>::max()
+                               : static_cast<sqlite3_int64>(beforeId);
+
+    std::unique_lock<std::mutex> lock;
+    Connection &reader = _reader(lock);
+
+    // the scan is driven by the trigram the fewest users have
+    const std::string *rarest = nullptr;
+    sqlite3_int64 fewest = std::numeric_limits<sqlite3_int64>::max();
+    for (const std::string &trigram : trigrams) {
+        Statement count(reader.statement(Query::SELECT_TRIGRAM_COUNT));
+        sqlite3_bind_blob(count.get(), 1, trigram.data(),
+                          static_cast<int>(trigram.size()), SQLITE_STATIC);
+        sqlite3_int64 owners = sqlite3_step(count.get()) == SQLITE_ROW
+                                   ? sqlite3_column_int64(count.get(), 0)
+                                   : 0;
+        // no name contains the trigram
+        if (owners == 0) return users;
+        if (owners < fewest) {
+            fewest = owners;
+            rarest = &trigram;
+        }
+    }
+
+    // queries shorter than a trigram scan the users from the newest one,
+    // the limit stops the scan once enough names matched
+    Statement statement(reader.statement(rarest == nullptr
+                                             ? Query::SEARCH_USERS
+                                             : Query::SEARCH_USERS_BY_TRIGRAM));
+    int column = 1;
+    if (rarest != nullptr) {
+        sqlite3_bind_blob(statement.get(), column++, rarest->data(),
+                          static_cast<int>(rarest->size()), SQLITE_STATIC);
+    }
+    sqlite3_bind_int64(statement.get(), column++, before);
+    sqlite3_bind_text(statement.get(), column++, pattern.data(),
+                      static_cast<int>(pattern.size()), SQLITE_STATIC);
+    sqlite3_bind_int64(statement.get(), column,
+                       static_cast<sqlite3_int64>(std::min<size_t>(
+                           limit, std::numeric_limits<int32_t>::max())));
+
+    int res;
+    while ((res = sqlite3_step(statement.get())) == SQLITE_ROW) {
+        const char *name = reinterpret_cast<const char *>(
+            sqlite3_column_text(statement.get(), 1));
+        users.emplace_back(
+            static_cast<uint32_t>(sqlite3_column_int64(statement.get(), 0)),
+            std::string(name, name + sqlite3_column_bytes(statement.get(), 1)),
+            "", zero::bytes_t{});
+    }
+    if (res != SQLITE_DONE)
+        throw Error("Search command failed: " + _getErrorMsgByReturnType(res));
+    return users;
+}
+
 UserData ServerSQLite::select(const UserData &query) const {
     if (query.id == 0 && query.name.empty()) return {};
 
@@ -74,111 +263,153 @@ UserData ServerSQLite::select(const UserData &query) const {
 }
 
 UserData ServerSQLite::select(uint32_t id) const {
-    sqlite3_stmt *statement = nullptr;
-    sqlite3_prepare_v2(_handler, "SELECT * FROM users WHERE id = ? LIMIT 1;",
-                       -1, &statement, nullptr);
-    sqlite3_bind_int(statement, 1, id);
-
-    UserData data;
-    if (sqlite3_step(statement) == SQLITE_ROW) {
-        data.id = static_cast<uint32_t>(sqlite3_column_int64(statement, 0));
-
-        size_t size = (static_cast<size_t>(sqlite3_column_bytes(statement, 1) /
-                                           static_cast<int>(sizeof(char))));
-        const char *ptr =
-            reinterpret_cast<const char *>(sqlite3_column_text(statement, 1));
-        data.name = std::string(ptr, ptr + size);
+    std::unique_lock<std::mutex> lock;
+    Statement statement(_reader(lock).statement(Query::SELECT_USER_BY_ID));
+    sqlite3_bind_int64(statement.get(), 1, id);
 
-        size = (static_cast<size_t>(sqlite3_column_bytes(statement, 2) /
-                                    static_cast<int>(sizeof(unsigned char))));
-        const unsigned char *ptr2 = sqlite3_column_text(statement, 2);
-        data.publicKey = zero::bytes_t(ptr2, ptr2 + size);
-    }
-    sqlite3_finalize(statement);
-    return data;
+    if (sqlite3_step(statement.get()) == SQLITE_ROW)
+        return _readUser(statement.get());
+    return {};
 }
 
 UserData ServerSQLite::select(const std::string &username) const {
-    sqlite3_stmt *statement = nullptr;
-    std::string query = "SELECT * FROM users WHERE username = ? LIMIT 1;";
-    sqlite3_prepare_v2(_handler, query.c_str(), -1, &statement, nullptr);
-    // 4th param: length of string in bytes or -1 to first null terminator
-    sqlite3_bind_text(statement, 1, username.c_str(), -1, SQLITE_STATIC);
-
-    UserData data;
-    if (sqlite3_step(statement) == SQLITE_ROW) {
-        data.id = static_cast<uint32_t>(sqlite3_column_int64(statement, 0));
-
-        size_t size = (static_cast<size_t>(sqlite3_column_bytes(statement, 1) /
-                                           static_cast<int>(sizeof(char))));
-        const char *ptr =
-            reinterpret_cast<const char *>(sqlite3_column_text(statement, 1));
-        data.name = std::string(ptr, ptr + size);
-
-        size = (static_cast<size_t>(sqlite3_column_bytes(statement, 2) /
-                                    static_cast<int>(sizeof(unsigned char))));
-        const unsigned char *ptr2 = sqlite3_column_text(statement, 2);
-        data.publicKey = zero::bytes_t(ptr2, ptr2 + size);
-    }
-    sqlite3_finalize(statement);
-    return data;
+    std::unique_lock<std::mutex> lock;
+    Statement statement(_reader(lock).statement(Query::SELECT_USER_BY_NAME));
+    sqlite3_bind_text(statement.get(), 1, username.data(),
+                      static_cast<int>(username.size()), SQLITE_STATIC);
+
+    if (sqlite3_step(statement.get()) == SQLITE_ROW)
+        return _readUser(statement.get());
+    return {};
 }
 
 bool ServerSQLite::remove(const UserData &data) {
-    if (data.id == 0)
-        return _execute(
-                   "DELETE FROM users WHERE username "
-                   "= '" +
-                       _sCheck(data.name) + "';",
-                   nullptr, nullptr) == SQLITE_OK;
-    return _execute(
-               "DELETE FROM users WHERE id = " + std::to_string(data.id) + ";",
-               nullptr, nullptr) == SQLITE_OK;
+    std::lock_guard<std::mutex> lock(_writeLock);
+    bool removed = true;
+    _transaction([&]() {
+        // the name is needed to find the user's rows in the search index
+        UserData user;
+        {
+            Statement select(_writer->statement(
+                data.id == 0 ? Query::SELECT_USER_BY_NAME
+                             : Query::SELECT_USER_BY_ID));
+            if (data.id == 0) {
+                sqlite3_bind_text(select.get(), 1, data.name.data(),
+                                  static_cast<int>(data.name.size()),
+                                  SQLITE_STATIC);
+            } else {
+                sqlite3_bind_int64(select.get(), 1, data.id);
+            }
+            if (sqlite3_step(select.get()) != SQLITE_ROW) return;
+            user = _readUser(select.get());
+        }
+        _updateSearchIndex(false, user.id, user.name);
+
+        Statement statement(_writer->statement(Query::REMOVE_USER_BY_ID));
+        sqlite3_bind_int64(statement.get(), 1, user.id);
+        removed = _run(statement) == SQLITE_DONE;
+    });
+    return removed;
 }
 
 void ServerSQLite::insertData(uint32_t userId,
                               const std::vector<unsigned char> &blob) {
-    sqlite3_stmt *statement = nullptr;
-    std::string query = "INSERT INTO messages (userid, data) VALUES (?, ?)";
-    sqlite3_prepare_v2(_handler, query.c_str(), -1, &statement, nullptr);
-    sqlite3_bind_int(statement, 1, userId);
-    sqlite3_bind_blob64(statement, 2, blob.data(),
+    std::lock_guard<std::mutex> lock(_writeLock);
+    Statement statement(_writer->statement(Query::INSERT_DATA));
+    sqlite3_bind_int64(statement.get(), 1, userId);
+    sqlite3_bind_blob64(statement.get(), 2, blob.data(),
                         blob.size() * sizeof(unsigned char), SQLITE_STATIC);
-    if (sqlite3_step(statement) != SQLITE_DONE)
+    if (_run(statement) != SQLITE_DONE)
         throw Error("Failed to store blob into table 'messages'.");
-    sqlite3_finalize(statement);
 }
 
 std::vector<unsigned char> ServerSQLite::selectData(uint32_t userId) {
-    sqlite3_stmt *statement = nullptr;
-    std::string query = "SELECT id, data FROM messages WHERE userid = ?";
-    sqlite3_prepare_v2(_handler, query.c_str(), -1, &statement, nullptr);
-    sqlite3_bind_int(statement, 1, userId);
+    // destructive read, both statements run on the writer
+    std::lock_guard<std::mutex> lock(_writeLock);
+    Statement statement(_writer->statement(Query::SELECT_DATA));
+    sqlite3_bind_int64(statement.get(), 1, userId);
 
     std::vector<unsigned char> blob;
-    if (sqlite3_step(statement) == SQLITE_ROW) {
+    if (sqlite3_step(statement.get()) == SQLITE_ROW) {
         const auto *ptr = reinterpret_cast<const unsigned char *>(
-            sqlite3_column_blob(statement, 1));
-        blob.resize(static_cast<unsigned long>(
-            sqlite3_column_bytes(statement, 1) /
-            static_cast<int>(sizeof(unsigned char))));
-        std::copy(ptr, ptr + blob.size(), blob.data());
-
-        auto id = static_cast<uint32_t>(sqlite3_column_int64(statement, 0));
-        if (_execute(
-                "DELETE FROM messages WHERE id = " + std::to_string(id) + ";",
-                nullptr, nullptr) != SQLITE_OK) {
+            sqlite3_column_blob(statement.get(), 1));
+        blob.assign(ptr, ptr + sqlite3_column_bytes(statement.get(), 1));
+
+        sqlite3_int64 id = sqlite3_column_int64(statement.get(), 0);
+        Statement remove(_writer->statement(Query::REMOVE_DATA));
+        sqlite3_bind_int64(remove.get(), 1, id);
+        if (_run(remove) != SQLITE_DONE) {
             throw Error("Failed to delete message when selecting.");
         }
     }
-    sqlite3_finalize(statement);
     return blob;
 }
 
+std::vector<std::vector<unsigned char>> ServerSQLite::selectData(
+    uint32_t userId, size_t maxCount, size_t maxBytes, bool &more) {
+    std::vector<std::vector<unsigned char>> blobs;
+    std::lock_guard<std::mutex> lock(_writeLock);
+    _transaction([&]() {
+        uint64_t last = 0;
+        blobs = _readData(userId, maxCount, maxBytes, last, more);
+        if (!blobs.empty()) _deleteData(userId, last);
+    });
+    return blobs;
+}
+
+std::vector<std::vector<unsigned char>> ServerSQLite::peekData(
+    uint32_t userId, size_t maxCount, size_t maxBytes, uint64_t &last,
+    bool &more) {
+    std::lock_guard<std::mutex> lock(_writeLock);
+    return _readData(userId, maxCount, maxBytes, last, more);
+}
+
+void ServerSQLite::deleteData(uint32_t userId, uint64_t last) {
+    std::lock_guard<std::mutex> lock(_writeLock);
+    _deleteData(userId, last);
+}
+
+std::vector<std::vector<unsigned char>> ServerSQLite::_readData(
+    uint32_t userId, size_t maxCount, size_t maxBytes, uint64_t &last,
+    bool &more) {
+    std::vector<std::vector<unsigned char>> blobs;
+    Statement statement(_writer->statement(Query::SELECT_DATA));
+    sqlite3_bind_int64(statement.get(), 1, userId);
+
+    // the row that does not fit is stepped to, it tells whether more remain
+    size_t bytes = 0;
+    more = false;
+    while (sqlite3_step(statement.get()) == SQLITE_ROW) {
+        auto size =
+            static_cast<size_t>(sqlite3_column_bytes(statement.get(), 1));
+        if (blobs.size() == maxCount ||
+            (!blobs.empty() && bytes + size > maxBytes)) {
+            more = true;
+            break;
+        }
+        const auto *ptr = reinterpret_cast<const unsigned char *>(
+            sqlite3_column_blob(statement.get(), 1));
+        blobs.emplace_back(ptr, ptr + size);
+        bytes += size;
+        last = static_cast<uint64_t>(sqlite3_column_int64(statement.get(), 0));
+    }
+    return blobs;
+}
+
+void ServerSQLite::_deleteData(uint32_t userId, uint64_t last) {
+    Statement remove(_writer->statement(Query::REMOVE_DATA_UP_TO));
+    sqlite3_bind_int64(remove.get(), 1, userId);
+    sqlite3_bind_int64(remove.get(), 2, static_cast<sqlite3_int64>(last));
+    if (_run(remove) != SQLITE_DONE)
+        throw Error("Failed to delete messages when selecting.");
+}
+
 void ServerSQLite::deleteAllData(uint32_t userId) {
-    if (int res = _execute("DELETE FROM messages WHERE userid = " +
-                               std::to_string(userId) + ";",
-                           nullptr, nullptr) != SQLITE_OK) {
+    std::lock_guard<std::mutex> lock(_writeLock);
+    Statement statement(_writer->statement(Query::REMOVE_ALL_DATA));
+    sqlite3_bind_int64(statement.get(), 1, userId);
+    int res = _run(statement);
+    if (res != SQLITE_DONE) {
         throw Error("Could not delete data of the user: " +
                     _getErrorMsgByReturnType(res));
     }
@@ -187,83 +418,71 @@ void ServerSQLite::deleteAllData(uint32_t userId) {
 void ServerSQLite::insertBundle(uint32_t userId,
                                 const std::vector<unsigned char> &blob,
                                 uint64_t timestamp) {
-    sqlite3_stmt *statement = nullptr;
-    // todo needs to be checked, also replaces all the data
-    std::string query = "INSERT OR REPLACE INTO bundles VALUES (?, ?, ?)";
-    sqlite3_prepare_v2(_handler, query.c_str(), -1, &statement, nullptr);
-    sqlite3_bind_int(statement, 1, userId);
+    std::lock_guard<std::mutex> lock(_writeLock);
+    Statement statement(_writer->statement(Query::INSERT_BUNDLE));
+    sqlite3_bind_int64(statement.get(), 1, userId);
     sqlite3_bind_int64(
-        statement, 2,
+        statement.get(), 2,
         static_cast<sqlite3_int64>(timestamp == 0 ? getTimestampOf(nullptr)
                                                   : timestamp));
-    sqlite3_bind_blob64(statement, 3, blob.data(),
+    sqlite3_bind_blob64(statement.get(), 3, blob.data(),
                         blob.size() * sizeof(unsigned char), SQLITE_STATIC);
-    if (sqlite3_step(statement) != SQLITE_DONE)
+    if (_run(statement) != SQLITE_DONE)
         throw Error("Failed to store blob into table 'bundles'. (" +
-                    std::string(sqlite3_errmsg(_handler)) + ")");
-    sqlite3_finalize(statement);
+                    std::string(sqlite3_errmsg(_writer->handler())) + ")");
 }
 
 std::vector<unsigned char> ServerSQLite::selectBundle(uint32_t userId) const {
-    sqlite3_stmt *statement = nullptr;
-    std::string query = "SELECT data FROM bundles WHERE userid = ?";
-    sqlite3_prepare_v2(_handler, query.c_str(), -1, &statement, nullptr);
-    sqlite3_bind_int(statement, 1, userId);
+    std::unique_lock<std::mutex> lock;
+    Statement statement(_reader(lock).statement(Query::SELECT_BUNDLE));
+    sqlite3_bind_int64(statement.get(), 1, userId);
 
     std::vector<unsigned char> blob;
-    if (sqlite3_step(statement) == SQLITE_ROW) {
+    if (sqlite3_step(statement.get()) == SQLITE_ROW) {
         const auto *ptr = reinterpret_cast<const unsigned char *>(
-            sqlite3_column_blob(statement, 0));
-        blob.resize(static_cast<unsigned long>(
-            sqlite3_column_bytes(statement, 0) /
-            static_cast<int>(sizeof(unsigned char))));
-        std::copy(ptr, ptr + blob.size(), blob.data());
+            sqlite3_column_blob(statement.get(), 0));
+        blob.assign(ptr, ptr + sqlite3_column_bytes(statement.get(), 0));
     }
-    sqlite3_finalize(statement);
     return blob;
 }
 
 uint64_t ServerSQLite::getBundleTimestamp(uint32_t userId) const {
-    sqlite3_stmt *statement = nullptr;
-    std::string query = "SELECT timestamp FROM bundles WHERE userid = ?";
-    sqlite3_prepare_v2(_handler, query.c_str(), -1, &statement, nullptr);
-    sqlite3_bind_int(statement, 1, userId);
+    std::unique_lock<std::mutex> lock;
+    Statement statement(
+        _reader(lock).statement(Query::SELECT_BUNDLE_TIMESTAMP));
+    sqlite3_bind_int64(statement.get(), 1, userId);
 
     uint64_t timestamp = 0;
-    if (sqlite3_step(statement) == SQLITE_ROW) {
-        timestamp = static_cast<uint64_t>(sqlite3_column_int64(statement, 0));
+    if (sqlite3_step(statement.get()) == SQLITE_ROW) {
+        timestamp =
+            static_cast<uint64_t>(sqlite3_column_int64(statement.get(), 0));
     }
-    sqlite3_finalize(statement);
     return timestamp;
 }
 
 void ServerSQLite::updateBundle(uint32_t userId,
                                 const std::vector<unsigned char> &blob) {
-    sqlite3_stmt *statement = nullptr;
-    std::string query = "UPDATE bundles SET data = ? WHERE userid = ?";
-    sqlite3_prepare_v2(_handler, query.c_str(), -1, &statement, nullptr);
-    sqlite3_bind_blob64(statement, 1, blob.data(),
+    std::lock_guard<std::mutex> lock(_writeLock);
+    Statement statement(_writer->statement(Query::UPDATE_BUNDLE));
+    sqlite3_bind_blob64(statement.get(), 1, blob.data(),
                         blob.size() * sizeof(unsigned char), SQLITE_STATIC);
-    sqlite3_bind_int(statement, 2, userId);
-    if (sqlite3_step(statement) != SQLITE_DONE)
+    sqlite3_bind_int64(statement.get(), 2, userId);
+    if (_run(statement) != SQLITE_DONE)
         throw Error("Failed to store blob into table 'bundles'.");
-    sqlite3_finalize(statement);
 }
 
 void ServerSQLite::updateBundle(uint32_t userId,
                                 const std::vector<unsigned char> &blob,
                                 uint64_t timestamp) {
-    sqlite3_stmt *statement = nullptr;
-    std::string query =
-        "UPDATE bundles SET timestamp = ?, data = ? WHERE userid = ?";
-    sqlite3_prepare_v2(_handler, query.c_str(), -1, &statement, nullptr);
-    sqlite3_bind_int64(statement, 1, static_cast<sqlite3_int64>(timestamp));
-    sqlite3_bind_blob64(statement, 2, blob.data(),
+    std::lock_guard<std::mutex> lock(_writeLock);
+    Statement statement(_writer->statement(Query::UPDATE_BUNDLE_WITH_TIMESTAMP));
+    sqlite3_bind_int64(statement.get(), 1,
+                       static_cast<sqlite3_int64>(timestamp));
+    sqlite3_bind_blob64(statement.get(), 2, blob.data(),
                         blob.size() * sizeof(unsigned char), SQLITE_STATIC);
-    sqlite3_bind_int(statement, 3, userId);
-    if (sqlite3_step(statement) != SQLITE_DONE)
+    sqlite3_bind_int64(statement.get(), 3, userId);
+    if (_run(statement) != SQLITE_DONE)
         throw Error("Failed to store blob into table 'bundles'.");
-    sqlite3_finalize(statement);
 }
 
 /**
@@ -272,12 +491,154 @@ void ServerSQLite::updateBundle(uint32_t userId,
  * @return true if succeeded
  */
 bool ServerSQLite::removeBundle(uint32_t userId) {
-    return _execute("DELETE FROM bundles WHERE userid = " +
-                        std::to_string(userId) + ";",
-                    nullptr, nullptr) == SQLITE_OK;
+    std::lock_guard<std::mutex> lock(_writeLock);
+    bool removed = true;
+    _transaction([&]() {
+        for (Query query : {Query::REMOVE_BUNDLE, Query::REMOVE_ONETIME_KEYS}) {
+            Statement statement(_writer->statement(query));
+            sqlite3_bind_int64(statement.get(), 1, userId);
+            removed &= _run(statement) == SQLITE_DONE;
+        }
+    });
+    return removed;
+}
+
+void ServerSQLite::insertOneTimeKeys(uint32_t userId,
+                                     const std::vector<zero::bytes_t> &keys) {
+    std::lock_guard<std::mutex> lock(_writeLock);
+    _transaction([&]() { _insertOneTimeKeys(userId, keys); });
+}
+
+std::pair<uint32_t, zero::bytes_t> ServerSQLite::popOneTimeKey(
+    uint32_t userId) {
+    std::pair<uint32_t, zero::bytes_t> result{0, {}};
+    std::lock_guard<std::mutex> lock(_writeLock);
+    _transaction([&]() { result = _popOneTimeKey(userId); });
+    return result;
+}
+
+void ServerSQLite::replaceBundle(uint32_t userId,
+                                 const std::vector<unsigned char> &blob,
+                                 const std::vector<zero::bytes_t> &keys) {
+    std::lock_guard<std::mutex> lock(_writeLock);
+    _transaction([&]() {
+        Statement statement(_writer->statement(Query::INSERT_BUNDLE));
+        sqlite3_bind_int64(statement.get(), 1, userId);
+        sqlite3_bind_int64(
+            statement.get(), 2,
+            static_cast<sqlite3_int64>(getTimestampOf(nullptr)));
+        sqlite3_bind_blob64(statement.get(), 3, blob.data(), blob.size(),
+                            SQLITE_STATIC);
+        if (_run(statement) != SQLITE_DONE)
+            throw Error("Failed to store blob into table 'bundles'. (" +
+                        std::string(sqlite3_errmsg(_writer->handler())) + ")");
+        _insertOneTimeKeys(userId, keys);
+    });
+}
+
+ClaimedBundle ServerSQLite::claimBundle(uint32_t userId,
+                                        uint64_t expiredTimestamp) {
+    ClaimedBundle result;
+    std::lock_guard<std::mutex> lock(_writeLock);
+    _transaction([&]() {
+        {
+            Statement statement(
+                _writer->statement(Query::SELECT_BUNDLE_WITH_TIMESTAMP));
+            sqlite3_bind_int64(statement.get(), 1, userId);
+            if (sqlite3_step(statement.get()) != SQLITE_ROW) return;
+
+            result.timestamp =
+                static_cast<uint64_t>(sqlite3_column_int64(statement.get(), 0));
+            const auto *ptr = reinterpret_cast<const unsigned char *>(
+                sqlite3_column_blob(statement.get(), 1));
+            result.bundle.assign(
+                ptr, ptr + sqlite3_column_bytes(statement.get(), 1));
+        }
+        std::pair<uint32_t, zero::bytes_t> key = _popOneTimeKey(userId);
+        result.oneTimeKeyId = key.first;
+        result.oneTimeKey = std::move(key.second);
+
+        {
+            Statement count(_writer->statement(Query::COUNT_ONETIME_KEYS));
+            sqlite3_bind_int64(count.get(), 1, userId);
+            if (sqlite3_step(count.get()) == SQLITE_ROW)
+                result.oneTimeKeysLeft =
+                    static_cast<size_t>(sqlite3_column_int64(count.get(), 0));
+        }
+        if (result.oneTimeKeysLeft > 0) return;
+
+        // the blob is left as is, only the owner replaces it
+        Statement expire(_writer->statement(Query::UPDATE_BUNDLE_TIMESTAMP));
+        sqlite3_bind_int64(expire.get(), 1,
+                           static_cast<sqlite3_int64>(expiredTimestamp));
+        sqlite3_bind_int64(expire.get(), 2, userId);
+        if (_run(expire) != SQLITE_DONE)
+            throw Error("Failed to update bundle timestamp.");
+        result.timestamp = expiredTimestamp;
+    });
+    return result;
+}
+
+void ServerSQLite::_insertOneTimeKeys(uint32_t userId,
+                                      const std::vector<zero::bytes_t> &keys) {
+    Statement remove(_writer->statement(Query::REMOVE_ONETIME_KEYS));
+    sqlite3_bind_int64(remove.get(), 1, userId);
+    if (_run(remove) != SQLITE_DONE)
+        throw Error("Failed to replace one-time keys.");
+
+    // one statement reused for all the keys, inserted in one transaction
+    sqlite3_stmt *insert = _writer->statement(Query::INSERT_ONETIME_KEY);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        Statement statement(insert);
+        sqlite3_bind_int64(statement.get(), 1, userId);
+        sqlite3_bind_int64(statement.get(), 2, static_cast<sqlite3_int64>(i));
+        sqlite3_bind_blob64(statement.get(), 3, keys[i].data(), keys[i].size(),
+                            SQLITE_STATIC);
+        if (_run(statement) != SQLITE_DONE)
+            throw Error("Failed to store one-time key. (" +
+                        std::string(sqlite3_errmsg(_writer->handler())) + ")");
+    }
+}
+
+std::pair<uint32_t, zero::bytes_t> ServerSQLite::_popOneTimeKey(
+    uint32_t userId) {
+    std::pair<uint32_t, zero::bytes_t> result{0, {}};
+    {
+        Statement statement(_writer->statement(Query::SELECT_LAST_ONETIME_KEY));
+        sqlite3_bind_int64(statement.get(), 1, userId);
+        if (sqlite3_step(statement.get()) != SQLITE_ROW) return result;
+
+        result.first =
+            static_cast<uint32_t>(sqlite3_column_int64(statement.get(), 0));
+        const auto *ptr = reinterpret_cast<const unsigned char *>(
+            sqlite3_column_blob(statement.get(), 1));
+        result.second.assign(ptr,
+                             ptr + sqlite3_column_bytes(statement.get(), 1));
+    }
+    Statement remove(_writer->statement(Query::REMOVE_ONETIME_KEY));
+    sqlite3_bind_int64(remove.get(), 1, userId);
+    sqlite3_bind_int64(remove.get(), 2, result.first);
+    if (_run(remove) != SQLITE_DONE)
+        throw Error("Failed to claim one-time key.");
+    return result;
+}
+
+size_t ServerSQLite::countOneTimeKeys(uint32_t userId) const {
+    std::unique_lock<std::mutex> lock;
+    Statement statement(_reader(lock).statement(Query::COUNT_ONETIME_KEYS));
+    sqlite3_bind_int64(statement.get(), 1, userId);
+
+    size_t count = 0;
+    if (sqlite3_step(statement.get()) == SQLITE_ROW)
+        count = static_cast<size_t>(sqlite3_column_int64(statement.get(), 0));
+    return count;
 }
 
 void ServerSQLite::drop(const std::string &tablename) {
+    std::lock_guard<std::mutex> lock(_writeLock);
+    // statements compiled against the dropped table would be stale,
+    // statements of readers get recompiled by sqlite on the schema change
+    _writer->finalize();
     if (int res = _execute("DROP TABLE " + tablename + ";", nullptr, nullptr) !=
                   SQLITE_OK) {
         throw Error("Could not delete database: " +
@@ -291,12 +652,154 @@ void ServerSQLite::drop() {
     }
 }
 
+ServerSQLite::Connection &ServerSQLite::_reader(
+    std::unique_lock<std::mutex> &lock) const {
+    if (_filename.empty()) {
+        lock = std::unique_lock<std::mutex>(_writeLock);
+        return *_writer;
+    }
+
+    // databases the thread has read, its connections are closed on exit
+    struct ThreadReaders {
+        std::vector<std::weak_ptr<Readers>> used;
+
+        ~ThreadReaders() {
+            for (const std::weak_ptr<Readers> &database : used) {
+                std::shared_ptr<Readers> readers = database.lock();
+                if (readers == nullptr) continue;
+                std::lock_guard<std::mutex> guard(readers->lock);
+                readers->connections.erase(this);
+            }
+        }
+    };
+    thread_local ThreadReaders thread;
+
+    std::lock_guard<std::mutex> guard(_readers->lock);
+    std::unique_ptr<Connection> &reader = _readers->connections[&thread];
+    if (reader == nullptr) {
+        reader = std::make_unique<Connection>(
+            _filename.c_str(), SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX);
+        // forget databases destroyed meanwhile
+        thread.used.erase(
+            std::remove_if(thread.used.begin(), thread.used.end(),
+                           [](const std::weak_ptr<Readers> &database) {
+                               return database.expired();
+                           }),
+            thread.used.end());
+        thread.used.push_back(_readers);
+        _configure(*reader);
+    }
+    return *reader;
+}
+
+size_t ServerSQLite::readerConnections() const {
+    std::lock_guard<std::mutex> guard(_readers->lock);
+    return _readers->connections.size();
+}
+
+void ServerSQLite::_configure(const Connection &connection) const {
+    std::string pragmas =
+        "PRAGMA synchronous = " + _options.synchronous +
+        "; PRAGMA cache_size = " + std::to_string(_options.cacheSize) +
+        "; PRAGMA mmap_size = " + std::to_string(_options.mmapSize) +
+        "; PRAGMA temp_store = " + _options.tempStore + ";";
+    if (sqlite3_exec(connection.handler(), pragmas.c_str(), nullptr, nullptr,
+                     nullptr) != SQLITE_OK) {
+        throw Error("Invalid database options: " +
+                    std::string(sqlite3_errmsg(connection.handler())));
+    }
+    // checkpoints may lock the file for a moment
+    sqlite3_busy_timeout(connection.handler(), 5000);
+}
+
+void ServerSQLite::_updateSearchIndex(bool insert, uint32_t id,
+                                      const std::string &name) {
+    sqlite3_stmt *update = _writer->statement(
+        insert ? Query::INSERT_USER_TRIGRAM : Query::REMOVE_USER_TRIGRAM);
+    sqlite3_stmt *count =
+        _writer->statement(insert ? Query::INCREMENT_TRIGRAM_COUNT
+                                  : Query::DECREMENT_TRIGRAM_COUNT);
+    for (const std::string &trigram : _trigrams(name)) {
+        Statement statement(update);
+        sqlite3_bind_blob(statement.get(), 1, trigram.data(),
+                          static_cast<int>(trigram.size()), SQLITE_STATIC);
+        sqlite3_bind_int64(statement.get(), 2, id);
+        Statement counter(count);
+        sqlite3_bind_blob(counter.get(), 1, trigram.data(),
+                          static_cast<int>(trigram.size()), SQLITE_STATIC);
+        if (_run(statement) != SQLITE_DONE || _run(counter) != SQLITE_DONE)
+            throw Error("Failed to update user search index. (" +
+                        std::string(sqlite3_errmsg(_writer->handler())) +
+                        ")");
+    }
+}
+
+void ServerSQLite::_indexAllUsers() {
+    std::lock_guard<std::mutex> lock(_writeLock);
+    _transaction([&]() {
+        Statement statement(_writer->statement(Query::SELECT_USER_NAMES));
+        while (sqlite3_step(statement.get()) == SQLITE_ROW) {
+            const char *name = reinterpret_cast<const char *>(
+                sqlite3_column_text(statement.get(), 1));
+            _updateSearchIndex(
+                true,
+                static_cast<uint32_t>(sqlite3_column_int64(statement.get(), 0)),
+                std::string(name,
+                            name + sqlite3_column_bytes(statement.get(), 1)));
+        }
+    });
+}
+
+std::vector<std::string> ServerSQLite::_trigrams(const std::string &name) {
+    std::string lower = name;
+    std::transform(lower.begin(), lower.end(), lower.begin(), [](char c) {
+        return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+    });
+    std::vector<std::string> trigrams;
+    for (size_t i = 0; i + 3 <= lower.size(); ++i) {
+        std::string trigram = lower.substr(i, 3);
+        if (std::find(trigrams.begin(), trigrams.end(), trigram) ==
+            trigrams.end())
+            trigrams.push_back(std::move(trigram));
+    }
+    return trigrams;
+}
+
+std::string ServerSQLite::_escapeLike(const std::string &query) {
+    std::string escaped;
+    escaped.reserve(query.size());
+    for (char c : query) {
+        if (c == '%' || c == '_' || c == '\\') escaped.push_back('\\');
+        escaped.push_back(c);
+    }
+    return escaped;
+}
+
+UserData ServerSQLite::_readUser(sqlite3_stmt *statement) {
+    UserData data;
+    data.id = static_cast<uint32_t>(sqlite3_column_int64(statement, 0));
+
+    const char *name =
+        reinterpret_cast<const char *>(sqlite3_column_text(statement, 1));
+    data.name = std::string(name, name + sqlite3_column_bytes(statement, 1));
+
+    const unsigned char *key = sqlite3_column_text(statement, 2);
+    data.publicKey =
+        zero::bytes_t(key, key + sqlite3_column_bytes(statement, 2));
+    return data;
+}
+
+int ServerSQLite::_run(const Statement &statement) {
+    return sqlite3_step(statement.get());
+}
+
 int ServerSQLite::_execute(std::string &&command,
                            int (*callback)(void *, int, char **, char **),
                            void *fstArg) {
     command.push_back('\0');    // the c library - just to be sure
     char *error;
-    int res = sqlite3_exec(_handler, command.data(), callback, fstArg, &error);
+    int res = sqlite3_exec(_writer->handler(), command.data(), callback, fstArg,
+                           &error);
     if (res != SQLITE_OK) {
         printf("%s\n", error);
     }
@@ -304,6 +807,15 @@ int ServerSQLite::_execute(std::string &&command,
 }
 
 void ServerSQLite::_createTablesIfNExists() {
+    bool indexed = false;
+    _execute("SELECT name FROM sqlite_master WHERE type = 'table' "
+             "AND name = 'user_trigrams';",
+             [](void *found, int, char **, char **) {
+                 *static_cast<bool *>(found) = true;
+                 return 0;
+             },
+             &indexed);
+
     if (int res = _execute("CREATE TABLE IF NOT EXISTS users ("
                            "id INTEGER PRIMARY KEY AUTOINCREMENT, "
                            "username TEXT, "
@@ -333,6 +845,41 @@ void ServerSQLite::_createTablesIfNExists() {
         throw Error("Could not create key bundles database: " +
                     _getErrorMsgByReturnType(res));
     }
+
+    if (int res = _execute("CREATE TABLE IF NOT EXISTS onetime_keys ("
+                           "userid INTEGER, "
+                           "keyid INTEGER, "
+                           "key BLOB, "
+                           "PRIMARY KEY (userid, keyid)) WITHOUT ROWID;",
+                           nullptr, nullptr) != SQLITE_OK) {
+        throw Error("Could not create one-time keys database: " +
+                    _getErrorMsgByReturnType(res));
+    }
+
+    // exact name lookups (login, registration) use the index as well
+    if (int res = _execute("CREATE INDEX IF NOT EXISTS users_username "
+                           "ON users (username);",
+                           nullptr, nullptr) != SQLITE_OK) {
+        throw Error("Could not create users index: " +
+                    _getErrorMsgByReturnType(res));
+    }
+
+    if (int res = _execute("CREATE TABLE IF NOT EXISTS user_trigrams ("
+                           "trigram BLOB, "
+                           "userid INTEGER, "
+                           "PRIMARY KEY (trigram, userid)) WITHOUT ROWID;",
+                           nullptr, nullptr) != SQLITE_OK) {
+        throw Error("Could not create user search index: " +
+                    _getErrorMsgByReturnType(res));
+    }
+    if (int res = _execute("CREATE TABLE IF NOT EXISTS trigram_counts ("
+                           "trigram BLOB PRIMARY KEY, "
+                           "users INTEGER) WITHOUT ROWID;",
+                           nullptr, nullptr) != SQLITE_OK) {
+        throw Error("Could not create user search index: " +
+                    _getErrorMsgByReturnType(res));
+    }
+    if (!indexed) _indexAllUsers();
 }
 
 std::string ServerSQLite::_sCheck(std::string query) {
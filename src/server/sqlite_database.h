@@ -11,7 +11,11 @@
 #ifndef HELLOWORLD_SERVER_SQLITE_DATABASE_H_
 #define HELLOWORLD_SERVER_SQLITE_DATABASE_H_
 
+#include <array>
 #include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 
 #include "../shared/user_data.h"
 #include "database_server.h"
@@ -22,12 +26,146 @@ namespace helloworld {
 
 const std::string specialCharacters = ":?\"%'";
 
+/**
+ * Tuning of file database connections, values are passed to the pragmas
+ * of the same name, see https://www.sqlite.org/pragma.html
+ */
+struct SQLiteOptions {
+    std::string synchronous{"NORMAL"};    /**< OFF, NORMAL, FULL or EXTRA */
+    int64_t cacheSize{-8192};             /**< pages, or KiB if negative */
+    int64_t mmapSize{256 * 1024 * 1024};  /**< mapped bytes, 0 disables */
+    std::string tempStore{"MEMORY"};      /**< DEFAULT, FILE or MEMORY */
+};
+
 class ServerSQLite : public ServerDatabase {
+    /**
+     * Every statement the database runs, index into the statement cache
+     */
+    enum class Query : size_t {
+        INSERT_USER = 0,
+        INSERT_USER_WITH_ID,
+        SELECT_USER_LIKE,
+        SELECT_USER_BY_ID,
+        SELECT_USER_BY_NAME,
+        REMOVE_USER_BY_ID,
+        REMOVE_USER_BY_NAME,
+        SELECT_USER_NAMES,
+        SEARCH_USERS,
+        SEARCH_USERS_BY_TRIGRAM,
+        INSERT_USER_TRIGRAM,
+        REMOVE_USER_TRIGRAM,
+        SELECT_TRIGRAM_COUNT,
+        INCREMENT_TRIGRAM_COUNT,
+        DECREMENT_TRIGRAM_COUNT,
+        INSERT_DATA,
+        SELECT_DATA,
+        REMOVE_DATA,
+        REMOVE_ALL_DATA,
+        REMOVE_DATA_UP_TO,
+        INSERT_BUNDLE,
+        SELECT_BUNDLE,
+        SELECT_BUNDLE_TIMESTAMP,
+        SELECT_BUNDLE_WITH_TIMESTAMP,
+        UPDATE_BUNDLE,
+        UPDATE_BUNDLE_WITH_TIMESTAMP,
+        UPDATE_BUNDLE_TIMESTAMP,
+        REMOVE_BUNDLE,
+        INSERT_ONETIME_KEY,
+        SELECT_LAST_ONETIME_KEY,
+        COUNT_ONETIME_KEYS,
+        REMOVE_ONETIME_KEY,
+        REMOVE_ONETIME_KEYS,
+        BEGIN_TRANSACTION,
+        COMMIT_TRANSACTION,
+        ROLLBACK_TRANSACTION,
+        COUNT
+    };
+
+    static const std::array<const char *,
+                            static_cast<size_t>(Query::COUNT)> _queries;
+
+    /**
+     * Database connection with its own cache of statements, each prepared
+     * once on first use; must be used by one thread at a time
+     */
+    class Connection {
+        sqlite3 *_handler = nullptr;
+        std::array<sqlite3_stmt *, static_cast<size_t>(Query::COUNT)>
+            _statements{};
+
+       public:
+        /**
+         * @param filename database file or nullptr for in-memory database
+         * @param flags sqlite3_open_v2() flags
+         */
+        Connection(const char *filename, int flags);
+
+        // Copying is not available
+        Connection(const Connection &other) = delete;
+
+        Connection &operator=(const Connection &other) = delete;
+
+        ~Connection();
+
+        sqlite3 *handler() const { return _handler; }
+
+        sqlite3_stmt *statement(Query query);
+
+        /**
+         * Finalize all cached statements
+         */
+        void finalize();
+    };
+
+    /**
+     * Use of cached statement, on release the statement is reset and its
+     * bindings cleared so it is ready for the next use
+     */
+    class Statement {
+        sqlite3_stmt *_statement;
+
+       public:
+        explicit Statement(sqlite3_stmt *statement) : _statement(statement) {}
+
+        Statement(const Statement &other) = delete;
+
+        Statement &operator=(const Statement &other) = delete;
+
+        ~Statement() {
+            sqlite3_reset(_statement);
+            sqlite3_clear_bindings(_statement);
+        }
+
+        sqlite3_stmt *get() const { return _statement; }
+    };
+
     std::vector<std::unique_ptr<UserData>> _cache;
-    sqlite3 *_handler = nullptr;
+    // empty for in-memory database, that has the writer connection only
+    std::string _filename;
+    SQLiteOptions _options;
+
+    // all writes are serialized through one connection
+    mutable std::mutex _writeLock;
+    std::unique_ptr<Connection> _writer;
+
+    /**
+     * Read connections by the thread owning them, a thread closes its
+     * connection when it exits; shared so that the database may be
+     * destroyed before the threads that used it
+     */
+    struct Readers {
+        std::mutex lock;
+        std::unordered_map<const void *, std::unique_ptr<Connection>>
+            connections;
+    };
+
+    // WAL readers never wait for the writer, one connection per thread
+    std::shared_ptr<Readers> _readers = std::make_shared<Readers>();
 
    public:
-    const std::vector<std::string> tables{"users", "bundles", "messages"};
+    const std::vector<std::string> tables{"users", "bundles", "messages",
+                                          "onetime_keys", "user_trigrams",
+                                          "trigram_counts"};
 
     /**
      * Creates temporary in-memory database
@@ -36,12 +174,14 @@ class ServerSQLite : public ServerDatabase {
     ServerSQLite();
 
     /**
-     * Creates file database wit table named user
+     * Creates file database wit table named user, the database is switched
+     * to write-ahead log so that reads run concurrently with the writes
      *
      * @param filename name of the database, the filename string is modified
      *          filename without the '.db' file type specifier
+     * @param options connection tuning
      */
-    explicit ServerSQLite(std::string &&filename);
+    explicit ServerSQLite(std::string &&filename, SQLiteOptions options = {});
 
     // Copying is not available
     ServerSQLite(const ServerSQLite &other) = delete;
@@ -61,6 +201,9 @@ class ServerSQLite : public ServerDatabase {
         const UserData &query) override;
     const std::vector<std::unique_ptr<UserData>> &selectLike(
         const std::string &username) override;
+    std::vector<UserData> searchUsers(const std::string &query,
+                                      uint32_t beforeId,
+                                      size_t limit) const override;
     bool remove(const UserData &data) override;
 
     /*
@@ -69,6 +212,13 @@ class ServerSQLite : public ServerDatabase {
     void insertData(uint32_t userId,
                     const std::vector<unsigned char> &blob) override;
     std::vector<unsigned char> selectData(uint32_t userId) override;
+    std::vector<std::vector<unsigned char>> selectData(
+        uint32_t userId, size_t maxCount, size_t maxBytes,
+        bool &more) override;
+    std::vector<std::vector<unsigned char>> peekData(
+        uint32_t userId, size_t maxCount, size_t maxBytes, uint64_t &last,
+        bool &more) override;
+    void deleteData(uint32_t userId, uint64_t last) override;
     void deleteAllData(uint32_t userId) override;
 
     /*
@@ -83,49 +233,132 @@ class ServerSQLite : public ServerDatabase {
     void updateBundle(uint32_t userId, const std::vector<unsigned char> &blob,
                       uint64_t timestamp) override;
     bool removeBundle(uint32_t userId) override;
+    void insertOneTimeKeys(uint32_t userId,
+                           const std::vector<zero::bytes_t> &keys) override;
+    std::pair<uint32_t, zero::bytes_t> popOneTimeKey(uint32_t userId) override;
+    size_t countOneTimeKeys(uint32_t userId) const override;
+    void replaceBundle(uint32_t userId, const std::vector<unsigned char> &blob,
+                       const std::vector<zero::bytes_t> &keys) override;
+    ClaimedBundle claimBundle(uint32_t userId,
+                              uint64_t expiredTimestamp) override;
+
+    /**
+     * Number of open read connections, one per live thread that has read
+     * the file database
+     */
+    size_t readerConnections() const;
 
     void drop() override;
 
     void drop(const std::string &tablename) override;
 
    private:
-    int _execute(std::string &&command,
-                 int (*callback)(void *, int, char **, char **), void *fstArg);
+    /**
+     * Get read connection of the calling thread, opened on first use
+     *
+     * @param lock locked with the writer lock if database has no
+     *        separate readers (in-memory database)
+     * @return connection to run read only statements with
+     */
+    Connection &_reader(std::unique_lock<std::mutex> &lock) const;
 
     /**
-     * Create all tables and their structures if n exists
+     * Apply the options to newly opened connection
      */
-    void _createTablesIfNExists();
+    void _configure(const Connection &connection) const;
 
     /**
-     * Callback for execution, perform selection - save data
-     * @param argc number of values in a row
-     * @param argv values in array
-     * @param colName coll names in array
-     * @return 0 on success
+     * Run function in a transaction on the writer connection, rolled back
+     * if the function throws; the caller must hold the writer lock
      */
-    static int _fillData(void *data, int argc, char **argv,
-                         char ** /*colName*/) {
-        if (argc != 3) return 1;
+    template <typename Function>
+    void _transaction(Function function);
 
-        auto *cache =
-            static_cast<std::vector<std::unique_ptr<UserData>> *>(data);
-        auto id = static_cast<uint32_t>(std::stol(argv[0]));
-        std::string pubkey(argv[2]);
-        zero::bytes_t publicKey(pubkey.begin(), pubkey.end());
-        UserData temp{id, argv[1], "", publicKey};
-        cache->push_back(std::make_unique<UserData>(temp));
-        return 0;
-    }
+    /**
+     * Read the oldest blobs of the user on the writer connection,
+     * the caller must hold the writer lock
+     *
+     * @param last id of the last blob read, untouched if none
+     * @param more set to whether a blob follows the batch
+     */
+    std::vector<std::vector<unsigned char>> _readData(uint32_t userId,
+                                                      size_t maxCount,
+                                                      size_t maxBytes,
+                                                      uint64_t &last,
+                                                      bool &more);
+
+    /**
+     * Delete blobs of the user up to the id given on the writer connection,
+     * the caller must hold the writer lock
+     */
+    void _deleteData(uint32_t userId, uint64_t last);
+
+    /**
+     * Replace one-time keys of the user on the writer connection, the caller
+     * must hold the writer lock and run it in a transaction
+     */
+    void _insertOneTimeKeys(uint32_t userId,
+                            const std::vector<zero::bytes_t> &keys);
+
+    /**
+     * Claim one-time key of the user on the writer connection, the caller
+     * must hold the writer lock and run it in a transaction
+     */
+    std::pair<uint32_t, zero::bytes_t> _popOneTimeKey(uint32_t userId);
+
+    /**
+     * Add or remove trigrams of the user name in the search index,
+     * the caller must hold the writer lock
+     *
+     * @param insert true to add the user, false to remove
+     */
+    void _updateSearchIndex(bool insert, uint32_t id, const std::string &name);
+
+    /**
+     * Index names of all users, used once when the index is created
+     * for a database that already has users
+     */
+    void _indexAllUsers();
+
+    /**
+     * Distinct three byte substrings of the name, ascii letters lowered
+     * as LIKE ignores their case
+     */
+    static std::vector<std::string> _trigrams(const std::string &name);
+
+    /**
+     * Escape LIKE wildcards, the statements use '\' as escape character
+     */
+    static std::string _escapeLike(const std::string &query);
+
+    /**
+     * Read user row (id, username, pubkey) the statement points to
+     */
+    static UserData _readUser(sqlite3_stmt *statement);
+
+    /**
+     * Run statement not returning any rows
+     *
+     * @return sqlite result code of the step
+     */
+    static int _run(const Statement &statement);
+
+    int _execute(std::string &&command,
+                 int (*callback)(void *, int, char **, char **), void *fstArg);
+
+    /**
+     * Create all tables and their structures if n exists
+     */
+    void _createTablesIfNExists();
 
     static std::string _getErrorMsgByReturnType(int ret);
 
     /**
-     * Query check to protect from injection
+     * Query check, all values are bound as parameters, used to keep
+     * wildcard characters out of LIKE patterns
      *
      * @param query query to check
-     * @return query without special characters that would allowed to attack
-     * database
+     * @return query without special characters
      */
     static std::string _sCheck(std::string query);
 };
@@ -35,7 +35,7 @@ class ServerFiles : public ServerTransmissionManager {
     std::string _lastNew;
 
 public:
-    explicit ServerFiles(Callable<void, bool, const std::string&, std::stringstream&&>* callback) :
+    explicit ServerFiles(Callable<void, bool, const std::string&, const ByteSpan&>* callback) :
                          ServerTransmissionManager(callback) {
         //we put there the super class method, which is overridden (type error otherwise)
         Network::setServer(&ServerTransmissionManager::receive, this);
@@ -78,10 +78,10 @@ public:
         }
 
         try {
-            std::stringstream result{};
-            _base64.toStream(received, result);
+            std::stringstream decoded{};
+            _base64.toStream(received, decoded);
+            std::vector<unsigned char> result = vector_from_stream(decoded);
             std::string name = incoming.substr(0, incoming.size() - 4);
-            result.seekg(0, std::ios::beg);
 
             received.close();
             if (remove(incoming.c_str()) != 0) {
@@ -91,8 +91,8 @@ public:
             bool existing = exists(name);
             if (!existing) _lastNew = name;
 
-            Callable<void, bool, const std::string&, std::stringstream&&>::call(
-                    callback, std::move(existing), name, std::move(result));
+            Callable<void, bool, const std::string&, const ByteSpan&>::call(
+                    callback, std::move(existing), name, ByteSpan(result));
         } catch (...) {
             remove(incoming.c_str());
             throw;
@@ -134,13 +134,8 @@ public:
      * @param filename name to check
      * @return 0 if no connection found, otherwise >0
      */
-    bool exists(const std::string& filename) {
-        for (auto& item : _files) {
-            if (item == filename) {
-                return true;
-            }
-        }
-        return false;
+    bool exists(const std::string& filename) override {
+        return _files.find(filename) != _files.end();
     }
 
     std::set<std::string> getOpenConnections() override {
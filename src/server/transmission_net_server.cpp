@@ -5,7 +5,8 @@
 #include <set>
 #include <sstream>
 
-#include "../shared/base_64.h"
+#include "../shared/buffer_pool.h"
+#include "../shared/framing.h"
 #include "../shared/transmission.h"
 #include "../shared/utils.h"
 
@@ -20,6 +21,7 @@ ServerSocket::ServerSocket(QTcpSocket *socket, std::string username,
     : QObject(parent),
       server(server),
       socket(socket),
+      codec(&SocketCodec::of(socket)),
       username(std::move(username)) {
     socket->setParent(this);
     connect(socket, &QTcpSocket::readyRead, this, &ServerSocket::receive,
@@ -32,6 +34,7 @@ ServerSocket::ServerSocket(ServerSocket &&other) {
     server = std::move(other.server);
     username = std::move(other.username);
     socket = std::move(other.socket);
+    codec = other.codec;
     socket->setParent(this);
     other._owned = false;
 }
@@ -40,12 +43,13 @@ ServerSocket &ServerSocket::operator=(ServerSocket &&other) {
     server = std::move(other.server);
     username = std::move(other.username);
     socket = std::move(other.socket);
+    codec = other.codec;
     socket->setParent(this);
     other._owned = false;
     return *this;
 }
 
-void ServerSocket::receive() { server->_receive(socket, username); }
+void ServerSocket::receive() { server->_receive(socket, *codec, username); }
 
 void ServerSocket::updateConnection(QAbstractSocket::SocketState state) {
     switch (state) {
@@ -78,30 +82,108 @@ void SocketManager::emplace(QTcpSocket *socket, const std::string &name) {
     ownedSockets.emplace_back(new ServerSocket(socket, name, server, this));
     connect(ownedSockets.back(), &ServerSocket::disconnected, this,
             &SocketManager::remove);
+    ServerSocket *owned = ownedSockets.back();
+    std::vector<QByteArray> pending = server->_index(owned);
     lock.unlock();
+    // runs in the socket thread, anything sent later is queued behind this
+    for (const QByteArray &message : pending) {
+        std::vector<unsigned char> frame = owned->codec->encode(
+            {message.begin(), message.end()});
+        socket->write(reinterpret_cast<const char *>(frame.data()),
+                      static_cast<qint64>(frame.size()));
+    }
 }
 
 bool SocketManager::remove(const QTcpSocket *socket) {
+    QWriteLocker lock1(&lock);
     auto it = std::find_if(
         ownedSockets.begin(), ownedSockets.end(),
         [&socket](const ServerSocket *o) { return o->socket == socket; });
     if (it != ownedSockets.end()) {
-        QWriteLocker lock1(&lock);
+        server->_unindex(*it);
         auto name = QString::fromStdString((*it)->username);
         ownedSockets.erase(it);
+        lock1.unlock();
         emit removed(std::move(name));
         return true;
     }
     return false;
 }
 
-void SocketManager::toRegister(QTcpSocket *socket, const QString &name) {
-    emplace(socket, name.toStdString());
+void SocketManager::_post(SocketTask task) {
+    _outbox.push(std::move(task));
+    // one wakeup per batch, drain() resets the flag before it starts popping
+    if (!_drainScheduled.exchange(true))
+        QMetaObject::invokeMethod(this, "drain", Qt::QueuedConnection);
+}
+
+void SocketManager::post(QTcpSocket *socket, QByteArray data) {
+    _post({SocketTask::Action::WRITE, socket, std::move(data)});
+}
+
+void SocketManager::postClose(QTcpSocket *socket) {
+    _post({SocketTask::Action::CLOSE, socket, {}});
+}
+
+void SocketManager::postRegister(QTcpSocket *socket, const std::string &name) {
+    _post({SocketTask::Action::REGISTER, socket,
+           QByteArray(name.data(), static_cast<int>(name.size()))});
+}
+
+void SocketManager::drain() {
+    _drainScheduled = false;
+
+    // socket might have been removed since the work was posted
+    auto owned = [this](QTcpSocket *socket) {
+        ServerSocket *owner = nullptr;
+        return server->_bySocket.find(socket, owner) && owner->parent() == this;
+    };
+
+    QTcpSocket *target = nullptr;
+    QByteArray batch;
+    auto flush = [&owned, &target, &batch]() {
+        if (target && !batch.isEmpty() && owned(target)) target->write(batch);
+        batch.clear();
+    };
+
+    SocketTask task;
+    while (_outbox.pop(task)) {
+        if (task.action == SocketTask::Action::SEND && owned(task.socket)) {
+            std::vector<unsigned char> frame =
+                SocketCodec::of(task.socket).encode(
+                    {task.data.begin(), task.data.end()});
+            task.data = QByteArray(reinterpret_cast<const char *>(frame.data()),
+                                   static_cast<int>(frame.size()));
+            task.action = SocketTask::Action::WRITE;
+        }
+        if (task.action != SocketTask::Action::WRITE ||
+            task.socket != target) {
+            flush();
+            target = nullptr;
+        }
+        switch (task.action) {
+            case SocketTask::Action::WRITE:
+                target = task.socket;
+                batch.append(task.data);
+                break;
+            case SocketTask::Action::CLOSE:
+                if (owned(task.socket)) task.socket->disconnectFromHost();
+                break;
+            case SocketTask::Action::REGISTER:
+                emplace(task.socket, task.data.toStdString());
+                break;
+            case SocketTask::Action::SEND:    // socket no longer owned
+                break;
+        }
+    }
+    flush();
 }
 
 /*****************************************************************************/
 
 QThreadStorage<PtrWrap<QTcpSocket>> ServerTCP::_lastSending;
+constexpr std::chrono::milliseconds ServerTCP::PENDING_TIMEOUT;
+constexpr size_t ServerTCP::MAX_PENDING_FRAMES;
 
 void ServerTCP::cleanAfter(QString name) {
     emit clossedConnection(std::move(name));
@@ -122,6 +204,7 @@ SocketManager *ServerTCP::minThread() {
 void ServerTCP::discoverConnection() {
     QTcpSocket *lastIncomming = _server.nextPendingConnection();
     _lastSending.setLocalData(lastIncomming);
+    _unregistered.insert(lastIncomming);
     connect(lastIncomming, SIGNAL(readyRead()), this, SLOT(receive()));
     connect(lastIncomming, &QAbstractSocket::stateChanged, this,
             &ServerTCP::updateConnection);
@@ -132,6 +215,7 @@ void ServerTCP::updateConnection(QAbstractSocket::SocketState state) {
     switch (state) {
         case QAbstractSocket::SocketState::UnconnectedState: {
             QTcpSocket *sender = static_cast<QTcpSocket *>(QObject::sender());
+            _unregistered.erase(sender);
             sender->deleteLater();
             break;
         }
@@ -140,30 +224,64 @@ void ServerTCP::updateConnection(QAbstractSocket::SocketState state) {
     }
 }
 
-void ServerTCP::_receive(QTcpSocket *sender, const std::string &name) {
+void ServerTCP::_receive(QTcpSocket *sender, FrameCodec &codec,
+                         const std::string &name) {
     _lastSending.setLocalData(sender);
-    QByteArray data = sender->readAll();
-    std::stringstream received{};
-    received.write(data.data(), data.size());
-    std::string msg;
-    while (std::getline(received, msg, '\0')) {
-        std::stringstream result{}, from(msg);
-        _base64.toStream(from, result);
-
-        Callable<void, bool, const std::string &, std::stringstream &&>::call(
-            callback, !name.empty(), name, std::move(result));
+    // read straight into the codec buffer, the only copy before decryption
+    qint64 available = sender->bytesAvailable();
+    if (available > 0) {
+        auto length = static_cast<size_t>(available);
+        qint64 read = sender->read(
+            reinterpret_cast<char *>(codec.prepare(length)), available);
+        codec.commit(read > 0 ? static_cast<size_t>(read) : 0);
+    }
+    _handshake(sender, codec);
+
+    ByteSpan frame;
+    while (true) {
+        try {
+            if (!codec.next(frame)) break;
+        } catch (Error & /*invalid frame*/) {
+            // the stream cannot be resynchronized
+            sender->disconnectFromHost();
+            return;
+        }
+        if (!_workers) {
+            Callable<void, bool, const std::string &, const ByteSpan &>::call(
+                callback, !name.empty(), name, frame);
+            continue;
+        }
+        // the frame must outlive the receive buffer; one lane per connection
+        // for its whole life, requests pipelined across the login must not
+        // overtake each other on two lanes
+        size_t lane = WorkerPool::keyOf(sender);
+        _workers->submit(lane, [this, sender, name, data = frame.toVector()]() {
+            _lastSending.setLocalData(sender);
+            Callable<void, bool, const std::string &, const ByteSpan &>::call(
+                callback, !name.empty(), name, ByteSpan(data));
+            _lastSending.setLocalData({});
+        });
     }
 }
 
+void ServerTCP::_handshake(QTcpSocket *receiver, FrameCodec &codec) {
+    std::vector<unsigned char> handshake = codec.handshake();
+    if (!handshake.empty())
+        receiver->write(reinterpret_cast<const char *>(handshake.data()),
+                        static_cast<qint64>(handshake.size()));
+}
+
 void ServerTCP::receive() {
     QTcpSocket *sender = dynamic_cast<QTcpSocket *>(QObject::sender());
-    _receive(sender);
+    _receive(sender, SocketCodec::of(sender));
 }
 
 ServerTCP::ServerTCP(
-    Callable<void, bool, const std::string &, std::stringstream &&> *callback,
-    QObject *parent)
+    Callable<void, bool, const std::string &, const ByteSpan &> *callback,
+    size_t workers, QObject *parent)
     : QObject(parent), ServerTransmissionManager(callback) {
+    if (workers > 0) _workers = std::make_unique<WorkerPool>(workers);
+
     // start threads
     int optimal = QThread::idealThreadCount() - 1;
     assert(optimal > 0);
@@ -188,34 +306,149 @@ void ServerTCP::_send(QTcpSocket *receiver, QByteArray &data) {
 
 void ServerTCP::send(const std::string &usrname, std::iostream &data) {
     data.seekg(0, std::ios::beg);
-    std::stringstream toSend;
-    _base64.fromStream(data, toSend);
-    toSend << '\0';
-    QByteArray arr(toSend.str().data(), getSize(toSend));
     QTcpSocket *client = nullptr;
     if (!usrname.empty()) {
-        // TODO: use cv
-        while (!client) client = getSocket(usrname);
+        ServerSocket *p = _socketOrQueue(usrname, data);
+        if (!p) return;
 
-        auto p = dynamic_cast<ServerSocket *>(client->parent());
-        connect(this, &ServerTCP::forward, p, &ServerSocket::send);
-        emit forward(arr);
-        disconnect(this, &ServerTCP::forward, p, &ServerSocket::send);
+        static_cast<SocketManager *>(p->parent())
+            ->post(p->socket, _frame(*p->codec, data));
         return;
     }
     client = _lastSending.localData();
-
+    if (_workers && _workers->isWorkerThread()) {
+        // the socket is owned by another thread, which does the writing
+        ServerSocket *owner = nullptr;
+        if (_bySocket.find(client, owner)) {
+            static_cast<SocketManager *>(owner->parent())
+                ->post(client, _frame(*owner->codec, data));
+        } else {
+            std::vector<unsigned char> message = vector_from_stream(data);
+            _post({SocketTask::Action::SEND, client,
+                   QByteArray(reinterpret_cast<const char *>(message.data()),
+                              static_cast<int>(message.size()))});
+        }
+        return;
+    }
+    QByteArray arr = _frame(SocketCodec::of(client), data);
     _send(client, arr);
 }
 
+QByteArray ServerTCP::_frame(FrameCodec &codec, std::istream &data) {
+    // payload and frame live in pooled buffers, the array handed to the
+    // socket is the only allocation per message
+    size_t size = getSize(data);
+    MessageBuffer payload(size);
+    payload->resize(size);
+    read_n(data, payload->data(), payload->size());
+    MessageBuffer frame(codec.frameSize(size));
+    codec.encode(*payload, *frame);
+    return QByteArray(reinterpret_cast<const char *>(frame->data()),
+                      static_cast<int>(frame->size()));
+}
+
+void ServerTCP::_post(SocketTask task) {
+    _outbox.push(std::move(task));
+    if (!_drainScheduled.exchange(true))
+        QMetaObject::invokeMethod(this, "drain", Qt::QueuedConnection);
+}
+
+void ServerTCP::drain() {
+    _drainScheduled = false;
+    SocketTask task;
+    while (_outbox.pop(task)) {
+        if (_unregistered.find(task.socket) == _unregistered.end()) {
+            // disconnected meanwhile, the registration will never finish
+            if (task.action == SocketTask::Action::REGISTER) {
+                QMutexLocker locker(&_pendingLock);
+                auto pending = _pending.find(task.data.toStdString());
+                if (pending != _pending.end() &&
+                    pending->second.socket == task.socket) {
+                    _pending.erase(pending);
+                    _pendingCount = _pending.size();
+                }
+            }
+            continue;
+        }
+        switch (task.action) {
+            case SocketTask::Action::SEND: {
+                std::vector<unsigned char> frame =
+                    SocketCodec::of(task.socket)
+                        .encode({task.data.begin(), task.data.end()});
+                task.socket->write(reinterpret_cast<const char *>(frame.data()),
+                                   static_cast<qint64>(frame.size()));
+                break;
+            }
+            case SocketTask::Action::WRITE:
+                task.socket->write(task.data);
+                break;
+            case SocketTask::Action::CLOSE:
+                task.socket->disconnectFromHost();
+                break;
+            case SocketTask::Action::REGISTER:
+                _handOver(task.socket, task.data.toStdString());
+                break;
+        }
+    }
+}
+
+ServerSocket *ServerTCP::_socketOrQueue(const std::string &username,
+                                        std::iostream &data) {
+    ServerSocket *target = nullptr;
+    // fast path, nobody is being registered right now
+    if (_pendingCount == 0 && _byName.find(username, target)) return target;
+
+    // the user moves from pending to indexed under the lock, there is no
+    // window to wait for: neither of them means no connection
+    QMutexLocker locker(&_pendingLock);
+    // pending registration wins, an indexed socket may be the old one
+    auto pending = _pending.find(username);
+    if (pending != _pending.end()) {
+        PendingSends &queue = pending->second;
+        if (std::chrono::steady_clock::now() - queue.since > PENDING_TIMEOUT ||
+            queue.messages.size() >= MAX_PENDING_FRAMES) {
+            _pending.erase(pending);
+            _pendingCount = _pending.size();
+            throw Error("Connection registration timed out.");
+        }
+        std::vector<unsigned char> message = vector_from_stream(data);
+        queue.messages.emplace_back(
+            reinterpret_cast<const char *>(message.data()),
+            static_cast<int>(message.size()));
+        return nullptr;
+    }
+    if (_byName.find(username, target)) return target;
+    throw Error("No connection available for the user.");
+}
+
 void ServerTCP::registerConnection(const std::string &username) {
     QTcpSocket *sender = _lastSending.localData();
     _lastSending.setLocalData({});
+    if (_workers && _workers->isWorkerThread()) {
+        // only the thread owning the socket can move it
+        if (username.empty() || _bySocket.contains(sender)) return;
+        _markPending(username, sender);
+        _post({SocketTask::Action::REGISTER, sender,
+               QByteArray(username.data(), static_cast<int>(username.size()))});
+        return;
+    }
     if (auto owner =
             dynamic_cast<ServerSocket *>(sender->parent()) != nullptr) {
         return;
     }
     if (username.empty()) return;
+    _markPending(username, sender);
+    _handOver(sender, username);
+}
+
+void ServerTCP::_markPending(const std::string &username, QTcpSocket *socket) {
+    QMutexLocker locker(&_pendingLock);
+    _pending[username] = {socket, std::chrono::steady_clock::now(), {}};
+    _pendingCount = _pending.size();
+}
+
+void ServerTCP::_handOver(QTcpSocket *sender, const std::string &username) {
+    _unregistered.erase(sender);
     disconnect(sender, SIGNAL(readyRead()), this, SLOT(receive()));
     disconnect(sender, &QAbstractSocket::stateChanged, this,
                &ServerTCP::updateConnection);
@@ -225,80 +458,84 @@ void ServerTCP::registerConnection(const std::string &username) {
     sender->setParent(nullptr);
     sender->moveToThread(connectionManager->thread);
 
-    connect(this, &ServerTCP::toRegister, connectionManager,
-            &SocketManager::toRegister);
-    emit toRegister(sender, QString().fromStdString(username));
-    disconnect(this, &ServerTCP::toRegister, connectionManager,
-               &SocketManager::toRegister);
+    connectionManager->postRegister(sender, username);
 }
 
 void ServerTCP::discardNewConnection(const std::vector<unsigned char> &data) {
     QTcpSocket *sender = static_cast<QTcpSocket *>(QObject::sender());
     assert(sender);
     emit disconn(sender->peerAddress(), sender->peerPort());
-    sender->write(reinterpret_cast<const char *>(data.data()),
-                  static_cast<long long>(data.size()));
+    std::vector<unsigned char> frame = SocketCodec::of(sender).encode(data);
+    sender->write(reinterpret_cast<const char *>(frame.data()),
+                  static_cast<long long>(frame.size()));
 
     disconnect(sender, SIGNAL(readyRead()), this, SLOT(recieve()));
+    _unregistered.erase(sender);
     sender->deleteLater();
 }
 
 bool ServerTCP::removeConnection(const std::string &username) {
-    auto socket = getSocket(username);
-    if (!socket) return false;
-
-    auto socketWrapper = dynamic_cast<ServerSocket *>(socket->parent());
-    if (!socketWrapper) return false;
+    ServerSocket *socketWrapper = nullptr;
+    if (!_byName.find(username, socketWrapper)) return false;
 
-    connect(this, &ServerTCP::toClose, socketWrapper,
-            &ServerSocket::closeConnection);
-    emit toClose();
-    disconnect(this, &ServerTCP::toClose, socketWrapper,
-               &ServerSocket::closeConnection);
+    static_cast<SocketManager *>(socketWrapper->parent())
+        ->postClose(socketWrapper->socket);
     return true;
 }
 
+std::vector<LaneMetrics> ServerTCP::workerMetrics() const {
+    if (!_workers) return {};
+    return _workers->metrics();
+}
+
 bool ServerTCP::exists(const std::string &username) {
-    return getSocket(username) != nullptr;
+    if (_byName.contains(username)) return true;
+    // socket being registered, sends are queued until it is indexed
+    if (_pendingCount == 0) return false;
+    QMutexLocker locker(&_pendingLock);
+    return _pending.find(username) != _pending.end();
 }
 
 // todo will return even auth-waiting users ! consider the consequence
 std::set<std::string> ServerTCP::getOpenConnections() {
-    lock.lockForRead();
     std::set<std::string> names;
-    for (auto &thread : _threads) {
-        thread->lock.lockForRead();
-        for (const auto &connection : thread->ownedSockets) {
-            names.insert(connection->username);
-        }
-        thread->lock.unlock();
-    }
-    lock.unlock();
+    _byName.forEach([&names](const std::string &name, ServerSocket *) {
+        names.insert(name);
+    });
     return names;
 }
 
-QTcpSocket *ServerTCP::getSocket(const std::string &username) {
-    QReadLocker lock1(&lock);
-    for (auto &thread : _threads) {
-        QReadLocker lock2(&thread->lock);
-        for (const auto &connection : thread->ownedSockets)
-            if (username == connection->username) {
-                return connection->socket;
-            }
+std::vector<QByteArray> ServerTCP::_index(ServerSocket *socket) {
+    std::vector<QByteArray> messages;
+    QMutexLocker locker(&_pendingLock);
+    _byName.insert(socket->username, socket);
+    _bySocket.insert(socket->socket, socket);
+
+    auto pending = _pending.find(socket->username);
+    if (pending != _pending.end() && pending->second.socket == socket->socket) {
+        messages = std::move(pending->second.messages);
+        _pending.erase(pending);
+        _pendingCount = _pending.size();
     }
-    return nullptr;
+    return messages;
+}
+
+void ServerTCP::_unindex(ServerSocket *socket) {
+    // the name might already belong to newer connection of the same user
+    _byName.erase(socket->username, socket);
+    _bySocket.erase(socket->socket, socket);
+}
+
+QTcpSocket *ServerTCP::getSocket(const std::string &username) {
+    ServerSocket *found = nullptr;
+    if (!_byName.find(username, found)) return nullptr;
+    return found->socket;
 }
 
 std::string ServerTCP::getName(const QTcpSocket *client) {
-    QReadLocker lock1(&lock);
-    for (auto &thread : _threads) {
-        QReadLocker lock2(&thread->lock);
-        for (const auto &connection : thread->ownedSockets)
-            if (client == connection->socket) {
-                return connection->username;
-            }
-    }
-    return "";
+    ServerSocket *found = nullptr;
+    if (!_bySocket.find(client, found)) return "";
+    return found->username;
 }
 
 }    // namespace helloworld
@@ -18,19 +18,24 @@
 #include <fstream>
 #include <sstream>
 #include <set>
+#include <atomic>
+#include <chrono>
 #include <cstring>
+#include <map>
 #include <memory>
 
 #include <QtCore>
 #include <QtNetwork>
 #include <QThread>
 #include <qreadwritelock.h>
+#include <QMutex>
 #include <QThreadStorage>
 
 #include "../shared/transmission.h"
-#include "../shared/base_64.h"
+#include "../shared/framing.h"
 #include "../shared/utils.h"
 #include "net_utils.h"
+#include "worker_pool.h"
 
 namespace helloworld {
 
@@ -43,6 +48,7 @@ Q_OBJECT
     ServerTCP *server;
 public:
     QTcpSocket *socket{nullptr};
+    FrameCodec *codec{nullptr}; // owned by the socket (SocketCodec child)
     std::string username;
 
     explicit ServerSocket(QTcpSocket *socket, std::string username, ServerTCP *server, QObject *parent = nullptr);
@@ -97,6 +103,13 @@ Q_SIGNALS:
 class SocketManager : public QObject {
 Q_OBJECT
     ServerTCP *server;
+
+    // work posted to the thread from other threads
+    MpscQueue<SocketTask> _outbox;
+    std::atomic<bool> _drainScheduled{false};
+
+    void _post(SocketTask task);
+
 public:
     EventThread *thread; // Custom thread runing event loop
     std::vector<ServerSocket *> ownedSockets;
@@ -104,6 +117,29 @@ public:
 
     SocketManager(ServerTCP *server, QObject *parent = nullptr);
 
+    /**
+     * @brief queue data to be written to socket owned by this thread,
+     *        callable from any thread, messages to one socket keep order
+     * @param socket socket to write to
+     * @param data framed data
+     */
+    void post(QTcpSocket *socket, QByteArray data);
+
+    /**
+     * @brief queue closing of socket owned by this thread, callable from
+     *        any thread
+     * @param socket socket to close
+     */
+    void postClose(QTcpSocket *socket);
+
+    /**
+     * @brief queue emplacing of socket that was moved to this thread,
+     *        callable from any thread
+     * @param socket socket to store in thread
+     * @param name username of user connected to socket
+     */
+    void postRegister(QTcpSocket *socket, const std::string &name);
+
 public slots:
 
     /**
@@ -120,12 +156,13 @@ public slots:
      */
     bool remove(const QTcpSocket *socket);
 
+private slots:
+
     /**
-     * @brief toRegister (just because std string cant be done by default)
-     * @param socket
-     * @param name
+     * @brief process everything posted to the thread, consecutive writes
+     *        to one socket are merged into single write
      */
-    void toRegister(QTcpSocket *socket, const QString &name);
+    void drain();
 
 signals:
 
@@ -137,16 +174,49 @@ signals:
 
 class ServerTCP : public QObject, public ServerTransmissionManager {
     friend ServerSocket;
+    friend SocketManager;
 
     // must be destroyed after all threads finish (not before)
     static QThreadStorage<PtrWrap < QTcpSocket>> _lastSending;
 
 Q_OBJECT
 
-    Base64 _base64;
     std::vector<std::unique_ptr<SocketManager>> _threads;
     QTcpServer _server;
+
+    // registered sockets indexed for O(1) routing, kept up to date by
+    // SocketManager::emplace / remove
+    ShardedHashMap<std::string, ServerSocket *> _byName;
+    ShardedHashMap<const QTcpSocket *, ServerSocket *> _bySocket;
+
+    /**
+     * Messages for user whose socket is still moving into its SocketManager
+     * thread, framed and flushed by SocketManager::emplace once the socket
+     * is owned
+     */
+    struct PendingSends {
+        QTcpSocket *socket;
+        std::chrono::steady_clock::time_point since;
+        std::vector<QByteArray> messages;
+    };
+    std::map<std::string, PendingSends> _pending;
+    std::atomic<size_t> _pendingCount{0};
+    QMutex _pendingLock;
+
+    // sockets not registered yet, owned by this thread, accessed only by it
+    std::set<const QTcpSocket *> _unregistered;
+    // work for unregistered sockets posted from the worker threads
+    MpscQueue<SocketTask> _outbox;
+    std::atomic<bool> _drainScheduled{false};
+
+    // destroyed first: running jobs may still use everything above
+    std::unique_ptr<WorkerPool> _workers;
 public:
+    // maximum time the registration may take before sends to user fail
+    static constexpr std::chrono::milliseconds PENDING_TIMEOUT{5000};
+    // maximum number of messages buffered for user being registered
+    static constexpr size_t MAX_PENDING_FRAMES = 256;
+
     QReadWriteLock lock;
 
 public slots:
@@ -169,6 +239,11 @@ private slots:
      */
     void cleanAfter(QString name);
 
+    /**
+     * @brief process work posted by worker threads for unregistered sockets
+     */
+    void drain();
+
 Q_SIGNALS:
 
     void conn(QHostAddress, quint16);
@@ -177,15 +252,17 @@ Q_SIGNALS:
 
     void clossedConnection(QString);
 
-    void toRegister(QTcpSocket *, QString);
-
-    void forward(QByteArray);
-
-    void toClose();
-
 public:
-    explicit ServerTCP(Callable<void, bool, const std::string &, std::stringstream &&> *callback,
-                       QObject *parent = nullptr);
+    /**
+     * @brief Start listening
+     * @param callback receiver of incoming messages
+     * @param workers number of request processing threads, the callback is
+     *        run by them instead of the socket threads; 0 to run the
+     *        callback directly in the socket threads
+     * @param parent Qt parent
+     */
+    explicit ServerTCP(Callable<void, bool, const std::string &, const ByteSpan &> *callback,
+                       size_t workers = 0, QObject *parent = nullptr);
 
     // Copying is not available
     ServerTCP(const ServerTCP &other) = delete;
@@ -220,7 +297,7 @@ public:
      * @param filename name to check
      * @return 0 if no connection found, otherwise >0
      */
-    bool exists(const std::string &username);
+    bool exists(const std::string &username) override;
 
     /**
      * Get names of all connected users
@@ -229,15 +306,77 @@ public:
     //todo will return even auth-waiting users ! consider the consequence
     std::set<std::string> getOpenConnections() override;
 
+    /**
+     * Get queue depth and latency of every worker lane
+     * @return metrics, empty if callbacks run in the socket threads
+     */
+    std::vector<LaneMetrics> workerMetrics() const;
+
 private:
 
     SocketManager *minThread();
 
-    void _receive(QTcpSocket *sender, const std::string &name = "");
+    /**
+     * @brief read socket data and pass every complete frame to callback
+     * @param sender socket with data available
+     * @param codec frame codec of the socket
+     * @param name username associated with socket, empty if not registered
+     */
+    void _receive(QTcpSocket *sender, FrameCodec &codec, const std::string &name = "");
+
+    /**
+     * @brief write handshake bytes the codec might request
+     */
+    void _handshake(QTcpSocket *receiver, FrameCodec &codec);
+
+    /**
+     * @brief wrap outgoing message into frame of the codec protocol
+     */
+    static QByteArray _frame(FrameCodec &codec, std::istream &data);
+
+    /**
+     * @brief post work for unregistered socket to this thread
+     */
+    void _post(SocketTask task);
+
+    /**
+     * @brief mark user as being registered, sends to it are queued
+     */
+    void _markPending(const std::string &username, QTcpSocket *socket);
+
+    /**
+     * @brief move unregistered socket into the least loaded SocketManager
+     *        must run in this object's thread
+     */
+    void _handOver(QTcpSocket *socket, const std::string &username);
 
     void _send(QTcpSocket *receiver, QByteArray &data);
 
-    //todo maybe use hashmap or treemap - better than O(n)
+    /**
+     * @brief index registered socket and take messages sent to it meanwhile
+     * @param socket socket owned by some SocketManager
+     * @return messages to send before anything else, in order
+     */
+    std::vector<QByteArray> _index(ServerSocket *socket);
+
+    /**
+     * @brief find registered socket of user, or queue the message if the
+     *        user is being registered
+     * @param username user to send the data to
+     * @param data data to queue
+     * @return socket to send the data to, nullptr if data queued
+     * @throws Error when the user has no connection, or the registration
+     *         takes longer than PENDING_TIMEOUT or its queue is full
+     */
+    ServerSocket *_socketOrQueue(const std::string &username,
+                                 std::iostream &data);
+
+    /**
+     * @brief remove socket from index
+     * @param socket socket being removed from its SocketManager
+     */
+    void _unindex(ServerSocket *socket);
+
     QTcpSocket *getSocket(const std::string &username);
 
     std::string getName(const QTcpSocket *client);
@@ -0,0 +1,96 @@
+#include "worker_pool.h"
+
+#include <algorithm>
+
+#include "../shared/serializable_error.h"
+
+namespace helloworld {
+
+thread_local const WorkerPool *WorkerPool::_current = nullptr;
+
+WorkerPool::WorkerPool(size_t lanes) {
+    if (lanes == 0) throw Error("Worker pool needs at least one lane.");
+    _lanes.reserve(lanes);
+    for (size_t i = 0; i < lanes; ++i) {
+        _lanes.push_back(std::make_unique<Lane>());
+        Lane &lane = *_lanes.back();
+        lane.thread = std::thread([this, &lane]() { _run(lane); });
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    for (auto &lane : _lanes) {
+        std::lock_guard<std::mutex> lock(lane->mutex);
+        lane->stop = true;
+        lane->ready.notify_one();
+    }
+    for (auto &lane : _lanes) lane->thread.join();
+}
+
+size_t WorkerPool::keyOf(const void *object) {
+    // splitmix64 finalizer, every bit of the address affects the lane
+    auto key = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(object));
+    key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+    return static_cast<size_t>(key ^ (key >> 31));
+}
+
+void WorkerPool::submit(size_t key, std::function<void()> job) {
+    Lane &lane = *_lanes[key % _lanes.size()];
+    std::lock_guard<std::mutex> lock(lane.mutex);
+    lane.jobs.push_back({std::move(job), clock::now()});
+    lane.metrics.depth = lane.jobs.size();
+    lane.metrics.maxDepth =
+        std::max(lane.metrics.maxDepth, lane.metrics.depth);
+    lane.ready.notify_one();
+}
+
+std::vector<LaneMetrics> WorkerPool::metrics() const {
+    std::vector<LaneMetrics> result;
+    result.reserve(_lanes.size());
+    for (const auto &lane : _lanes) {
+        std::lock_guard<std::mutex> lock(lane->mutex);
+        result.push_back(lane->metrics);
+    }
+    return result;
+}
+
+void WorkerPool::_run(Lane &lane) {
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+    _current = this;
+
+    std::unique_lock<std::mutex> lock(lane.mutex);
+    while (true) {
+        lane.ready.wait(
+            lock, [&lane]() { return lane.stop || !lane.jobs.empty(); });
+        // stop only once everything submitted is done
+        if (lane.jobs.empty()) return;
+
+        Job job = std::move(lane.jobs.front());
+        lane.jobs.pop_front();
+        lane.metrics.depth = lane.jobs.size();
+        lock.unlock();
+
+        clock::time_point start = clock::now();
+        bool failed = false;
+        try {
+            job.task();
+        } catch (...) {
+            failed = true;
+        }
+        clock::time_point end = clock::now();
+
+        lock.lock();
+        auto wait = static_cast<uint64_t>(
+            duration_cast<microseconds>(start - job.queued).count());
+        lane.metrics.processed++;
+        lane.metrics.failed += failed;
+        lane.metrics.totalWait += wait;
+        lane.metrics.maxWait = std::max(lane.metrics.maxWait, wait);
+        lane.metrics.totalRun += static_cast<uint64_t>(
+            duration_cast<microseconds>(end - start).count());
+    }
+}
+
+}    // namespace helloworld
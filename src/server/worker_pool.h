@@ -0,0 +1,116 @@
+/**
+ * @file worker_pool.h
+ * @brief Request processing threads decoupled from the socket threads
+ *        - jobs with the same key run in the same lane, in submission order
+ *        - every lane keeps its queue depth and latency metrics
+ *
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef HELLOWORLD_SERVER_WORKER_POOL_H_
+#define HELLOWORLD_SERVER_WORKER_POOL_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace helloworld {
+
+/**
+ * Snapshot of lane statistics, times in microseconds
+ */
+struct LaneMetrics {
+    size_t depth = 0;         /**< jobs waiting right now */
+    size_t maxDepth = 0;      /**< largest depth seen */
+    uint64_t processed = 0;   /**< jobs finished */
+    uint64_t failed = 0;      /**< jobs that threw */
+    uint64_t totalWait = 0;   /**< time spent in queue, sum over jobs */
+    uint64_t maxWait = 0;     /**< longest time spent in queue */
+    uint64_t totalRun = 0;    /**< time spent running, sum over jobs */
+};
+
+class WorkerPool {
+    using clock = std::chrono::steady_clock;
+
+    struct Job {
+        std::function<void()> task;
+        clock::time_point queued;
+    };
+
+    struct Lane {
+        mutable std::mutex mutex;
+        std::condition_variable ready;
+        std::deque<Job> jobs;
+        LaneMetrics metrics;
+        bool stop = false;
+        std::thread thread;
+    };
+
+    std::vector<std::unique_ptr<Lane>> _lanes;
+
+    static thread_local const WorkerPool *_current;
+
+   public:
+    /**
+     * @brief Start the lanes
+     *
+     * @param lanes number of lanes (threads), at least one
+     */
+    explicit WorkerPool(size_t lanes);
+
+    // Copying is not available
+    WorkerPool(const WorkerPool &other) = delete;
+
+    WorkerPool &operator=(const WorkerPool &other) = delete;
+
+    /**
+     * @brief Finish all submitted jobs and join the threads
+     */
+    ~WorkerPool();
+
+    size_t size() const { return _lanes.size(); }
+
+    /**
+     * @brief Queue job, jobs with equal key are never run concurrently
+     *        and run in the order of submission
+     *
+     * @param key ordering key, e.g. hash of the username
+     * @param job job to run, exceptions thrown are counted and dropped
+     */
+    void submit(size_t key, std::function<void()> job);
+
+    /**
+     * @brief Ordering key of an object, e.g. a connection; the address
+     *        is mixed, its low bits are zero due to the alignment
+     *
+     * @param object object the jobs belong to
+     */
+    static size_t keyOf(const void *object);
+
+    /**
+     * @brief Statistics of every lane
+     */
+    std::vector<LaneMetrics> metrics() const;
+
+    /**
+     * @brief Check whether the caller runs in a lane of this pool
+     */
+    bool isWorkerThread() const { return _current == this; }
+
+   private:
+    void _run(Lane &lane);
+};
+
+}    // namespace helloworld
+
+#endif    // HELLOWORLD_SERVER_WORKER_POOL_H_
@@ -1,4 +1,5 @@
 #include "X3DH.h"
+#include "keystore.h"
 #include "utils.h"
 
 namespace helloworld {
@@ -31,16 +32,14 @@ std::pair<std::vector<unsigned char>, X3DH::X3DHSecretKeyPair> X3DH::getSecret(
     // DH4 step
     if (x3dhBundle.opKeyUsed == X3DHRequest<C25519>::OP_KEY_USED) {
         C25519 onetimeKeyCurve;
-        onetimeKeyCurve.loadPrivateKey(
-            username + std::to_string(x3dhBundle.opKeyId) + oneTimeC25519priv +
-                (old ? ".old" : ""),
-            pwd);
+        loadOneTimeKey(onetimeKeyCurve, x3dhBundle.opKeyId, old);
         onetimeKeyCurve.setPublicKey(x3dhBundle.senderEphermalPubKey);
         append(dh_bytes, onetimeKeyCurve.getShared());
     }
 
     hkdf kdf;
-    zero::str_t sk = kdf.generate(to_hex(dh_bytes), 16);
+    zero::bytes_t sk(16);
+    kdf.generate(dh_bytes, sk);
 
     zero::bytes_t ad = x3dhBundle.senderIdPubKey;
     append(ad, loadC25519Key(username + idC25519pub + (old ? ".old" : "")));
@@ -49,7 +48,7 @@ std::pair<std::vector<unsigned char>, X3DH::X3DHSecretKeyPair> X3DH::getSecret(
 
     return std::make_pair(
         x3dhBundle.AEADenrypted,
-        X3DHSecretKeyPair{from_hex(sk), std::move(ad), std::move(pubKey),
+        X3DHSecretKeyPair{std::move(sk), std::move(ad), std::move(pubKey),
                           preKeyCurve.getPrivateKey()});
 }
 
@@ -78,13 +77,15 @@ std::pair<X3DHRequest<C25519>, X3DH::X3DHSecretPubKey> X3DH::setSecret(
     append(dh, ephermal.getShared());
     // optional DH4 step
     if (opAvailable) {
-        keyId = bundle.oneTimeKeys.size() - 1;
-        ephermal.setPublicKey(bundle.oneTimeKeys[keyId]);
+        // the last key is used, the server sends just one
+        keyId = bundle.firstOneTimeKeyId + bundle.oneTimeKeys.size() - 1;
+        ephermal.setPublicKey(bundle.oneTimeKeys.back());
         append(dh, ephermal.getShared());
     }
 
     hkdf kdf;
-    zero::str_t sk = kdf.generate(to_hex(dh), 16);
+    zero::bytes_t sk(16);
+    kdf.generate(dh, sk);
 
     zero::bytes_t pubKey = loadC25519Key(username + idC25519pub);
 
@@ -99,7 +100,7 @@ std::pair<X3DHRequest<C25519>, X3DH::X3DHSecretPubKey> X3DH::setSecret(
 
     append(pubKey, bundle.identityKey);    // X3DH additional data
     return std::make_pair(
-        toFill, X3DHSecretPubKey{from_hex(sk), pubKey, bundle.preKey});
+        toFill, X3DHSecretPubKey{std::move(sk), pubKey, bundle.preKey});
 }
 
 bool X3DH::verifyPrekey(const zero::bytes_t &identityPub,
@@ -122,4 +123,17 @@ zero::bytes_t X3DH::loadC25519Key(const std::string &filename) const {
     return key;
 }
 
+void X3DH::loadOneTimeKey(C25519 &curve, size_t id, bool old) const {
+    std::string suffix = old ? ".old" : "";
+    std::vector<zero::bytes_t> keys;
+    if (!OneTimeKeystore::load(username + oneTimeKeystore + suffix, pwd,
+                               keys)) {
+        curve.loadPrivateKey(
+            username + std::to_string(id) + oneTimeC25519priv + suffix, pwd);
+        return;
+    }
+    if (id >= keys.size()) throw Error("Invalid one-time key id.");
+    curve.setPrivateKey(keys[id]);
+}
+
 }    // namespace helloworld
@@ -94,6 +94,15 @@ class X3DH {
      * @return vector with raw bytes of public key
      */
     zero::bytes_t loadC25519Key(const std::string& filename) const;
+
+    /**
+     * Load one-time private key from the keystore, keys generated before
+     * the keystore are read from their own files
+     * @param curve curve to set the private key to
+     * @param id one-time key id
+     * @param old true to load from the archived key set
+     */
+    void loadOneTimeKey(C25519& curve, size_t id, bool old) const;
 };
 
 }    // namespace helloworld
@@ -22,6 +22,7 @@ void AESGCM::encrypt(std::istream &in, std::ostream &out) {
         _reset();
     }
     _init(true);
+    _expanded = false;
     dirty = true;
     std::stringstream tmp;
     _process(in, tmp);
@@ -40,6 +41,7 @@ void AESGCM::encryptWithAd(std::istream &in, std::istream &ad,
         _reset();
     }
     _init(true);
+    _expanded = false;
     _additional(ad);
     dirty = true;
 
@@ -60,6 +62,7 @@ void AESGCM::encryptWithAd(const std::vector<unsigned char> &in,
         _reset();
     }
     _init(true);
+    _expanded = false;
     _additional(ad);
     dirty = true;
 
@@ -83,6 +86,7 @@ void AESGCM::decrypt(std::istream &in, std::ostream &out) {
         throw Error("Could not read tag.");
     }
     _init(false);
+    _expanded = false;
     dirty = true;
     _process(in, out);
 
@@ -102,6 +106,7 @@ void AESGCM::decryptWithAd(std::istream &in, std::istream &ad,
     }
 
     _init(false);
+    _expanded = false;
     _additional(ad);
     dirty = true;
     _process(in, out);
@@ -121,6 +126,7 @@ void AESGCM::decryptWithAd(const std::vector<unsigned char> &in,
     std::copy(in.begin(), in.begin() + TAG_LEN, std::back_inserter(tag));
 
     _init(false);
+    _expanded = false;
     _additional(ad);
     dirty = true;
     _process(in, out, TAG_LEN);
@@ -129,6 +135,63 @@ void AESGCM::decryptWithAd(const std::vector<unsigned char> &in,
         throw Error("mbedTLS authetification error");
 }
 
+bool AESGCM::setRawKey(ByteSpan key) {
+    if (key.size != key_size) return false;
+    // gcm uses the encryption key schedule for both directions
+    if (mbedtls_cipher_setkey(&_context, key.data, key_size * 8,
+                              MBEDTLS_ENCRYPT) != 0) {
+        throw Error("Failed to initialize AES key - unable to continue.");
+    }
+    _expanded = true;
+    return true;
+}
+
+void AESGCM::encrypt(ByteSpan iv, ByteSpan in, ByteSpan ad,
+                     MutableByteSpan out, MutableByteSpan tag) {
+    if (!_expanded) throw Error("Key is missing.");
+    if (iv.size != iv_size) throw Error("IV is missing.");
+    if (out.size < in.size || tag.size != TAG_LEN)
+        throw Error("Output buffer too small.");
+
+    size_t outLength;
+    if (mbedtls_cipher_auth_encrypt(&_context, iv.data, iv.size, ad.data,
+                                    ad.size, in.data, in.size, out.data,
+                                    &outLength, tag.data, tag.size) != 0 ||
+        outLength != in.size) {
+        throw Error("mbedTLS error while encrypting");
+    }
+}
+
+void AESGCM::decrypt(ByteSpan iv, ByteSpan in, ByteSpan ad, ByteSpan tag,
+                     MutableByteSpan out) {
+    if (!_expanded) throw Error("Key is missing.");
+    if (iv.size != iv_size) throw Error("IV is missing.");
+    if (tag.size != TAG_LEN) throw Error("Could not read tag.");
+    if (out.size < in.size) throw Error("Output buffer too small.");
+
+    size_t outLength;
+    if (mbedtls_cipher_auth_decrypt(&_context, iv.data, iv.size, ad.data,
+                                    ad.size, in.data, in.size, out.data,
+                                    &outLength, tag.data, tag.size) != 0) {
+        clear<unsigned char>(out.data, in.size);
+        throw Error("mbedTLS authetification error");
+    }
+}
+
+void AESGCM::seal(ByteSpan iv, ByteSpan in, ByteSpan ad,
+                  MutableByteSpan out) {
+    if (out.size < TAG_LEN) throw Error("Output buffer too small.");
+    encrypt(iv, in, ad, {out.data + TAG_LEN, out.size - TAG_LEN},
+            {out.data, TAG_LEN});
+}
+
+void AESGCM::open(ByteSpan iv, ByteSpan in, ByteSpan ad,
+                  MutableByteSpan out) {
+    if (in.size < TAG_LEN) throw Error("Could not read tag.");
+    decrypt(iv, {in.data + TAG_LEN, in.size - TAG_LEN}, ad, {in.data, TAG_LEN},
+            out);
+}
+
 void AESGCM::_additional(std::istream &ad) {
     if (!ad) throw Error("input stream invalid");
 
@@ -13,6 +13,7 @@
 
 #include <array>
 #include <sstream>
+#include "byte_span.h"
 #include "config.h"
 #include "mbedtls/cipher.h"
 #include "symmetric_cipher_base.h"
@@ -21,6 +22,10 @@ namespace helloworld {
 
 class AESGCM : public SymmetricCipherBase<MBEDTLS_CIPHER_AES_128_GCM, 16, 12> {
     static constexpr size_t TAG_LEN = 16;
+    // key expanded into the context by setRawKey(), the stream methods
+    // replace it with the key from setKey()
+    bool _expanded = false;
+
     /**
      * @brief Processes additional data
      *
@@ -36,6 +41,8 @@ class AESGCM : public SymmetricCipherBase<MBEDTLS_CIPHER_AES_128_GCM, 16, 12> {
     void _additional(const std::vector<unsigned char> &ad);
 
    public:
+    static constexpr size_t tag_size = TAG_LEN;
+
     AESGCM() { setPadding(Padding::PKCS7); };
 
     AESGCM(const AESGCM &other) = delete;
@@ -104,6 +111,56 @@ class AESGCM : public SymmetricCipherBase<MBEDTLS_CIPHER_AES_128_GCM, 16, 12> {
     void decryptWithAd(const std::vector<unsigned char> &in,
                        const std::vector<unsigned char> &ad,
                        std::vector<unsigned char> &out);
+
+    /**
+     * @brief Expands the key into the context once, the buffer methods below
+     *        use it until replaced; the stream methods set the key on each call
+     *
+     * @param key raw key of key_size bytes
+     * @return true if key set correctly
+     */
+    bool setRawKey(ByteSpan key);
+
+    /**
+     * @brief Encrypts and authenticates contiguous buffer in single call,
+     *        no stream and no allocation; key set by setRawKey()
+     *
+     * @param iv raw initialization vector of iv_size bytes
+     * @param in plaintext
+     * @param ad additional data, authenticated only
+     * @param out ciphertext, at least in.size bytes
+     * @param tag authentication tag, tag_size bytes
+     */
+    void encrypt(ByteSpan iv, ByteSpan in, ByteSpan ad, MutableByteSpan out,
+                 MutableByteSpan tag);
+
+    /**
+     * @brief Decrypts and authenticates contiguous buffer in single call,
+     *        throws if the authentication fails; key set by setRawKey()
+     *
+     * @param iv raw initialization vector of iv_size bytes
+     * @param in ciphertext
+     * @param ad additional data, authenticated only
+     * @param tag authentication tag, tag_size bytes
+     * @param out plaintext, at least in.size bytes
+     */
+    void decrypt(ByteSpan iv, ByteSpan in, ByteSpan ad, ByteSpan tag,
+                 MutableByteSpan out);
+
+    /**
+     * @brief Encrypts into the encryptWithAd() layout: tag, then ciphertext
+     *
+     * @param out output of tag_size + in.size bytes
+     */
+    void seal(ByteSpan iv, ByteSpan in, ByteSpan ad, MutableByteSpan out);
+
+    /**
+     * @brief Decrypts output of seal() or encryptWithAd()
+     *
+     * @param in tag followed by ciphertext, at least tag_size bytes
+     * @param out output of in.size - tag_size bytes
+     */
+    void open(ByteSpan iv, ByteSpan in, ByteSpan ad, MutableByteSpan out);
 };
 
 }    // namespace helloworld
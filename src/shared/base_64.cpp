@@ -1,79 +1,98 @@
 #include "base_64.h"
+
+#include <algorithm>
+
+#include "codec.h"
 #include "serializable_error.h"
-#include "mbedtls/base64.h"
 #include "utils.h"
 
 namespace helloworld {
 
-std::vector<unsigned char> Base64::encode(const std::vector<unsigned char> &message) {
-    size_t requiredSize;
-    mbedtls_base64_encode(nullptr, 0, &requiredSize, message.data(), message.size());
-
-    size_t actualLength;
-    //unsigned char encoded[requiredSize];
-    std::vector<unsigned char> encoded(requiredSize);
-    if (mbedtls_base64_encode(encoded.data(), requiredSize, &actualLength, message.data(), message.size()) != 0) {
-        throw Error("The buffer size provided for Base64 encoder is too small.");
+constexpr size_t Base64::LINE_BYTES;
+
+namespace {
+
+void decodeAppend(const char *data, size_t length, std::vector<unsigned char> &out) {
+    size_t offset = out.size();
+    out.resize(offset + codec::base64MaxDecodedSize(length));
+    size_t written;
+    if (!codec::fromBase64(data, length, out.data() + offset, written)) {
+        throw Error("Invalid Base64 conversion: invalid character.");
     }
-    encoded.resize(actualLength);
+    out.resize(offset + written);
+}
+
+} // namespace
+
+std::vector<unsigned char> Base64::encode(const std::vector<unsigned char> &message) {
+    std::vector<unsigned char> encoded(codec::base64Size(message.size()));
+    codec::toBase64(message.data(), message.size(), reinterpret_cast<char *>(encoded.data()));
     return encoded;
 }
 
 std::vector<unsigned char> Base64::decode(const std::vector<unsigned char> &data) {
-    size_t requiredSize;
-    mbedtls_base64_encode(nullptr, 0, &requiredSize, data.data(), data.size());
-
-    size_t actualLength;
-    std::vector<unsigned char> decoded(requiredSize);
-    switch (mbedtls_base64_decode(decoded.data(), requiredSize, &actualLength, data.data(), data.size())) {
-        case MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL:
-            throw Error("The buffer size provided for Base64 encoder is insufficient.");
-        case MBEDTLS_ERR_BASE64_INVALID_CHARACTER:
-            throw Error("Invalid Base64 conversion: invalid character.");
-        default:
-            decoded.resize(actualLength);
-    }
-
+    std::vector<unsigned char> decoded;
+    decodeAppend(reinterpret_cast<const char *>(data.data()), data.size(), decoded);
     return decoded;
 }
 
 void Base64::fromStream(std::istream &toEncode, std::ostream &out) {
     while (toEncode.good()) {
-        unsigned char buffer[256];
-        size_t read = read_n(toEncode, buffer, 256);
-
-        size_t requiredSize;
-        mbedtls_base64_encode(nullptr, 0, &requiredSize, buffer, read);
-
-        size_t actualLength;
-        std::vector<unsigned char> encoded(requiredSize);
-        if (mbedtls_base64_encode(encoded.data(), requiredSize, &actualLength, buffer, read) != 0) {
-            throw Error("The buffer size provided for Base64 encoder is too small.");
-        }
-        write_n(out, encoded.data(), actualLength);
-        out << '\n';
+        unsigned char buffer[LINE_BYTES];
+        size_t read = read_n(toEncode, buffer, LINE_BYTES);
+
+        char encoded[codec::base64Size(LINE_BYTES) + 1];
+        size_t length = codec::toBase64(buffer, read, encoded);
+        encoded[length] = '\n';
+        out.write(encoded, length + 1);
     }
 }
 
 void Base64::toStream(std::istream &toDecode, std::ostream &out) {
     std::string chunk;
+    std::vector<unsigned char> decoded;
     while (std::getline(toDecode, chunk)) {
-        size_t requiredSize;
-        mbedtls_base64_decode(nullptr, 0, &requiredSize,
-                              reinterpret_cast<const unsigned char*>(chunk.data()), chunk.size());
-
-        size_t actualLength;
-        std::vector<unsigned char> decoded(requiredSize);
-        switch (mbedtls_base64_decode(decoded.data(), requiredSize, &actualLength,
-                reinterpret_cast<const unsigned char*>(chunk.data()), chunk.size())) {
-            case MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL:
-                throw Error("The buffer size provided for Base64 encoder is insufficient.");
-            case MBEDTLS_ERR_BASE64_INVALID_CHARACTER:
-                throw Error("Invalid Base64 conversion: invalid character.");
-            default:
-                break;
-        }
-        write_n(out, decoded.data(), actualLength);
+        decoded.clear();
+        decodeAppend(chunk.data(), chunk.size(), decoded);
+        write_n(out, decoded.data(), decoded.size());
+    }
+}
+
+std::vector<unsigned char> Base64::encodeLines(ByteSpan data) {
+    std::vector<unsigned char> encoded;
+    encodeLines(data, encoded);
+    return encoded;
+}
+
+size_t Base64::linesSize(size_t length) {
+    // a line is written for the last incomplete block, even empty one
+    size_t lines = length / LINE_BYTES + 1;
+    size_t last = length % LINE_BYTES;
+    return (lines - 1) * (codec::base64Size(LINE_BYTES) + 1) +
+           codec::base64Size(last) + 1;
+}
+
+void Base64::encodeLines(ByteSpan data, std::vector<unsigned char> &out) {
+    out.resize(linesSize(data.size));
+
+    char *encoded = reinterpret_cast<char *>(out.data());
+    for (size_t offset = 0;; offset += LINE_BYTES) {
+        size_t block = std::min(LINE_BYTES, data.size - offset);
+        encoded += codec::toBase64(data.data + offset, block, encoded);
+        *encoded++ = '\n';
+        if (block < LINE_BYTES) break;
+    }
+}
+
+void Base64::decodeLines(ByteSpan data, std::vector<unsigned char> &out) {
+    out.clear();
+    out.reserve(codec::base64MaxDecodedSize(data.size));
+    const char *begin = reinterpret_cast<const char *>(data.data);
+    const char *end = begin + data.size;
+    while (begin < end) {
+        const char *line = std::find(begin, end, '\n');
+        decodeAppend(begin, static_cast<size_t>(line - begin), out);
+        begin = line + 1;
     }
 }
 
@@ -9,6 +9,7 @@
  *
  */
 
+#include "byte_span.h"
 #include "encode.h"
 
 #ifndef HELLOWORLD_SHARED_BASE64_H_
@@ -21,6 +22,9 @@ using Encoder = Encode<std::vector<unsigned char>, std::vector<unsigned char>>;
 class Base64 : public Encoder {
 
 public:
+    // bytes encoded on one line of the stream format
+    static constexpr size_t LINE_BYTES = 256;
+
     Base64() = default;
     Base64(const Base64& other) = delete;
     Base64& operator=(const Base64& other) = delete;
@@ -33,6 +37,38 @@ public:
     void toStream(std::istream &toDecode, std::ostream &out) override;
 
     void fromStream(std::istream &toEncode, std::ostream &out) override;
+
+    /**
+     * @brief Size of data encoded into the fromStream() format
+     *
+     * @param length length of the data
+     */
+    static size_t linesSize(size_t length);
+
+    /**
+     * @brief Encode into the fromStream() format: LINE_BYTES blocks,
+     *        each on its own line
+     *
+     * @param data data to encode
+     * @return encoded lines
+     */
+    static std::vector<unsigned char> encodeLines(ByteSpan data);
+
+    /**
+     * @brief Encode into the fromStream() format
+     *
+     * @param data data to encode
+     * @param out encoded lines, replaces the content
+     */
+    static void encodeLines(ByteSpan data, std::vector<unsigned char>& out);
+
+    /**
+     * @brief Decode the fromStream() format
+     *
+     * @param data encoded lines
+     * @param out decoded data, replaces the content
+     */
+    static void decodeLines(ByteSpan data, std::vector<unsigned char>& out);
 };
 
 } // namespace helloworld
@@ -0,0 +1,94 @@
+#include "buffer_pool.h"
+
+#include <atomic>
+
+#include "mbedtls/platform_util.h"
+
+namespace helloworld {
+
+constexpr size_t BufferPool::MIN_CAPACITY;
+constexpr size_t BufferPool::MAX_CAPACITY;
+constexpr size_t BufferPool::CLASSES;
+constexpr size_t BufferPool::BUFFERS_PER_CLASS;
+
+static_assert(BufferPool::MIN_CAPACITY << (BufferPool::CLASSES - 1) ==
+                  BufferPool::MAX_CAPACITY,
+              "capacity classes must cover the pooled range");
+
+namespace {
+
+std::atomic<uint64_t> acquired{0};
+std::atomic<uint64_t> reused{0};
+std::atomic<uint64_t> allocations{0};
+
+struct ThreadPool {
+    std::vector<std::vector<unsigned char>> free[BufferPool::CLASSES];
+
+    ~ThreadPool();
+};
+
+// buffers may be released by thread local objects destroyed after the pool
+thread_local bool poolAlive = true;
+thread_local ThreadPool pool;
+
+ThreadPool::~ThreadPool() { poolAlive = false; }
+
+size_t classCapacity(size_t index) { return BufferPool::MIN_CAPACITY << index; }
+
+}    // namespace
+
+std::vector<unsigned char> BufferPool::acquire(size_t capacity) {
+    acquired.fetch_add(1, std::memory_order_relaxed);
+    std::vector<unsigned char> buffer;
+    if (capacity > MAX_CAPACITY) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        buffer.reserve(capacity);
+        return buffer;
+    }
+
+    // smallest class that fits the requested capacity
+    size_t index = 0;
+    while (classCapacity(index) < capacity) index++;
+    if (poolAlive && !pool.free[index].empty()) {
+        reused.fetch_add(1, std::memory_order_relaxed);
+        buffer = std::move(pool.free[index].back());
+        pool.free[index].pop_back();
+        return buffer;
+    }
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    buffer.reserve(classCapacity(index));
+    return buffer;
+}
+
+void BufferPool::release(std::vector<unsigned char> &&buffer,
+                         size_t acquiredCapacity) {
+    // resized buffer reallocated at least once
+    if (buffer.capacity() > acquiredCapacity)
+        allocations.fetch_add(1, std::memory_order_relaxed);
+
+    // wiped also when the buffer is freed, a plain memset before free
+    // may be optimized out
+    if (!buffer.empty())
+        mbedtls_platform_zeroize(buffer.data(), buffer.size());
+    buffer.clear();
+
+    size_t capacity = buffer.capacity();
+    if (!poolAlive || capacity < MIN_CAPACITY || capacity > MAX_CAPACITY)
+        return;
+
+    // largest class the capacity satisfies
+    size_t index = CLASSES - 1;
+    while (classCapacity(index) > capacity) index--;
+    if (pool.free[index].size() < BUFFERS_PER_CLASS)
+        pool.free[index].push_back(std::move(buffer));
+}
+
+BufferMetrics BufferPool::metrics() {
+    BufferMetrics metrics;
+    metrics.acquired = acquired.load();
+    metrics.reused = reused.load();
+    metrics.allocations = allocations.load();
+    return metrics;
+}
+
+}    // namespace helloworld
@@ -0,0 +1,98 @@
+/**
+ * @file buffer_pool.h
+ * @brief Per-thread pool of message buffers, buffers used to decrypt, seal
+ *        and frame a message return to the pool with their capacity, so
+ *        that steady traffic handled by a thread does not allocate
+ *
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef HELLOWORLD_SHARED_BUFFER_POOL_H_
+#define HELLOWORLD_SHARED_BUFFER_POOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace helloworld {
+
+/**
+ * Snapshot of the buffer pool statistics, summed over all threads
+ */
+struct BufferMetrics {
+    uint64_t acquired = 0;      /**< buffers handed out */
+    uint64_t reused = 0;        /**< buffers handed out from a pool */
+    uint64_t allocations = 0;   /**< heap allocations: pool misses and
+                                     buffers that grew while in use */
+
+    double reuseRatio() const {
+        return acquired == 0 ? 0 : static_cast<double>(reused) / acquired;
+    }
+};
+
+class BufferPool {
+   public:
+    // buffers are pooled by power of two capacity classes in this range
+    static constexpr size_t MIN_CAPACITY = 256;
+    static constexpr size_t MAX_CAPACITY = 1024 * 1024;
+    static constexpr size_t CLASSES = 13;
+    // buffers kept per class and thread, bursts above it are freed
+    static constexpr size_t BUFFERS_PER_CLASS = 8;
+
+    /**
+     * @brief Take empty buffer from the pool of the calling thread
+     *
+     * @param capacity minimal capacity of the buffer
+     * @return empty buffer
+     */
+    static std::vector<unsigned char> acquire(size_t capacity);
+
+    /**
+     * @brief Return buffer to the pool of the calling thread, the content
+     *        is cleared (it may be plaintext of a message) also when the
+     *        buffer is freed instead of pooled
+     *
+     * @param buffer buffer to return
+     * @param acquiredCapacity capacity the buffer had when acquired
+     */
+    static void release(std::vector<unsigned char> &&buffer,
+                        size_t acquiredCapacity);
+
+    static BufferMetrics metrics();
+};
+
+/**
+ * RAII handle of a pooled buffer, returns it to the pool of the thread
+ * that destroys the handle
+ */
+class MessageBuffer {
+    std::vector<unsigned char> _buffer;
+    size_t _capacity;
+
+   public:
+    /**
+     * @param capacity expected size of the message, the buffer may grow
+     */
+    explicit MessageBuffer(size_t capacity = BufferPool::MIN_CAPACITY)
+        : _buffer(BufferPool::acquire(capacity)),
+          _capacity(_buffer.capacity()) {}
+
+    MessageBuffer(const MessageBuffer &other) = delete;
+    MessageBuffer &operator=(const MessageBuffer &other) = delete;
+
+    ~MessageBuffer() { BufferPool::release(std::move(_buffer), _capacity); }
+
+    std::vector<unsigned char> &operator*() { return _buffer; }
+    const std::vector<unsigned char> &operator*() const { return _buffer; }
+    std::vector<unsigned char> *operator->() { return &_buffer; }
+    const std::vector<unsigned char> *operator->() const { return &_buffer; }
+};
+
+}    // namespace helloworld
+
+#endif    // HELLOWORLD_SHARED_BUFFER_POOL_H_
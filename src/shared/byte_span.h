@@ -0,0 +1,111 @@
+/**
+ * @file byte_span.h
+ * @brief Non-owning view of contiguous bytes and read-only stream over it,
+ *        used to pass received frames without copying them
+ *
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef HELLOWORLD_SHARED_BYTE_SPAN_H_
+#define HELLOWORLD_SHARED_BYTE_SPAN_H_
+
+#include <cstddef>
+#include <istream>
+#include <streambuf>
+#include <vector>
+
+namespace helloworld {
+
+/**
+ * Non-owning view of bytes, the viewed memory must outlive the span
+ */
+struct ByteSpan {
+    const unsigned char *data{nullptr};
+    size_t size{0};
+
+    ByteSpan() = default;
+
+    ByteSpan(const unsigned char *data, size_t size) : data(data), size(size) {}
+
+    // any allocator, e.g. zero::bytes_t
+    template <typename Allocator>
+    ByteSpan(const std::vector<unsigned char, Allocator> &vector)
+        : data(vector.data()), size(vector.size()) {}
+
+    const unsigned char *begin() const { return data; }
+
+    const unsigned char *end() const { return data + size; }
+
+    bool empty() const { return size == 0; }
+
+    std::vector<unsigned char> toVector() const { return {begin(), end()}; }
+};
+
+/**
+ * Non-owning writable view of bytes, output buffer provided by the caller
+ */
+struct MutableByteSpan {
+    unsigned char *data{nullptr};
+    size_t size{0};
+
+    MutableByteSpan() = default;
+
+    MutableByteSpan(unsigned char *data, size_t size) : data(data), size(size) {}
+
+    template <typename Allocator>
+    MutableByteSpan(std::vector<unsigned char, Allocator> &vector)
+        : data(vector.data()), size(vector.size()) {}
+
+    operator ByteSpan() const { return {data, size}; }
+};
+
+/**
+ * Stream buffer reading directly from the span memory
+ */
+class ByteSpanBuffer : public std::streambuf {
+   public:
+    explicit ByteSpanBuffer(const ByteSpan &span) {
+        // std::streambuf api is not const-correct, get area is never written
+        char *begin =
+            const_cast<char *>(reinterpret_cast<const char *>(span.data));
+        setg(begin, begin, begin + span.size);
+    }
+
+   protected:
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                     std::ios_base::openmode which) override {
+        if (!(which & std::ios_base::in)) return pos_type(off_type(-1));
+        char *target = dir == std::ios_base::beg
+                           ? eback() + off
+                           : dir == std::ios_base::cur ? gptr() + off
+                                                       : egptr() + off;
+        if (target < eback() || target > egptr()) return pos_type(off_type(-1));
+        setg(eback(), target, egptr());
+        return pos_type(target - eback());
+    }
+
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+        return seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+};
+
+/**
+ * Input stream over span, no data copied; the span memory must outlive it
+ */
+class ByteSpanStream : public std::istream {
+    ByteSpanBuffer _buffer;
+
+   public:
+    explicit ByteSpanStream(const ByteSpan &span)
+        : std::istream(nullptr), _buffer(span) {
+        rdbuf(&_buffer);
+    }
+};
+
+}    // namespace helloworld
+
+#endif    // HELLOWORLD_SHARED_BYTE_SPAN_H_
@@ -0,0 +1,509 @@
+#include "codec.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+// vector kernels are compiled with target attributes, the rest of the
+// project stays built for the baseline cpu and the kernel is chosen at runtime
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define HELLOWORLD_CODEC_X86 1
+#include <immintrin.h>
+// small helpers must be inlined into the kernels, vectors passed by value
+// between functions go through memory otherwise
+#define HELLOWORLD_CODEC_HELPER(isa) \
+    __attribute__((target(isa), always_inline)) inline
+#else
+#define HELLOWORLD_CODEC_X86 0
+#endif
+
+namespace helloworld {
+namespace codec {
+
+namespace {
+
+constexpr unsigned char INVALID = 0xff;
+
+struct HexTables {
+    char encode[512];
+    unsigned char decode[256];
+
+    constexpr HexTables() : encode(), decode() {
+        for (int i = 0; i < 256; i++) {
+            encode[2 * i] = "0123456789abcdef"[i >> 4];
+            encode[2 * i + 1] = "0123456789abcdef"[i & 0xf];
+            decode[i] = INVALID;
+        }
+        for (int i = 0; i < 10; i++) decode['0' + i] = i;
+        for (int i = 0; i < 6; i++) {
+            decode['a' + i] = 10 + i;
+            decode['A' + i] = 10 + i;
+        }
+    }
+};
+
+struct Base64Tables {
+    char encode[64];
+    unsigned char decode[256];
+
+    constexpr Base64Tables() : encode(), decode() {
+        for (int i = 0; i < 64; i++) {
+            encode[i] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz"
+                        "0123456789+/"[i];
+        }
+        for (int i = 0; i < 256; i++) decode[i] = INVALID;
+        for (int i = 0; i < 64; i++)
+            decode[static_cast<unsigned char>(encode[i])] = i;
+    }
+};
+
+constexpr HexTables HEX{};
+constexpr Base64Tables BASE64{};
+
+/*
+ * SCALAR KERNELS
+ */
+
+void scalarToHex(const unsigned char *in, size_t length, char *out) {
+    for (size_t i = 0; i < length; i++) {
+        std::memcpy(out + 2 * i, HEX.encode + 2 * in[i], 2);
+    }
+}
+
+bool scalarFromHex(const char *in, size_t length, unsigned char *out) {
+    unsigned char invalid = 0;
+    for (size_t i = 0; i < length / 2; i++) {
+        unsigned char high = HEX.decode[static_cast<unsigned char>(in[2 * i])];
+        unsigned char low =
+            HEX.decode[static_cast<unsigned char>(in[2 * i + 1])];
+        invalid |= high | low;
+        out[i] = static_cast<unsigned char>(high << 4 | low);
+    }
+    return (invalid & 0x80) == 0;
+}
+
+size_t scalarToBase64(const unsigned char *in, size_t length, char *out) {
+    char *begin = out;
+    size_t i = 0;
+    for (; i + 3 <= length; i += 3, out += 4) {
+        uint32_t value = static_cast<uint32_t>(in[i]) << 16 |
+                         static_cast<uint32_t>(in[i + 1]) << 8 | in[i + 2];
+        out[0] = BASE64.encode[value >> 18];
+        out[1] = BASE64.encode[(value >> 12) & 0x3f];
+        out[2] = BASE64.encode[(value >> 6) & 0x3f];
+        out[3] = BASE64.encode[value & 0x3f];
+    }
+    if (i < length) {
+        uint32_t value = static_cast<uint32_t>(in[i]) << 16;
+        if (i + 1 < length) value |= static_cast<uint32_t>(in[i + 1]) << 8;
+        out[0] = BASE64.encode[value >> 18];
+        out[1] = BASE64.encode[(value >> 12) & 0x3f];
+        out[2] = i + 1 < length ? BASE64.encode[(value >> 6) & 0x3f] : '=';
+        out[3] = '=';
+        out += 4;
+    }
+    return static_cast<size_t>(out - begin);
+}
+
+bool scalarFromBase64(const char *in, size_t length, unsigned char *out,
+                      size_t &written) {
+    auto value = [in](size_t i) {
+        return BASE64.decode[static_cast<unsigned char>(in[i])];
+    };
+
+    written = 0;
+    if (length % 4 != 0) return false;
+    if (length == 0) return true;
+
+    size_t padding = in[length - 1] == '=' ? in[length - 2] == '=' ? 2 : 1 : 0;
+    size_t full = padding == 0 ? length : length - 4;
+    unsigned char *begin = out;
+    unsigned char invalid = 0;
+    for (size_t i = 0; i < full; i += 4, out += 3) {
+        unsigned char a = value(i), b = value(i + 1), c = value(i + 2),
+                      d = value(i + 3);
+        invalid |= a | b | c | d;
+        uint32_t bits = static_cast<uint32_t>(a) << 18 |
+                        static_cast<uint32_t>(b) << 12 |
+                        static_cast<uint32_t>(c) << 6 | d;
+        out[0] = static_cast<unsigned char>(bits >> 16);
+        out[1] = static_cast<unsigned char>(bits >> 8);
+        out[2] = static_cast<unsigned char>(bits);
+    }
+    if (padding != 0) {
+        // '=' is invalid in the table, so only trailing padding passes
+        unsigned char a = value(full), b = value(full + 1);
+        unsigned char c = padding == 1 ? value(full + 2) : 0;
+        invalid |= a | b | c;
+        uint32_t bits = static_cast<uint32_t>(a) << 18 |
+                        static_cast<uint32_t>(b) << 12 |
+                        static_cast<uint32_t>(c) << 6;
+        *out++ = static_cast<unsigned char>(bits >> 16);
+        if (padding == 1) *out++ = static_cast<unsigned char>(bits >> 8);
+    }
+    written = static_cast<size_t>(out - begin);
+    return (invalid & 0x80) == 0;
+}
+
+#if HELLOWORLD_CODEC_X86
+
+/*
+ * SSE2 KERNELS
+ */
+
+HELLOWORLD_CODEC_HELPER("sse2") __m128i sse2HexDigits(__m128i nibbles) {
+    // '0' + n, for n > 9 skip the 39 characters between '9' and 'a'
+    __m128i letters = _mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9));
+    return _mm_add_epi8(
+        _mm_add_epi8(nibbles, _mm_set1_epi8('0')),
+        _mm_and_si128(letters, _mm_set1_epi8('a' - '0' - 10)));
+}
+
+__attribute__((target("sse2"))) void sse2ToHex(const unsigned char *in,
+                                               size_t length, char *out) {
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i bytes =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+        __m128i high = _mm_and_si128(_mm_srli_epi16(bytes, 4), mask);
+        __m128i low = _mm_and_si128(bytes, mask);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 2 * i),
+                         sse2HexDigits(_mm_unpacklo_epi8(high, low)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 2 * i + 16),
+                         sse2HexDigits(_mm_unpackhi_epi8(high, low)));
+    }
+    scalarToHex(in + i, length - i, out + 2 * i);
+}
+
+/**
+ * Nibble values of 16 hex characters, invalid characters set their
+ * bit in the invalid mask
+ */
+HELLOWORLD_CODEC_HELPER("sse2") __m128i sse2HexNibbles(__m128i chars,
+                                                      __m128i &invalid) {
+    // signed compare, characters above 0x7f are negative and out of range
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('0' - 1)),
+                                  _mm_cmplt_epi8(chars, _mm_set1_epi8('9' + 1)));
+    __m128i lower = _mm_or_si128(chars, _mm_set1_epi8(0x20));
+    __m128i letter =
+        _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                      _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+    invalid = _mm_or_si128(
+        invalid, _mm_andnot_si128(_mm_or_si128(digit, letter),
+                                  _mm_set1_epi8(static_cast<char>(0xff))));
+    return _mm_or_si128(
+        _mm_and_si128(digit, _mm_sub_epi8(chars, _mm_set1_epi8('0'))),
+        _mm_and_si128(letter, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10))));
+}
+
+/**
+ * Joins nibble pairs into bytes, 16 bit lane holds high nibble in the low
+ * byte; results are in the low bytes of the lanes
+ */
+HELLOWORLD_CODEC_HELPER("sse2") __m128i sse2JoinNibbles(__m128i nibbles) {
+    return _mm_or_si128(
+        _mm_slli_epi16(_mm_and_si128(nibbles, _mm_set1_epi16(0x00ff)), 4),
+        _mm_srli_epi16(nibbles, 8));
+}
+
+__attribute__((target("sse2"))) bool sse2FromHex(const char *in,
+                                                 size_t length,
+                                                 unsigned char *out) {
+    __m128i invalid = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m128i first = sse2HexNibbles(
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i)),
+            invalid);
+        __m128i second = sse2HexNibbles(
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i + 16)),
+            invalid);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i / 2),
+                         _mm_packus_epi16(sse2JoinNibbles(first),
+                                          sse2JoinNibbles(second)));
+    }
+    return _mm_movemask_epi8(invalid) == 0 &&
+           scalarFromHex(in + i, length - i, out + i / 2);
+}
+
+/*
+ * AVX2 KERNELS
+ */
+
+HELLOWORLD_CODEC_HELPER("avx2") __m256i avx2HexDigits(__m256i nibbles) {
+    __m256i letters = _mm256_cmpgt_epi8(nibbles, _mm256_set1_epi8(9));
+    return _mm256_add_epi8(
+        _mm256_add_epi8(nibbles, _mm256_set1_epi8('0')),
+        _mm256_and_si256(letters, _mm256_set1_epi8('a' - '0' - 10)));
+}
+
+__attribute__((target("avx2"))) void avx2ToHex(const unsigned char *in,
+                                               size_t length, char *out) {
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i bytes =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+        __m256i high = _mm256_and_si256(_mm256_srli_epi16(bytes, 4), mask);
+        __m256i low = _mm256_and_si256(bytes, mask);
+        // unpack works within 128 bit lanes, put the lanes back in order
+        __m256i first = avx2HexDigits(_mm256_unpacklo_epi8(high, low));
+        __m256i second = avx2HexDigits(_mm256_unpackhi_epi8(high, low));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + 2 * i),
+                            _mm256_permute2x128_si256(first, second, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + 2 * i + 32),
+                            _mm256_permute2x128_si256(first, second, 0x31));
+    }
+    // upper halves are cleared before sse code, mixing them is slow
+    _mm256_zeroupper();
+    sse2ToHex(in + i, length - i, out + 2 * i);
+}
+
+HELLOWORLD_CODEC_HELPER("avx2") __m256i avx2HexNibbles(__m256i chars,
+                                                      __m256i &invalid) {
+    __m256i digit =
+        _mm256_and_si256(_mm256_cmpgt_epi8(chars, _mm256_set1_epi8('0' - 1)),
+                         _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), chars));
+    __m256i lower = _mm256_or_si256(chars, _mm256_set1_epi8(0x20));
+    __m256i letter =
+        _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+                         _mm256_cmpgt_epi8(_mm256_set1_epi8('f' + 1), lower));
+    invalid = _mm256_or_si256(
+        invalid,
+        _mm256_andnot_si256(_mm256_or_si256(digit, letter),
+                            _mm256_set1_epi8(static_cast<char>(0xff))));
+    return _mm256_or_si256(
+        _mm256_and_si256(digit, _mm256_sub_epi8(chars, _mm256_set1_epi8('0'))),
+        _mm256_and_si256(letter,
+                         _mm256_sub_epi8(lower, _mm256_set1_epi8('a' - 10))));
+}
+
+HELLOWORLD_CODEC_HELPER("avx2") __m256i avx2JoinNibbles(__m256i nibbles) {
+    return _mm256_or_si256(
+        _mm256_slli_epi16(_mm256_and_si256(nibbles, _mm256_set1_epi16(0x00ff)),
+                          4),
+        _mm256_srli_epi16(nibbles, 8));
+}
+
+__attribute__((target("avx2"))) bool avx2FromHex(const char *in,
+                                                 size_t length,
+                                                 unsigned char *out) {
+    __m256i invalid = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 64 <= length; i += 64) {
+        __m256i first = avx2HexNibbles(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i)),
+            invalid);
+        __m256i second = avx2HexNibbles(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i + 32)),
+            invalid);
+        // pack works within lanes too
+        __m256i bytes = _mm256_packus_epi16(avx2JoinNibbles(first),
+                                            avx2JoinNibbles(second));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i / 2),
+                            _mm256_permute4x64_epi64(bytes, 0xd8));
+    }
+    bool valid = _mm256_testz_si256(invalid, invalid);
+    _mm256_zeroupper();
+    return valid && sse2FromHex(in + i, length - i, out + i / 2);
+}
+
+/*
+ * Base64 kernels follow W. Muła, D. Lemire: Faster Base64 Encoding
+ * and Decoding Using AVX2 Instructions (2018)
+ */
+
+__attribute__((target("avx2"))) size_t avx2ToBase64(const unsigned char *in,
+                                                    size_t length, char *out) {
+    // spread 3 byte groups to 4 byte lanes: b1 b0 b2 b1
+    const __m256i spread = _mm256_setr_epi8(
+        1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,    //
+        1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    const __m256i offsets = _mm256_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+
+    size_t i = 0;
+    char *begin = out;
+    // each lane reads 16 bytes and uses 12 of them
+    for (; i + 28 <= length; i += 24, out += 32) {
+        __m256i bytes = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(
+                _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i))),
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i + 12)),
+            1);
+        bytes = _mm256_shuffle_epi8(bytes, spread);
+
+        // 6 bit indices, one per byte
+        __m256i ac = _mm256_mulhi_epu16(
+            _mm256_and_si256(bytes, _mm256_set1_epi32(0x0fc0fc00)),
+            _mm256_set1_epi32(0x04000040));
+        __m256i bd = _mm256_mullo_epi16(
+            _mm256_and_si256(bytes, _mm256_set1_epi32(0x003f03f0)),
+            _mm256_set1_epi32(0x01000010));
+        __m256i indices = _mm256_or_si256(ac, bd);
+
+        // index ranges to their character offsets
+        __m256i range = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+        range = _mm256_or_si256(range,
+                                _mm256_and_si256(upper, _mm256_set1_epi8(13)));
+        __m256i chars = _mm256_add_epi8(
+            indices, _mm256_shuffle_epi8(offsets, range));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), chars);
+    }
+    _mm256_zeroupper();
+    out += scalarToBase64(in + i, length - i, out);
+    return static_cast<size_t>(out - begin);
+}
+
+__attribute__((target("avx2"))) bool avx2FromBase64(const char *in,
+                                                    size_t length,
+                                                    unsigned char *out,
+                                                    size_t &written) {
+    const __m256i lowLut = _mm256_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a,
+        0x1b, 0x1b, 0x1b, 0x1a, 0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    const __m256i highLut = _mm256_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i rollLut = _mm256_setr_epi8(
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,    //
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i mask = _mm256_set1_epi8(0x2f);
+    const __m256i order = _mm256_setr_epi8(
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,    //
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+    if (length % 4 != 0) {
+        written = 0;
+        return false;
+    }
+
+    size_t i = 0;
+    unsigned char *begin = out;
+    // the last block may hold padding, left for the scalar code
+    for (; i + 32 < length; i += 32, out += 24) {
+        __m256i chars =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+        __m256i highNibbles =
+            _mm256_and_si256(_mm256_srli_epi32(chars, 4), mask);
+        __m256i lowNibbles = _mm256_and_si256(chars, mask);
+        __m256i low = _mm256_shuffle_epi8(lowLut, lowNibbles);
+        __m256i high = _mm256_shuffle_epi8(highLut, highNibbles);
+        if (!_mm256_testz_si256(low, high)) {
+            _mm256_zeroupper();
+            written = 0;
+            return false;
+        }
+        __m256i slash = _mm256_cmpeq_epi8(chars, mask);
+        __m256i roll = _mm256_shuffle_epi8(
+            rollLut, _mm256_add_epi8(slash, highNibbles));
+        __m256i values = _mm256_add_epi8(chars, roll);
+
+        // join 4 x 6 bits into 3 bytes within each 32 bit lane
+        __m256i pairs =
+            _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+        __m256i groups =
+            _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+        groups = _mm256_shuffle_epi8(groups, order);
+        groups = _mm256_permutevar8x32_epi32(
+            groups, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, -1, -1));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out),
+                         _mm256_castsi256_si128(groups));
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(out + 16),
+                         _mm256_extracti128_si256(groups, 1));
+    }
+    _mm256_zeroupper();
+    size_t rest;
+    bool valid = scalarFromBase64(in + i, length - i, out, rest);
+    written = static_cast<size_t>(out - begin) + rest;
+    return valid;
+}
+
+Kernel detect() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return Kernel::AVX2;
+    if (__builtin_cpu_supports("sse2")) return Kernel::SSE2;
+    return Kernel::SCALAR;
+}
+
+#else
+
+Kernel detect() { return Kernel::SCALAR; }
+
+#endif    // HELLOWORLD_CODEC_X86
+
+std::atomic<Kernel> &current() {
+    static std::atomic<Kernel> kernel{detected()};
+    return kernel;
+}
+
+}    // namespace
+
+Kernel detected() {
+    static const Kernel kernel = detect();
+    return kernel;
+}
+
+Kernel active() { return current().load(std::memory_order_relaxed); }
+
+Kernel use(Kernel selected) {
+    // kernels are ordered, a cpu supporting one supports those before it
+    if (static_cast<int>(selected) > static_cast<int>(detected()))
+        selected = detected();
+    current().store(selected);
+    return selected;
+}
+
+void toHex(const unsigned char *in, size_t length, char *out) {
+    switch (active()) {
+#if HELLOWORLD_CODEC_X86
+        case Kernel::AVX2:
+            return avx2ToHex(in, length, out);
+        case Kernel::SSE2:
+            return sse2ToHex(in, length, out);
+#endif
+        default:
+            return scalarToHex(in, length, out);
+    }
+}
+
+bool fromHex(const char *in, size_t length, unsigned char *out) {
+    if (length % 2 != 0) return false;
+    switch (active()) {
+#if HELLOWORLD_CODEC_X86
+        case Kernel::AVX2:
+            return avx2FromHex(in, length, out);
+        case Kernel::SSE2:
+            return sse2FromHex(in, length, out);
+#endif
+        default:
+            return scalarFromHex(in, length, out);
+    }
+}
+
+size_t toBase64(const unsigned char *in, size_t length, char *out) {
+#if HELLOWORLD_CODEC_X86
+    if (active() == Kernel::AVX2) return avx2ToBase64(in, length, out);
+#endif
+    return scalarToBase64(in, length, out);
+}
+
+bool fromBase64(const char *in, size_t length, unsigned char *out,
+                size_t &written) {
+#if HELLOWORLD_CODEC_X86
+    if (active() == Kernel::AVX2)
+        return avx2FromBase64(in, length, out, written);
+#endif
+    return scalarFromBase64(in, length, out, written);
+}
+
+}    // namespace codec
+}    // namespace helloworld
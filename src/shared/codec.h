@@ -0,0 +1,97 @@
+/**
+ * @file codec.h
+ * @brief Hex and base64 encoding into caller provided buffers, table driven
+ *        with vectorized kernels picked by the cpu at runtime
+ *
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef HELLOWORLD_SHARED_CODEC_H_
+#define HELLOWORLD_SHARED_CODEC_H_
+
+#include <cstddef>
+
+namespace helloworld {
+namespace codec {
+
+enum class Kernel {
+    SCALAR, /**< lookup tables, any cpu */
+    SSE2,   /**< 16 bytes per step for hex, base64 stays scalar */
+    AVX2,   /**< 32 bytes per step for hex, 24 bytes per step for base64 */
+};
+
+/**
+ * @brief Best kernel supported by this cpu (and compiler), detected once
+ */
+Kernel detected();
+
+/**
+ * @brief Kernel used by the functions below
+ */
+Kernel active();
+
+/**
+ * @brief Select kernel, meant for tests and benchmarks
+ *
+ * @param kernel kernel to use, if not supported the detected() one is used
+ * @return kernel in use
+ */
+Kernel use(Kernel kernel);
+
+constexpr size_t hexSize(size_t length) { return length * 2; }
+
+/**
+ * @brief Encode bytes into lowercase hex
+ *
+ * @param in bytes to encode
+ * @param length number of bytes
+ * @param out output of hexSize(length) characters, not terminated
+ */
+void toHex(const unsigned char *in, size_t length, char *out);
+
+/**
+ * @brief Decode hex, both lowercase and uppercase digits
+ *
+ * @param in hex characters
+ * @param length number of characters, must be even
+ * @param out output of length / 2 bytes
+ * @return false if length is odd or any character is not hex digit,
+ *         the output content is then undefined
+ */
+bool fromHex(const char *in, size_t length, unsigned char *out);
+
+constexpr size_t base64Size(size_t length) { return (length + 2) / 3 * 4; }
+
+constexpr size_t base64MaxDecodedSize(size_t length) { return length / 4 * 3; }
+
+/**
+ * @brief Encode bytes into padded base64 (RFC 4648)
+ *
+ * @param in bytes to encode
+ * @param length number of bytes
+ * @param out output of base64Size(length) characters, not terminated
+ * @return number of characters written
+ */
+size_t toBase64(const unsigned char *in, size_t length, char *out);
+
+/**
+ * @brief Decode padded base64
+ *
+ * @param in base64 characters, no whitespace
+ * @param length number of characters, must be multiple of 4
+ * @param out output of base64MaxDecodedSize(length) bytes
+ * @param written number of bytes decoded
+ * @return false if the input is not valid base64, the output content
+ *         is then undefined
+ */
+bool fromBase64(const char *in, size_t length, unsigned char *out,
+                size_t &written);
+
+}    // namespace codec
+}    // namespace helloworld
+
+#endif    // HELLOWORLD_SHARED_CODEC_H_
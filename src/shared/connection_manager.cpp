@@ -16,22 +16,21 @@ ClientToServerManager::ClientToServerManager(const zero::str_t &sessionKey,
     _rsa_out.setPublicKey(publicKeyData);
 }
 
-Response ClientToServerManager::parseIncoming(std::stringstream &&data) {
-    if (getSize(data) < HEADER_ENCRYPTED_SIZE)
+Response ClientToServerManager::parseIncoming(std::istream &&data) {
+    if (getSize(data) <= SEALED_OVERHEAD)
         throw Error("Server returned generic error.");
-    std::stringstream headDecrypted = _GCMdecryptHead(data);
-    std::stringstream bodyDecrypted = _GCMdecryptBody(data);
+    std::vector<unsigned char> decrypted = _GCMdecrypt(data);
 
     Response response;
-    std::vector<unsigned char> head(sizeof(Request::Header));
-    read_n(headDecrypted, head.data(), head.size());
-    response.header = Response::Header::deserialize(head);
+    uint64_t from = 0;
+    response.header = Response::Header::deserialize(decrypted, from);
     if (!_testing && !_counter.checkIncomming(response))
         throw Error("Possible replay attack");
 
-    // will pass only encrypted payload if not for server to read
-    response.payload.resize(getSize(bodyDecrypted));
-    read_n(bodyDecrypted, response.payload.data(), response.payload.size());
+    // will pass only encrypted payload if not for server to read, the buffer
+    // is reused for it instead of copying
+    decrypted.erase(decrypted.begin(), decrypted.begin() + from);
+    response.payload = std::move(decrypted);
 
     return response;
 }
@@ -42,8 +41,7 @@ std::stringstream ClientToServerManager::parseOutgoing(Request data) {
     // data cannot be const ref - cannot set number
     _counter.setNumber(data);
     if (_established) {
-        _GCMencryptHead(result, data);
-        _GCMencryptBody(result, data);
+        _GCMencrypt(result, data);
     } else {
         // this section sent only once: when registered / authenticated
         write_n(result, _rsa_out.encryptKey(from_hex(_sessionKey)));
@@ -62,7 +60,7 @@ GenericServerManager::GenericServerManager(const std::string &privkeyFilename,
     _rsa_in.loadPrivateKey(privkeyFilename, std::move(password));
 }
 
-Request GenericServerManager::parseIncoming(std::stringstream &&data) {
+Request GenericServerManager::parseIncoming(std::istream &&data) {
     Request request;
     // encrypted session key
     std::vector<unsigned char> encryptedKey =
@@ -96,13 +94,14 @@ std::stringstream GenericServerManager::returnErrorGeneric() {
     return std::stringstream{};
 }
 
-void GenericServerManager::setKey(const zero::str_t &key) { _sessionKey = key; }
+void GenericServerManager::setKey(const zero::str_t &key) {
+    _setSessionKey(key);
+}
 
 std::stringstream GenericServerManager::parseOutgoing(Response data) {
     std::stringstream result{};
     _counter.setNumber(data);
-    _GCMencryptHead(result, data);
-    _GCMencryptBody(result, data);
+    _GCMencrypt(result, data);
     result.seekg(0, std::ios::beg);
     _sessionKey = "";    // reset key to nothing, prevent misuse
     return result;
@@ -113,31 +112,67 @@ ServerToClientManager::ServerToClientManager(const zero::str_t &sessionKey)
     switchSecureChannel(true);
 }
 
-Request ServerToClientManager::parseIncoming(std::stringstream &&data) {
+Request ServerToClientManager::parseIncoming(std::istream &&data) {
     Request request;
 
-    std::stringstream headDecrypted = _GCMdecryptHead(data);
-    std::stringstream bodyDecrypted = _GCMdecryptBody(data);
+    std::vector<unsigned char> decrypted;
+    {
+        std::lock_guard<std::mutex> open(_openLock);
+        decrypted = _GCMdecrypt(data);
+    }
 
-    std::vector<unsigned char> head(sizeof(Request::Header));
-    read_n(headDecrypted, head.data(), head.size());
-    request.header = Request::Header::deserialize(head);
+    uint64_t from = 0;
+    request.header = Request::Header::deserialize(decrypted, from);
+    std::lock_guard<std::mutex> counter(_counterLock);
     if (!_testing && !_counter.checkIncomming(request))
         throw Error("Possible replay attack");
 
     // will pass only encrypted payload if not for server to read
-    request.payload.resize(getSize(bodyDecrypted));
-    read_n(bodyDecrypted, request.payload.data(), request.payload.size());
+    decrypted.erase(decrypted.begin(), decrypted.begin() + from);
+    request.payload = std::move(decrypted);
 
     return request;
 }
 
+RequestView ServerToClientManager::parseIncoming(
+    ByteSpan data, std::vector<unsigned char> &buffer) {
+    {
+        std::lock_guard<std::mutex> open(_openLock);
+        _GCMdecrypt(data, buffer);
+    }
+
+    uint64_t from = 0;
+    Request::Header header = Request::Header::deserialize(buffer, from);
+    std::lock_guard<std::mutex> counter(_counterLock);
+    if (!_testing && !_counter.checkIncomming(header))
+        throw Error("Possible replay attack");
+
+    return {header, {buffer.data() + from, buffer.size() - from}};
+}
+
 std::stringstream ServerToClientManager::parseOutgoing(Response data) {
+    return parseOutgoing(ResponseView(data));
+}
+
+std::stringstream ServerToClientManager::parseOutgoing(ResponseView data) {
     std::stringstream result{};
-    _counter.setNumber(data);
-    _GCMencryptHead(result, data);
-    _GCMencryptBody(result, data);
+    parseOutgoing(data, [&result](std::stringstream &sealed) {
+        result = std::move(sealed);
+    });
     return result;
 }
 
+void ServerToClientManager::parseOutgoing(
+    ResponseView data, const std::function<void(std::stringstream &)> &send) {
+    std::stringstream result{};
+    // numbered, sealed and queued in one step, messages leave in number order
+    std::lock_guard<std::mutex> seal(_sealLock);
+    {
+        std::lock_guard<std::mutex> counter(_counterLock);
+        _counter.setNumber(data.header);
+    }
+    _GCMencrypt(result, data);
+    send(result);
+}
+
 }    // namespace helloworld
@@ -21,11 +21,15 @@
 #ifndef HELLOWORLD_SHARED_CONNECTIONMANAGER_H_
 #define HELLOWORLD_SHARED_CONNECTIONMANAGER_H_
 
+#include <algorithm>
+#include <functional>
 #include <iterator>
 #include <map>
+#include <mutex>
 #include <sstream>
 
 #include "aes_gcm.h"
+#include "buffer_pool.h"
 #include "request_response.h"
 #include "rsa_2048.h"
 
@@ -50,17 +54,22 @@ namespace helloworld {
 template <typename incoming, typename outgoing>
 class ConnectionManager {
    protected:
-    AESGCM _gcm{};
+    // separate contexts, a message may be sealed while other one is opened
+    AESGCM _sealer{};
+    AESGCM _opener{};
     Random _random;
 
     zero::str_t _sessionKey;
     bool _established = false;
 
-    static constexpr int HEADER_ENCRYPTED_SIZE = 32;
+    // message is [iv][tag][encrypted header + payload]
+    static constexpr size_t SEALED_OVERHEAD =
+        AESGCM::iv_size + AESGCM::tag_size;
 
    public:
-    explicit ConnectionManager(zero::str_t sessionKey)
-        : _sessionKey(std::move(sessionKey)){};
+    explicit ConnectionManager(const zero::str_t &sessionKey) {
+        _setSessionKey(sessionKey);
+    };
 
     virtual ~ConnectionManager() = default;
 
@@ -78,10 +87,11 @@ class ConnectionManager {
      * @brief Parse bytes into incoming (request/response) type structure,
      *    decrypt and verify integrity
      *
-     * @param data
+     * @param data message stream, any stream (e.g. ByteSpanStream over
+     *        the receive buffer) to avoid copying the message
      * @return
      */
-    virtual incoming parseIncoming(std::stringstream &&data) = 0;
+    virtual incoming parseIncoming(std::istream &&data) = 0;
 
     /**
      * @brief Parse outgoing (request/response) type structure into byte array,
@@ -93,71 +103,84 @@ class ConnectionManager {
     virtual std::stringstream parseOutgoing(outgoing data) = 0;
 
    protected:
-    // pretty ugly, but C++ does not simply allows to move n bytes
-    std::stringstream _nBytesFromStream(std::istream &input, size_t n) {
-        std::stringstream result;
-        std::vector<unsigned char> buff(n);
-        size_t size = read_n(input, buff.data(), buff.size());
-        write_n(result, buff.data(), size);
-        clear<unsigned char>(buff.data(), buff.size());
-        return result;
+    /**
+     * @brief Sets session key and expands it into the GCM contexts, the key
+     *        schedule is computed once per key instead of once per message
+     *
+     * @param key hex session key, invalid key makes the GCM methods throw
+     */
+    void _setSessionKey(const zero::str_t &key) {
+        _sessionKey = key;
+        if (!_hasSessionKey()) return;
+        zero::bytes_t raw = from_hex(_sessionKey);
+        _sealer.setRawKey(raw);
+        _opener.setRawKey(raw);
     }
 
-    void _GCMencryptBody(std::ostream &out, const outgoing &data) {
-        std::stringstream body;
-        write_n(body, data.payload);
-        std::string bodyIv = to_hex(_random.get(AESGCM::iv_size));
-        std::istringstream bodyIvStream{bodyIv};
-        std::stringstream bodyEncrypted;
-        if (!_gcm.setKey(_sessionKey) || !_gcm.setIv(bodyIv)) {
-            throw Error("Could not initialize GCM.");
-        }
-        write_n(out, bodyIv);
-        _gcm.encryptWithAd(body, bodyIvStream, out);
+    bool _hasSessionKey() const {
+        return _sessionKey.size() == AESGCM::key_size * 2;
     }
 
-    void _GCMencryptHead(std::ostream &out, const outgoing &data) {
-        std::vector<unsigned char> head_data = data.header.serialize();
-        std::stringstream head;
-        write_n(head, head_data);
-
-        // 1) encrypt head
-        std::string headIv = to_hex(_random.get(AESGCM::iv_size));
-        std::istringstream headIvStream{headIv};
-        std::stringstream headEncrypted;
-        if (!_gcm.setKey(_sessionKey) || !_gcm.setIv(headIv)) {
-            throw Error("Could not initialize GCM.");
-        }
-        write_n(out, headIv);
-        _gcm.encryptWithAd(head, headIvStream, out);
+    /**
+     * @brief Encrypts header and payload with single iv in one operation
+     *
+     * @param out stream to write the sealed message to
+     * @param data message to seal, owning or view (payload convertible
+     *        to ByteSpan)
+     */
+    template <typename Message>
+    void _GCMencrypt(std::ostream &out, const Message &data) {
+        if (!_hasSessionKey()) throw Error("Could not initialize GCM.");
+
+        // pooled buffers, the plaintext is cleared on release
+        ByteSpan payload = data.payload;
+        MessageBuffer plain(data.header.serialized_size() + payload.size);
+        data.header.serialize(*plain);
+        plain->insert(plain->end(), payload.begin(), payload.end());
+
+        MessageBuffer sealed(SEALED_OVERHEAD + plain->size());
+        sealed->resize(SEALED_OVERHEAD + plain->size());
+        _random.get({sealed->data(), AESGCM::iv_size});
+        _sealer.seal({sealed->data(), AESGCM::iv_size}, *plain, {},
+                     {sealed->data() + AESGCM::iv_size,
+                      sealed->size() - AESGCM::iv_size});
+        write_n(out, *sealed);
     }
 
-    std::stringstream _GCMdecryptHead(std::istream &in) {
-        // in hex string - 2x length
-        std::stringstream headIvStream =
-            _nBytesFromStream(in, AESGCM::iv_size * 2);
-        std::stringstream headStream =
-            _nBytesFromStream(in, HEADER_ENCRYPTED_SIZE);
-        std::stringstream headDecrypted;
-        if (!_gcm.setKey(_sessionKey) || !_gcm.setIv(headIvStream.str())) {
-            throw Error("Could not initialize GCM.");
-        }
-        headIvStream.seekg(0, std::ios::beg);
-        _gcm.decryptWithAd(headStream, headIvStream, headDecrypted);
-        return headDecrypted;
+    /**
+     * @brief Decrypts and verifies message sealed by _GCMencrypt()
+     *
+     * @param sealed the sealed message
+     * @param plain buffer to decrypt into, resized to the serialized header
+     *        followed by the payload
+     */
+    void _GCMdecrypt(ByteSpan sealed, std::vector<unsigned char> &plain) {
+        if (!_hasSessionKey()) throw Error("Could not initialize GCM.");
+        if (sealed.size < SEALED_OVERHEAD) throw Error("Message too short.");
+
+        plain.resize(sealed.size - SEALED_OVERHEAD);
+        _opener.open({sealed.data, AESGCM::iv_size},
+                     {sealed.data + AESGCM::iv_size,
+                      sealed.size - AESGCM::iv_size},
+                     {}, plain);
     }
 
-    std::stringstream _GCMdecryptBody(std::istream &in) {
-        std::stringstream bodyIvStream =
-            _nBytesFromStream(in, AESGCM::iv_size * 2);
-        std::stringstream bodyStream = _nBytesFromStream(in, getSize(in));
-        std::stringstream bodyDecrypted;
-        if (!_gcm.setKey(_sessionKey) || !_gcm.setIv(bodyIvStream.str())) {
-            throw Error("Could not initialize GCM.");
+    /**
+     * @brief Decrypts and verifies message sealed by _GCMencrypt()
+     *
+     * @param in stream with the sealed message
+     * @return serialized header followed by the payload
+     */
+    std::vector<unsigned char> _GCMdecrypt(std::istream &in) {
+        if (!_hasSessionKey()) throw Error("Could not initialize GCM.");
+
+        std::vector<unsigned char> sealed(getSize(in));
+        if (read_n(in, sealed.data(), sealed.size()) != sealed.size()) {
+            throw Error("Message too short.");
         }
-        bodyIvStream.seekg(0, std::ios::beg);
-        _gcm.decryptWithAd(bodyStream, bodyIvStream, bodyDecrypted);
-        return bodyDecrypted;
+        std::vector<unsigned char> plain;
+        _GCMdecrypt(sealed, plain);
+        return plain;
     }
 };
 
@@ -208,7 +231,7 @@ class ClientToServerManager : public BasicConnectionManager<Response, Request> {
     explicit ClientToServerManager(const zero::str_t &sessionKey,
                                    const zero::bytes_t &publicKeyData);
 
-    Response parseIncoming(std::stringstream &&data) override;
+    Response parseIncoming(std::istream &&data) override;
 
     std::stringstream parseOutgoing(Request data) override;
 
@@ -220,12 +243,44 @@ class ClientToServerManager : public BasicConnectionManager<Response, Request> {
  * server always knows the session key as it is forwarded in auth / registration
  */
 class ServerToClientManager : public BasicConnectionManager<Request, Response> {
+    // the manager is used by the owner's lane and by lanes of users
+    // forwarding to him; seal and open use own contexts and may overlap,
+    // the message counter is shared by both
+    std::mutex _sealLock;
+    std::mutex _openLock;
+    std::mutex _counterLock;
+
    public:
     explicit ServerToClientManager(const zero::str_t &sessionKey);
 
-    Request parseIncoming(std::stringstream &&data) override;
+    Request parseIncoming(std::istream &&data) override;
+
+    /**
+     * @brief Parse request without copying its payload
+     *
+     * @param data sealed message
+     * @param buffer buffer to decrypt the message into
+     * @return request with payload pointing into the buffer
+     */
+    RequestView parseIncoming(ByteSpan data, std::vector<unsigned char> &buffer);
 
     std::stringstream parseOutgoing(Response data) override;
+
+    /**
+     * @brief Seal response borrowing its payload, e.g. forwarded message
+     */
+    std::stringstream parseOutgoing(ResponseView data);
+
+    /**
+     * @brief Seal response and hand it over to be sent, both under the seal
+     *        lock: the client accepts only the next message number, the
+     *        messages must be queued to the socket in number order
+     *
+     * @param data response to seal
+     * @param send called with the sealed message, e.g. posts it to socket
+     */
+    void parseOutgoing(ResponseView data,
+                       const std::function<void(std::stringstream &)> &send);
 };
 
 /**
@@ -252,7 +307,7 @@ class GenericServerManager : BasicConnectionManager<Request, Response> {
      * @param data data to parse
      * @return Request from new user
      */
-    Request parseIncoming(std::stringstream &&data) override;
+    Request parseIncoming(std::istream &&data) override;
 
     /**
      * Return reponse bytes of 0s that satisfies the parsed reponse length
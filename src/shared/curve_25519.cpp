@@ -1,5 +1,8 @@
 #include "curve_25519.h"
 
+#include <algorithm>
+#include <thread>
+
 #include "eddsa/eddsa.h"
 
 extern "C" {
@@ -20,6 +23,50 @@ C25519KeyGen::C25519KeyGen() {
     curve25519_keygen(_buffer_public.data(), _buffer_private.data());
 }
 
+std::vector<C25519KeyPair> C25519KeyGen::generate(size_t count,
+                                                  size_t threads) {
+    std::vector<C25519KeyPair> keys(count);
+
+    // the drbg limits single request size
+    Random random{};
+    constexpr size_t KEYS_PER_REQUEST = MBEDTLS_CTR_DRBG_MAX_REQUEST /
+                                        KEY_BYTES_LEN;
+    for (size_t first = 0; first < count; first += KEYS_PER_REQUEST) {
+        size_t batch = std::min(KEYS_PER_REQUEST, count - first);
+        zero::bytes_t bytes = random.getKey(batch * KEY_BYTES_LEN);
+        for (size_t i = 0; i < batch; i++) {
+            auto begin = bytes.begin() + i * KEY_BYTES_LEN;
+            keys[first + i].privateKey.assign(begin, begin + KEY_BYTES_LEN);
+        }
+    }
+
+    auto derive = [&keys](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            C25519KeyPair &pair = keys[i];
+            sc_clamp(pair.privateKey.data());
+            pair.publicKey.resize(KEY_BYTES_LEN);
+            curve25519_keygen(pair.publicKey.data(), pair.privateKey.data());
+        }
+    };
+
+    // a thread is worth starting for a few keys at least
+    constexpr size_t MIN_KEYS_PER_THREAD = 4;
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::max<size_t>(
+        1, std::min(threads, count / MIN_KEYS_PER_THREAD));
+
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    size_t step = count / threads;
+    size_t begin = 0;
+    for (size_t i = 1; i < threads; i++, begin += step)
+        workers.emplace_back(derive, begin, begin + step);
+    derive(begin, count);
+    for (std::thread &worker : workers) worker.join();
+    return keys;
+}
+
 bool C25519KeyGen::savePrivateKey(const std::string &filename,
                                   const zero::str_t &key,
                                   const std::string &iv) {
@@ -28,6 +28,14 @@ namespace helloworld {
 
 class C25519;
 
+/**
+ * Key pair generated in a batch by C25519KeyGen::generate()
+ */
+struct C25519KeyPair {
+    zero::bytes_t privateKey;
+    zero::bytes_t publicKey;
+};
+
 class C25519KeyGen : AsymmetricKeyGen {
     friend C25519;
     static constexpr int KEY_BYTES_LEN = 32;
@@ -57,6 +65,17 @@ class C25519KeyGen : AsymmetricKeyGen {
 
     zero::bytes_t getPrivateKey() const;
 
+    /**
+     * Generates key pairs at once: the private keys are drawn from the random
+     * generator in bulk, the public keys are derived in parallel
+     *
+     * @param count number of key pairs
+     * @param threads threads deriving the public keys, 0 for one per core
+     * @return key pairs
+     */
+    static std::vector<C25519KeyPair> generate(size_t count,
+                                               size_t threads = 0);
+
     static zero::str_t getHexPwd(const zero::str_t &pwd) {
         return SHA512{}.getSafeHex(pwd).substr(0, 32);
     }
@@ -19,29 +19,33 @@ zero::bytes_t DoubleRatchetAdapter::DH(const DHPair &dh_pair,
 
 std::pair<zero::bytes_t, zero::bytes_t> DoubleRatchetAdapter::KDF_RK(
     const zero::bytes_t &rk, const zero::bytes_t &dh_out) {
-    _hkdf_rk.setSalt(to_hex(rk));
-    return split(from_hex(_hkdf_rk.generate(to_hex(dh_out), KDF_RK_SIZE)));
+    zero::bytes_t output(KDF_RK_SIZE);
+    _hkdf_rk.setSalt(ByteSpan(rk));
+    _hkdf_rk.generate(dh_out, output);
+    return split(output);
 }
 
 std::pair<zero::bytes_t, zero::bytes_t> DoubleRatchetAdapter::KDF_CK(
     const zero::bytes_t &ck, unsigned char input) {
-    _hmac.setKey(to_hex(ck));
-    return split(_hmac.generate(zero::bytes_t{input}));
+    zero::bytes_t output(KDF_RK_SIZE);
+    _hmac.setKey(ByteSpan(ck));
+    _hmac.generate(ByteSpan(&input, 1), output.data());
+    return split(output);
 }
 
 CipherHMAC DoubleRatchetAdapter::ENCRYPT(
     const zero::bytes_t &mk, const std::vector<unsigned char> &plaintext,
     const std::vector<unsigned char> &associated_data) {
-    zero::bytes_t keys = from_hex(_hkdf_encrypt.generate(to_hex(mk), 60));
-    zero::bytes_t encryptionKey, authenticationKey, iv;
-    std::tie(encryptionKey, keys) = split(keys, 16);
-    std::tie(authenticationKey, iv) = split(keys, 32);
+    zero::bytes_t keys(ENCRYPT_KEYS_SIZE);
+    _hkdf_encrypt.generate(mk, keys);
+    ByteSpan encryptionKey(keys.data(), ENCRYPTION_KEY_SIZE);
+    ByteSpan authenticationKey(encryptionKey.end(), AUTHENTICATION_KEY_SIZE);
+    ByteSpan iv(authenticationKey.end(), AESGCM::iv_size);
 
     AESGCM gcm;
-    gcm.setKey(to_hex(encryptionKey));
-    gcm.setIv(to_hex(iv));
-    std::vector<unsigned char> ciphertext;
-    gcm.encryptWithAd(plaintext, associated_data, ciphertext);
+    gcm.setRawKey(encryptionKey);
+    std::vector<unsigned char> ciphertext(AESGCM::tag_size + plaintext.size());
+    gcm.seal(iv, plaintext, associated_data, ciphertext);
 
     return {ciphertext,
             getHmac(authenticationKey, associated_data, ciphertext)};
@@ -51,22 +55,24 @@ std::vector<unsigned char> DoubleRatchetAdapter::DECRYPT(
     const zero::bytes_t &mk, const std::vector<unsigned char> &ciphertext,
     const std::vector<unsigned char> &hmac,
     const std::vector<unsigned char> &associated_data) {
-    zero::bytes_t keys = from_hex(_hkdf_encrypt.generate(to_hex(mk), 60));
-    zero::bytes_t encryptionKey, authenticationKey, iv;
-
-    std::tie(encryptionKey, keys) = split(keys, 16);
-    std::tie(authenticationKey, iv) = split(keys, 32);
+    zero::bytes_t keys(ENCRYPT_KEYS_SIZE);
+    _hkdf_encrypt.generate(mk, keys);
+    ByteSpan encryptionKey(keys.data(), ENCRYPTION_KEY_SIZE);
+    ByteSpan authenticationKey(encryptionKey.end(), AUTHENTICATION_KEY_SIZE);
+    ByteSpan iv(authenticationKey.end(), AESGCM::iv_size);
 
     if (getHmac(authenticationKey, associated_data, ciphertext) != hmac) {
         throw Error("DR: authentication failed");
     }
 
+    if (ciphertext.size() < AESGCM::tag_size) {
+        throw Error("DR: ciphertext too short");
+    }
     AESGCM gcm;
-    gcm.setKey(to_hex(encryptionKey));
-    gcm.setIv(to_hex(iv));
-
-    std::vector<unsigned char> plaintext;
-    gcm.decryptWithAd(ciphertext, associated_data, plaintext);
+    gcm.setRawKey(encryptionKey);
+    std::vector<unsigned char> plaintext(ciphertext.size() -
+                                         AESGCM::tag_size);
+    gcm.open(iv, ciphertext, associated_data, plaintext);
 
     return plaintext;
 }
@@ -79,10 +85,13 @@ MessageHeader DoubleRatchetAdapter::HEADER(const DHPair &dh_pair, size_t pn,
 std::vector<unsigned char> DoubleRatchetAdapter::CONCAT(
     const zero::bytes_t &ad, const MessageHeader &header) const {
     std::vector<unsigned char> result;
-    result.insert(result.begin(), ad.begin(), ad.end());
-    auto serializedMessageHeader = header.serialize();
-    result.insert(result.end(), serializedMessageHeader.begin(),
-                  serializedMessageHeader.end());
+    // the legacy length of dh takes at most 8 bytes
+    result.reserve(ad.size() + header.serialized_size() + sizeof(uint64_t));
+    result.insert(result.end(), ad.begin(), ad.end());
+    // associated data keep the header layout of the legacy format, messages
+    // sealed before the format change still verify
+    serialize::Writer out(result, serialize::LEGACY_VERSION);
+    header.write(out);
     return result;
 }
 
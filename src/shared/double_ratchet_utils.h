@@ -35,29 +35,17 @@ struct DHPair : Serializable<DHPair> {
     DHPair(zero::bytes_t pub, zero::bytes_t priv)
         : pub(std::move(pub)), priv(std::move(priv)) {}
 
-    serialize::structure &serialize(
-        serialize::structure &result) const override {
-        serialize::serialize(pub, result);
-        serialize::serialize(priv, result);
-        return result;
-    }
-
-    serialize::structure serialize() const override {
-        serialize::structure result;
-        return serialize(result);
-    }
+    void write(serialize::Writer &out) const override { out << pub << priv; }
 
-    static DHPair deserialize(const serialize::structure &data,
-                              uint64_t &from) {
-        DHPair object;
-        object.pub = serialize::deserialize<decltype(object.pub)>(data, from);
-        object.priv = serialize::deserialize<decltype(object.priv)>(data, from);
-        return object;
+    uint64_t serialized_size() const {
+        return serialize::serialized_size(pub) +
+               serialize::serialized_size(priv);
     }
 
-    static DHPair deserialize(const serialize::structure &data) {
-        uint64_t from = 0;
-        return deserialize(data, from);
+    static DHPair read(serialize::Reader &in) {
+        DHPair result;
+        in >> result.pub >> result.priv;
+        return result;
     }
 };
 
@@ -77,62 +65,49 @@ struct DRState : Serializable<DRState> {
     bool receivedMessage;    // boolean flag for checking whether double ratchet
                              // was initialized on both sides
 
-    serialize::structure &serialize(
-        serialize::structure &result) const override {
-        serialize::serialize(DHs, result);
-        serialize::serialize(DHr, result);
-        serialize::serialize(RK, result);
-        serialize::serialize(CKs, result);
-        serialize::serialize(CKr, result);
-        serialize::serialize(Ns, result);
-        serialize::serialize(Nr, result);
-        serialize::serialize(PN, result);
-        uint64_t size = MKSKIPPED.size();
-        serialize::serialize(size, result);
+    void write(serialize::Writer &out) const override {
+        out << DHs << DHr << RK << CKs << CKr << Ns << Nr << PN;
+        out.length(MKSKIPPED.size());
         for (const auto &x : MKSKIPPED) {
-            serialize::serialize(x.first.first, result);
-            serialize::serialize(x.first.second, result);
-            serialize::serialize(x.second, result);
+            out << x.first.first << x.first.second << x.second;
         }
-        serialize::serialize(AD, result);
-        serialize::serialize(receivedMessage, result);
-        return result;
-    }
-    serialize::structure serialize() const override {
-        serialize::structure result;
-        return serialize(result);
+        out << AD << receivedMessage;
+    }
+
+    uint64_t serialized_size() const {
+        uint64_t size = serialize::serialized_size(DHs) +
+                        serialize::serialized_size(DHr) +
+                        serialize::serialized_size(RK) +
+                        serialize::serialized_size(CKs) +
+                        serialize::serialized_size(CKr) +
+                        serialize::serialized_size(Ns) +
+                        serialize::serialized_size(Nr) +
+                        serialize::serialized_size(PN) +
+                        serialize::varint_size(MKSKIPPED.size());
+        for (const auto &x : MKSKIPPED) {
+            size += serialize::serialized_size(x.first.first) +
+                    serialize::serialized_size(x.first.second) +
+                    serialize::serialized_size(x.second);
+        }
+        return size + serialize::serialized_size(AD) +
+               serialize::serialized_size(receivedMessage);
     }
 
-    static DRState deserialize(const serialize::structure &data,
-                               uint64_t &from) {
+    static DRState read(serialize::Reader &in) {
         DRState result;
-        result.DHs = serialize::deserialize<decltype(result.DHs)>(data, from);
-        result.DHr = serialize::deserialize<decltype(result.DHr)>(data, from);
-        result.RK = serialize::deserialize<decltype(result.RK)>(data, from);
-        result.CKs = serialize::deserialize<decltype(result.CKs)>(data, from);
-        result.CKr = serialize::deserialize<decltype(result.CKr)>(data, from);
-        result.Ns = serialize::deserialize<decltype(result.Ns)>(data, from);
-        result.Nr = serialize::deserialize<decltype(result.Nr)>(data, from);
-        result.PN = serialize::deserialize<decltype(result.PN)>(data, from);
-        uint64_t size = serialize::deserialize<uint64_t>(data, from);
+        in >> result.DHs >> result.DHr >> result.RK >> result.CKs >> result.CKr
+           >> result.Ns >> result.Nr >> result.PN;
+        uint64_t size = in.length();
         for (uint64_t i = 0; i < size; ++i) {
             std::pair<zero::bytes_t, size_t> skipped_key;
-            skipped_key.first =
-                serialize::deserialize<zero::bytes_t>(data, from);
-            skipped_key.second = serialize::deserialize<size_t>(data, from);
-            auto value = serialize::deserialize<zero::bytes_t>(data, from);
+            zero::bytes_t value;
+            in >> skipped_key.first >> skipped_key.second >> value;
 
             result.MKSKIPPED.emplace(std::move(skipped_key), std::move(value));
         }
-        result.AD = serialize::deserialize<decltype(result.AD)>(data, from);
-        result.receivedMessage = serialize::deserialize<decltype(result.receivedMessage)>(data, from);
+        in >> result.AD >> result.receivedMessage;
         return result;
     }
-
-    static DRState deserialize(const serialize::structure &data) {
-        uint64_t from = 0;
-        return deserialize(data, from);
-    }
 };
 
 struct MessageHeader : public Serializable<MessageHeader> {
@@ -154,30 +129,18 @@ struct MessageHeader : public Serializable<MessageHeader> {
     MessageHeader(zero::bytes_t dh, size_t pn, size_t n)
         : dh(std::move(dh)), pn(pn), n(n) {}
 
-    serialize::structure &serialize(
-        serialize::structure &result) const override {
-        serialize::serialize(dh, result);
-        serialize::serialize(pn, result);
-        serialize::serialize(n, result);
-        return result;
-    }
-    serialize::structure serialize() const override {
-        serialize::structure result;
-        return serialize(result);
+    void write(serialize::Writer &out) const override { out << dh << pn << n; }
+
+    uint64_t serialized_size() const {
+        return serialize::serialized_size(dh) + serialize::serialized_size(pn) +
+               serialize::serialized_size(n);
     }
 
-    static MessageHeader deserialize(const serialize::structure &data,
-                                     uint64_t &from) {
+    static MessageHeader read(serialize::Reader &in) {
         MessageHeader result;
-        result.dh = serialize::deserialize<decltype(result.dh)>(data, from);
-        result.pn = serialize::deserialize<decltype(result.pn)>(data, from);
-        result.n = serialize::deserialize<decltype(result.n)>(data, from);
+        in >> result.dh >> result.pn >> result.n;
         return result;
     }
-    static MessageHeader deserialize(const serialize::structure &data) {
-        uint64_t from = 0;
-        return deserialize(data, from);
-    }
 };
 
 struct CipherHMAC {
@@ -197,37 +160,32 @@ struct Message : public Serializable<Message> {
           ciphertext(cipherHMAC.ciphertext),
           hmac(cipherHMAC.hmac) {}
 
-    serialize::structure &serialize(
-        serialize::structure &result) const override {
-        serialize::serialize(header, result);
-        serialize::serialize(ciphertext, result);
-        serialize::serialize(hmac, result);
-        return result;
-    }
-    serialize::structure serialize() const override {
-        serialize::structure result;
-        return serialize(result);
+    void write(serialize::Writer &out) const override {
+        out << header << ciphertext << hmac;
     }
 
-    static Message deserialize(const serialize::structure &data,
-                               uint64_t &from) {
-        Message message;
-        message.header =
-            serialize::deserialize<decltype(message.header)>(data, from);
-        message.ciphertext =
-            serialize::deserialize<decltype(message.ciphertext)>(data, from);
-        message.hmac =
-            serialize::deserialize<decltype(message.hmac)>(data, from);
-        return message;
+    uint64_t serialized_size() const {
+        return serialize::serialized_size(header) +
+               serialize::serialized_size(ciphertext) +
+               serialize::serialized_size(hmac);
     }
-    static Message deserialize(const serialize::structure &data) {
-        uint64_t from = 0;
-        return deserialize(data, from);
+
+    static Message read(serialize::Reader &in) {
+        Message result;
+        in >> result.header >> result.ciphertext >> result.hmac;
+        return result;
     }
 };
 
 class DoubleRatchetAdapter {
     static const size_t KDF_RK_SIZE = 64;
+    // ENCRYPT keys derived from message key: encryption key, authentication
+    // key and iv
+    static const size_t ENCRYPTION_KEY_SIZE = AESGCM::key_size;
+    static const size_t AUTHENTICATION_KEY_SIZE = 32;
+    static const size_t ENCRYPT_KEYS_SIZE =
+        ENCRYPTION_KEY_SIZE + AUTHENTICATION_KEY_SIZE + AESGCM::iv_size;
+
     hmac_base<MBEDTLS_MD_SHA512, KDF_RK_SIZE> _hmac;
     hkdf _hkdf_rk{std::make_unique<hmac_base<MBEDTLS_MD_SHA512, KDF_RK_SIZE>>(),
                   "KDF_RK for Double Ratchet. 584"};
@@ -235,14 +193,13 @@ class DoubleRatchetAdapter {
         std::make_unique<hmac_base<MBEDTLS_MD_SHA512, KDF_RK_SIZE>>(),
         "ENCRYPT for Double Ratchet. 239"};
 
-    std::vector<unsigned char> getHmac(
-        const zero::bytes_t &authentication_key,
-        const std::vector<unsigned char> &associated_data,
-        const std::vector<unsigned char> &ciphertext) {
-        auto hmacInput = associated_data;
+    std::vector<unsigned char> getHmac(ByteSpan authentication_key,
+                                       ByteSpan associated_data,
+                                       ByteSpan ciphertext) {
+        std::vector<unsigned char> result(_hmac.hmacLength());
         _hmac.setKey(authentication_key);
-        hmacInput.insert(hmacInput.end(), ciphertext.begin(), ciphertext.end());
-        return _hmac.generate(hmacInput);
+        _hmac.generate({associated_data, ciphertext}, result.data());
+        return result;
     }
 
    public:
@@ -0,0 +1,176 @@
+#include "framing.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "base_64.h"
+#include "buffer_pool.h"
+#include "serializable_error.h"
+#include "utils.h"
+
+namespace helloworld {
+
+constexpr unsigned char FrameCodec::PROTOCOL_MARKER;
+constexpr size_t FrameCodec::LENGTH_PREFIX_SIZE;
+constexpr size_t FrameCodec::MAX_FRAME_LENGTH;
+
+std::vector<unsigned char> FrameCodec::handshake() {
+    if (!_handshakePending) return {};
+    _handshakePending = false;
+    return {PROTOCOL_MARKER};
+}
+
+size_t FrameCodec::frameSize(size_t length) const {
+    // unknown protocol is sent as legacy
+    return _protocol == WireProtocol::BINARY ? LENGTH_PREFIX_SIZE + length
+                                             : Base64::linesSize(length) + 1;
+}
+
+void FrameCodec::encode(std::istream &data, std::ostream &out) {
+    // we spoke first, the peer has to follow
+    if (_protocol == WireProtocol::UNKNOWN)
+        _protocol = WireProtocol::LEGACY_BASE64;
+
+    if (_protocol == WireProtocol::LEGACY_BASE64) {
+        Base64 base64;
+        base64.fromStream(data, out);
+        out << '\0';    // to distinguish messages
+        return;
+    }
+
+    size_t size = getSize(data);
+    MessageBuffer payload(size);
+    payload->resize(size);
+    read_n(data, payload->data(), payload->size());
+    MessageBuffer frame(frameSize(size));
+    encode(*payload, *frame);
+    write_n(out, *frame);
+}
+
+std::vector<unsigned char> FrameCodec::encode(
+    const std::vector<unsigned char> &data) {
+    std::vector<unsigned char> frame;
+    encode(data, frame);
+    return frame;
+}
+
+void FrameCodec::encode(ByteSpan data, std::vector<unsigned char> &frame) {
+    if (_protocol == WireProtocol::UNKNOWN)
+        _protocol = WireProtocol::LEGACY_BASE64;
+
+    if (_protocol == WireProtocol::LEGACY_BASE64) {
+        frame.reserve(frameSize(data.size));
+        Base64::encodeLines(data, frame);
+        frame.push_back('\0');    // to distinguish messages
+        return;
+    }
+
+    if (data.size > MAX_FRAME_LENGTH)
+        throw Error("Message too long to be sent in one frame.");
+
+    auto length = static_cast<uint32_t>(data.size);
+    frame.resize(LENGTH_PREFIX_SIZE + data.size);
+    frame[0] = static_cast<unsigned char>(length >> 24);
+    frame[1] = static_cast<unsigned char>(length >> 16);
+    frame[2] = static_cast<unsigned char>(length >> 8);
+    frame[3] = static_cast<unsigned char>(length);
+    if (data.size > 0)
+        std::memcpy(frame.data() + LENGTH_PREFIX_SIZE, data.data, data.size);
+}
+
+unsigned char *FrameCodec::prepare(size_t length) {
+    _compact(length);
+    if (_buffer.size() < _size + length)
+        _buffer.resize(std::max(_buffer.size() * 2, _size + length));
+    return _buffer.data() + _size;
+}
+
+void FrameCodec::commit(size_t length) {
+    _size += length;
+    if (_incoming == WireProtocol::UNKNOWN && buffered() > 0) _detect();
+}
+
+void FrameCodec::feed(const char *data, size_t length) {
+    if (length == 0) return;
+    std::memcpy(prepare(length), data, length);
+    commit(length);
+}
+
+bool FrameCodec::next(ByteSpan &frame) {
+    switch (_incoming) {
+        case WireProtocol::BINARY:
+            return _nextBinary(frame);
+        case WireProtocol::LEGACY_BASE64:
+            return _nextLegacy(frame);
+        default:
+            return false;
+    }
+}
+
+bool FrameCodec::next(std::vector<unsigned char> &frame) {
+    ByteSpan view;
+    if (!next(view)) return false;
+    frame.assign(view.begin(), view.end());
+    return true;
+}
+
+void FrameCodec::_detect() {
+    if (_buffer[_offset] == PROTOCOL_MARKER) {
+        _incoming = WireProtocol::BINARY;
+        ++_offset;
+    } else {
+        _incoming = WireProtocol::LEGACY_BASE64;
+    }
+    // answer in the same protocol the peer speaks
+    if (_protocol == WireProtocol::UNKNOWN) {
+        _protocol = _incoming;
+        _handshakePending = _incoming == WireProtocol::BINARY;
+    } else if (_incoming == WireProtocol::LEGACY_BASE64) {
+        // announced binary, the peer does not know it
+        _protocol = WireProtocol::LEGACY_BASE64;
+    }
+}
+
+bool FrameCodec::_nextBinary(ByteSpan &frame) {
+    if (buffered() < LENGTH_PREFIX_SIZE) return false;
+
+    const unsigned char *prefix = _buffer.data() + _offset;
+    size_t length = static_cast<size_t>(prefix[0]) << 24 |
+                    static_cast<size_t>(prefix[1]) << 16 |
+                    static_cast<size_t>(prefix[2]) << 8 |
+                    static_cast<size_t>(prefix[3]);
+    if (length > MAX_FRAME_LENGTH)
+        throw Error("Invalid frame: length exceeds the limit.");
+    if (buffered() < LENGTH_PREFIX_SIZE + length) return false;
+
+    frame = {prefix + LENGTH_PREFIX_SIZE, length};
+    _offset += LENGTH_PREFIX_SIZE + length;
+    return true;
+}
+
+bool FrameCodec::_nextLegacy(ByteSpan &frame) {
+    const unsigned char *begin = _buffer.data() + _offset;
+    const unsigned char *end = _buffer.data() + _size;
+    const unsigned char *terminator = std::find(begin, end, '\0');
+    if (terminator == end) return false;
+
+    // consumed even if invalid, the next frame can still be read
+    _offset += static_cast<size_t>(terminator - begin) + 1;
+    Base64::decodeLines({begin, static_cast<size_t>(terminator - begin)},
+                        _decoded);
+    frame = ByteSpan(_decoded);
+    return true;
+}
+
+void FrameCodec::_compact(size_t required) {
+    if (_offset == _size) {
+        _offset = _size = 0;
+    } else if (_offset > 0 && _size + required > _buffer.size()) {
+        // move the unfinished frame to the front instead of growing
+        std::memmove(_buffer.data(), _buffer.data() + _offset, buffered());
+        _size -= _offset;
+        _offset = 0;
+    }
+}
+
+}    // namespace helloworld
@@ -0,0 +1,183 @@
+/**
+ * @file framing.h
+ * @brief Wire framing codec, splits the tcp byte stream into messages
+ *         - binary protocol: 4 byte length prefix (big endian) + raw bytes
+ *         - legacy protocol: base64 lines, message terminated by '\0'
+ *
+ * The protocol is negotiated: binary client announces itself by sending
+ * PROTOCOL_MARKER as the very first byte of the connection, server
+ * acknowledges with the same byte. The client sends frames only once
+ * acknowledged(), servers that stay silent speak legacy and the client
+ * has to reconnect without the announcement.
+ *
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef HELLOWORLD_SHARED_FRAMING_H_
+#define HELLOWORLD_SHARED_FRAMING_H_
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "byte_span.h"
+
+namespace helloworld {
+
+enum class WireProtocol {
+    UNKNOWN,          /**< not negotiated yet, sending uses legacy */
+    LEGACY_BASE64,    /**< base64 lines, message terminated by '\0' */
+    BINARY            /**< length prefixed raw frames */
+};
+
+class FrameCodec {
+    WireProtocol _protocol;
+    WireProtocol _incoming = WireProtocol::UNKNOWN;
+    bool _handshakePending;
+
+    // receive arena: [_offset, _size) holds bytes not yet returned as frame
+    std::vector<unsigned char> _buffer;
+    size_t _offset = 0;
+    size_t _size = 0;
+    // legacy frames are decoded here, binary frames are viewed in place
+    std::vector<unsigned char> _decoded;
+
+   public:
+    // byte never present in base64 output, opens binary connection
+    static constexpr unsigned char PROTOCOL_MARKER = 0xB1;
+    static constexpr size_t LENGTH_PREFIX_SIZE = 4;
+    static constexpr size_t MAX_FRAME_LENGTH = 16 * 1024 * 1024;
+
+    /**
+     * @brief Create codec
+     *
+     * @param protocol protocol used for outgoing messages, UNKNOWN to follow
+     *        the protocol the peer speaks (server side)
+     */
+    explicit FrameCodec(WireProtocol protocol = WireProtocol::UNKNOWN)
+        : _protocol(protocol),
+          _handshakePending(protocol == WireProtocol::BINARY) {}
+
+    /**
+     * @brief Protocol used for outgoing messages
+     */
+    WireProtocol protocol() const { return _protocol; }
+
+    /**
+     * @brief Protocol detected on incoming messages
+     */
+    WireProtocol incoming() const { return _incoming; }
+
+    /**
+     * @brief Whether the peer answered, outgoing frames of the announced
+     *        binary protocol must wait for it; peer answering in legacy
+     *        switches the outgoing protocol to legacy
+     */
+    bool acknowledged() const { return _incoming != WireProtocol::UNKNOWN; }
+
+    /**
+     * @brief Bytes that must be written to the socket before any frame,
+     *        returns non-empty value at most once (announcement or ack)
+     *
+     * @return handshake bytes to write, empty if nothing to write
+     */
+    std::vector<unsigned char> handshake();
+
+    /**
+     * @brief Size of frame the message is wrapped into
+     *
+     * @param length length of the message
+     */
+    size_t frameSize(size_t length) const;
+
+    /**
+     * @brief Wrap message into frame of outgoing protocol
+     *
+     * @param data message to frame, read until the end
+     * @param out stream to write the frame to
+     */
+    void encode(std::istream &data, std::ostream &out);
+
+    /**
+     * @brief Wrap message into frame of outgoing protocol
+     *
+     * @param data message to frame
+     * @return frame bytes
+     */
+    std::vector<unsigned char> encode(const std::vector<unsigned char> &data);
+
+    /**
+     * @brief Wrap message into frame of outgoing protocol, e.g. into
+     *        a pooled buffer
+     *
+     * @param data message to frame
+     * @param frame frame bytes, replaces the content
+     */
+    void encode(ByteSpan data, std::vector<unsigned char> &frame);
+
+    /**
+     * @brief Reserve space for incoming bytes so that the socket can be read
+     *        directly into the receive buffer, must be followed by commit()
+     *        invalidates all spans returned by next()
+     *
+     * @param length maximum number of bytes that will be written
+     * @return pointer to write the received bytes to
+     */
+    unsigned char *prepare(size_t length);
+
+    /**
+     * @brief Confirm bytes written into the space returned by prepare()
+     *
+     * @param length number of bytes actually written
+     */
+    void commit(size_t length);
+
+    /**
+     * @brief Append bytes received from socket, the data may contain
+     *        partial frame or any number of frames
+     *        invalidates all spans returned by next()
+     *
+     * @param data received bytes
+     * @param length length of data
+     */
+    void feed(const char *data, size_t length);
+
+    /**
+     * @brief Take next complete frame from the received data without copying,
+     *        the span is valid until the next prepare() / feed() / next() call
+     *
+     * @param frame view of decoded message, untouched if no frame complete
+     * @return true if frame was complete and returned
+     */
+    bool next(ByteSpan &frame);
+
+    /**
+     * @brief Take next complete frame from the received data
+     *
+     * @param frame decoded message, untouched if no frame complete
+     * @return true if frame was complete and returned
+     */
+    bool next(std::vector<unsigned char> &frame);
+
+    /**
+     * @brief Number of received bytes not yet returned as a frame
+     */
+    size_t buffered() const { return _size - _offset; }
+
+   private:
+    void _detect();
+
+    bool _nextBinary(ByteSpan &frame);
+
+    bool _nextLegacy(ByteSpan &frame);
+
+    void _compact(size_t required);
+};
+
+}    // namespace helloworld
+
+#endif    // HELLOWORLD_SHARED_FRAMING_H_
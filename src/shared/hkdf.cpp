@@ -2,43 +2,72 @@
 // Created by ivan on 30.3.19.
 //
 #include "hkdf.h"
-#include <cmath>
+#include <array>
+#include <cstring>
+#include "mbedtls/md.h"
+#include "mbedtls/platform_util.h"
 #include "utils.h"
 
 using namespace helloworld;
 
-zero::str_t hkdf::_extract(const zero::str_t &IKM,
-                           const zero::str_t &salt) const {
-    _hash->setKey(salt);
-    return to_hex(_hash->generate(from_hex(IKM)));
+void hkdf::_extract(ByteSpan IKM, unsigned char *PRK) const {
+    _hash->setKey(ByteSpan(_salt));
+    _hash->generate(IKM, PRK);
 }
 
-zero::str_t hkdf::_expand(const zero::str_t &PRK, const zero::str_t &info,
-                          size_t len) const {
-    auto N = static_cast<size_t>(
-        ceil(static_cast<double>(len) / _hash->hmacLength()));
-    _hash->setKey(PRK);
-    zero::bytes_t T;
+void hkdf::_expand(ByteSpan PRK, MutableByteSpan output) const {
+    size_t length = _hash->hmacLength();
+    if (output.size > 255 * length) throw Error("HKDF: output too long.");
 
-    zero::bytes_t prevT;
-    for (size_t i = 0u; i < N; i++) {
-        std::copy(info.begin(), info.end(), std::back_inserter(prevT));
-        prevT.push_back(static_cast<unsigned char &&>(i + 1));
-        prevT = _hash->generate(prevT);
+    _hash->setKey(PRK);
+    ByteSpan info(reinterpret_cast<const unsigned char *>(_info.data()),
+                  _info.size());
+    std::array<unsigned char, MBEDTLS_MD_MAX_SIZE> last;
 
-        std::copy(prevT.begin(), prevT.end(), std::back_inserter(T));
+    // T(i) = HMAC(PRK, T(i - 1) || info || i), written straight to output,
+    // only the last incomplete block goes through a buffer
+    ByteSpan previous;
+    for (size_t offset = 0, i = 1; offset < output.size;
+         offset += length, i++) {
+        auto counter = static_cast<unsigned char>(i);
+        unsigned char *block = output.size - offset >= length
+                                   ? output.data + offset
+                                   : last.data();
+        _hash->generate({previous, info, ByteSpan(&counter, 1)}, block);
+        if (block == last.data()) {
+            std::memcpy(output.data + offset, block, output.size - offset);
+        }
+        previous = ByteSpan(block, length);
     }
-    return to_hex(T).substr(0, len * 2);
+    mbedtls_platform_zeroize(last.data(), last.size());
 }
 
 hkdf::hkdf(std::unique_ptr<hmac> &&hash, zero::str_t info)
     : _hash(std::move(hash)),
+      // RFC 5869 default salt: hash length of zero bytes
       _salt(_hash->hmacLength(), 0),
-      _info(std::move(info)) {}
+      _info(std::move(info)) {
+    if (_hash->hmacLength() > MBEDTLS_MD_MAX_SIZE)
+        throw Error("HKDF: unsupported hmac length.");
+}
 
-void hkdf::setSalt(const zero::str_t &newSalt) { _salt = newSalt; }
+void hkdf::setSalt(const zero::str_t &newSalt) { _salt = from_hex(newSalt); }
+
+void hkdf::setSalt(ByteSpan newSalt) {
+    _salt.assign(newSalt.begin(), newSalt.end());
+}
 
 zero::str_t hkdf::generate(const zero::str_t &InputKeyingMaterial,
                            size_t outputLength) const {
-    return _expand(_extract(InputKeyingMaterial, _salt), _info, outputLength);
+    zero::bytes_t output(outputLength);
+    generate(ByteSpan(from_hex(InputKeyingMaterial)), output);
+    return to_hex(output);
+}
+
+void hkdf::generate(ByteSpan InputKeyingMaterial,
+                    MutableByteSpan output) const {
+    std::array<unsigned char, MBEDTLS_MD_MAX_SIZE> PRK;
+    _extract(InputKeyingMaterial, PRK.data());
+    _expand(ByteSpan(PRK.data(), _hash->hmacLength()), output);
+    mbedtls_platform_zeroize(PRK.data(), PRK.size());
 }
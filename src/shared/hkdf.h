@@ -19,28 +19,24 @@ namespace helloworld {
 
 class hkdf {
     std::unique_ptr<hmac> _hash;
-    zero::str_t _salt;
+    zero::bytes_t _salt;
     const zero::str_t _info;
 
     /**
      * extracts pseudo random key from input keying material and salt
      * (based on RFC5869)
-     * @param IKM Input Keying material (hex representation)
-     * @param salt
-     * @return
+     * @param IKM Input Keying material
+     * @param PRK output buffer of hmacLength() bytes
      */
-    zero::str_t _extract(const zero::str_t &IKM, const zero::str_t &salt) const;
+    void _extract(ByteSpan IKM, unsigned char *PRK) const;
 
     /**
-     * expands pseudo random key into output keying material with length len
-     * (based on RFC5869)
+     * expands pseudo random key into output keying material filling output
+     * (based on RFC5869), info is the application specific information
      * @param PRK pseudo random key
-     * @param info application specific inforamtion
-     * @param len output length
-     * @return hex representation of keying material
+     * @param output keying material
      */
-    zero::str_t _expand(const zero::str_t &PRK, const zero::str_t &info,
-                        size_t len) const;
+    void _expand(ByteSpan PRK, MutableByteSpan output) const;
 
    public:
     /**
@@ -59,6 +55,12 @@ class hkdf {
      */
     void setSalt(const zero::str_t &newSalt);
 
+    /**
+     * salt setter
+     * @param newSalt new salt bytes
+     */
+    void setSalt(ByteSpan newSalt);
+
     /**
      * generates keying material from input keying material
      * @param IKM input keying material, from which keying material will be
@@ -67,6 +69,15 @@ class hkdf {
      * @return hex representation of output keying material
      */
     zero::str_t generate(const zero::str_t &IKM, size_t outputLength) const;
+
+    /**
+     * generates keying material from input keying material
+     * @param IKM input keying material, from which keying material will be
+     * generated
+     * @param output buffer filled with output keying material,
+     *        at most 255 * hmacLength() bytes
+     */
+    void generate(ByteSpan IKM, MutableByteSpan output) const;
 };
 
 }    // namespace helloworld
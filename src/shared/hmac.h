@@ -12,6 +12,8 @@
 #ifndef HELLOWORLD_HMAC_H
 #define HELLOWORLD_HMAC_H
 
+#include <initializer_list>
+#include "byte_span.h"
 #include "key.h"
 
 namespace helloworld {
@@ -20,14 +22,41 @@ class hmac {
    public:
     virtual size_t hmacLength() const = 0;
 
+    /**
+     * @param newKey hex representation of the key
+     */
     virtual void setKey(const zero::str_t &newKey) = 0;
 
-    virtual void setKey(const zero::bytes_t &newKey) = 0;
+    /**
+     * @param newKey raw key bytes
+     */
+    virtual void setKey(ByteSpan newKey) = 0;
 
-    virtual std::vector<unsigned char> generate(
-        const std::vector<unsigned char> &message) const = 0;
+    /**
+     * @brief generates HMAC of the concatenated message parts
+     *
+     * @param parts message parts, processed in order
+     * @param output buffer of hmacLength() bytes
+     */
+    virtual void generate(std::initializer_list<ByteSpan> parts,
+                          unsigned char *output) const = 0;
 
-    virtual zero::bytes_t generate(const zero::bytes_t &message) const = 0;
+    void generate(ByteSpan message, unsigned char *output) const {
+        generate({message}, output);
+    }
+
+    std::vector<unsigned char> generate(
+        const std::vector<unsigned char> &message) const {
+        std::vector<unsigned char> output(hmacLength());
+        generate(ByteSpan(message), output.data());
+        return output;
+    }
+
+    zero::bytes_t generate(const zero::bytes_t &message) const {
+        zero::bytes_t output(hmacLength());
+        generate(ByteSpan(message), output.data());
+        return output;
+    }
 
     virtual ~hmac() = default;
 };
@@ -12,6 +12,7 @@
 #ifndef HELLOWORLD_HMAC_BASE_H
 #define HELLOWORLD_HMAC_BASE_H
 
+#include <memory>
 #include <vector>
 #include "hmac.h"
 #include "mbedtls/md.h"
@@ -22,20 +23,43 @@ namespace helloworld {
 
 template <mbedtls_md_type_t Hash = MBEDTLS_MD_SHA512, size_t Size = 64>
 class hmac_base : public hmac {
-    zero::bytes_t key_;
+    struct ContextFree {
+        void operator()(mbedtls_md_context_t *ctx) const {
+            mbedtls_md_free(ctx);
+            delete ctx;
+        }
+    };
+
+    // set up once, keyed by setKey(); every generate() only resets it
+    // to the already processed key instead of setting up a new context
+    std::unique_ptr<mbedtls_md_context_t, ContextFree> _ctx;
+    // the context was keyed and not used yet, reset not needed
+    mutable bool _ready = false;
 
    public:
     static constexpr mbedtls_md_type_t hmac_type = Hash;
     static constexpr size_t hmac_size = Size;
 
-    hmac_base() = default;
+    hmac_base() : hmac_base(zero::bytes_t{}) {}
 
-    explicit hmac_base(zero::bytes_t key) : key_(std::move(key)) {}
+    explicit hmac_base(const zero::bytes_t &key)
+        : _ctx(new mbedtls_md_context_t) {
+        mbedtls_md_init(_ctx.get());
+        if (mbedtls_md_setup(_ctx.get(), mbedtls_md_info_from_type(hmac_type),
+                             1) != 0) {
+            throw Error("Failed to start hmac");
+        }
+        setKey(ByteSpan(key));
+    }
 
-    hmac_base(const hmac &) = delete;
-    hmac_base &operator=(const hmac &) = delete;
+    hmac_base(const hmac_base &) = delete;
+    hmac_base &operator=(const hmac_base &) = delete;
+    hmac_base(hmac_base &&) noexcept = default;
+    hmac_base &operator=(hmac_base &&) noexcept = default;
     ~hmac_base() override = default;
 
+    using hmac::generate;
+
     /**
      * hmac length getter
      * @return hmac results length
@@ -47,70 +71,42 @@ class hmac_base : public hmac {
      *
      *  @param newKey key, which will be set as new authentication key
      */
-    void setKey(const zero::str_t &newKey) override { key_ = from_hex(newKey); }
+    void setKey(const zero::str_t &newKey) override {
+        setKey(ByteSpan(from_hex(newKey)));
+    }
 
     /**
      *  @brief set key used to generate hmac
      *
      *  @param newKey key, which will be set as new authentication key
      */
-    void setKey(const zero::bytes_t &newKey) override { key_ = newKey; }
+    void setKey(ByteSpan newKey) override {
+        _ready = false;
+        if (mbedtls_md_hmac_starts(_ctx.get(), newKey.data, newKey.size) != 0)
+            throw Error("Failed to start hmac");
+        _ready = true;
+    }
 
     /**
-     * @brief generates HMAC for a message
+     * @brief generates HMAC of the concatenated message parts
      *
-     * @param message from which, hmac will be generated
-     * @return generated HMAC
+     * @param parts message parts, processed in order
+     * @param output buffer of hmac_size bytes
      */
-    std::vector<unsigned char> generate(
-        const std::vector<unsigned char> &message) const override {
-        std::vector<unsigned char> output{};
-        output.resize(hmac_size);
-
-        mbedtls_md_context_t ctx;
-
-        mbedtls_md_init(&ctx);
-        if (mbedtls_md_setup(&ctx, mbedtls_md_info_from_type(hmac_type), 1) !=
-            0) {
-            throw Error("Failed to start hmac");
-        }
-
-        if (mbedtls_md_hmac_starts(&ctx, key_.data(), key_.size()) != 0)
+    void generate(std::initializer_list<ByteSpan> parts,
+                  unsigned char *output) const override {
+        if (!_ready && mbedtls_md_hmac_reset(_ctx.get()) != 0)
             throw Error("Failed to start hmac");
+        _ready = false;
 
-        if (mbedtls_md_hmac_update(&ctx, message.data(), message.size()) != 0) {
-            throw Error("Failed to update HMAC.");
+        for (const ByteSpan &part : parts) {
+            if (mbedtls_md_hmac_update(_ctx.get(), part.data, part.size) != 0) {
+                throw Error("Failed to update HMAC.");
+            }
         }
 
-        mbedtls_md_hmac_finish(&ctx, output.data());
-        mbedtls_md_free(&ctx);
-
-        return output;
-    }
-
-    zero::bytes_t generate(const zero::bytes_t &message) const override {
-        zero::bytes_t output{};
-        output.resize(hmac_size);
-
-        mbedtls_md_context_t ctx;
-
-        mbedtls_md_init(&ctx);
-        if (mbedtls_md_setup(&ctx, mbedtls_md_info_from_type(hmac_type), 1) !=
-            0) {
-            throw Error("Failed to start hmac");
-        }
-
-        if (mbedtls_md_hmac_starts(&ctx, key_.data(), key_.size()) != 0)
-            throw Error("Failed to start hmac");
-
-        if (mbedtls_md_hmac_update(&ctx, message.data(), message.size()) != 0) {
-            throw Error("Failed to update HMAC.");
-        }
-
-        mbedtls_md_hmac_finish(&ctx, output.data());
-        mbedtls_md_free(&ctx);
-
-        return output;
+        if (mbedtls_md_hmac_finish(_ctx.get(), output) != 0)
+            throw Error("Failed to finish HMAC.");
     }
 };
 }    // namespace helloworld
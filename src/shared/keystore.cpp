@@ -0,0 +1,84 @@
+#include "keystore.h"
+
+#include <fstream>
+
+#include "aes_gcm.h"
+#include "hkdf.h"
+#include "random.h"
+#include "serializable_error.h"
+#include "utils.h"
+
+namespace helloworld {
+
+constexpr size_t OneTimeKeystore::KEY_LENGTH;
+
+namespace {
+
+// message is [iv][tag][encrypted keys]
+constexpr size_t OVERHEAD = AESGCM::iv_size + AESGCM::tag_size;
+
+void setPasswordKey(AESGCM &aes, const zero::str_t &pwd) {
+    // own info, the key differs from the one protecting the key files
+    hkdf kdf{std::make_unique<hmac_base<>>(), "HelloWorld one-time keystore"};
+    zero::bytes_t key(AESGCM::key_size);
+    kdf.generate({reinterpret_cast<const unsigned char *>(pwd.data()),
+                  pwd.size()},
+                 key);
+    aes.setRawKey(key);
+}
+
+}    // namespace
+
+void OneTimeKeystore::save(const std::string &filename,
+                           const zero::str_t &pwd,
+                           const std::vector<zero::bytes_t> &keys) {
+    zero::bytes_t plain;
+    plain.reserve(keys.size() * KEY_LENGTH);
+    for (const zero::bytes_t &key : keys) {
+        if (key.size() != KEY_LENGTH) throw Error("Invalid one-time key.");
+        plain.insert(plain.end(), key.begin(), key.end());
+    }
+
+    std::vector<unsigned char> sealed(OVERHEAD + plain.size());
+    // the key is the same for each save, the iv must not repeat
+    Random{}.get({sealed.data(), AESGCM::iv_size});
+    AESGCM aes;
+    setPasswordKey(aes, pwd);
+    aes.seal({sealed.data(), AESGCM::iv_size}, plain, {},
+             {sealed.data() + AESGCM::iv_size,
+              sealed.size() - AESGCM::iv_size});
+
+    std::ofstream out{filename,
+                      std::ios::out | std::ios::binary | std::ios::trunc};
+    if (!out) throw Error("cannot access keystore file: " + filename);
+    write_n(out, sealed);
+}
+
+bool OneTimeKeystore::load(const std::string &filename,
+                           const zero::str_t &pwd,
+                           std::vector<zero::bytes_t> &keys) {
+    std::ifstream in{filename, std::ios::in | std::ios::binary};
+    if (!in) return false;
+
+    std::vector<unsigned char> sealed(getSize(in));
+    read_n(in, sealed.data(), sealed.size());
+    if (sealed.size() < OVERHEAD ||
+        (sealed.size() - OVERHEAD) % KEY_LENGTH != 0)
+        throw Error("Invalid keystore file.");
+
+    zero::bytes_t plain(sealed.size() - OVERHEAD);
+    AESGCM aes;
+    setPasswordKey(aes, pwd);
+    aes.open({sealed.data(), AESGCM::iv_size},
+             {sealed.data() + AESGCM::iv_size,
+              sealed.size() - AESGCM::iv_size},
+             {}, plain);
+
+    keys.clear();
+    for (size_t offset = 0; offset < plain.size(); offset += KEY_LENGTH)
+        keys.emplace_back(plain.begin() + offset,
+                          plain.begin() + offset + KEY_LENGTH);
+    return true;
+}
+
+}    // namespace helloworld
@@ -0,0 +1,54 @@
+/**
+ * @file keystore.h
+ * @brief Password protected file holding the whole set of one-time private
+ *        keys, the key is derived from the password once per set instead of
+ *        once per key file
+ *
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef HELLOWORLD_SHARED_KEYSTORE_H_
+#define HELLOWORLD_SHARED_KEYSTORE_H_
+
+#include <string>
+#include <vector>
+
+#include "key.h"
+
+namespace helloworld {
+
+class OneTimeKeystore {
+   public:
+    // file is [iv][tag][encrypted keys], each key of KEY_LENGTH bytes
+    static constexpr size_t KEY_LENGTH = 32;
+
+    /**
+     * @brief Encrypt keys into the keystore file, replaces the file
+     *
+     * @param filename keystore file
+     * @param pwd password to derive the key from
+     * @param keys private keys, index is the key id
+     */
+    static void save(const std::string &filename, const zero::str_t &pwd,
+                     const std::vector<zero::bytes_t> &keys);
+
+    /**
+     * @brief Decrypt keys from the keystore file,
+     *        throws if the file is corrupted or the password is wrong
+     *
+     * @param filename keystore file
+     * @param pwd password to derive the key from
+     * @param keys private keys, index is the key id
+     * @return false if the file does not exist
+     */
+    static bool load(const std::string &filename, const zero::str_t &pwd,
+                     std::vector<zero::bytes_t> &keys);
+};
+
+}    // namespace helloworld
+
+#endif    // HELLOWORLD_SHARED_KEYSTORE_H_
@@ -45,6 +45,16 @@ std::vector<unsigned char> Random::get(size_t size) {
     return result;
 }
 
+void Random::get(MutableByteSpan out) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (_use_since_reseed >= RESEED_AFTER) _reseed();
+    if (mbedtls_ctr_drbg_random(&_ctr_drbg, out.data, out.size) != 0) {
+        throw Error("Could not generate random sequence.");
+    }
+
+    ++_use_since_reseed;
+}
+
 zero::bytes_t Random::getKey(size_t size) {
     std::unique_lock<std::mutex> lock(_mutex);
     zero::bytes_t key(size);
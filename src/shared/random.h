@@ -18,6 +18,7 @@
 #include "mbedtls/ctr_drbg.h"
 #include "mbedtls/entropy.h"
 
+#include "byte_span.h"
 #include "key.h"
 
 namespace helloworld {
@@ -48,6 +49,13 @@ class Random {
      */
     std::vector<unsigned char> get(size_t size);
 
+    /**
+     * Fills buffer with random data, e.g. iv written in place
+     *
+     * @param out buffer to fill
+     */
+    void get(MutableByteSpan out);
+
     /**
      * Generates vector into key type alias
      * @param size length of the key
@@ -3,99 +3,81 @@
 using namespace helloworld;
 
 
-bool MessageNumberGenerator::checkIncomming(const Request& data) {
+bool MessageNumberGenerator::checkIncomming(const Request::Header& header) {
     if (!_set) {
         _set = true;
-        _nIncomming = data.header.messageNumber;
+        _nIncomming = header.messageNumber;
         return true;
     }
-    if (data.header.messageNumber != _nIncomming + 1)
+    if (header.messageNumber != _nIncomming + 1)
         return false;
 
 
-    _unresolvedNumbers.insert(data.header.messageNumber);
+    _unresolvedNumbers.insert(header.messageNumber);
     ++_nIncomming;
     return true;
 }
 
-bool MessageNumberGenerator::checkIncomming(const Response& data) {
+bool MessageNumberGenerator::checkIncomming(const Response::Header& header) {
 
     // check whether it is response to request
-    auto it = _unresolvedNumbers.find(data.header.messageNumber);
+    auto it = _unresolvedNumbers.find(header.messageNumber);
     if (it != _unresolvedNumbers.end()) {
-        _unresolvedNumbers.erase(data.header.messageNumber);
+        _unresolvedNumbers.erase(header.messageNumber);
         return true;
     }
     if (!_set) {
         _set = true;
-        _nIncomming = data.header.messageNumber;
+        _nIncomming = header.messageNumber;
         return true;
     }
-    if (data.header.messageNumber != _nIncomming + 1)
+    if (header.messageNumber != _nIncomming + 1)
         return false;
 
-    _unresolvedNumbers.insert(data.header.messageNumber);
+    _unresolvedNumbers.insert(header.messageNumber);
     ++_nIncomming;
     return true;
 }
 
-void MessageNumberGenerator::setNumber(Request& r) {
-    r.header.messageNumber = ++_nOutgoing;
-    _unresolvedNumbers.insert(r.header.messageNumber);
+void MessageNumberGenerator::setNumber(Request::Header& header) {
+    header.messageNumber = ++_nOutgoing;
+    _unresolvedNumbers.insert(header.messageNumber);
 }
 
-void MessageNumberGenerator::setNumber(Response& r) {
+void MessageNumberGenerator::setNumber(Response::Header& header) {
     // check whether it is response to request
-    auto it = _unresolvedNumbers.find(r.header.messageNumber);
+    auto it = _unresolvedNumbers.find(header.messageNumber);
     if (it != _unresolvedNumbers.end()) {
-        _unresolvedNumbers.erase(r.header.messageNumber);
+        _unresolvedNumbers.erase(header.messageNumber);
         return;
     }
     // if it is unsolicitated
-    r.header.messageNumber = ++_nOutgoing;
+    header.messageNumber = ++_nOutgoing;
 }
 
-serialize::structure& Request::Header::serialize(serialize::structure& result) const {
+constexpr uint64_t Request::Header::fixed_serialized_size;
+constexpr uint64_t Response::Header::fixed_serialized_size;
 
-    serialize::serialize(static_cast<uint32_t >(type), result);
-    serialize::serialize(messageNumber, result);
-    serialize::serialize(userId, result);
-    serialize::serialize(fromId, result);
-    return result;
+void Request::Header::write(serialize::Writer& out) const {
+    out << static_cast<uint32_t>(type) << messageNumber << userId << fromId;
 }
 
-Request::Header Request::Header::deserialize(const serialize::structure &data, uint64_t& from) {
+Request::Header Request::Header::read(serialize::Reader& in) {
     Header ret;
-    uint32_t type =
-            serialize::deserialize<uint32_t >(data, from);
-    ret.type = static_cast<Type >(type);
-    ret.messageNumber =
-            serialize::deserialize<decltype(ret.messageNumber)>(data, from);
-    ret.userId =
-            serialize::deserialize<decltype(ret.userId)>(data, from);
-    ret.fromId =
-            serialize::deserialize<decltype(ret.userId)>(data, from);
+    uint32_t type;
+    in >> type >> ret.messageNumber >> ret.userId >> ret.fromId;
+    ret.type = static_cast<Type>(type);
     return ret;
 }
 
-Response::Header  Response::Header::deserialize(const serialize::structure &data, uint64_t& from) {
-    Header ret;
-    uint32_t type =
-            serialize::deserialize<uint32_t >(data, from);
-    ret.type = static_cast<Type >(type);
-    ret.messageNumber =
-            serialize::deserialize<decltype(ret.messageNumber)>(data, from);
-    ret.userId =
-            serialize::deserialize<decltype(ret.userId)>(data, from);
-    ret.fromId =
-            serialize::deserialize<decltype(ret.userId)>(data, from);
-    return ret;
+void Response::Header::write(serialize::Writer& out) const {
+    out << static_cast<uint32_t>(type) << messageNumber << userId << fromId;
 }
 
-serialize::structure& Response::Header::serialize(serialize::structure& result) const  {
-    serialize::serialize(static_cast<uint32_t >(type), result);
-    serialize::serialize(messageNumber, result);
-    serialize::serialize(userId, result);
-    serialize::serialize(fromId, result);
-    return result;
+Response::Header Response::Header::read(serialize::Reader& in) {
+    Header ret;
+    uint32_t type;
+    in >> type >> ret.messageNumber >> ret.userId >> ret.fromId;
+    ret.type = static_cast<Type>(type);
+    return ret;
 }
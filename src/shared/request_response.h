@@ -17,6 +17,7 @@
 #include <set>
 #include <type_traits>
 #include <vector>
+#include "byte_span.h"
 #include "random.h"
 #include "serializable.h"
 
@@ -51,19 +52,16 @@ struct Request {
         Header(Type type, uint32_t userId, uint32_t fromId)
             : type(type), userId(userId), fromId(fromId) {}
 
-        serialize::structure& serialize(
-            serialize::structure& result) const override;
-        serialize::structure serialize() const override {
-            serialize::structure result;
-            return serialize(result);
-        }
-
-        static Header deserialize(const serialize::structure& data,
-                                  uint64_t& from);
-        static Header deserialize(const std::vector<unsigned char>& data) {
-            uint64_t from = 0;
-            return deserialize(data, from);
-        };
+        // type, message number, user id and from id
+        static constexpr uint64_t fixed_serialized_size = 4 * sizeof(uint32_t);
+        // frame header of fixed layout, also on its own
+        static constexpr bool versioned = false;
+
+        uint64_t serialized_size() const { return fixed_serialized_size; }
+
+        void write(serialize::Writer& out) const override;
+
+        static Header read(serialize::Reader& in);
     };
 
     Header header;
@@ -86,7 +84,8 @@ struct Response {
         FAILED_TO_CLOSE_CONNECTION,
         CHALLENGE_RESPONSE_NEEDED,
         BUNDLE_UPDATE_NEEDED,
-        FAILED_TO_UPDATE_BUNDLE
+        FAILED_TO_UPDATE_BUNDLE,
+        RECEIVE_OLD_BATCH
     };
 
     struct Header : public Serializable<Response::Header> {
@@ -102,19 +101,16 @@ struct Response {
         Header(Type type, uint32_t userId, uint32_t fromId)
             : type(type), userId(userId), fromId(fromId) {}
 
-        serialize::structure& serialize(
-            serialize::structure& result) const override;
-        serialize::structure serialize() const override {
-            serialize::structure result;
-            return serialize(result);
-        }
-
-        static Header deserialize(const serialize::structure& data,
-                                  uint64_t& from);
-        static Header deserialize(const std::vector<unsigned char>& data) {
-            uint64_t from = 0;
-            return deserialize(data, from);
-        };
+        // type, message number, user id and from id
+        static constexpr uint64_t fixed_serialized_size = 4 * sizeof(uint32_t);
+        // frame header of fixed layout, also on its own
+        static constexpr bool versioned = false;
+
+        uint64_t serialized_size() const { return fixed_serialized_size; }
+
+        void write(serialize::Writer& out) const override;
+
+        static Header read(serialize::Reader& in);
     };
 
     Header header;
@@ -135,6 +131,44 @@ struct Response {
         : header(type, userId), payload(std::move(payload)) {}
 };
 
+/**
+ * Request borrowing its payload (e.g. from the decrypted frame) for read-only
+ * consumers, the payload memory must outlive the view
+ */
+struct RequestView {
+    Request::Header header;
+    ByteSpan payload;
+
+    RequestView() = default;
+    RequestView(Request::Header header, ByteSpan payload)
+        : header(std::move(header)), payload(payload) {}
+    RequestView(const Request& request)
+        : header(request.header), payload(request.payload) {}
+
+    /**
+     * @return request owning copy of the payload, when it must outlive
+     *         the viewed memory
+     */
+    Request toOwned() const { return {header, payload.toVector()}; }
+};
+
+/**
+ * Response borrowing its payload (e.g. forwarded from a request),
+ * the payload memory must outlive the view
+ */
+struct ResponseView {
+    Response::Header header;
+    ByteSpan payload;
+
+    ResponseView() = default;
+    ResponseView(Response::Header header, ByteSpan payload)
+        : header(std::move(header)), payload(payload) {}
+    ResponseView(const Response& response)
+        : header(response.header), payload(response.payload) {}
+
+    Response toOwned() const { return {header, payload.toVector()}; }
+};
+
 class MessageNumberGenerator {
     bool _set{false};
     std::set<uint32_t> _unresolvedNumbers;
@@ -146,13 +180,25 @@ class MessageNumberGenerator {
         : _nOutgoing(
               static_cast<uint32_t>(Random{}.getBounded(0, UINT32_MAX))) {}
 
-    bool checkIncomming(const Request& data);
+    bool checkIncomming(const Request::Header& header);
+
+    bool checkIncomming(const Response::Header& header);
+
+    bool checkIncomming(const Request& data) {
+        return checkIncomming(data.header);
+    }
+
+    bool checkIncomming(const Response& data) {
+        return checkIncomming(data.header);
+    }
+
+    void setNumber(Request::Header& header);
 
-    bool checkIncomming(const Response& data);
+    void setNumber(Response::Header& header);
 
-    void setNumber(Request& r);
+    void setNumber(Request& r) { setNumber(r.header); }
 
-    void setNumber(Response& r);
+    void setNumber(Response& r) { setNumber(r.header); }
 };
 
 }    // namespace helloworld
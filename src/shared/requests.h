@@ -33,43 +33,37 @@ struct KeyBundle : Serializable<KeyBundle<Asymmetric>> {
     zero::bytes_t preKey;
     signiture_t preKeySingiture;
     std::vector<zero::bytes_t> oneTimeKeys;
+    // id of the first one-time key, the keys are numbered from it; bundle
+    // sent to a sender holds just the key claimed for him
+    uint32_t firstOneTimeKeyId = 0;
 
     void generateTimeStamp() { timestamp = getTimestampOf(nullptr); }
 
-    serialize::structure& serialize(
-        serialize::structure& result) const override {
-        serialize::serialize(timestamp, result);
-        serialize::serialize(identityKey, result);
-        serialize::serialize(preKey, result);
-        serialize::serialize(preKeySingiture, result);
-        serialize::serialize(oneTimeKeys, result);
-        return result;
+    void write(serialize::Writer& out) const override {
+        out << timestamp << identityKey << preKey << preKeySingiture
+            << oneTimeKeys;
+        if (out.version() != serialize::LEGACY_VERSION)
+            out.length(firstOneTimeKeyId);
     }
-    serialize::structure serialize() const override {
-        serialize::structure result;
-        return serialize(result);
+
+    uint64_t serialized_size() const {
+        return serialize::serialized_size(timestamp) +
+               serialize::serialized_size(identityKey) +
+               serialize::serialized_size(preKey) +
+               serialize::serialized_size(preKeySingiture) +
+               serialize::serialized_size(oneTimeKeys) +
+               serialize::varint_size(firstOneTimeKeyId);
     }
 
-    static KeyBundle deserialize(const serialize::structure& data,
-                                 uint64_t& from) {
+    static KeyBundle read(serialize::Reader& in) {
         KeyBundle result;
-        result.timestamp =
-            serialize::deserialize<decltype(result.timestamp)>(data, from);
-        result.identityKey =
-            serialize::deserialize<decltype(result.identityKey)>(data, from);
-        result.preKey =
-            serialize::deserialize<decltype(result.preKey)>(data, from);
-        result.preKeySingiture =
-            serialize::deserialize<decltype(result.preKeySingiture)>(data,
-                                                                     from);
-        result.oneTimeKeys =
-            serialize::deserialize<decltype(result.oneTimeKeys)>(data, from);
+        in >> result.timestamp >> result.identityKey >> result.preKey
+           >> result.preKeySingiture >> result.oneTimeKeys;
+        // bundles stored before the key id was added end here
+        if (in.version() != serialize::LEGACY_VERSION && in.remaining() > 0)
+            result.firstOneTimeKeyId = static_cast<uint32_t>(in.length());
         return result;
     }
-    static KeyBundle deserialize(const serialize::structure& data) {
-        uint64_t from = 0;
-        return deserialize(data, from);
-    }
 };
 
 struct AuthenticateRequest : public Serializable<AuthenticateRequest> {
@@ -83,32 +77,15 @@ struct AuthenticateRequest : public Serializable<AuthenticateRequest> {
     AuthenticateRequest(std::string name, zero::bytes_t publicKey)
         : name(std::move(name)), publicKey(std::move(publicKey)) {}
 
-    serialize::structure& serialize(
-        serialize::structure& result) const override {
-        serialize::serialize(name, result);
-        serialize::serialize(sessionKey, result);
-        serialize::serialize(publicKey, result);
-        return result;
-    }
-    serialize::structure serialize() const override {
-        serialize::structure result;
-        return serialize(result);
+    void write(serialize::Writer& out) const override {
+        out << name << sessionKey << publicKey;
     }
 
-    static AuthenticateRequest deserialize(const serialize::structure& data,
-                                           uint64_t& from) {
+    static AuthenticateRequest read(serialize::Reader& in) {
         AuthenticateRequest result;
-        result.name = serialize::deserialize<decltype(result.name)>(data, from);
-        result.sessionKey =
-            serialize::deserialize<decltype(result.sessionKey)>(data, from);
-        result.publicKey =
-            serialize::deserialize<decltype(result.publicKey)>(data, from);
+        in >> result.name >> result.sessionKey >> result.publicKey;
         return result;
     }
-    static AuthenticateRequest deserialize(const serialize::structure& data) {
-        uint64_t from = 0;
-        return deserialize(data, from);
-    }
 };
 
 /**
@@ -123,89 +100,77 @@ struct CompleteAuthRequest : public Serializable<CompleteAuthRequest> {
     CompleteAuthRequest(std::vector<unsigned char> secret, std::string name)
         : secret(std::move(secret)), name(std::move(name)) {}
 
-    serialize::structure& serialize(
-        serialize::structure& result) const override {
-        serialize::serialize(secret, result);
-        serialize::serialize(name, result);
-
-        return result;
-    }
-    serialize::structure serialize() const override {
-        serialize::structure result;
-        return serialize(result);
-    }
+    void write(serialize::Writer& out) const override { out << secret << name; }
 
-    static CompleteAuthRequest deserialize(const serialize::structure& data,
-                                           uint64_t& from) {
+    static CompleteAuthRequest read(serialize::Reader& in) {
         CompleteAuthRequest result;
-        result.secret =
-            serialize::deserialize<std::vector<unsigned char>>(data, from);
-        result.name = serialize::deserialize<std::string>(data, from);
+        in >> result.secret >> result.name;
         return result;
     }
-
-    static CompleteAuthRequest deserialize(const serialize::structure& data) {
-        uint64_t from = 0;
-        return deserialize(data, from);
-    }
 };
 
-struct GenericRequest : public Serializable<AuthenticateRequest> {
+struct GenericRequest : public Serializable<GenericRequest> {
     uint32_t id = 0;
 
     GenericRequest() = default;
 
     explicit GenericRequest(uint32_t id) : id(id) {}
 
-    serialize::structure& serialize(
-        serialize::structure& result) const override {
-        serialize::serialize(id, result);
-        return result;
-    }
-    serialize::structure serialize() const override {
-        serialize::structure result;
-        return serialize(result);
-    }
+    void write(serialize::Writer& out) const override { out << id; }
 
-    static GenericRequest deserialize(const serialize::structure& data,
-                                      uint64_t& from) {
+    static GenericRequest read(serialize::Reader& in) {
         GenericRequest result;
-        result.id = serialize::deserialize<uint32_t>(data, from);
+        in >> result.id;
         return result;
     }
-
-    static GenericRequest deserialize(const serialize::structure& data) {
-        uint64_t from = 0;
-        return deserialize(data, from);
-    }
 };
 
 struct GetUsers : public Serializable<GetUsers> {
     std::string query;
+    // page of users with id smaller than beforeId, 0 for the first page
+    uint32_t beforeId = 0;
+    // maximum of users in the reply, 0 leaves it to the server
+    uint32_t limit = 0;
 
     GetUsers() = default;
 
-    explicit GetUsers(std::string query) : query(std::move(query)) {}
+    explicit GetUsers(std::string query, uint32_t beforeId = 0,
+                      uint32_t limit = 0)
+        : query(std::move(query)), beforeId(beforeId), limit(limit) {}
 
-    serialize::structure& serialize(
-        serialize::structure& result) const override {
-        serialize::serialize(query, result);
-        return result;
-    }
-    serialize::structure serialize() const override {
-        serialize::structure result;
-        return serialize(result);
+    void write(serialize::Writer& out) const override {
+        out << query << beforeId << limit;
     }
 
-    static GetUsers deserialize(const serialize::structure& data,
-                                uint64_t& from) {
+    static GetUsers read(serialize::Reader& in) {
         GetUsers result;
-        result.query = serialize::deserialize<std::string>(data, from);
+        in >> result.query >> result.beforeId >> result.limit;
         return result;
     }
-    static GetUsers deserialize(const serialize::structure& data) {
-        uint64_t from = 0;
-        return deserialize(data, from);
+};
+
+struct GetOnline : public Serializable<GetOnline> {
+    // presence version of the list the client has, 0 for the full list
+    uint64_t since = 0;
+    // page of users with name greater than after, empty for the first page
+    std::string after;
+    // maximum of users in the reply, 0 for all of them
+    uint32_t limit = 0;
+
+    GetOnline() = default;
+
+    explicit GetOnline(uint64_t since, std::string after = "",
+                       uint32_t limit = 0)
+        : since(since), after(std::move(after)), limit(limit) {}
+
+    void write(serialize::Writer& out) const override {
+        out << since << after << limit;
+    }
+
+    static GetOnline read(serialize::Reader& in) {
+        GetOnline result;
+        in >> result.since >> result.after >> result.limit;
+        return result;
     }
 };
 
@@ -226,37 +191,24 @@ struct SendData : public Serializable<SendData> {
           x3dh(x3dh),
           data(std::move(data)) {}
 
-    serialize::structure& serialize(
-        serialize::structure& result) const override {
-        serialize::serialize(date, result);
-        serialize::serialize(from, result);
-        serialize::serialize(fromId, result);
-        serialize::serialize(x3dh, result);
-        serialize::serialize(data, result);
-        return result;
+    void write(serialize::Writer& out) const override {
+        out << date << from << fromId << x3dh << data;
     }
-    serialize::structure serialize() const override {
-        serialize::structure result;
-        return serialize(result);
+
+    uint64_t serialized_size() const {
+        return serialize::serialized_size(date) +
+               serialize::serialized_size(from) +
+               serialize::serialized_size(fromId) +
+               serialize::serialized_size(x3dh) +
+               serialize::serialized_size(data);
     }
 
-    static SendData deserialize(const serialize::structure& data,
-                                uint64_t& from) {
+    static SendData read(serialize::Reader& in) {
         SendData result;
-        result.date = serialize::deserialize<std::string>(data, from);
-        result.from = serialize::deserialize<std::string>(data, from);
-        result.fromId =
-            serialize::deserialize<decltype(result.fromId)>(data, from);
-        result.x3dh = serialize::deserialize<decltype(result.x3dh)>(data, from);
-        result.data = serialize::deserialize<decltype(result.data)>(data, from);
-
+        in >> result.date >> result.from >> result.fromId >> result.x3dh
+           >> result.data;
         return result;
     }
-
-    static SendData deserialize(const serialize::structure& data) {
-        uint64_t from = 0;
-        return deserialize(data, from);
-    }
 };
 
 template <typename Asymmetric>
@@ -274,43 +226,27 @@ struct X3DHRequest : public Serializable<X3DHRequest<Asymmetric>> {
 
     X3DHRequest() = default;
 
-    serialize::structure& serialize(
-        serialize::structure& result) const override {
-        serialize::serialize(timestamp, result);
-        serialize::serialize(senderIdPubKey, result);
-        serialize::serialize(senderEphermalPubKey, result);
-        serialize::serialize(opKeyUsed, result);
-        serialize::serialize(opKeyId, result);
-        serialize::serialize(AEADenrypted, result);
-        return result;
+    void write(serialize::Writer& out) const override {
+        out << timestamp << senderIdPubKey << senderEphermalPubKey << opKeyUsed
+            << opKeyId << AEADenrypted;
     }
-    serialize::structure serialize() const override {
-        serialize::structure result;
-        return serialize(result);
+
+    uint64_t serialized_size() const {
+        return serialize::serialized_size(timestamp) +
+               serialize::serialized_size(senderIdPubKey) +
+               serialize::serialized_size(senderEphermalPubKey) +
+               serialize::serialized_size(opKeyUsed) +
+               serialize::serialized_size(opKeyId) +
+               serialize::serialized_size(AEADenrypted);
     }
 
-    static X3DHRequest deserialize(const serialize::structure& data,
-                                   uint64_t& from) {
+    static X3DHRequest read(serialize::Reader& in) {
         X3DHRequest result;
-        result.timestamp =
-            serialize::deserialize<decltype(result.timestamp)>(data, from);
-        result.senderIdPubKey =
-            serialize::deserialize<decltype(result.senderIdPubKey)>(data, from);
-        result.senderEphermalPubKey =
-            serialize::deserialize<decltype(result.senderEphermalPubKey)>(data,
-                                                                          from);
-        result.opKeyUsed =
-            serialize::deserialize<decltype(result.opKeyUsed)>(data, from);
-        result.opKeyId =
-            serialize::deserialize<decltype(result.opKeyId)>(data, from);
-        result.AEADenrypted =
-            serialize::deserialize<decltype(result.AEADenrypted)>(data, from);
+        in >> result.timestamp >> result.senderIdPubKey
+           >> result.senderEphermalPubKey >> result.opKeyUsed >> result.opKeyId
+           >> result.AEADenrypted;
         return result;
     }
-    static X3DHRequest deserialize(const serialize::structure& data) {
-        uint64_t from = 0;
-        return deserialize(data, from);
-    }
 };
 
 }    // namespace helloworld
@@ -22,33 +22,52 @@ namespace helloworld {
 struct UserListReponse : public Serializable<UserListReponse> {
     std::vector<uint32_t> ids;
     std::vector<std::string> online;
+    // presence version the list reflects, 0 for search results
+    uint64_t version = 0;
+    // true if the list holds only changes, apply them to the previous list
+    bool delta = false;
+    // ids of users gone offline, used by delta only
+    std::vector<uint32_t> offline;
 
     UserListReponse() = default;
 
     UserListReponse(std::vector<std::string> users, std::vector<uint32_t> ids) :
             ids(std::move(ids)), online(std::move(users)) {}
 
-    serialize::structure& serialize(serialize::structure& result) const override {
-        serialize::serialize(ids, result);
-        serialize::serialize(online, result);
-        return result;
-    }
-    serialize::structure serialize() const override {
-        serialize::structure result;
-        return serialize(result);
+    void write(serialize::Writer& out) const override {
+        out << ids << online << version << delta << offline;
     }
 
-    static UserListReponse deserialize(const serialize::structure  &data, uint64_t& from) {
+    static UserListReponse read(serialize::Reader& in) {
         UserListReponse result;
-        result.ids =
-                serialize::deserialize<decltype(result.ids)>(data, from);
-        result.online =
-                serialize::deserialize<decltype(result.online)>(data, from);
+        in >> result.ids >> result.online >> result.version >> result.delta
+           >> result.offline;
         return result;
     }
-    static UserListReponse deserialize(const serialize::structure& data) {
-        uint64_t from = 0;
-        return deserialize(data, from);
+};
+
+/**
+ * Messages stored while the user was offline, each message is
+ * the payload a RECEIVE_OLD response would carry
+ */
+struct MessageBatch : public Serializable<MessageBatch> {
+    std::vector<std::vector<unsigned char>> messages;
+    // true if the server may hold more messages, ask again
+    bool more = false;
+
+    MessageBatch() = default;
+
+    MessageBatch(std::vector<std::vector<unsigned char>> messages, bool more) :
+            messages(std::move(messages)), more(more) {}
+
+    void write(serialize::Writer& out) const override {
+        out << messages << more;
+    }
+
+    static MessageBatch read(serialize::Reader& in) {
+        MessageBatch result;
+        in >> result.messages >> result.more;
+        return result;
     }
 };
 
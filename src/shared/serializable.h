@@ -13,17 +13,59 @@
 #define HELLOWORLD_SHARED_SERIALIZABLE_H_
 
 #include <vector>
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
+#include <string>
 #include <type_traits>
 #include <iostream>
 #include <cassert>
+#include <stdexcept>
+
+#include "byte_span.h"
 
 namespace helloworld {
     namespace serialize {
         using structure = std::vector<unsigned char>;
+
+        /**
+         * format of data written before versioning: fixed 8 byte lengths,
+         * no version on top-level objects
+         */
+        constexpr unsigned char LEGACY_VERSION = 0;
+
+        /**
+         * current format: LEB128 varint lengths
+         */
+        constexpr unsigned char VERSION = 1;
+
+        /**
+         * first byte of versioned top-level object, followed by the version
+         */
+        constexpr unsigned char VERSION_TAG = 0xfe;
+
+        /**
+         * number of bytes of length written as varint
+         * @param value length to write
+         * @return size of the varint in bytes
+         */
+        inline uint64_t varint_size(uint64_t value) {
+            uint64_t size = 1;
+            while (value >= 0x80) {
+                value >>= 7;
+                ++size;
+            }
+            return size;
+        }
     }
     namespace detail
     {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        constexpr bool HOST_LITTLE_ENDIAN = false;
+#else
+        constexpr bool HOST_LITTLE_ENDIAN = true;
+#endif
+
         template<typename T, typename = void>
         struct is_container : public std::false_type {};
 
@@ -43,20 +85,254 @@ namespace helloworld {
                 >
         > : public std::true_type {};
 
+        // borrowed bytes have their own overloads
+        template<>
+        struct is_container<ByteSpan> : public std::false_type {};
+
+        /**
+         * scalars written as little endian integers
+         */
+        template<typename T>
+        struct is_integer : public std::integral_constant<bool,
+                std::is_integral<T>::value || std::is_enum<T>::value> {};
+
+        /**
+         * containers storing integers in one memory block,
+         * (de)serialized with a single memcpy
+         */
+        template<typename T>
+        struct is_bulk : public std::false_type {};
+
+        template<typename T, typename Allocator>
+        struct is_bulk<std::vector<T, Allocator>>
+                : public std::integral_constant<bool,
+                        is_integer<T>::value && !std::is_same<T, bool>::value> {};
+
+        template<typename T, typename Traits, typename Allocator>
+        struct is_bulk<std::basic_string<T, Traits, Allocator>> : public std::true_type {};
+
+        /**
+         * objects written without version also on top level, e.g. frame
+         * headers of fixed layout, declare static constexpr bool versioned
+         * member set to false
+         */
+        template<typename T, typename = void>
+        struct is_versioned : public std::true_type {};
+
+        template<typename T>
+        struct is_versioned<T, typename std::enable_if<!T::versioned>::type>
+                : public std::false_type {};
+
+        template<typename T>
+        auto reserve(T &container, uint64_t size, int) -> decltype(container.reserve(size), void()) {
+            container.reserve(size);
+        }
+
+        template<typename T>
+        void reserve(T &, uint64_t, long) {}
+
+        // objects knowing their size reserve it before serialization
+        template<typename T>
+        auto reserve_serialized(const T &obj, serialize::structure &result, int)
+        -> decltype(obj.serialized_size(), void()) {
+            // version tag and version
+            result.reserve(result.size() + obj.serialized_size() + 2);
+        }
+
+        template<typename T>
+        void reserve_serialized(const T &, serialize::structure &, long) {}
+
     } // detail
 
+    namespace serialize {
+
+        /**
+         * Streaming writer of the serialized format, appends to the structure;
+         * integers are written as little endian, lengths of containers
+         * as varints (fixed 8 bytes in the legacy version)
+         */
+        class Writer {
+            structure &_out;
+            unsigned char _version;
+
+        public:
+            explicit Writer(structure &out, unsigned char version = VERSION)
+                    : _out(out), _version(version) {}
+
+            unsigned char version() const { return _version; }
+
+            /**
+             * writes raw bytes
+             * @param data bytes to write
+             * @param size number of bytes
+             */
+            void bytes(const void *data, uint64_t size) {
+                auto begin = static_cast<const unsigned char *>(data);
+                _out.insert(_out.end(), begin, begin + size);
+            }
+
+            /**
+             * writes lowest bytes of the value as little endian integer
+             * @param value value to write
+             * @param size number of bytes
+             */
+            void integer(uint64_t value, size_t size) {
+                unsigned char buffer[sizeof(uint64_t)];
+                if (detail::HOST_LITTLE_ENDIAN) {
+                    std::memcpy(buffer, &value, sizeof(value));
+                } else {
+                    for (size_t i = 0; i < size; ++i) {
+                        buffer[i] = static_cast<unsigned char>(value >> (8 * i));
+                    }
+                }
+                bytes(buffer, size);
+            }
+
+            /**
+             * writes length of container
+             * @param size number of elements
+             */
+            void length(uint64_t size) {
+                if (_version == LEGACY_VERSION) {
+                    integer(size, sizeof(uint64_t));
+                    return;
+                }
+                if (size < 0x80) {
+                    _out.push_back(static_cast<unsigned char>(size));
+                    return;
+                }
+                unsigned char buffer[10];
+                size_t used = 0;
+                while (size >= 0x80) {
+                    buffer[used++] = static_cast<unsigned char>(size | 0x80);
+                    size >>= 7;
+                }
+                buffer[used++] = static_cast<unsigned char>(size);
+                bytes(buffer, used);
+            }
+
+            template<typename T>
+            Writer &operator<<(const T &obj) {
+                write(*this, obj);
+                return *this;
+            }
+        };
+
+        /**
+         * Streaming reader of the serialized format, reads the version it is
+         * given; throws std::runtime_error on malformed or short data
+         */
+        class Reader {
+            ByteSpan _data;
+            uint64_t _from;
+            unsigned char _version;
+
+        public:
+            explicit Reader(ByteSpan data, uint64_t from = 0,
+                            unsigned char version = VERSION)
+                    : _data(data), _from(from), _version(version) {}
+
+            unsigned char version() const { return _version; }
+
+            /**
+             * @return offset of the next byte to read
+             */
+            uint64_t position() const { return _from; }
+
+            /**
+             * @return number of bytes left to read
+             */
+            uint64_t remaining() const {
+                return _from < _data.size ? _data.size - _from : 0;
+            }
+
+            /**
+             * reads raw bytes
+             * @param size number of bytes
+             * @return pointer to the bytes in the read data
+             */
+            const unsigned char *bytes(uint64_t size) {
+                if (size > remaining()) {
+                    throw std::runtime_error("serialized data too short");
+                }
+                const unsigned char *result = _data.data + _from;
+                _from += size;
+                return result;
+            }
+
+            /**
+             * reads little endian integer
+             * @param size number of bytes
+             * @return read value
+             */
+            uint64_t integer(size_t size) {
+                const unsigned char *data = bytes(size);
+                uint64_t value = 0;
+                if (detail::HOST_LITTLE_ENDIAN) {
+                    std::memcpy(&value, data, size);
+                } else {
+                    for (size_t i = 0; i < size; ++i) {
+                        value |= static_cast<uint64_t>(data[i]) << (8 * i);
+                    }
+                }
+                return value;
+            }
+
+            /**
+             * reads length of container
+             * @return number of elements
+             */
+            uint64_t length() {
+                if (_version == LEGACY_VERSION) {
+                    return integer(sizeof(uint64_t));
+                }
+                uint64_t value = 0;
+                for (unsigned shift = 0; shift < 64; shift += 7) {
+                    unsigned char byte = *bytes(1);
+                    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+                    if ((byte & 0x80) == 0) {
+                        // the tenth byte holds only the highest bit
+                        if (shift == 63 && byte > 1) break;
+                        return value;
+                    }
+                }
+                throw std::runtime_error("invalid serialized length");
+            }
+
+            template<typename T>
+            Reader &operator>>(T &obj) {
+                read(*this, obj);
+                return *this;
+            }
+        };
+
+        template<typename T>
+        T deserialize_versioned(ByteSpan data);
+    }
+
     /**
-     *  Interface for serializable objects
+     *  Interface for serializable objects, inheriting class implements
+     *  write() and static Obj read(serialize::Reader &in)
      * @tparam Obj inheritting class
      */
     template<typename Obj>
     struct Serializable {
         /**
-         * serializes object
+         * writes the object
+         * @param out writer to write the fields to
+         */
+        virtual void write(serialize::Writer& out) const = 0;
+
+        /**
+         * serializes object, without version as a part of another object
          * @param result where serialized object will be stored
          * @return reference to serialized object
          */
-        virtual serialize::structure& serialize(serialize::structure& result) const = 0;
+        serialize::structure& serialize(serialize::structure& result) const {
+            serialize::Writer out(result);
+            write(out);
+            return result;
+        }
 
         /**
          * deseriliazes object from byte vector
@@ -65,24 +341,34 @@ namespace helloworld {
          * @return deserialized objec
          */
         static Obj deserialize(const serialize::structure& data, uint64_t& from) {
-            return Obj::deserialize(data, from);
+            serialize::Reader in(data, from);
+            Obj result = Obj::read(in);
+            from = in.position();
+            return result;
         }
 
         /**
-         * seriliazes object to byte vector
-         * (mainly for backward compatibility)
+         * seriliazes object to byte vector prefixed with the format version
          * @return  serialized object
          */
-        virtual serialize::structure serialize() const = 0;
+        serialize::structure serialize() const {
+            serialize::structure result;
+            detail::reserve_serialized(static_cast<const Obj&>(*this), result, 0);
+            if (detail::is_versioned<Obj>::value) {
+                result.push_back(serialize::VERSION_TAG);
+                result.push_back(serialize::VERSION);
+            }
+            return serialize(result);
+        }
+
         /**
-         * deseriliazes object from byte vector
-         * (mainly for backward compatibility)
+         * deseriliazes object from byte vector written by serialize(),
+         * data written before versioning are read in the legacy format
          * @param data containing object
          * @return deserialized object
          */
         static Obj deserialize(const serialize::structure& data) {
-            uint64_t from = 0;
-            return Obj::deserialize(data, from);
+            return serialize::deserialize_versioned<Obj>(data);
         }
         virtual ~Serializable() = default;
     };
@@ -99,157 +385,317 @@ namespace helloworld {
         };
 
         /**
-         * serializes object, which inherits from Serializable
-         * @tparam T type of object to serialize
-         * @param obj object to serialize
-         * @param result structure to store serialized object
-         * @return reference to structure holding serialized object
+         * writes object, which inherits from Serializable
+         * @tparam T type of object to write
+         * @param out writer
+         * @param obj object to write
          */
         template<typename T>
-        auto serialize(const T &obj, serialize::structure &result)
-        -> typename std::enable_if<is_serializable<T>::value, serialize::structure>::type {
-            return obj.serialize(result);
+        auto write(Writer &out, const T &obj)
+        -> typename std::enable_if<is_serializable<T>::value>::type {
+            obj.write(out);
         }
 
         /**
-        * serializes object, which is a scalar type
-        * @tparam T type of object to serialize
-        * @param obj object to serialize
-        * @param result structure to store serialized object
-        * @return reference to structure holding serialized object
-        */
+         * writes object, which is integer, enum or bool
+         * @tparam T type of object to write
+         * @param out writer
+         * @param obj object to write
+         */
         template<typename T>
-        auto serialize(const T &obj, serialize::structure &result)
-        -> typename std::enable_if<std::is_scalar<T>::value, serialize::structure>::type {
-            union {
-                unsigned char bytes[sizeof(T)];
-                T value;
-            } helper;
-            helper.value = obj;
-            for (auto i : helper.bytes) {
-                result.push_back(i);
-            }
-            return result;
+        auto write(Writer &out, const T &obj)
+        -> typename std::enable_if<detail::is_integer<T>::value>::type {
+            out.integer(static_cast<uint64_t>(obj), sizeof(T));
         }
 
         /**
-        * serializes object, which is container
-        * @tparam T type of object to serialize
-        * @param obj object to serialize
-        * @param result structure to store serialized object
-        * @return reference to structure holding serialized object
-        */
+         * writes container of integers stored in one memory block,
+         * the same format as element by element serialization
+         * @tparam T type of object to write
+         * @param out writer
+         * @param obj object to write
+         */
         template<typename T>
-        auto serialize(const T &obj, serialize::structure &result)
-        -> typename std::enable_if<detail::is_container<T>::value, serialize::structure>::type {
-            uint64_t size = obj.size();
-            serialize<uint64_t>(size, result);
+        auto write(Writer &out, const T &obj)
+        -> typename std::enable_if<detail::is_bulk<T>::value>::type {
+            using value_type = typename T::value_type;
+            out.length(obj.size());
+            if (sizeof(value_type) == 1 || detail::HOST_LITTLE_ENDIAN) {
+                out.bytes(obj.data(), obj.size() * sizeof(value_type));
+                return;
+            }
+            for (const auto &i : obj) {
+                write(out, i);
+            }
+        }
 
+        /**
+         * writes object, which is container
+         * @tparam T type of object to write
+         * @param out writer
+         * @param obj object to write
+         */
+        template<typename T>
+        auto write(Writer &out, const T &obj)
+        -> typename std::enable_if<detail::is_container<T>::value && !detail::is_bulk<T>::value>::type {
+            out.length(obj.size());
             for (const auto &i : obj) {
-                serialize(i, result);
+                write(out, i);
             }
-            return result;
         }
 
         /**
-        * serializes object, which is pair
-        * @tparam T type of object to serialize
-        * @param obj object to serialize
-        * @param result structure to store serialized object
-        * @return reference to structure holding serialized object
-        */
+         * writes object, which is pair
+         * @param out writer
+         * @param obj object to write
+         */
         template<typename T, typename U>
-        auto serialize(const std::pair<T, U> &obj, serialize::structure &result) {
-            serialize(obj.first, result);
-            serialize(obj.second, result);
-            
-            return result;
+        void write(Writer &out, const std::pair<T, U> &obj) {
+            write(out, obj.first);
+            write(out, obj.second);
         }
 
         /**
-         * deserializes object, which is of scalar type
-         * @tparam T type of object to deserialize
-         * @param input structure holding serialized object
-         * @param from offset where object starts in the structure
-         * @return deserialized object
+         * writes borrowed bytes, the same format as std::vector<unsigned char>
+         * @param out writer
+         * @param obj bytes to write
+         */
+        inline void write(Writer &out, const ByteSpan &obj) {
+            out.length(obj.size);
+            out.bytes(obj.data, obj.size);
+        }
+
+        /**
+         * reads object, which inherits from serializable
+         * @tparam T type of object to read
+         * @param in reader
+         * @param obj object to read into
+         */
+        template<typename T>
+        auto read(Reader &in, T &obj)
+        -> typename std::enable_if<is_serializable<T>::value>::type {
+            obj = T::read(in);
+        }
+
+        /**
+         * reads object, which is integer, enum or bool
+         * @tparam T type of object to read
+         * @param in reader
+         * @param obj object to read into
          */
         template<typename T>
-        auto
-        deserialize(const serialize::structure &input, uint64_t &from)
-        -> typename std::enable_if<std::is_scalar<T>::value, T>::type {
-            union {
-                unsigned char bytes[sizeof(T)];
-                T value;
-            } helper;
-            if (input.size() < from + sizeof(T)) {
-                auto message = "serialized data too short (" + std::to_string(input.size()) + ")";
-                throw std::runtime_error(message);
+        auto read(Reader &in, T &obj)
+        -> typename std::enable_if<detail::is_integer<T>::value>::type {
+            obj = static_cast<T>(in.integer(sizeof(T)));
+        }
+
+        /**
+         * reads container of integers stored in one memory block
+         * @tparam T type of object to read
+         * @param in reader
+         * @param obj object to read into
+         */
+        template<typename T>
+        auto read(Reader &in, T &obj)
+        -> typename std::enable_if<detail::is_bulk<T>::value>::type {
+            using value_type = typename T::value_type;
+            uint64_t size = in.length();
+            if (size > in.remaining() / sizeof(value_type)) {
+                throw std::runtime_error("serialized data too short");
             }
-            for (auto i = from; from < i + sizeof(T); ++from) {
-                helper.bytes[from - i] = input[from];
+            if (sizeof(value_type) == 1) {
+                auto bytes = reinterpret_cast<const value_type *>(in.bytes(size));
+                obj.assign(bytes, bytes + size);
+            } else if (detail::HOST_LITTLE_ENDIAN) {
+                obj.assign(size, value_type{});
+                if (size > 0) {
+                    std::memcpy(&obj[0], in.bytes(size * sizeof(value_type)),
+                                size * sizeof(value_type));
+                }
+            } else {
+                obj.assign(size, value_type{});
+                for (auto &i : obj) {
+                    read(in, i);
+                }
+            }
+        }
+
+        /**
+         * reads object, which is container
+         * @tparam T type of object to read
+         * @param in reader
+         * @param obj object to read into
+         */
+        template<typename T, typename value_type = typename T::value_type>
+        auto read(Reader &in, T &obj)
+        -> typename std::enable_if<detail::is_container<T>::value && !detail::is_bulk<T>::value>::type {
+            uint64_t size = in.length();
+            obj.clear();
+            // each element takes at least one byte, size is not trusted
+            detail::reserve(obj, std::min<uint64_t>(size, in.remaining()), 0);
+            for (uint64_t i = 0; i < size; ++i) {
+                value_type tmp;
+                read(in, tmp);
+                obj.push_back(std::move(tmp));
             }
-            return helper.value;
         }
 
         /**
-         * deserializes object, which inherits from serializable
+         * reads object, which is pair
+         * @param in reader
+         * @param obj object to read into
+         */
+        template<typename T, typename U>
+        void read(Reader &in, std::pair<T, U> &obj) {
+            read(in, obj.first);
+            read(in, obj.second);
+        }
+
+        /**
+         * reads bytes serialized as std::vector<unsigned char> without
+         * copying them, for read-only consumers
+         * @param in reader
+         * @param obj set to view into the read data, valid while the data is
+         */
+        inline void read(Reader &in, ByteSpan &obj) {
+            uint64_t size = in.length();
+            obj = ByteSpan(in.bytes(size), size);
+        }
+
+        /**
+         * serializes object in the current format
+         * @tparam T type of object to serialize
+         * @param obj object to serialize
+         * @param result structure to store serialized object
+         * @return reference to structure holding serialized object
+         */
+        template<typename T>
+        structure &serialize(const T &obj, structure &result) {
+            Writer out(result);
+            out << obj;
+            return result;
+        }
+
+        /**
+         * deserializes object in the current format
          * @tparam T type of object to deserialize
          * @param input structure holding serialized object
          * @param from offset where object starts in the structure
          * @return deserialized object
          */
         template<typename T>
-        auto
-        deserialize(const serialize::structure &input, uint64_t &from)
-        -> typename std::enable_if<is_serializable<T>::value, T>::type {
-            return Serializable<T>::deserialize(input, from);
+        T deserialize(const structure &input, uint64_t &from) {
+            Reader in(input, from);
+            T result;
+            in >> result;
+            from = in.position();
+            return result;
         }
 
         /**
-         * deserializes object, which is container
+         * deserializes top-level object written by Serializable::serialize(),
+         * objects without the version prefix are read in the legacy format
          * @tparam T type of object to deserialize
-         * @param input structure holding serialized object
-         * @param from offset where object starts in the structure
+         * @param data serialized object
          * @return deserialized object
          */
-        template<typename T, typename value_type = typename T::value_type>
-        auto
-        deserialize(const serialize::structure &input, uint64_t &from)
-        -> typename std::enable_if<detail::is_container<T>::value, T>::type {
-            T result;
-            if (input.size() < sizeof(uint64_t)) {
-                throw std::runtime_error("serialized data too short");
+        template<typename T>
+        T deserialize_versioned(ByteSpan data) {
+            if (!detail::is_versioned<T>::value) {
+                Reader in(data);
+                return T::read(in);
             }
-            uint64_t size = deserialize<uint64_t>(input, from);
-            for (uint64_t i = 0; i < size; ++i) {
-                value_type tmp = deserialize<value_type>(input, from);
-                result.push_back(std::move(tmp));
+            if (data.size >= 2 && data.data[0] == VERSION_TAG && data.data[1] == VERSION) {
+                try {
+                    Reader in(data, 2);
+                    T result = T::read(in);
+                    // legacy data starting with the tag by chance are
+                    // not likely to be read whole
+                    if (in.remaining() == 0) {
+                        return result;
+                    }
+                } catch (std::exception &) {
+                }
             }
-            return result;
+            Reader in(data, 0, LEGACY_VERSION);
+            return T::read(in);
         }
 
         /**
-         * deserializes object, which is pair
-         * @param T type of object to deserialize
-         * @param input structure holding serialized object
-         * @param from offset where object starts in the structure
-         * @return deserialized object
+         * size of serialized object known at compile time, 0 if it
+         * depends on the value; objects with fixed size declare it
+         * as static constexpr fixed_serialized_size member
+         * @tparam T type of object
          */
+        template<typename T, typename = void>
+        struct fixed_size : std::integral_constant<uint64_t, 0> {};
+
         template<typename T>
-        auto
-        deserialize(const serialize::structure &input, uint64_t &from)
-        -> typename std::conditional<false, typename T::first, typename T::second>::type {
-            union {
-                unsigned char bytes[sizeof(T)];
-                T value;
-            } helper;
-            if (input.size() < from + sizeof(T)) {
-                throw std::runtime_error("serialized data too short");
+        struct fixed_size<T, typename std::enable_if<std::is_scalar<T>::value>::type>
+                : std::integral_constant<uint64_t, sizeof(T)> {};
+
+        template<typename T>
+        struct fixed_size<T, typename std::enable_if<(T::fixed_serialized_size > 0)>::type>
+                : std::integral_constant<uint64_t, T::fixed_serialized_size> {};
+
+        template<typename T>
+        constexpr auto serialized_size(const T &)
+        -> typename std::enable_if<std::is_scalar<T>::value, uint64_t>::type;
+
+        template<typename T>
+        auto serialized_size(const T &obj)
+        -> typename std::enable_if<is_serializable<T>::value, decltype(obj.serialized_size())>::type;
+
+        template<typename T>
+        auto serialized_size(const T &obj)
+        -> typename std::enable_if<detail::is_container<T>::value, uint64_t>::type;
+
+        template<typename T, typename U>
+        uint64_t serialized_size(const std::pair<T, U> &obj);
+
+        inline uint64_t serialized_size(const ByteSpan &obj);
+
+        /**
+         * number of bytes serialize() appends for the object in the current
+         * format, use to reserve the structure before serializing; objects
+         * inheriting from Serializable provide serialized_size() member
+         * @tparam T type of object
+         * @param obj object to be serialized
+         * @return size of serialized object in bytes
+         */
+        template<typename T>
+        constexpr auto serialized_size(const T &)
+        -> typename std::enable_if<std::is_scalar<T>::value, uint64_t>::type {
+            return sizeof(T);
+        }
+
+        template<typename T>
+        auto serialized_size(const T &obj)
+        -> typename std::enable_if<is_serializable<T>::value, decltype(obj.serialized_size())>::type {
+            return obj.serialized_size();
+        }
+
+        template<typename T>
+        auto serialized_size(const T &obj)
+        -> typename std::enable_if<detail::is_container<T>::value, uint64_t>::type {
+            using value_type = typename std::decay<decltype(*std::begin(obj))>::type;
+            uint64_t size = varint_size(obj.size());
+            if (fixed_size<value_type>::value > 0) {
+                return size + obj.size() * fixed_size<value_type>::value;
             }
-            for (auto i = from; from < i + sizeof(T); ++from) {
-                helper.bytes[from - i] = input[from];
+            for (const auto &i : obj) {
+                size += serialized_size(i);
             }
-            return helper.value;
+            return size;
+        }
+
+        template<typename T, typename U>
+        uint64_t serialized_size(const std::pair<T, U> &obj) {
+            return serialized_size(obj.first) + serialized_size(obj.second);
+        }
+
+        inline uint64_t serialized_size(const ByteSpan &obj) {
+            return varint_size(obj.size) + obj.size;
         }
 
     } // serialize
@@ -28,25 +28,13 @@ struct Error : public std::exception, public Serializable<Error> {
 
     const char *what() const noexcept override { return message.c_str(); }
 
-    serialize::structure& serialize(serialize::structure& result) const override {
-        serialize::serialize(message, result);
-        return result;
-    }
-    serialize::structure serialize() const override {
-        serialize::structure result;
-        return serialize(result);
-    }
+    void write(serialize::Writer& out) const override { out << message; }
 
-    static Error deserialize(const serialize::structure  &data, uint64_t& from) {
+    static Error read(serialize::Reader& in) {
         Error result;
-        result.message =
-                serialize::deserialize<decltype(result.message)>(data, from);
+        in >> result.message;
         return result;
     }
-    static Error deserialize(const serialize::structure& data) {
-        uint64_t from = 0;
-        return deserialize(data, from);
-    }
 };
 
 } // namespace helloworld
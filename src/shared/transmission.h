@@ -24,6 +24,7 @@
 #include <fstream>
 #include <queue>
 
+#include "byte_span.h"
 #include "utils.h"
 #include "serializable_error.h"
 
@@ -34,11 +35,11 @@ protected:
     /**
      * Function that can handle receive() output
      */
-    Callable<void, bool, const std::string &, std::stringstream &&> *callback;
+    Callable<void, bool, const std::string &, const ByteSpan &> *callback;
 
 public:
     explicit ServerTransmissionManager(Callable<void, bool,
-            const std::string &, std::stringstream &&> *callback) : callback(callback) {
+            const std::string &, const ByteSpan &> *callback) : callback(callback) {
         if (callback == nullptr)
             throw Error("Null not allowed.");
     };
@@ -61,7 +62,8 @@ public:
     /**
      * @brief Receive request / response depending on side
      *        in TCP, this method is waiting for any incoming request / reponse
-     *        uses callback to forward unsigned long, std::stringstream
+     *        uses callback to forward every complete message as a span,
+     *        valid only for the duration of the callback
      */
     virtual void receive() = 0;
 
@@ -84,6 +86,13 @@ public:
      */
     virtual bool removeConnection(const std::string &usrname) = 0;
 
+    /**
+     * Check whether user has opened connection, a connection still being
+     * registered counts, data sent to it are delivered once registered
+     * @param usrname user name as connection id
+     */
+    virtual bool exists(const std::string &usrname) = 0;
+
     /**
      * Get online user list
      */
@@ -35,37 +35,14 @@ struct UserData : public Serializable<UserData> {
           sessionKey(std::move(sessionKey)),
           publicKey(std::move(publicKey)) {}
 
-    serialize::structure &serialize(
-        serialize::structure &result) const override {
-        serialize::serialize(id, result);
-        serialize::serialize(name, result);
-        serialize::serialize(sessionKey, result);
-        serialize::serialize(publicKey, result);
-
-        return result;
-    }
-
-    serialize::structure serialize() const override {
-        serialize::structure result;
-        return serialize(result);
+    void write(serialize::Writer &out) const override {
+        out << id << name << sessionKey << publicKey;
     }
 
-    static UserData deserialize(const serialize::structure &data,
-                                uint64_t &from) {
-        UserData userData;
-        userData.id = serialize::deserialize<decltype(userData.id)>(data, from);
-        userData.name =
-            serialize::deserialize<decltype(userData.name)>(data, from);
-        userData.sessionKey =
-            serialize::deserialize<decltype(userData.sessionKey)>(data, from);
-        userData.publicKey =
-            serialize::deserialize<decltype(userData.publicKey)>(data, from);
-        return userData;
-    }
-
-    static UserData deserialize(const serialize::structure &data) {
-        uint64_t from = 0;
-        return deserialize(data, from);
+    static UserData read(serialize::Reader &in) {
+        UserData result;
+        in >> result.id >> result.name >> result.sessionKey >> result.publicKey;
+        return result;
     }
 };
 
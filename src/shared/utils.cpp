@@ -1,8 +1,8 @@
 #include <algorithm>
 #include <ctime>
-#include <iomanip>
 #include <sstream>
 
+#include "codec.h"
 #include "serializable_error.h"
 #include "utils.h"
 
@@ -77,31 +77,24 @@ std::string to_hex(const std::vector<unsigned char> &bytes) {
 }
 
 std::string to_hex(const unsigned char bytes[], size_t length) {
-    std::stringstream stream;
-    for (size_t i = 0; i < length; i++) {
-        stream << std::hex << std::setfill('0') << std::setw(2)
-               << static_cast<int>(bytes[i]);
-    }
-    return stream.str();
+    std::string result(codec::hexSize(length), '\0');
+    codec::toHex(bytes, length, &result[0]);
+    return result;
 }
 
 void from_hex(const std::string &input, unsigned char *output, size_t length) {
     if (input.size() != length * 2) {
         throw Error("Invalid conversion dimensions.");
     }
-    std::vector<unsigned char> vector = from_hex(input);
-    std::copy_n(vector.data(), length, output);
+    if (!codec::fromHex(input.data(), input.size(), output)) {
+        throw Error("Invalid hex string.");
+    }
 }
 
 std::vector<unsigned char> from_hex(const std::string &input) {
-    std::vector<unsigned char> vector;
-
-    size_t len = input.length();
-    for (size_t i = 0; i < len; i += 2) {
-        std::stringstream x{input.substr(i, 2)};
-        unsigned int c;
-        x >> std::hex >> c;
-        vector.push_back(static_cast<unsigned char &&>(c));
+    std::vector<unsigned char> vector(input.size() / 2);
+    if (!codec::fromHex(input.data(), input.size(), vector.data())) {
+        throw Error("Invalid hex string.");
     }
     return vector;
 }
@@ -18,7 +18,8 @@
 #include <cstdint>
 #include <iostream>
 
-#include "../../src/shared/base_64.h"
+#include "../../src/shared/framing.h"
+#include "../../src/shared/utils.h"
 
 namespace helloworld {
     namespace detail {
@@ -26,7 +27,7 @@ namespace helloworld {
             Q_OBJECT
                     QTcpSocket *_socket;
 
-            Base64 _base;
+            FrameCodec _codec;
         public:
             Connection(QTcpSocket *socket, QObject *parent = nullptr)
                     : QObject(parent), _socket(socket) {
@@ -39,8 +40,7 @@ namespace helloworld {
 
             void send(std::istream&& data)  {
                 std::stringstream out;
-                _base.fromStream(data, out);
-                out << '\0';
+                _codec.encode(data, out);
                 QByteArray qdata = QByteArray::fromStdString(out.str());
 
                 _socket->write(qdata);
@@ -57,7 +57,15 @@ namespace helloworld {
 
                     void read() {
                 QByteArray data = _socket->readAll();
-                emit messageRecieved(this, data.toStdString());
+                _codec.feed(data.data(), static_cast<size_t>(data.size()));
+                std::vector<unsigned char> handshake = _codec.handshake();
+                if (!handshake.empty())
+                    _socket->write(reinterpret_cast<const char *>(handshake.data()),
+                                   static_cast<qint64>(handshake.size()));
+                std::vector<unsigned char> frame;
+                while (_codec.next(frame)) {
+                    emit messageRecieved(this, to_string(frame));
+                }
                 //emit closing(this);
             };
 
@@ -90,7 +98,6 @@ namespace helloworld {
             std::function<void(Connection *, std::string)> messageCallback;
 
             std::unique_ptr<QTcpServer> _server;
-            Base64 _base;
         public:
             std::deque<std::string> recieved;
             MocServer(qint16 port = 5000, QHostAddress address = QHostAddress::Any)
@@ -125,14 +132,8 @@ namespace helloworld {
 
         public Q_SLOTS:
             void messageRecieved(Connection *src, std::string s) {
-            std::stringstream ss(s);
-            std::string line;
-            while(!std::getline(ss, line, '\0').eof()) {
-                std::stringstream in(line), out{};
-                _base.toStream(in, out);
-                recieved.push_back(std::move(out.str()));
-                messageCallback(src, out.str());
-            }
+                recieved.push_back(s);
+                messageCallback(src, std::move(s));
             };
 
             void onConnection() {
@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../../src/shared/codec.h"
+#include "mbedtls/base64.h"
+
+using namespace helloworld;
+
+// hex and base64 throughput of the previous implementations (stringstream
+// hex, mbedtls base64) against the codec kernels
+
+static constexpr size_t VOLUME = 64 * 1024 * 1024;
+// the previous hex code is orders of magnitude slower
+static constexpr size_t PREVIOUS_VOLUME = VOLUME / 64;
+
+template <typename Function>
+void measure(const char *name, const char *what, size_t size,
+             Function function, size_t volume = VOLUME) {
+    size_t rounds = std::max<size_t>(1, volume / size);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < rounds; i++) function();
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+    std::cout << std::setw(10) << name << std::setw(16) << what
+              << std::setw(10) << size << std::setw(12) << std::fixed
+              << std::setprecision(1)
+              << rounds * size / seconds / (1024 * 1024) << "\n";
+}
+
+const char *kernelName(codec::Kernel kernel) {
+    switch (kernel) {
+        case codec::Kernel::AVX2:
+            return "avx2";
+        case codec::Kernel::SSE2:
+            return "sse2";
+        default:
+            return "scalar";
+    }
+}
+
+int main() {
+    std::cout << "    kernel       operation     bytes   MB/s (of raw bytes)\n";
+    for (size_t size : {32, 1024, 64 * 1024}) {
+        std::vector<unsigned char> bytes(size);
+        for (size_t i = 0; i < size; i++)
+            bytes[i] = static_cast<unsigned char>(i * 131);
+        std::string hex(codec::hexSize(size), '\0');
+        std::string base64(codec::base64Size(size), '\0');
+        std::vector<unsigned char> decoded(size);
+        size_t written;
+
+        // previous implementations, only sizes they handle in reasonable time
+        if (size <= 1024) {
+            measure("previous", "hex encode", size, [&]() {
+                std::stringstream stream;
+                for (unsigned char byte : bytes) {
+                    stream << std::hex << std::setfill('0') << std::setw(2)
+                           << static_cast<int>(byte);
+                }
+                hex = stream.str();
+            }, PREVIOUS_VOLUME);
+            measure("previous", "hex decode", size, [&]() {
+                for (size_t i = 0; i < hex.size(); i += 2) {
+                    std::stringstream x{hex.substr(i, 2)};
+                    unsigned int c;
+                    x >> std::hex >> c;
+                    decoded[i / 2] = static_cast<unsigned char>(c);
+                }
+            }, PREVIOUS_VOLUME);
+        }
+        measure("previous", "base64 encode", size, [&]() {
+            mbedtls_base64_encode(reinterpret_cast<unsigned char *>(&base64[0]),
+                                  base64.size() + 1, &written, bytes.data(),
+                                  bytes.size());
+        });
+        measure("previous", "base64 decode", size, [&]() {
+            mbedtls_base64_decode(
+                decoded.data(), decoded.size(), &written,
+                reinterpret_cast<const unsigned char *>(base64.data()),
+                base64.size());
+        });
+
+        for (codec::Kernel kernel : {codec::Kernel::SCALAR, codec::Kernel::SSE2,
+                                     codec::Kernel::AVX2}) {
+            if (codec::use(kernel) != kernel) continue;
+            const char *name = kernelName(kernel);
+            measure(name, "hex encode", size,
+                    [&]() { codec::toHex(bytes.data(), size, &hex[0]); });
+            measure(name, "hex decode", size, [&]() {
+                codec::fromHex(hex.data(), hex.size(), decoded.data());
+            });
+            measure(name, "base64 encode", size, [&]() {
+                codec::toBase64(bytes.data(), size, &base64[0]);
+            });
+            measure(name, "base64 decode", size, [&]() {
+                codec::fromBase64(base64.data(), base64.size(), decoded.data(),
+                                  written);
+            });
+        }
+        codec::use(codec::detected());
+    }
+}
@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "../../src/shared/connection_manager.h"
+
+using namespace helloworld;
+
+// per message cost of the connection manager symmetric crypto: the previous
+// path (hex ivs, stream api, key set and header / payload sealed separately)
+// against single aead call with raw iv and key expanded once;
+// then aes-gcm encryption throughput of the stream, vector and buffer api
+
+static constexpr int MESSAGES = 20000;
+static const zero::str_t KEY = "73bed6b8e3c1743b7116e69e22229516";
+// bytes encrypted for each message size in the throughput test
+static constexpr size_t VOLUME = 64 * 1024 * 1024;
+
+void legacySeal(AESGCM &gcm, Random &random, std::ostream &out,
+                const std::vector<unsigned char> &head,
+                const std::vector<unsigned char> &body) {
+    for (const std::vector<unsigned char> *part : {&head, &body}) {
+        std::stringstream plain;
+        write_n(plain, *part);
+        std::string iv = to_hex(random.get(AESGCM::iv_size));
+        std::istringstream ivStream{iv};
+        if (!gcm.setKey(KEY) || !gcm.setIv(iv))
+            throw Error("Could not initialize GCM.");
+        write_n(out, iv);
+        gcm.encryptWithAd(plain, ivStream, out);
+    }
+}
+
+std::stringstream legacyPart(std::istream &in, size_t length) {
+    std::stringstream result;
+    std::vector<unsigned char> buff(length);
+    write_n(result, buff.data(), read_n(in, buff.data(), buff.size()));
+    return result;
+}
+
+void legacyOpen(AESGCM &gcm, std::istream &in, std::ostream &head,
+                std::ostream &body) {
+    for (std::ostream *out : {&head, &body}) {
+        std::stringstream iv = legacyPart(in, AESGCM::iv_size * 2);
+        std::stringstream part =
+            legacyPart(in, out == &head ? 32 : getSize(in));
+        if (!gcm.setKey(KEY) || !gcm.setIv(iv.str()))
+            throw Error("Could not initialize GCM.");
+        iv.seekg(0, std::ios::beg);
+        gcm.decryptWithAd(part, iv, *out);
+    }
+}
+
+void print(const char *name, size_t size,
+           std::chrono::steady_clock::time_point start) {
+    auto end = std::chrono::steady_clock::now();
+    double micros =
+        std::chrono::duration<double, std::micro>(end - start).count();
+    std::cout << std::setw(8) << name << std::setw(10) << size
+              << std::setw(16) << std::fixed << std::setprecision(2)
+              << micros / MESSAGES << "\n";
+}
+
+template <typename Encrypt>
+void throughput(const char *name, size_t size, Encrypt encrypt) {
+    size_t rounds = std::max<size_t>(1, VOLUME / size);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < rounds; i++) encrypt();
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+    std::cout << std::setw(8) << name << std::setw(10) << size
+              << std::setw(12) << std::fixed << std::setprecision(1)
+              << rounds * size / seconds / (1024 * 1024) << "\n";
+}
+
+void throughput() {
+    std::vector<unsigned char> iv(AESGCM::iv_size, 1);
+    std::vector<unsigned char> ad(32, 2);
+    AESGCM gcm;
+    gcm.setKey(KEY);
+    gcm.setIv(to_hex(iv));
+    AESGCM raw;
+    raw.setRawKey(from_hex(KEY));
+
+    std::cout << "\n     api   payload        MB/s\n";
+    for (size_t size = 64; size <= 1024 * 1024; size *= 4) {
+        std::vector<unsigned char> plain(size, 0x5a);
+        std::vector<unsigned char> out(AESGCM::tag_size + size);
+
+        throughput("stream", size, [&]() {
+            std::istringstream in{
+                std::string(plain.begin(), plain.end())};
+            std::istringstream adStream{std::string(ad.begin(), ad.end())};
+            std::ostringstream result;
+            gcm.encryptWithAd(in, adStream, result);
+        });
+        throughput("vector", size, [&]() {
+            std::vector<unsigned char> result;
+            gcm.encryptWithAd(plain, ad, result);
+        });
+        throughput("buffer", size, [&]() { raw.seal(iv, plain, ad, out); });
+    }
+}
+
+int main() {
+    ServerToClientManager server{KEY};
+    ClientToServerManager client{KEY, "server_pub.pem"};
+    client.switchSecureChannel(true);
+    client._testing = true;
+
+    AESGCM legacy;
+    Random random;
+
+    std::cout << "    path   payload  us/message (seal + open)\n";
+    for (size_t size : {64, 1024, 16 * 1024}) {
+        Response response{{Response::Type::RECEIVE, 1},
+                          std::vector<unsigned char>(size, 0x5a)};
+        std::vector<unsigned char> head = response.header.serialize();
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < MESSAGES; i++) {
+            std::stringstream sealed;
+            legacySeal(legacy, random, sealed, head, response.payload);
+            std::stringstream headOut;
+            std::stringstream bodyOut;
+            legacyOpen(legacy, sealed, headOut, bodyOut);
+        }
+        print("before", size, start);
+
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < MESSAGES; i++) {
+            client.parseIncoming(server.parseOutgoing(response));
+        }
+        print("after", size, start);
+    }
+
+    throughput();
+}
@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+
+#include "../../src/server/cached_database.h"
+#include "../../src/server/sqlite_database.h"
+
+using namespace helloworld;
+
+// per-query latency of the cached prepared statements used by ServerSQLite
+// compared to preparing and finalizing the same statement on every call,
+// and of the indexed user search compared to the LIKE '%query%' scan,
+// and of the users directory cache compared to the database lookup
+
+static constexpr int USERS = 1000;
+static constexpr int QUERIES = 20000;
+static constexpr int SEARCH_USERS = 1000000;
+static constexpr int SEARCH_QUERIES = 20;
+
+double measure(const std::function<void(int)> &query, int queries = QUERIES) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < queries; i++) query(i);
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count() /
+           queries;
+}
+
+// the query as it was run before: prepare, bind, step, finalize
+void uncached(sqlite3 *handler, const char *sql, int64_t id) {
+    sqlite3_stmt *statement = nullptr;
+    sqlite3_prepare_v2(handler, sql, -1, &statement, nullptr);
+    sqlite3_bind_int64(statement, 1, id);
+    sqlite3_step(statement);
+    sqlite3_finalize(statement);
+}
+
+void report(const std::string &name, double before, double after) {
+    std::cout << std::setw(22) << name << std::setw(14) << std::fixed
+              << std::setprecision(2) << before << std::setw(14) << after
+              << std::setw(10) << std::setprecision(1) << before / after
+              << "x\n";
+}
+
+void search() {
+    ServerSQLite db{};
+    for (int i = 1; i <= SEARCH_USERS; i++) {
+        db.insert({static_cast<uint32_t>(i), "user" + std::to_string(i), "",
+                   zero::bytes_t(32, 'k')},
+                  false);
+    }
+
+    // names of users created long ago, found at the end of the scan
+    auto name = [](int i) { return std::to_string(i % 1000 + 1000); };
+    report("search rare name",
+           measure([&db, &name](int i) { db.selectLike(name(i)); },
+                   SEARCH_QUERIES),
+           measure([&db, &name](int i) { db.searchUsers(name(i), 0, 50); },
+                   SEARCH_QUERIES));
+    report("search common name",
+           measure([&db](int) { db.selectLike("user1"); }, SEARCH_QUERIES),
+           measure([&db](int) { db.searchUsers("user1", 0, 50); },
+                   SEARCH_QUERIES));
+}
+
+int main() {
+    ServerSQLite db{};
+    sqlite3 *raw = nullptr;
+    sqlite3_open(nullptr, &raw);
+    sqlite3_exec(raw,
+                 "CREATE TABLE users (id INTEGER PRIMARY KEY AUTOINCREMENT, "
+                 "username TEXT, pubkey TEXT);"
+                 "CREATE TABLE bundles (userid INTEGER PRIMARY KEY, "
+                 "timestamp INTEGER, data BLOB);",
+                 nullptr, nullptr, nullptr);
+
+    std::vector<unsigned char> bundle(512, 42);
+    for (int i = 1; i <= USERS; i++) {
+        std::string name = "user" + std::to_string(i);
+        db.insert({static_cast<uint32_t>(i), name, "", {'k', 'e', 'y'}},
+                  false);
+        db.insertBundle(static_cast<uint32_t>(i), bundle);
+        std::string insert = "INSERT INTO users VALUES (" + std::to_string(i) +
+                             ", '" + name + "', 'key');"
+                             "INSERT INTO bundles VALUES (" +
+                             std::to_string(i) + ", 0, zeroblob(512));";
+        sqlite3_exec(raw, insert.c_str(), nullptr, nullptr, nullptr);
+    }
+
+    std::cout << "                 query  prepared[us]    cached[us]   speedup\n";
+    report("select user by id",
+           measure([raw](int i) {
+               uncached(raw, "SELECT id, username, pubkey FROM users "
+                             "WHERE id = ? LIMIT 1;",
+                        i % USERS + 1);
+           }),
+           measure([&db](int i) {
+               db.select(static_cast<uint32_t>(i % USERS + 1));
+           }));
+    report("select bundle",
+           measure([raw](int i) {
+               uncached(raw, "SELECT data FROM bundles WHERE userid = ?;",
+                        i % USERS + 1);
+           }),
+           measure([&db](int i) {
+               db.selectBundle(static_cast<uint32_t>(i % USERS + 1));
+           }));
+    report("bundle timestamp",
+           measure([raw](int i) {
+               uncached(raw,
+                        "SELECT timestamp FROM bundles WHERE userid = ?;",
+                        i % USERS + 1);
+           }),
+           measure([&db](int i) {
+               db.getBundleTimestamp(static_cast<uint32_t>(i % USERS + 1));
+           }));
+    sqlite3_close(raw);
+
+    auto inner = std::make_unique<ServerSQLite>();
+    ServerSQLite *database = inner.get();
+    CachedDatabase cached{std::move(inner)};
+    for (int i = 1; i <= USERS; i++) {
+        cached.insert({static_cast<uint32_t>(i), "user" + std::to_string(i),
+                       "", {'k', 'e', 'y'}},
+                      false);
+    }
+    std::cout
+        << "\n                 query   database[us]    cached[us]   speedup\n";
+    report("select user by id",
+           measure([database](int i) {
+               database->select(static_cast<uint32_t>(i % USERS + 1));
+           }),
+           measure([&cached](int i) {
+               cached.select(static_cast<uint32_t>(i % USERS + 1));
+           }));
+    report("select user by name",
+           measure([database](int i) {
+               database->select("user" + std::to_string(i % USERS + 1));
+           }),
+           measure([&cached](int i) {
+               cached.select("user" + std::to_string(i % USERS + 1));
+           }));
+    CacheMetrics metrics = cached.metrics();
+    std::cout << "hit ratio " << metrics.hitRatio() << ", hit "
+              << metrics.hitTime / std::max<uint64_t>(1, metrics.hits)
+              << " ns, miss "
+              << metrics.missTime / std::max<uint64_t>(1, metrics.misses)
+              << " ns\n";
+
+    std::cout
+        << "\n                 query      scan[us]   indexed[us]   speedup\n";
+    search();
+}
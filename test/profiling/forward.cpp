@@ -0,0 +1,117 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+
+#include "../../src/shared/buffer_pool.h"
+#include "../../src/shared/byte_span.h"
+#include "../../src/shared/connection_manager.h"
+#include "../../src/shared/framing.h"
+
+using namespace helloworld;
+
+// heap allocations and throughput of forwarding one message on the server:
+// open the sender's frame, seal the payload for the receiver, frame it for
+// the socket; each round needs a fresh frame, replayed ones are rejected
+
+static constexpr int ROUNDS = 5000;
+
+static size_t allocations = 0;
+static size_t allocated = 0;
+
+void *operator new(size_t size) {
+    allocations++;
+    allocated += size;
+    if (void *memory = std::malloc(size)) return memory;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept { std::free(memory); }
+
+void operator delete(void *memory, size_t) noexcept { std::free(memory); }
+
+template <typename Function>
+void measure(const char *name, ClientToServerManager &sender, size_t size,
+             Function forward) {
+    Request request{{Request::Type::SEND, 5, 7},
+                    std::vector<unsigned char>(size, 'm')};
+    std::vector<std::string> frames;
+    for (int i = 0; i < ROUNDS; i++)
+        frames.push_back(sender.parseOutgoing(request).str());
+
+    size_t count = allocations, bytes = allocated;
+    auto start = std::chrono::steady_clock::now();
+    for (const std::string &frame : frames) {
+        forward(ByteSpan(reinterpret_cast<const unsigned char *>(frame.data()),
+                         frame.size()));
+    }
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+    std::cout << std::setw(10) << name << std::setw(10) << size
+              << std::setw(10) << (allocations - count) / ROUNDS
+              << std::setw(14) << (allocated - bytes) / ROUNDS
+              << std::setw(14) << std::fixed << std::setprecision(0)
+              << ROUNDS / seconds << "\n";
+}
+
+int main() {
+    ClientToServerManager alice{"73bed6b8e3c1743b7116e69e22229516",
+                                "server_pub.pem"};
+    alice.switchSecureChannel(true);
+    ServerToClientManager fromAlice{"73bed6b8e3c1743b7116e69e22229516"};
+    ServerToClientManager toBob{"4e8b3fd1c3ec90ba1e2e3e5a8e43dd0c"};
+
+    std::cout << "      path   payload  allocs/msg  alloc B/msg  "
+                 "messages/s\n";
+    for (size_t size : {64, 1024, 16 * 1024}) {
+        // server.h callback + forward() before the payload views
+        measure("owning", alice, size, [&](ByteSpan data) {
+            Request incoming = fromAlice.parseIncoming(ByteSpanStream(data));
+            Response outgoing{{Response::Type::RECEIVE, incoming.header.userId,
+                               incoming.header.fromId},
+                              incoming.payload};
+            std::stringstream sealed = toBob.parseOutgoing(outgoing);
+        });
+
+        // ServerTCP::send() before the pooled buffers
+        FrameCodec codec{WireProtocol::BINARY};
+        measure("view", alice, size, [&](ByteSpan data) {
+            std::vector<unsigned char> buffer;
+            RequestView incoming = fromAlice.parseIncoming(data, buffer);
+            ResponseView outgoing{{Response::Type::RECEIVE,
+                                   incoming.header.userId,
+                                   incoming.header.fromId},
+                                  incoming.payload};
+            std::stringstream sealed = toBob.parseOutgoing(outgoing);
+            std::stringstream toSend;
+            codec.encode(sealed, toSend);
+            std::string socket = toSend.str();
+        });
+
+        // server.h callback and ServerTCP::_frame()
+        measure("pooled", alice, size, [&](ByteSpan data) {
+            MessageBuffer buffer(data.size);
+            RequestView incoming = fromAlice.parseIncoming(data, *buffer);
+            ResponseView outgoing{{Response::Type::RECEIVE,
+                                   incoming.header.userId,
+                                   incoming.header.fromId},
+                                  incoming.payload};
+            std::stringstream sealed = toBob.parseOutgoing(outgoing);
+            size_t length = getSize(sealed);
+            MessageBuffer payload(length);
+            payload->resize(length);
+            read_n(sealed, payload->data(), payload->size());
+            MessageBuffer frame(codec.frameSize(length));
+            codec.encode(*payload, *frame);
+            std::string socket(frame->begin(), frame->end());
+        });
+    }
+
+    BufferMetrics metrics = BufferPool::metrics();
+    std::cout << "\nbuffer pool: " << metrics.acquired << " acquired, "
+              << metrics.reused << " reused, " << metrics.allocations
+              << " allocations, reuse " << std::setprecision(3)
+              << metrics.reuseRatio() << "\n";
+}
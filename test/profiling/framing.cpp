@@ -0,0 +1,54 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+#include "../../src/shared/framing.h"
+#include "../../src/shared/random.h"
+
+using namespace helloworld;
+
+// compares legacy base64 framing against binary length prefixed frames:
+// bytes on wire and frames per second (encode + decode)
+
+static constexpr int FRAMES = 2000;
+
+void measure(WireProtocol protocol, const std::vector<unsigned char> &message) {
+    FrameCodec sender{protocol};
+    FrameCodec receiver;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<unsigned char> wire = sender.handshake();
+    for (int i = 0; i < FRAMES; i++) {
+        std::vector<unsigned char> frame = sender.encode(message);
+        wire.insert(wire.end(), frame.begin(), frame.end());
+    }
+    // simulate tcp segments of 1460 bytes (ethernet MSS)
+    int frames = 0;
+    ByteSpan result;
+    for (size_t i = 0; i < wire.size(); i += 1460) {
+        size_t length = std::min<size_t>(1460, wire.size() - i);
+        std::copy(wire.data() + i, wire.data() + i + length,
+                  receiver.prepare(length));
+        receiver.commit(length);
+        while (receiver.next(result)) ++frames;
+    }
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+
+    std::cout << std::setw(8)
+              << (protocol == WireProtocol::BINARY ? "binary" : "base64")
+              << std::setw(10) << message.size() << std::setw(14)
+              << (wire.size() / FRAMES) << std::setw(16)
+              << static_cast<uint64_t>(frames / seconds)
+              << (frames == FRAMES ? "" : "  (frames lost!)") << "\n";
+}
+
+int main() {
+    std::cout << "protocol   payload  bytes/frame      frames/sec\n";
+    for (size_t size : {64, 1024, 16 * 1024, 256 * 1024}) {
+        std::vector<unsigned char> message = Random{}.get(size);
+        measure(WireProtocol::LEGACY_BASE64, message);
+        measure(WireProtocol::BINARY, message);
+    }
+}
@@ -0,0 +1,72 @@
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../../src/client/config.h"
+#include "../../src/shared/curve_25519.h"
+#include "../../src/shared/keystore.h"
+
+using namespace helloworld;
+
+// one-time keys of a key bundle: the previous sequential generation with
+// a password protected file per key against the batch generation and
+// the keystore
+
+static const zero::str_t PASSWORD = "hunter2";
+
+template <typename Function>
+void measure(const char *name, size_t count, Function generate) {
+    constexpr int ROUNDS = 5;
+    double best = 0;
+    for (int round = 0; round < ROUNDS; round++) {
+        auto start = std::chrono::steady_clock::now();
+        generate();
+        auto end = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(end - start).count();
+        if (round == 0 || seconds < best) best = seconds;
+    }
+    std::cout << std::setw(18) << name << std::setw(8) << count
+              << std::setw(12) << std::fixed << std::setprecision(2)
+              << best * 1000 << std::setw(12) << std::setprecision(0)
+              << count / best << "\n";
+}
+
+int main() {
+    std::cout << "              path    keys          ms      keys/s\n";
+    for (size_t count : {20, 100, 1000}) {
+        // Client::updateKeys() before the keystore
+        measure("files", count, [count]() {
+            for (size_t i = 0; i < count; ++i) {
+                C25519KeyGen oneTimeKeygen{};
+                oneTimeKeygen.savePublicKey("profiling" + std::to_string(i) +
+                                            oneTimeC25519pub);
+                oneTimeKeygen.savePrivateKeyPassword(
+                    "profiling" + std::to_string(i) + oneTimeC25519priv,
+                    PASSWORD);
+            }
+        });
+
+        measure("batch, 1 thread", count,
+                [count]() { C25519KeyGen::generate(count, 1); });
+        measure("batch", count, [count]() { C25519KeyGen::generate(count); });
+
+        measure("batch + keystore", count, [count]() {
+            std::vector<zero::bytes_t> keys;
+            for (C25519KeyPair &pair : C25519KeyGen::generate(count))
+                keys.push_back(std::move(pair.privateKey));
+            OneTimeKeystore::save("profiling" + oneTimeKeystore, PASSWORD,
+                                  keys);
+        });
+
+        for (size_t i = 0; i < count; ++i) {
+            std::remove(("profiling" + std::to_string(i) + oneTimeC25519pub)
+                            .c_str());
+            std::remove(("profiling" + std::to_string(i) + oneTimeC25519priv)
+                            .c_str());
+        }
+        std::remove(("profiling" + oneTimeKeystore).c_str());
+    }
+}
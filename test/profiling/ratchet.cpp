@@ -0,0 +1,57 @@
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+
+#include "../../src/shared/curve_25519.h"
+#include "../../src/shared/double_ratchet.h"
+
+using namespace helloworld;
+
+// double ratchet steps per second: key derivation steps alone and whole
+// messages, both in one direction (symmetric ratchet only) and alternating
+// (each message also performs diffie-hellman ratchet step)
+
+static constexpr int STEPS = 20000;
+
+void measure(const char *name, int steps, const std::function<void()> &step) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < steps; i++) step();
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+    std::cout << std::setw(24) << name << std::setw(14) << std::fixed
+              << std::setprecision(0) << steps / seconds << "\n";
+}
+
+int main() {
+    DoubleRatchetAdapter adapter;
+    zero::bytes_t rk(32, 'a'), ck(32, 'c'), dhOut(32, 'd');
+    std::vector<unsigned char> ad(32, 'b');
+    std::vector<unsigned char> plaintext(64, 'p');
+
+    std::cout << "                    step     steps/sec\n";
+    measure("KDF_RK", STEPS, [&]() { rk = adapter.KDF_RK(rk, dhOut).first; });
+    measure("KDF_CK", STEPS, [&]() { ck = adapter.KDF_CK(ck, 0x02).first; });
+    measure("ENCRYPT + DECRYPT", STEPS, [&]() {
+        CipherHMAC sealed = adapter.ENCRYPT(ck, plaintext, ad);
+        adapter.DECRYPT(ck, sealed.ciphertext, sealed.hmac, ad);
+    });
+
+    C25519KeyGen keygenBob;
+    zero::bytes_t sharedKey(32, 'a');
+    zero::bytes_t associated(32, 'b');
+    DoubleRatchet alice(sharedKey, associated, keygenBob.getPublicKey());
+    DoubleRatchet bob(sharedKey, associated, keygenBob.getPublicKey(),
+                      keygenBob.getPrivateKey());
+
+    measure("message one-way", STEPS, [&]() {
+        bob.RatchetDecrypt(alice.RatchetEncrypt(plaintext));
+    });
+    // diffie-hellman dominates, fewer rounds
+    int round = 0;
+    measure("message ping-pong", STEPS / 10, [&]() {
+        DoubleRatchet &sender = round % 2 ? bob : alice;
+        DoubleRatchet &receiver = round++ % 2 ? alice : bob;
+        receiver.RatchetDecrypt(sender.RatchetEncrypt(plaintext));
+    });
+}
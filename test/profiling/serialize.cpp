@@ -0,0 +1,88 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+#include "../../src/shared/curve_25519.h"
+#include "../../src/shared/double_ratchet_utils.h"
+#include "../../src/shared/request_response.h"
+#include "../../src/shared/requests.h"
+#include "../../src/shared/responses.h"
+
+using namespace helloworld;
+
+// serialize + deserialize round trips per second of typical messages:
+// request with 1 KiB send payload, response with user list, key bundle
+// with one-time keys, double ratchet state with skipped message keys
+
+static constexpr int ROUNDS = 20000;
+
+template <typename Function>
+void measure(const char *name, size_t bytes, Function roundTrip) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ROUNDS; i++) roundTrip();
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+    std::cout << std::setw(12) << name << std::setw(10) << bytes
+              << std::setw(14) << std::fixed << std::setprecision(0)
+              << ROUNDS / seconds << "\n";
+}
+
+int main() {
+    std::cout << "      object     bytes  round trips/s\n";
+
+    Request request{{Request::Type::SEND, 5, 7},
+                    SendData("2019-05-12", "alice", 7, false,
+                             std::vector<unsigned char>(1024, 'm'))
+                        .serialize()};
+    measure("request", request.payload.size(), [&]() {
+        serialize::structure data = request.header.serialize();
+        data.insert(data.end(), request.payload.begin(), request.payload.end());
+        uint64_t from = 0;
+        Request::Header header = Request::Header::deserialize(data, from);
+        SendData payload = serialize::deserialize_versioned<SendData>(
+            {data.data() + from, data.size() - from});
+        if (payload.data.size() != 1024 || header.userId != 5) throw Error("");
+    });
+
+    UserListReponse users;
+    for (uint32_t i = 0; i < 100; i++) {
+        users.ids.push_back(i);
+        users.online.push_back("user" + std::to_string(i));
+    }
+    Response response{{Response::Type::USERLIST, 5}, users.serialize()};
+    measure("response", response.payload.size(), [&]() {
+        serialize::structure data = response.header.serialize();
+        data.insert(data.end(), response.payload.begin(),
+                    response.payload.end());
+        uint64_t from = 0;
+        Response::Header header = Response::Header::deserialize(data, from);
+        UserListReponse payload =
+            serialize::deserialize_versioned<UserListReponse>(
+                {data.data() + from, data.size() - from});
+        if (payload.ids.size() != 100 || header.userId != 5) throw Error("");
+    });
+
+    KeyBundle<C25519> bundle;
+    bundle.timestamp = 1;
+    bundle.identityKey = zero::bytes_t(32, 'i');
+    bundle.preKey = zero::bytes_t(32, 'p');
+    bundle.preKeySingiture = std::vector<unsigned char>(64, 's');
+    for (int i = 0; i < 50; i++) bundle.oneTimeKeys.emplace_back(32, 'o');
+    measure("key bundle", bundle.serialize().size(), [&]() {
+        KeyBundle<C25519> copy =
+            KeyBundle<C25519>::deserialize(bundle.serialize());
+        if (copy.oneTimeKeys.size() != 50) throw Error("");
+    });
+
+    DRState state{};
+    state.DHs = {zero::bytes_t(32, 1), zero::bytes_t(32, 2)};
+    state.DHr = state.RK = state.CKs = state.CKr = zero::bytes_t(32, 3);
+    state.AD = zero::bytes_t(64, 4);
+    for (size_t i = 0; i < 20; i++)
+        state.MKSKIPPED.emplace(std::make_pair(zero::bytes_t(32, 5), i),
+                                zero::bytes_t(32, 6));
+    measure("ratchet", state.serialize().size(), [&]() {
+        DRState copy = DRState::deserialize(state.serialize());
+        if (copy.MKSKIPPED.size() != 20) throw Error("");
+    });
+}
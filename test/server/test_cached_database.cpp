@@ -0,0 +1,99 @@
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "catch.hpp"
+
+#include "../../src/server/cached_database.h"
+#include "../../src/server/lru_cache.h"
+#include "../../src/server/sqlite_database.h"
+
+using namespace helloworld;
+
+TEST_CASE("Lru cache evicts least recently used") {
+    // one shard so that the capacity is exact
+    LruCache<int, int, 1> cache{2};
+    int value = 0;
+
+    CHECK(cache.insert(1, 10, cache.generation()));
+    CHECK(cache.insert(2, 20, cache.generation()));
+    CHECK(cache.find(1, value));
+    CHECK(value == 10);
+    CHECK(cache.insert(3, 30, cache.generation()));
+
+    CHECK(cache.size() == 2);
+    CHECK_FALSE(cache.find(2, value));
+    CHECK(cache.find(1, value));
+    CHECK(cache.find(3, value));
+
+    SECTION("erase rejects values loaded before it") {
+        uint64_t generation = cache.generation();
+        cache.erase(1);
+        CHECK_FALSE(cache.find(1, value));
+        CHECK_FALSE(cache.insert(1, 11, generation));
+        CHECK_FALSE(cache.find(1, value));
+        CHECK(cache.insert(1, 12, cache.generation()));
+        CHECK(cache.find(1, value));
+        CHECK(value == 12);
+    }
+
+    SECTION("clear") {
+        cache.clear();
+        CHECK(cache.size() == 0);
+        CHECK_FALSE(cache.find(3, value));
+    }
+}
+
+TEST_CASE("Cached database answers repeated lookups from memory") {
+    CachedDatabase db{std::make_unique<ServerSQLite>()};
+    uint32_t alice = db.insert({0, "alice", "", {'k', 'e', 'y'}}, true);
+    uint32_t bob = db.insert({0, "bob", "", {'k', 'e', 'y'}}, true);
+
+    CHECK(db.select(alice).name == "alice");
+    CHECK(db.metrics().misses == 1);
+    // cached under both keys on miss
+    CHECK(db.select("alice").id == alice);
+    CHECK(db.select(alice).publicKey == zero::bytes_t{'k', 'e', 'y'});
+    CHECK(db.select(UserData{0, "alice", "", {}}).id == alice);
+    CacheMetrics metrics = db.metrics();
+    CHECK(metrics.hits == 3);
+    CHECK(metrics.misses == 1);
+    CHECK(metrics.size == 1);
+    CHECK(metrics.hitRatio() == Approx(0.75));
+
+    SECTION("unknown users are not cached") {
+        CHECK(db.select("carol").name.empty());
+        CHECK(db.select(999).name.empty());
+        CHECK(db.metrics().size == 1);
+        db.insert({0, "carol", "", {}}, true);
+        CHECK(db.select("carol").name == "carol");
+    }
+
+    SECTION("remove invalidates both keys") {
+        CHECK(db.select(bob).name == "bob");
+        CHECK(db.remove({0, "bob", "", {}}));
+        CHECK(db.select(bob).name.empty());
+        CHECK(db.select("bob").name.empty());
+
+        uint32_t again = db.insert({0, "bob", "", {'n', 'e', 'w'}}, true);
+        CHECK(db.select("bob").id == again);
+        CHECK(db.select("bob").publicKey == zero::bytes_t{'n', 'e', 'w'});
+    }
+
+    SECTION("concurrent lookups") {
+        std::vector<std::thread> threads;
+        std::vector<int> found(4, 0);
+        for (int t = 0; t < 4; t++) {
+            threads.emplace_back([&db, &found, t, alice, bob]() {
+                for (int i = 0; i < 1000; i++) {
+                    std::string name = i % 2 ? "alice" : "bob";
+                    found[t] += db.select(i % 2 ? alice : bob).id != 0;
+                    found[t] += !db.select(name).name.empty();
+                }
+            });
+        }
+        for (auto &thread : threads) thread.join();
+        for (int count : found) CHECK(count == 2000);
+        CHECK(db.metrics().hitRatio() > 0.99);
+    }
+}
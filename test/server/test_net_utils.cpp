@@ -0,0 +1,103 @@
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "catch.hpp"
+
+#include "../../src/server/net_utils.h"
+
+using namespace helloworld;
+
+TEST_CASE("Sharded hash map basic operations") {
+    ShardedHashMap<std::string, int> map;
+    int value = 0;
+
+    CHECK_FALSE(map.contains("alice"));
+    CHECK_FALSE(map.find("alice", value));
+
+    map.insert("alice", 1);
+    map.insert("bob", 2);
+    CHECK(map.contains("alice"));
+    CHECK(map.find("bob", value));
+    CHECK(value == 2);
+
+    map.insert("bob", 3);
+    CHECK(map.find("bob", value));
+    CHECK(value == 3);
+
+    SECTION("erase only expected value") {
+        CHECK_FALSE(map.erase("bob", 2));
+        CHECK(map.contains("bob"));
+        CHECK(map.erase("bob", 3));
+        CHECK_FALSE(map.contains("bob"));
+    }
+
+    SECTION("emplace keeps present value") {
+        CHECK_FALSE(map.emplace("bob", 5));
+        CHECK(map.find("bob", value));
+        CHECK(value == 3);
+        CHECK(map.emplace("carol", 5));
+        CHECK(map.contains("carol"));
+    }
+
+    SECTION("erase") {
+        CHECK(map.erase("alice"));
+        CHECK_FALSE(map.erase("alice"));
+    }
+
+    SECTION("for each") {
+        int sum = 0;
+        map.forEach([&sum](const std::string &, int v) { sum += v; });
+        CHECK(sum == 4);
+    }
+}
+
+TEST_CASE("Sharded hash map concurrent access") {
+    ShardedHashMap<std::string, int> map;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&map, t]() {
+            for (int i = 0; i < 1000; ++i) {
+                std::string name = std::to_string(t) + "-" + std::to_string(i);
+                map.insert(name, i);
+                int value = -1;
+                map.find(name, value);
+                if (i % 2) map.erase(name);
+            }
+        });
+    }
+    for (auto &thread : threads) thread.join();
+
+    int count = 0;
+    map.forEach([&count](const std::string &, int) { count++; });
+    CHECK(count == 2000);
+}
+
+TEST_CASE("Mpsc queue keeps order of every producer") {
+    MpscQueue<std::pair<int, int>> queue;
+    std::pair<int, int> item;
+    CHECK_FALSE(queue.pop(item));
+
+    const int producers = 4;
+    const int items = 10000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < producers; ++t) {
+        threads.emplace_back([&queue, t]() {
+            for (int i = 0; i < items; ++i) queue.push({t, i});
+        });
+    }
+
+    std::vector<int> last(producers, -1);
+    int popped = 0;
+    bool ordered = true;
+    while (popped < producers * items) {
+        if (!queue.pop(item)) continue;
+        ordered &= item.second == last[item.first] + 1;
+        last[item.first] = item.second;
+        ++popped;
+    }
+    for (auto &thread : threads) thread.join();
+
+    CHECK(ordered);
+    CHECK_FALSE(queue.pop(item));
+}
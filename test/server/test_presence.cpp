@@ -0,0 +1,102 @@
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "catch.hpp"
+
+#include "../../src/server/presence.h"
+
+using namespace helloworld;
+
+TEST_CASE("Presence registry keeps online users") {
+    PresenceRegistry presence;
+    CHECK(presence.version() == 0);
+
+    CHECK(presence.online("bob", 2) == 1);
+    CHECK(presence.online("alice", 1) == 2);
+    CHECK(presence.online("cyril", 3) == 3);
+    // repeated login and unknown logout change nothing
+    CHECK(presence.online("bob", 2) == 3);
+    CHECK(presence.offline("dave") == 3);
+    CHECK(presence.size() == 3);
+
+    SECTION("snapshot rebuilt only after change") {
+        auto first = presence.snapshot();
+        CHECK(presence.snapshot() == first);
+        UserListReponse list = UserListReponse::deserialize(*first);
+        CHECK(list.online == std::vector<std::string>{"alice", "bob", "cyril"});
+        CHECK(list.ids == std::vector<uint32_t>{1, 2, 3});
+        CHECK(list.version == 3);
+        CHECK_FALSE(list.delta);
+
+        presence.offline("bob");
+        auto second = presence.snapshot();
+        CHECK(second != first);
+        CHECK(UserListReponse::deserialize(*second).online ==
+              std::vector<std::string>{"alice", "cyril"});
+    }
+
+    SECTION("pages") {
+        UserListReponse page = presence.page("", 2);
+        CHECK(page.online == std::vector<std::string>{"alice", "bob"});
+        page = presence.page(page.online.back(), 2);
+        CHECK(page.online == std::vector<std::string>{"cyril"});
+        CHECK(presence.page("cyril", 2).online.empty());
+        CHECK(presence.page("", 0).online.size() == 3);
+    }
+
+    SECTION("changes since version") {
+        presence.offline("alice");
+        presence.online("dave", 4);
+        presence.offline("dave");
+        presence.online("eve", 5);
+
+        UserListReponse delta = presence.changes(3);
+        CHECK(delta.delta);
+        CHECK(delta.version == 7);
+        CHECK(delta.online == std::vector<std::string>{"eve"});
+        CHECK(delta.ids == std::vector<uint32_t>{5});
+        CHECK(delta.offline == std::vector<uint32_t>{1, 4});
+
+        CHECK(presence.changes(7).delta);
+        CHECK(presence.changes(7).online.empty());
+        // unknown future version gets the full list
+        CHECK_FALSE(presence.changes(100).delta);
+    }
+}
+
+TEST_CASE("Presence registry drops old changes") {
+    PresenceRegistry presence{2};
+    presence.online("alice", 1);
+    presence.online("bob", 2);
+    presence.online("cyril", 3);
+
+    UserListReponse full = presence.changes(0);
+    CHECK_FALSE(full.delta);
+    CHECK(full.online.size() == 3);
+
+    UserListReponse delta = presence.changes(1);
+    CHECK(delta.delta);
+    CHECK(delta.online == std::vector<std::string>{"bob", "cyril"});
+}
+
+TEST_CASE("Presence registry concurrent updates") {
+    PresenceRegistry presence;
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < 4; ++t) {
+        threads.emplace_back([&presence, t]() {
+            for (uint32_t i = 0; i < 500; ++i) {
+                std::string name = std::to_string(t) + "-" + std::to_string(i);
+                presence.online(name, t * 1000 + i);
+                presence.snapshot();
+                if (i % 2) presence.offline(name);
+            }
+        });
+    }
+    for (auto &thread : threads) thread.join();
+
+    CHECK(presence.size() == 1000);
+    CHECK(presence.version() == 3000);
+    CHECK(UserListReponse::deserialize(*presence.snapshot()).ids.size() ==
+          1000);
+}
@@ -252,7 +252,9 @@ TEST_CASE("Key Bundles") {
     CHECK(received.preKeySingiture == std::vector<unsigned char>{5});
     CHECK(received.preKey == zero::bytes_t{6});
     CHECK(received.identityKey == zero::bytes_t{7});
-    CHECK(received.oneTimeKeys == std::vector<zero::bytes_t>{{1}, {2}});
+    // only the claimed key is sent, along with its id
+    CHECK(received.oneTimeKeys == std::vector<zero::bytes_t>{{2}});
+    CHECK(received.firstOneTimeKeyId == 1);
 
     r = server.sendKeyBundle({{Request::Type::GET_RECEIVERS_BUNDLE, id},
                               GenericRequest{0}.serialize()},
@@ -262,6 +264,7 @@ TEST_CASE("Key Bundles") {
     CHECK(received.preKey == zero::bytes_t{6});
     CHECK(received.identityKey == zero::bytes_t{7});
     CHECK(received.oneTimeKeys == std::vector<zero::bytes_t>{{1}});
+    CHECK(received.firstOneTimeKeyId == 0);
 
     r = server.sendKeyBundle({{Request::Type::GET_RECEIVERS_BUNDLE, id},
                               GenericRequest{0}.serialize()},
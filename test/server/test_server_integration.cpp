@@ -8,6 +8,7 @@
 #include "../../src/server/server.h"
 #include "../../src/server/transmission_file_server.h"
 #include "../../src/shared/connection_manager.h"
+#include "../../src/shared/curve_25519.h"
 #include "../../src/shared/requests.h"
 #include "../../src/shared/responses.h"
 
@@ -46,6 +47,12 @@ Request deleteUser(uint32_t id) {
     return {{Request::Type::REMOVE, id}, deleteUser.serialize()};
 }
 
+std::vector<unsigned char> emptyBundle() {
+    KeyBundle<C25519> bundle;
+    bundle.generateTimeStamp();
+    return bundle.serialize();
+}
+
 struct ClientMock : public Callable<void, std::stringstream &&> {
     explicit ClientMock(std::string name) : _username(std::move(name)) {
         _transmission = std::make_unique<ClientFiles>(this, _username);
@@ -71,13 +78,13 @@ struct ClientMock : public Callable<void, std::stringstream &&> {
                 uid = response.header.userId;
 
                 std::stringstream buffer = _connection->parseOutgoing(
-                    {{Request::Type::KEY_BUNDLE_UPDATE, uid}, {0}});
+                    {{Request::Type::KEY_BUNDLE_UPDATE, uid}, emptyBundle()});
                 _transmission->send(buffer);
                 return;
             }
             case Response::Type::BUNDLE_UPDATE_NEEDED: {
                 std::stringstream buffer = _connection->parseOutgoing(
-                    {{Request::Type::KEY_BUNDLE_UPDATE, uid}, {0}});
+                    {{Request::Type::KEY_BUNDLE_UPDATE, uid}, emptyBundle()});
                 _transmission->send(buffer);
                 return;
             }
@@ -215,7 +222,7 @@ TEST_CASE("Scenario 2: get online users.") {
     registerUserRoutine(server, client3);
 
     std::stringstream getOnline = client2._connection->parseOutgoing(
-        {{Request::Type::GET_ONLINE, 0}, GenericRequest{0}.serialize()});
+        {{Request::Type::GET_ONLINE, 0}, GetOnline{0}.serialize()});
     client2._transmission->send(getOnline);
 
     // server receives request
@@ -3,6 +3,8 @@
 //
 
 #include <QCoreApplication>
+#include <chrono>
+#include <ctime>
 #include <deque>
 
 #include "../../src/server/transmission_net_server.h"
@@ -222,6 +224,35 @@ TEST_CASE("connect and send message") {
     CHECK(call.received.front().second == msg);
 }
 
+TEST_CASE("connect and send message binary frames") {
+    int argc = 0;
+    char name[] = "Test";
+    char *argv[] = {name, nullptr};
+    QCoreApplication a{argc, argv};
+
+    std::string msg;
+    SECTION("short message") { msg = "O"; }
+    SECTION("message split into segments") { msg = std::string(100000, 'a'); }
+
+    messageStorage call;
+    call.counter = 2;
+    ServerTCP server(&call);
+    MocClient client;
+    client.codec = FrameCodec{WireProtocol::BINARY};
+    client.onConnect = [&msg](MocClient *c) {
+        c->send(msg);
+        c->send(msg);
+    };
+    QObject::connect(&call, SIGNAL(done()), &a, SLOT(quit()));
+    REQUIRE_NOTHROW(client.connect(localhost, 5000));
+
+    QTimer::singleShot(timelimit_per_test * 1000, &a, SLOT(quit()));
+
+    a.exec();
+    CHECK(call.received.size() == 2);
+    for (auto &i : call.received) CHECK(i.second == msg);
+}
+
 TEST_CASE("connect and receive message") {
     int argc = 0;
     char name[] = "Test";
@@ -259,6 +290,64 @@ TEST_CASE("connect and receive message") {
     CHECK(e.emmited);
 }
 
+void login_burst(int users, size_t workers) {
+    int argc = 0;
+    char name[] = "Test";
+    char *argv[] = {name, nullptr};
+    QCoreApplication a{argc, argv};
+
+    LoginReply call;
+    ServerTCP server(&call, workers);
+    call.server = &server;
+
+    int replies = 0;
+    std::vector<std::unique_ptr<MocClient>> clients;
+    clients.reserve(users);
+    std::clock_t cpuStart = std::clock();
+    auto wallStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < users; ++i) {
+        clients.emplace_back(std::make_unique<MocClient>());
+        MocClient *client = clients.back().get();
+        client->onMessageRecieved = [&](std::string /*unused*/) {
+            if (++replies == users) a.quit();
+        };
+        client->onConnect = [i](MocClient *c) {
+            c->send("user" + std::to_string(i));
+        };
+        REQUIRE_NOTHROW(client->connect(localhost, 5000));
+        // let the server accept, keeps the listen backlog short
+        a.processEvents();
+    }
+
+    QTimer::singleShot(timelimit_per_test * 1000, &a, SLOT(quit()));
+    a.exec();
+    double wall = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - wallStart)
+                      .count();
+    double cpu = static_cast<double>(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+
+    CHECK(replies == users);
+    for (int i = 0; i < users; ++i) {
+        REQUIRE(clients[i]->received.size() == 1u);
+        CHECK(clients[i]->received.front() == "user" + std::to_string(i));
+    }
+    CHECK(server.getOpenConnections().size() == static_cast<size_t>(users));
+    // no thread spins while waiting for the socket threads
+    CHECK(cpu < wall * 2 + 1);
+
+    std::vector<LaneMetrics> metrics = server.workerMetrics();
+    CHECK(metrics.size() == workers);
+    uint64_t processed = 0;
+    for (const LaneMetrics &lane : metrics) processed += lane.processed;
+    if (workers > 0) CHECK(processed == static_cast<uint64_t>(users));
+}
+
+TEST_CASE("login burst replies are queued until registration finishes") {
+    login_burst(200, 0);
+}
+
+TEST_CASE("login burst processed by worker pool") { login_burst(200, 4); }
+
 TEST_CASE("unregistered send multiple messages") {
     server_send_1ucnm(2, std::string(200, 'a'));
     server_send_1ucnm(10, "Hello world!");
@@ -12,13 +12,13 @@
 #include <memory>
 #include <sstream>
 #include "../../src/server/transmission_net_server.h"
-#include "../../src/shared/base_64.h"
+#include "../../src/shared/framing.h"
 #include "../../src/shared/utils.h"
 namespace helloworld {
 struct MocClient : public QObject {
     Q_OBJECT
    public:
-    Base64 _base;
+    FrameCodec codec{WireProtocol::LEGACY_BASE64};
     std::unique_ptr<QTcpSocket> socket{std::make_unique<QTcpSocket>(this)};
     std::deque<std::string> received{};
     std::function<void(std::string)> onMessageRecieved{[](std::string /**/) {}};
@@ -33,14 +33,17 @@ struct MocClient : public QObject {
         if (!socket->waitForConnected()) {
             throw std::runtime_error("couldnt connect");
         }
+        std::vector<unsigned char> handshake = codec.handshake();
+        if (!handshake.empty())
+            socket->write(reinterpret_cast<const char*>(handshake.data()),
+                          static_cast<qint64>(handshake.size()));
         emit conn();
         onConnect(this);
     }
     void send(std::string msg) {
-        std::stringstream data{msg}, inBase;
-        _base.fromStream(data, inBase);
-        inBase << '\0';    // to different distinguish messages
-        QByteArray qdata(inBase.str().data(), inBase.str().size());
+        std::stringstream data{msg}, frame;
+        codec.encode(data, frame);
+        QByteArray qdata(frame.str().data(), frame.str().size());
         socket->write(qdata);
         socket->flush();
         emit sent();
@@ -55,13 +58,11 @@ struct MocClient : public QObject {
    public Q_SLOTS:
     void receive() {
         QByteArray data = socket->readAll();
-        std::stringstream ss(data.toStdString());
-        std::string line;
-        while (!std::getline(ss, line, '\0').eof()) {
-            std::stringstream inBase(line), fromBase{};
-            _base.toStream(inBase, fromBase);
-            onMessageRecieved(fromBase.str());
-            received.emplace_back(fromBase.str());
+        codec.feed(data.data(), static_cast<size_t>(data.size()));
+        std::vector<unsigned char> frame;
+        while (codec.next(frame)) {
+            onMessageRecieved(to_string(frame));
+            received.emplace_back(to_string(frame));
             emit recv();
         }
     };
@@ -100,19 +101,19 @@ struct signalReaction : public QObject {
 };
 
 struct noCallback
-    : public Callable<void, bool, const std::string&, std::stringstream&&> {
-    void callback(bool, const std::string&, std::stringstream&& /*unused*/) {}
+    : public Callable<void, bool, const std::string&, const ByteSpan&> {
+    void callback(bool, const std::string&, const ByteSpan& /*unused*/) {}
 };
 
 struct messageStorage
     : public QObject,
-      public Callable<void, bool, const std::string&, std::stringstream&&> {
+      public Callable<void, bool, const std::string&, const ByteSpan&> {
     Q_OBJECT
    public:
     std::deque<std::pair<std::string, std::string> > received;
     int counter{1};
-    void callback(bool, const std::string& name, std::stringstream&& ss) {
-        received.emplace_back(name, ss.str());
+    void callback(bool, const std::string& name, const ByteSpan& data) {
+        received.emplace_back(name, std::string(data.begin(), data.end()));
         counter--;
         if (counter == 0) {
             emit done();
@@ -124,11 +125,13 @@ struct messageStorage
 };
 
 struct EchoCallback
-    : public Callable<void, bool, const std::string&, std::stringstream&&> {
+    : public Callable<void, bool, const std::string&, const ByteSpan&> {
     ServerTCP* server;
     const std::vector<std::string>* names{nullptr};
     std::vector<std::string>::const_iterator it;
-    void callback(bool, const std::string& name, std::stringstream&& ss) {
+    void callback(bool, const std::string& name, const ByteSpan& data) {
+        std::stringstream ss;
+        write_n(ss, data.data, data.size);
         if (names) {
             if (it == std::vector<std::string>::iterator())
                 it = names->begin();
@@ -145,7 +148,7 @@ struct EchoCallback
 
 struct RegOnFirstMsg
     : public QObject,
-      public Callable<void, bool, const std::string&, std::stringstream&&> {
+      public Callable<void, bool, const std::string&, const ByteSpan&> {
     Q_OBJECT
    public:
     ServerTCP* server;
@@ -153,11 +156,12 @@ struct RegOnFirstMsg
     int counter{1};
 
     void callback(bool registered, const std::string& name,
-                  std::stringstream&& ss) {
+                  const ByteSpan& data) {
+        std::string message(data.begin(), data.end());
         if (!registered) {
-            server->registerConnection(ss.str());
+            server->registerConnection(message);
         } else {
-            received.emplace_back(name, ss.str());
+            received.emplace_back(name, message);
             counter--;
             if (counter == 0) {
                 emit done();
@@ -168,6 +172,20 @@ struct RegOnFirstMsg
    signals:
     void done();
 };
+// registers the user named in the first message and replies right away,
+// before the socket is moved into its thread (login flow of the server)
+struct LoginReply
+    : public Callable<void, bool, const std::string&, const ByteSpan&> {
+    ServerTCP* server;
+    void callback(bool registered, const std::string&,
+                  const ByteSpan& data) {
+        if (registered) return;
+        std::string name(data.begin(), data.end());
+        server->registerConnection(name);
+        std::stringstream reply{name};
+        server->send(name, reply);
+    }
+};
 }    // namespace helloworld
 
 #endif    // HELLOWORLD_TEST_SERVER_NET_H
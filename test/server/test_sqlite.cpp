@@ -1,3 +1,7 @@
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+
 #include "catch.hpp"
 
 #include "../../src/server/sqlite_database.h"
@@ -136,6 +140,86 @@ TEST_CASE("SQLITE Database delete users") {
     CHECK(db.selectLike(d2)[0]->name == "karel");
 }
 
+std::vector<std::string> names(const std::vector<UserData> &users) {
+    std::vector<std::string> result;
+    for (const auto &user : users) {
+        CHECK(user.publicKey.empty());
+        result.push_back(user.name);
+    }
+    return result;
+}
+
+TEST_CASE("SQLITE users are searched by index") {
+    ServerSQLite db{};
+
+    db.insert({1, "Penopa", "", strToVec("key")}, false);
+    db.insert({2, "karel", "", strToVec("key")}, false);
+    db.insert({3, "Karolina", "", strToVec("key")}, false);
+    db.insert({4, "50%_off", "", strToVec("key")}, false);
+    db.insert({5, "500 off", "", strToVec("key")}, false);
+
+    SECTION("substring, newest first, case insensitive") {
+        CHECK(names(db.searchUsers("KAR", 0, 10)) ==
+              std::vector<std::string>{"Karolina", "karel"});
+        CHECK(names(db.searchUsers("rel", 0, 10)) ==
+              std::vector<std::string>{"karel"});
+        CHECK(db.searchUsers("nowhere", 0, 10).empty());
+    }
+
+    SECTION("short queries") {
+        CHECK(names(db.searchUsers("a", 0, 10)) ==
+              std::vector<std::string>{"Karolina", "karel", "Penopa"});
+        CHECK(db.searchUsers("", 0, 10).size() == 5);
+    }
+
+    SECTION("wildcards match literally") {
+        CHECK(names(db.searchUsers("0%_", 0, 10)) ==
+              std::vector<std::string>{"50%_off"});
+        CHECK(names(db.searchUsers("%", 0, 10)) ==
+              std::vector<std::string>{"50%_off"});
+    }
+
+    SECTION("pages") {
+        auto first = db.searchUsers("", 0, 2);
+        REQUIRE(first.size() == 2);
+        CHECK(first.back().id == 4);
+        CHECK(names(db.searchUsers("", first.back().id, 2)) ==
+              std::vector<std::string>{"Karolina", "karel"});
+        CHECK(names(db.searchUsers("", 2, 2)) ==
+              std::vector<std::string>{"Penopa"});
+        CHECK(db.searchUsers("", 0, 0).empty());
+    }
+
+    SECTION("removed users are not found") {
+        CHECK(db.remove({0, "karel", "", {}}));
+        CHECK(db.remove({3, "", "", {}}));
+        CHECK(db.searchUsers("kar", 0, 10).empty());
+        db.insert({6, "karel", "", strToVec("key")}, false);
+        CHECK(db.searchUsers("kar", 0, 10).front().id == 6);
+    }
+}
+
+TEST_CASE("SQLITE users of existing database get indexed on open") {
+    std::remove("test_search_db");
+    sqlite3 *handler = nullptr;
+    REQUIRE(sqlite3_open("test_search_db", &handler) == SQLITE_OK);
+    sqlite3_exec(handler,
+                 "CREATE TABLE users (id INTEGER PRIMARY KEY AUTOINCREMENT, "
+                 "username TEXT, pubkey TEXT);"
+                 "INSERT INTO users VALUES (1, 'alice', 'key');"
+                 "INSERT INTO users VALUES (2, 'malice', 'key');",
+                 nullptr, nullptr, nullptr);
+    sqlite3_close(handler);
+    {
+        ServerSQLite db{"test_search_db"};
+        CHECK(names(db.searchUsers("lic", 0, 10)) ==
+              std::vector<std::string>{"malice", "alice"});
+    }
+    std::remove("test_search_db");
+    std::remove("test_search_db-wal");
+    std::remove("test_search_db-shm");
+}
+
 TEST_CASE("SQLITE basic operations messages / bundles table simple") {
     ServerSQLite db{};
 
@@ -302,4 +386,220 @@ TEST_CASE("SQLITE bundles re-insertion updates") {
     CHECK(db.selectBundle(4) == std::vector<unsigned char>{4, 2, 3});
     CHECK(db.selectBundle(3) == std::vector<unsigned char>{1, 2, 3});
     CHECK(db.selectBundle(2) == std::vector<unsigned char>{8, 8, 8, 8, 1});
-}
\ No newline at end of file
+}
+
+TEST_CASE("SQLITE messages are read in batches") {
+    ServerSQLite db{};
+    for (unsigned char i = 0; i < 10; i++)
+        db.insertData(7, std::vector<unsigned char>(10, i));
+    db.insertData(8, {42});
+    bool more = false;
+
+    SECTION("count limit") {
+        auto batch = db.selectData(7, 4, 1000, more);
+        REQUIRE(batch.size() == 4);
+        CHECK(more);
+        for (unsigned char i = 0; i < 4; i++)
+            CHECK(batch[i] == std::vector<unsigned char>(10, i));
+
+        batch = db.selectData(7, 100, 1000, more);
+        REQUIRE(batch.size() == 6);
+        CHECK_FALSE(more);
+        CHECK(batch.front() == std::vector<unsigned char>(10, 4));
+        CHECK(db.selectData(7, 100, 1000, more).empty());
+        CHECK_FALSE(more);
+    }
+
+    SECTION("count limit reached by the last message") {
+        CHECK(db.selectData(7, 10, 1000, more).size() == 10);
+        CHECK_FALSE(more);
+    }
+
+    SECTION("byte limit") {
+        auto batch = db.selectData(7, 100, 25, more);
+        REQUIRE(batch.size() == 2);
+        // cut by bytes, far below the count limit
+        CHECK(more);
+        // the first message is returned even if over the limit
+        batch = db.selectData(7, 100, 5, more);
+        REQUIRE(batch.size() == 1);
+        CHECK(more);
+        CHECK(batch.front() == std::vector<unsigned char>(10, 2));
+        CHECK(db.selectData(7) == std::vector<unsigned char>(10, 3));
+
+        // six messages of 10 bytes left, the limit is not reached
+        batch = db.selectData(7, 100, 65, more);
+        REQUIRE(batch.size() == 6);
+        CHECK_FALSE(more);
+    }
+
+    SECTION("peek keeps messages until deleted") {
+        uint64_t last = 0;
+        auto batch = db.peekData(7, 4, 1000, last, more);
+        REQUIRE(batch.size() == 4);
+        CHECK(more);
+        // not delivered, read again
+        CHECK(db.peekData(7, 4, 1000, last, more) == batch);
+
+        db.deleteData(7, last);
+        batch = db.peekData(7, 100, 1000, last, more);
+        REQUIRE(batch.size() == 6);
+        CHECK_FALSE(more);
+        CHECK(batch.front() == std::vector<unsigned char>(10, 4));
+        // messages stored meanwhile stay
+        db.insertData(7, {99});
+        db.deleteData(7, last);
+        CHECK(db.selectData(7, 100, 1000, more) ==
+              std::vector<std::vector<unsigned char>>{{99}});
+    }
+
+    CHECK(db.selectData(8, 100, 1000, more) ==
+          std::vector<std::vector<unsigned char>>{{42}});
+    CHECK(db.selectData(9, 100, 1000, more).empty());
+}
+
+TEST_CASE("SQLITE one-time keys are claimed once") {
+    ServerSQLite db{};
+    db.insertOneTimeKeys(3, {{1}, {2}, {3}});
+    db.insertOneTimeKeys(4, {{9}});
+    CHECK(db.countOneTimeKeys(3) == 3);
+
+    auto key = db.popOneTimeKey(3);
+    CHECK(key.first == 2);
+    CHECK(key.second == zero::bytes_t{3});
+    CHECK(db.countOneTimeKeys(3) == 2);
+
+    SECTION("replace keys") {
+        db.insertOneTimeKeys(3, {{5}});
+        CHECK(db.countOneTimeKeys(3) == 1);
+        CHECK(db.popOneTimeKey(3).second == zero::bytes_t{5});
+    }
+
+    SECTION("removed with bundle") {
+        db.insertBundle(3, {1});
+        CHECK(db.removeBundle(3));
+        CHECK(db.countOneTimeKeys(3) == 0);
+        CHECK(db.popOneTimeKey(3).second.empty());
+    }
+
+    SECTION("concurrent claims") {
+        db.insertOneTimeKeys(3, std::vector<zero::bytes_t>(100, {1}));
+        std::vector<std::thread> threads;
+        std::vector<std::vector<uint32_t>> claimed(4);
+        for (int t = 0; t < 4; t++) {
+            threads.emplace_back([&db, &claimed, t]() {
+                std::pair<uint32_t, zero::bytes_t> key;
+                while (!(key = db.popOneTimeKey(3)).second.empty())
+                    claimed[t].push_back(key.first);
+            });
+        }
+        for (auto &thread : threads) thread.join();
+
+        std::vector<uint32_t> all;
+        for (const auto &ids : claimed)
+            all.insert(all.end(), ids.begin(), ids.end());
+        std::sort(all.begin(), all.end());
+        REQUIRE(all.size() == 100);
+        CHECK(std::unique(all.begin(), all.end()) == all.end());
+    }
+
+    CHECK(db.countOneTimeKeys(4) == 1);
+}
+
+TEST_CASE("SQLITE bundle is claimed with its one-time keys") {
+    ServerSQLite db{};
+    db.replaceBundle(3, {7, 7}, {{1}, {2}});
+    uint64_t timestamp = db.getBundleTimestamp(3);
+    CHECK(timestamp != 0);
+
+    ClaimedBundle claimed = db.claimBundle(3, 1);
+    CHECK(claimed.bundle == std::vector<unsigned char>{7, 7});
+    CHECK(claimed.timestamp == timestamp);
+    CHECK(claimed.oneTimeKeyId == 1);
+    CHECK(claimed.oneTimeKey == zero::bytes_t{2});
+    CHECK(claimed.oneTimeKeysLeft == 1);
+
+    // the last key claimed marks the bundle, the blob is kept
+    claimed = db.claimBundle(3, 1);
+    CHECK(claimed.oneTimeKeyId == 0);
+    CHECK(claimed.oneTimeKey == zero::bytes_t{1});
+    CHECK(claimed.oneTimeKeysLeft == 0);
+    CHECK(claimed.timestamp == 1);
+    CHECK(db.getBundleTimestamp(3) == 1);
+    CHECK(db.selectBundle(3) == std::vector<unsigned char>{7, 7});
+
+    claimed = db.claimBundle(3, 1);
+    CHECK(claimed.bundle == std::vector<unsigned char>{7, 7});
+    CHECK(claimed.oneTimeKey.empty());
+
+    // replaced together, the new keys belong to the new bundle
+    db.replaceBundle(3, {8}, {{5}});
+    CHECK(db.getBundleTimestamp(3) > 1);
+    claimed = db.claimBundle(3, 1);
+    CHECK(claimed.bundle == std::vector<unsigned char>{8});
+    CHECK(claimed.oneTimeKey == zero::bytes_t{5});
+
+    // no bundle, no key is claimed
+    db.insertOneTimeKeys(4, {{9}});
+    CHECK(db.claimBundle(4, 1).bundle.empty());
+    CHECK(db.countOneTimeKeys(4) == 1);
+}
+
+TEST_CASE("SQLITE file database reads run concurrently with writes") {
+    std::remove("test_wal_db");
+    std::remove("test_wal_db-wal");
+    std::remove("test_wal_db-shm");
+    {
+        SQLiteOptions options;
+        options.synchronous = "OFF";
+        ServerSQLite db{"test_wal_db", options};
+
+        for (uint32_t i = 1; i <= 50; i++) {
+            db.insert({i, "user" + std::to_string(i), "", strToVec("key")},
+                      false);
+            db.insertBundle(i, std::vector<unsigned char>{1, 2, 3});
+        }
+
+        std::vector<std::thread> readers;
+        std::vector<int> found(4, 0);
+        for (int t = 0; t < 4; t++) {
+            readers.emplace_back([&db, &found, t]() {
+                for (uint32_t i = 1; i <= 50; i++) {
+                    if (db.select(i).name == "user" + std::to_string(i) &&
+                        db.selectBundle(i).size() == 3 &&
+                        db.getBundleTimestamp(i) != 0)
+                        found[t]++;
+                }
+            });
+        }
+        for (uint32_t i = 1; i <= 200; i++)
+            db.insertData(i % 50 + 1, std::vector<unsigned char>{7});
+        for (auto &reader : readers) reader.join();
+        // exited threads closed their connections
+        CHECK(db.readerConnections() == 0);
+
+        for (int count : found) CHECK(count == 50);
+        CHECK(db.selectData(1) == std::vector<unsigned char>{7});
+
+        // written data visible to readers of other threads
+        db.insert({0, "late", "", strToVec("key")}, true);
+        std::thread([&db]() {
+            CHECK(db.select("late").name == "late");
+            CHECK(db.readerConnections() == 1);
+        }).join();
+        CHECK(db.select("late").name == "late");
+        CHECK(db.readerConnections() == 1);
+    }
+
+    sqlite3 *handler = nullptr;
+    REQUIRE(sqlite3_open("test_wal_db", &handler) == SQLITE_OK);
+    sqlite3_stmt *statement = nullptr;
+    sqlite3_prepare_v2(handler, "PRAGMA journal_mode;", -1, &statement,
+                       nullptr);
+    REQUIRE(sqlite3_step(statement) == SQLITE_ROW);
+    CHECK(std::string(reinterpret_cast<const char *>(
+              sqlite3_column_text(statement, 0))) == "wal");
+    sqlite3_finalize(statement);
+    sqlite3_close(handler);
+    std::remove("test_wal_db");
+}
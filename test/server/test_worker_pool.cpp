@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "catch.hpp"
+
+#include "../../src/server/worker_pool.h"
+#include "../../src/shared/serializable_error.h"
+
+using namespace helloworld;
+
+TEST_CASE("Worker pool keeps order within key") {
+    std::mutex mutex;
+    std::map<size_t, std::vector<int>> results;
+    std::atomic<int> concurrent{0};
+    bool overlapped = false;
+    {
+        WorkerPool pool{4};
+        CHECK(pool.size() == 4);
+        CHECK_FALSE(pool.isWorkerThread());
+        for (int i = 0; i < 1000; ++i) {
+            size_t key = static_cast<size_t>(i % 7);
+            pool.submit(key, [&, key, i]() {
+                std::lock_guard<std::mutex> lock(mutex);
+                results[key].push_back(i);
+            });
+        }
+        // the same key never runs concurrently
+        for (int i = 0; i < 100; ++i) {
+            pool.submit(3, [&]() {
+                if (++concurrent > 1) overlapped = true;
+                std::this_thread::yield();
+                --concurrent;
+            });
+        }
+    }    // waits for all jobs
+
+    CHECK_FALSE(overlapped);
+    REQUIRE(results.size() == 7);
+    for (auto &result : results) {
+        CHECK(result.second.size() == (result.first < 1000 % 7 ? 143u : 142u));
+        CHECK(std::is_sorted(result.second.begin(), result.second.end()));
+    }
+}
+
+TEST_CASE("Worker pool metrics") {
+    WorkerPool pool{2};
+    std::atomic<bool> inside{false};
+    pool.submit(0, [&]() { inside = pool.isWorkerThread(); });
+    pool.submit(0, []() { throw Error("job failed"); });
+    pool.submit(1, []() {});
+
+    while (true) {
+        std::vector<LaneMetrics> metrics = pool.metrics();
+        REQUIRE(metrics.size() == 2);
+        if (metrics[0].processed == 2 && metrics[1].processed == 1) {
+            CHECK(metrics[0].failed == 1);
+            CHECK(metrics[0].depth == 0);
+            CHECK(metrics[0].maxDepth >= 1);
+            CHECK(metrics[1].failed == 0);
+            break;
+        }
+        std::this_thread::yield();
+    }
+    CHECK(inside);
+}
+
+TEST_CASE("Worker pool spreads connections over lanes") {
+    // sockets are aligned heap objects, addresses differ in high bits only
+    std::vector<std::unique_ptr<std::max_align_t[]>> sockets;
+    for (int i = 0; i < 64; ++i)
+        sockets.emplace_back(std::make_unique<std::max_align_t[]>(8));
+
+    WorkerPool pool{4};
+    for (const auto &socket : sockets)
+        pool.submit(WorkerPool::keyOf(socket.get()), []() {});
+    // the same connection always gets the same key
+    CHECK(WorkerPool::keyOf(sockets[0].get()) ==
+          WorkerPool::keyOf(sockets[0].get()));
+
+    while (true) {
+        std::vector<LaneMetrics> metrics = pool.metrics();
+        uint64_t processed = 0;
+        for (const LaneMetrics &lane : metrics) processed += lane.processed;
+        if (processed == sockets.size()) {
+            for (const LaneMetrics &lane : metrics) CHECK(lane.processed > 0);
+            break;
+        }
+        std::this_thread::yield();
+    }
+}
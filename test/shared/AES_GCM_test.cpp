@@ -2,6 +2,8 @@
 // Created by ivan on 23.3.19.
 //
 
+#include <algorithm>
+#include <array>
 #include <iomanip>
 #include <sstream>
 #include <string>
@@ -215,3 +217,78 @@ TEST_CASE("Test with vectors") {
     REQUIRE_NOTHROW(aes.decryptWithAd(output, additionalData, decrypted));
     CHECK(to_hex(plaintext) == to_hex(decrypted));
 }
+
+TEST_CASE("Buffer api matches the stream api") {
+    zero::str_t key = "FEFFE9928665731C6D6A8F9467308308";
+    std::string iv = "CAFEBABEFACEDBADDECAF888";
+    std::vector<unsigned char> plaintext = Random{}.get(1000);
+    std::vector<unsigned char> additionalData = Random{}.get(20);
+
+    AESGCM aes{};
+    aes.setPadding(Padding::NONE);
+    CHECK(aes.setKey(key));
+    CHECK(aes.setIv(iv));
+    std::vector<unsigned char> output;
+    aes.encryptWithAd(plaintext, additionalData, output);
+
+    AESGCM gcm{};
+    std::vector<unsigned char> rawIv = from_hex(iv);
+    std::vector<unsigned char> sealed(AESGCM::tag_size + plaintext.size());
+    CHECK_THROWS(gcm.seal(rawIv, plaintext, {}, sealed));
+    zero::bytes_t rawKey = from_hex(key);
+    CHECK_FALSE(gcm.setRawKey({rawKey.data(), rawKey.size() - 1}));
+    CHECK(gcm.setRawKey(rawKey));
+
+    // key expanded once, reused by following messages
+    for (int i = 0; i < 3; i++) {
+        gcm.seal(rawIv, plaintext, additionalData, sealed);
+        CHECK(sealed == output);
+
+        std::vector<unsigned char> opened(plaintext.size());
+        REQUIRE_NOTHROW(gcm.open(rawIv, sealed, additionalData, opened));
+        CHECK(opened == plaintext);
+    }
+
+    SECTION("separate tag") {
+        std::array<unsigned char, AESGCM::tag_size> tag{};
+        std::vector<unsigned char> ciphertext(plaintext.size());
+        gcm.encrypt(rawIv, plaintext, additionalData, ciphertext,
+                    {tag.data(), tag.size()});
+        CHECK(std::equal(tag.begin(), tag.end(), output.begin()));
+        CHECK(std::equal(ciphertext.begin(), ciphertext.end(),
+                         output.begin() + AESGCM::tag_size));
+
+        std::vector<unsigned char> decrypted(ciphertext.size());
+        gcm.decrypt(rawIv, ciphertext, additionalData, {tag.data(), tag.size()},
+                    decrypted);
+        CHECK(decrypted == plaintext);
+    }
+
+    SECTION("small buffers") {
+        std::vector<unsigned char> small(plaintext.size() - 1);
+        std::array<unsigned char, AESGCM::tag_size> tag{};
+        CHECK_THROWS(gcm.encrypt(rawIv, plaintext, {}, small,
+                                 {tag.data(), tag.size()}));
+        CHECK_THROWS(gcm.encrypt(rawIv, plaintext, {}, sealed,
+                                 {tag.data(), tag.size() - 1}));
+        CHECK_THROWS(gcm.encrypt({rawIv.data(), 8}, plaintext, {}, sealed,
+                                 {tag.data(), tag.size()}));
+        CHECK_THROWS(gcm.open(rawIv, {sealed.data(), AESGCM::tag_size - 1},
+                              {}, small));
+    }
+
+    std::vector<unsigned char> opened(plaintext.size());
+    SECTION("tampered ciphertext") {
+        sealed.back() ^= 1;
+        CHECK_THROWS(gcm.open(rawIv, sealed, additionalData, opened));
+    }
+
+    SECTION("tampered tag") {
+        sealed.front() ^= 1;
+        CHECK_THROWS(gcm.open(rawIv, sealed, additionalData, opened));
+    }
+
+    SECTION("wrong additional data") {
+        CHECK_THROWS(gcm.open(rawIv, sealed, {}, opened));
+    }
+}
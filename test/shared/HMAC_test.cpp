@@ -96,4 +96,28 @@ TEST_CASE("TEST VECTORS") {
     INFO("expected: " + output)
     // because some tests use truncated output
     CHECK(hexResult.rfind(output, 0) == 0);
-}
\ No newline at end of file
+}
+
+TEST_CASE("Raw api matches, context reused across keys") {
+    hmac_base<MBEDTLS_MD_SHA512, 64> reused;
+    zero::bytes_t first(20, 0x0b), second(25, 0xcd);
+    std::vector<unsigned char> message = from_string("Hi There");
+
+    for (const auto &key : {first, second, first}) {
+        hmac_base<MBEDTLS_MD_SHA512, 64> fresh;
+        fresh.setKey(to_hex(key));
+        std::vector<unsigned char> expected = fresh.generate(message);
+
+        reused.setKey(ByteSpan(key));
+        std::vector<unsigned char> output(reused.hmacLength());
+        reused.generate(ByteSpan(message), output.data());
+        CHECK(output == expected);
+
+        // same context, message in parts
+        std::fill(output.begin(), output.end(), 0);
+        reused.generate({ByteSpan(message.data(), 3),
+                         ByteSpan(message.data() + 3, message.size() - 3)},
+                        output.data());
+        CHECK(output == expected);
+    }
+}
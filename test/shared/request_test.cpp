@@ -14,6 +14,7 @@
 #include <sstream>
 #include <string>
 #include "../../src/shared/request_response.h"
+#include "../../src/shared/responses.h"
 #include "../../src/shared/utils.h"
 #include "cstdlib"
 
@@ -68,4 +69,16 @@ TEST_CASE("generate Serialize response header and deserialize") {
     CHECK(header.type == oheader.type);
     CHECK(header.messageNumber == oheader.messageNumber);
     CHECK(header.userId == oheader.userId);
-}
\ No newline at end of file
+}
+
+TEST_CASE("Serialize message batch and deserialize") {
+    MessageBatch batch{{{1, 2, 3}, {}, std::vector<unsigned char>(1000, 7)},
+                       true};
+    Response response{Response::Type::RECEIVE_OLD_BATCH, 5, batch.serialize()};
+
+    MessageBatch result = MessageBatch::deserialize(response.payload);
+    CHECK(result.messages == batch.messages);
+    CHECK(result.more);
+
+    CHECK(MessageBatch::deserialize(MessageBatch{}.serialize()).messages.empty());
+}
@@ -0,0 +1,93 @@
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "catch.hpp"
+
+#include "../../src/shared/buffer_pool.h"
+
+using namespace helloworld;
+
+TEST_CASE("Message buffers are reused by the thread") {
+    const unsigned char *memory;
+    {
+        MessageBuffer buffer(1000);
+        CHECK(buffer->empty());
+        CHECK(buffer->capacity() >= 1000);
+        buffer->assign(1000, 'x');
+        memory = buffer->data();
+    }
+    BufferMetrics before = BufferPool::metrics();
+    {
+        // same capacity class, the released buffer comes back cleared
+        MessageBuffer buffer(600);
+        CHECK(buffer->empty());
+        CHECK(buffer->data() == memory);
+        buffer->resize(1000);
+        CHECK(buffer->at(999) == 0);
+    }
+    BufferMetrics after = BufferPool::metrics();
+    CHECK(after.acquired == before.acquired + 1);
+    CHECK(after.reused == before.reused + 1);
+    CHECK(after.allocations == before.allocations);
+}
+
+TEST_CASE("Message buffer growth is counted") {
+    BufferMetrics before = BufferPool::metrics();
+    {
+        MessageBuffer buffer(BufferPool::MIN_CAPACITY);
+        buffer->resize(64 * 1024 + 1);
+    }
+    BufferMetrics after = BufferPool::metrics();
+    CHECK(after.acquired == before.acquired + 1);
+    CHECK(after.allocations >= before.allocations + 1);
+
+    // the grown buffer serves the larger class now
+    before = after;
+    { MessageBuffer buffer(64 * 1024); }
+    after = BufferPool::metrics();
+    CHECK(after.reused == before.reused + 1);
+    CHECK(after.allocations == before.allocations);
+}
+
+TEST_CASE("Oversized message buffers are not pooled") {
+    BufferMetrics before = BufferPool::metrics();
+    { MessageBuffer buffer(BufferPool::MAX_CAPACITY + 1); }
+    { MessageBuffer buffer(BufferPool::MAX_CAPACITY + 1); }
+    BufferMetrics after = BufferPool::metrics();
+    CHECK(after.reused == before.reused);
+    CHECK(after.allocations == before.allocations + 2);
+}
+
+TEST_CASE("Message buffers are pooled per thread") {
+    // fill the pool of this thread
+    { MessageBuffer buffer(4096); }
+
+    BufferMetrics before = BufferPool::metrics();
+    std::thread other([]() {
+        { MessageBuffer buffer(4096); }
+        { MessageBuffer buffer(4096); }
+    });
+    other.join();
+    BufferMetrics after = BufferPool::metrics();
+    // the other thread allocated its own buffer once
+    CHECK(after.acquired == before.acquired + 2);
+    CHECK(after.reused == before.reused + 1);
+    CHECK(after.allocations == before.allocations + 1);
+}
+
+TEST_CASE("Message buffer pool keeps limited number of buffers") {
+    {
+        std::vector<std::unique_ptr<MessageBuffer>> burst;
+        for (size_t i = 0; i < BufferPool::BUFFERS_PER_CLASS * 2; i++)
+            burst.emplace_back(new MessageBuffer(2048));
+    }
+    BufferMetrics before = BufferPool::metrics();
+    {
+        std::vector<std::unique_ptr<MessageBuffer>> burst;
+        for (size_t i = 0; i < BufferPool::BUFFERS_PER_CLASS * 2; i++)
+            burst.emplace_back(new MessageBuffer(2048));
+    }
+    BufferMetrics after = BufferPool::metrics();
+    CHECK(after.reused - before.reused == BufferPool::BUFFERS_PER_CLASS);
+}
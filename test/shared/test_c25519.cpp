@@ -73,4 +73,29 @@ TEST_CASE("Curve signatures") {
     std::vector<unsigned char> msg{1, 51, 21, 2, 12, 6, 6, 51, 65, 46, 84, 6, 51, 35, 6, 46, 51, 35, 46, 3, 35, 46, 4};
     std::vector<unsigned char> signature = client.sign(msg);
     CHECK(server.verify(signature, msg));
-}
\ No newline at end of file
+}
+
+TEST_CASE("Curve batch keygen") {
+    const size_t length = C25519::KEY_BYTES_LEN;
+    for (size_t threads : {0, 1, 3}) {
+        std::vector<C25519KeyPair> keys = C25519KeyGen::generate(50, threads);
+        REQUIRE(keys.size() == 50);
+
+        for (size_t i = 0; i < keys.size(); i++) {
+            CHECK(keys[i].privateKey.size() == length);
+            CHECK(keys[i].publicKey.size() == length);
+            CHECK(keys[i].privateKey != keys[(i + 1) % keys.size()].privateKey);
+
+            // public key belongs to the private one
+            const C25519KeyPair &other = keys[(i + 1) % keys.size()];
+            C25519 first, second;
+            first.setPrivateKey(keys[i].privateKey);
+            first.setPublicKey(other.publicKey);
+            second.setPrivateKey(other.privateKey);
+            second.setPublicKey(keys[i].publicKey);
+            CHECK(first.getShared() == second.getShared());
+        }
+    }
+    CHECK(C25519KeyGen::generate(0).empty());
+    CHECK(C25519KeyGen::generate(1, 8).size() == 1);
+}
@@ -0,0 +1,198 @@
+#include <algorithm>
+#include <cctype>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "catch.hpp"
+
+#include "../../src/shared/base_64.h"
+#include "../../src/shared/codec.h"
+#include "../../src/shared/random.h"
+#include "../../src/shared/utils.h"
+#include "mbedtls/base64.h"
+
+using namespace helloworld;
+
+// the implementations the codecs replaced, used as reference
+
+std::string referenceToHex(const std::vector<unsigned char> &bytes) {
+    std::stringstream stream;
+    for (unsigned char byte : bytes) {
+        stream << std::hex << std::setfill('0') << std::setw(2)
+               << static_cast<int>(byte);
+    }
+    return stream.str();
+}
+
+std::string referenceToBase64(const std::vector<unsigned char> &bytes) {
+    size_t size;
+    mbedtls_base64_encode(nullptr, 0, &size, bytes.data(), bytes.size());
+    std::vector<unsigned char> encoded(size);
+    mbedtls_base64_encode(encoded.data(), encoded.size(), &size, bytes.data(),
+                          bytes.size());
+    return std::string(encoded.begin(), encoded.begin() + size);
+}
+
+std::vector<codec::Kernel> supportedKernels() {
+    std::vector<codec::Kernel> kernels{codec::Kernel::SCALAR};
+    if (codec::detected() != codec::Kernel::SCALAR)
+        kernels.push_back(codec::Kernel::SSE2);
+    if (codec::detected() == codec::Kernel::AVX2)
+        kernels.push_back(codec::Kernel::AVX2);
+    return kernels;
+}
+
+std::vector<unsigned char> randomBytes(Random &random, size_t length) {
+    // drbg limits single request size
+    std::vector<unsigned char> bytes;
+    while (bytes.size() < length) {
+        std::vector<unsigned char> part =
+            random.get(std::min<size_t>(1024, length - bytes.size()));
+        bytes.insert(bytes.end(), part.begin(), part.end());
+    }
+    return bytes;
+}
+
+TEST_CASE("Codec kernels match the previous hex implementation") {
+    Random random;
+    for (codec::Kernel kernel : supportedKernels()) {
+        REQUIRE(codec::use(kernel) == kernel);
+
+        for (size_t length = 0; length < 300; length++) {
+            std::vector<unsigned char> bytes = randomBytes(random, length);
+            std::string expected = referenceToHex(bytes);
+
+            std::string hex(codec::hexSize(length), '\0');
+            codec::toHex(bytes.data(), length, &hex[0]);
+            REQUIRE(hex == expected);
+
+            std::vector<unsigned char> decoded(length);
+            REQUIRE(codec::fromHex(hex.data(), hex.size(), decoded.data()));
+            REQUIRE(decoded == bytes);
+
+            // uppercase accepted as well
+            for (char &c : hex) c = static_cast<char>(std::toupper(c));
+            REQUIRE(codec::fromHex(hex.data(), hex.size(), decoded.data()));
+            REQUIRE(decoded == bytes);
+
+            if (length == 0) continue;
+            // any invalid character at any position is found
+            size_t position = random.getBounded(0, hex.size());
+            for (char invalid : {'g', 'G', '/', ':', '@', '`', ' ', '\x80'}) {
+                std::string broken = hex;
+                broken[position] = invalid;
+                CHECK_FALSE(codec::fromHex(broken.data(), broken.size(),
+                                           decoded.data()));
+            }
+            CHECK_FALSE(
+                codec::fromHex(hex.data(), hex.size() - 1, decoded.data()));
+        }
+    }
+    codec::use(codec::detected());
+}
+
+TEST_CASE("Codec kernels match the previous base64 implementation") {
+    Random random;
+    for (codec::Kernel kernel : supportedKernels()) {
+        REQUIRE(codec::use(kernel) == kernel);
+
+        for (size_t length = 0; length < 300; length++) {
+            std::vector<unsigned char> bytes = randomBytes(random, length);
+            std::string expected = referenceToBase64(bytes);
+
+            std::string encoded(codec::base64Size(length), '\0');
+            REQUIRE(codec::toBase64(bytes.data(), length, &encoded[0]) ==
+                    encoded.size());
+            REQUIRE(encoded == expected);
+
+            std::vector<unsigned char> decoded(
+                codec::base64MaxDecodedSize(encoded.size()));
+            size_t written;
+            REQUIRE(codec::fromBase64(encoded.data(), encoded.size(),
+                                      decoded.data(), written));
+            decoded.resize(written);
+            REQUIRE(decoded == bytes);
+
+            if (length == 0) continue;
+            size_t position = random.getBounded(0, encoded.size());
+            // replaced padding may still be valid
+            if (encoded[position] == '=') continue;
+            for (char invalid : {'*', '-', '_', '=', ' ', '\n', '\x80'}) {
+                // '=' at the end is a valid padding
+                if (invalid == '=' && position + 2 >= encoded.size()) continue;
+                std::string broken = encoded;
+                broken[position] = invalid;
+                CHECK_FALSE(codec::fromBase64(broken.data(), broken.size(),
+                                              decoded.data(), written));
+            }
+        }
+    }
+    codec::use(codec::detected());
+}
+
+TEST_CASE("Codec large buffers") {
+    Random random;
+    std::vector<unsigned char> bytes = randomBytes(random, 64 * 1024 + 17);
+    std::string hex = referenceToHex(bytes);
+    std::string base64 = referenceToBase64(bytes);
+
+    for (codec::Kernel kernel : supportedKernels()) {
+        codec::use(kernel);
+        std::string encoded(hex.size(), '\0');
+        codec::toHex(bytes.data(), bytes.size(), &encoded[0]);
+        CHECK(encoded == hex);
+
+        encoded.assign(base64.size(), '\0');
+        codec::toBase64(bytes.data(), bytes.size(), &encoded[0]);
+        CHECK(encoded == base64);
+
+        std::vector<unsigned char> decoded(bytes.size());
+        size_t written;
+        CHECK(codec::fromBase64(base64.data(), base64.size(), decoded.data(),
+                                written));
+        CHECK(written == bytes.size());
+        CHECK(decoded == bytes);
+    }
+    codec::use(codec::detected());
+}
+
+TEST_CASE("Base64 lines keep the stream format") {
+    Random random;
+    Base64 base64;
+    for (size_t length : {0, 1, 255, 256, 257, 512, 1000}) {
+        std::vector<unsigned char> bytes = randomBytes(random, length);
+
+        // previous format: 256 byte blocks, each on its own line
+        std::string expected;
+        size_t offset = 0;
+        do {
+            size_t block = std::min<size_t>(256, length - offset);
+            expected += referenceToBase64(
+                {bytes.begin() + offset, bytes.begin() + offset + block});
+            expected += '\n';
+            offset += block;
+            if (block < 256) break;
+        } while (true);
+
+        std::vector<unsigned char> lines = Base64::encodeLines(bytes);
+        CHECK(std::string(lines.begin(), lines.end()) == expected);
+
+        std::stringstream in, out;
+        write_n(in, bytes);
+        base64.fromStream(in, out);
+        CHECK(out.str() == expected);
+
+        std::vector<unsigned char> decoded;
+        Base64::decodeLines(lines, decoded);
+        CHECK(decoded == bytes);
+
+        std::stringstream encoded{expected}, original;
+        base64.toStream(encoded, original);
+        CHECK(original.str() == std::string(bytes.begin(), bytes.end()));
+    }
+
+    std::vector<unsigned char> decoded;
+    CHECK_THROWS(Base64::decodeLines(from_string("Zm9v\nZm9*\n"), decoded));
+}
@@ -1,5 +1,7 @@
 
 #include <iostream>
+#include <mutex>
+#include <thread>
 #include "catch.hpp"
 
 #include "../../src/shared/connection_manager.h"
@@ -65,4 +67,102 @@ TEST_CASE("Server parses response, client reads response session key") {
     // CHECK(result.header.messageNumber == response.header.messageNumber);
     CHECK(result.header.userId == response.header.userId);
     CHECK(result.payload == response.payload);
-}
\ No newline at end of file
+}
+
+TEST_CASE("Tampered message is rejected") {
+    ClientToServerManager client{"73bed6b8e3c1743b7116e69e22229516",
+                                 "server_pub.pem"};
+    client.switchSecureChannel(true);    // enable secure channel
+
+    ServerToClientManager server{"73bed6b8e3c1743b7116e69e22229516"};
+
+    Request request{{Request::Type::SEND, 1111},
+                    std::vector<unsigned char>{5, 15, 15, 1, 99}};
+    std::string message = client.parseOutgoing(request).str();
+    // iv, tag, header and payload sealed together
+    CHECK(message.size() == 12 + 16 + 16 + 5);
+
+    SECTION("header") { message[12 + 16] ^= 1; }
+    SECTION("payload") { message.back() ^= 1; }
+    SECTION("iv") { message.front() ^= 1; }
+    SECTION("truncated") { message.pop_back(); }
+
+    CHECK_THROWS(server.parseIncoming(std::stringstream{message}));
+}
+
+TEST_CASE("Forwarded request is sealed without copying its payload") {
+    ClientToServerManager alice{"73bed6b8e3c1743b7116e69e22229516",
+                                "server_pub.pem"};
+    alice.switchSecureChannel(true);
+    ClientToServerManager bob{"4e8b3fd1c3ec90ba1e2e3e5a8e43dd0c",
+                              "server_pub.pem"};
+    bob.switchSecureChannel(true);
+
+    ServerToClientManager fromAlice{"73bed6b8e3c1743b7116e69e22229516"};
+    ServerToClientManager toBob{"4e8b3fd1c3ec90ba1e2e3e5a8e43dd0c"};
+
+    Request request{{Request::Type::SEND, 1111},
+                    std::vector<unsigned char>{5, 15, 15, 1, 99, 32, 13}};
+    std::string sealed = alice.parseOutgoing(request).str();
+
+    std::vector<unsigned char> buffer;
+    RequestView view = fromAlice.parseIncoming(from_string(sealed), buffer);
+    CHECK(view.header.type == request.header.type);
+    CHECK(view.header.userId == request.header.userId);
+    CHECK(view.payload.toVector() == request.payload);
+    // payload points into the decrypted frame
+    CHECK(view.payload.data >= buffer.data());
+    CHECK(view.payload.end() == buffer.data() + buffer.size());
+
+    ResponseView forwarded{{Response::Type::RECEIVE, 2222, 1111},
+                           view.payload};
+    Response result = bob.parseIncoming(toBob.parseOutgoing(forwarded));
+    CHECK(result.header.type == Response::Type::RECEIVE);
+    CHECK(result.header.userId == 2222);
+    CHECK(result.header.fromId == 1111);
+    CHECK(result.payload == request.payload);
+
+    // owning copy outlives the buffer
+    Request owned = view.toOwned();
+    buffer.assign(buffer.size(), 0);
+    CHECK(owned.payload == request.payload);
+}
+
+TEST_CASE("Responses sealed concurrently for one user stay valid") {
+    // receiver's lane and a forwarding lane seal on the same manager
+    ServerToClientManager toBob{"4e8b3fd1c3ec90ba1e2e3e5a8e43dd0c"};
+    constexpr int MESSAGES = 300;
+
+    // the socket of the receiver, lanes queue the messages into it
+    std::mutex socketLock;
+    std::vector<std::string> socket;
+    auto seal = [&](int lane) {
+        for (int i = 0; i < MESSAGES; i++) {
+            Response response{{Response::Type::RECEIVE, 2222,
+                               static_cast<uint32_t>(lane)},
+                              std::vector<unsigned char>(100, 'a' + lane)};
+            toBob.parseOutgoing(response, [&](std::stringstream &sealed) {
+                std::lock_guard<std::mutex> lock(socketLock);
+                socket.push_back(sealed.str());
+            });
+        }
+    };
+    std::thread forwarding(seal, 1);
+    seal(0);
+    forwarding.join();
+
+    // numbers are checked: the client accepts only the next one
+    ClientToServerManager bob{"4e8b3fd1c3ec90ba1e2e3e5a8e43dd0c",
+                              "server_pub.pem"};
+    bob.switchSecureChannel(true);
+    int received[2] = {0, 0};
+    for (const std::string &message : socket) {
+        Response response = bob.parseIncoming(std::stringstream(message));
+        uint32_t lane = response.header.fromId;
+        REQUIRE(lane < 2);
+        CHECK(response.payload == std::vector<unsigned char>(100, 'a' + lane));
+        received[lane]++;
+    }
+    CHECK(received[0] == MESSAGES);
+    CHECK(received[1] == MESSAGES);
+}
@@ -0,0 +1,185 @@
+#include "catch.hpp"
+
+#include "../../src/shared/framing.h"
+#include "../../src/shared/utils.h"
+
+using namespace helloworld;
+
+namespace {
+
+void feed(FrameCodec &codec, const std::vector<unsigned char> &data) {
+    codec.feed(reinterpret_cast<const char *>(data.data()), data.size());
+}
+
+std::vector<unsigned char> concat(std::vector<unsigned char> first,
+                                  const std::vector<unsigned char> &second) {
+    first.insert(first.end(), second.begin(), second.end());
+    return first;
+}
+
+}    // namespace
+
+TEST_CASE("Frame codec binary frames") {
+    FrameCodec client{WireProtocol::BINARY};
+    FrameCodec server;
+
+    std::vector<unsigned char> hello = client.handshake();
+    CHECK(hello == std::vector<unsigned char>{FrameCodec::PROTOCOL_MARKER});
+    CHECK(client.handshake().empty());
+
+    std::vector<unsigned char> msg = from_string("Hello world!");
+    std::vector<unsigned char> frame = client.encode(msg);
+    CHECK(frame.size() == msg.size() + FrameCodec::LENGTH_PREFIX_SIZE);
+
+    std::vector<unsigned char> result;
+    SECTION("single read") {
+        feed(server, concat(hello, frame));
+        REQUIRE(server.next(result));
+        CHECK(result == msg);
+        CHECK_FALSE(server.next(result));
+    }
+
+    SECTION("partial reads") {
+        std::vector<unsigned char> wire = concat(hello, frame);
+        for (size_t i = 0; i < wire.size() - 1; ++i) {
+            feed(server, {wire[i]});
+            CHECK_FALSE(server.next(result));
+        }
+        feed(server, {wire.back()});
+        REQUIRE(server.next(result));
+        CHECK(result == msg);
+    }
+
+    SECTION("coalesced reads") {
+        std::vector<unsigned char> empty = client.encode({});
+        feed(server, concat(concat(concat(hello, frame), empty), frame));
+        REQUIRE(server.next(result));
+        CHECK(result == msg);
+        REQUIRE(server.next(result));
+        CHECK(result.empty());
+        REQUIRE(server.next(result));
+        CHECK(result == msg);
+        CHECK_FALSE(server.next(result));
+        CHECK(server.buffered() == 0);
+    }
+
+    CHECK(server.incoming() == WireProtocol::BINARY);
+    CHECK(server.protocol() == WireProtocol::BINARY);
+    CHECK(server.handshake() ==
+          std::vector<unsigned char>{FrameCodec::PROTOCOL_MARKER});
+    CHECK(server.handshake().empty());
+}
+
+TEST_CASE("Frame codec legacy base64 frames") {
+    FrameCodec client{WireProtocol::LEGACY_BASE64};
+    FrameCodec server;
+    CHECK(client.handshake().empty());
+
+    std::vector<unsigned char> msg(1000, 'a');
+    std::vector<unsigned char> frame = client.encode(msg);
+    CHECK(frame.back() == '\0');
+
+    std::vector<unsigned char> result;
+    SECTION("split in the middle") {
+        std::vector<unsigned char> first(frame.begin(),
+                                         frame.begin() + frame.size() / 2);
+        std::vector<unsigned char> second(frame.begin() + frame.size() / 2,
+                                          frame.end());
+        feed(server, first);
+        CHECK_FALSE(server.next(result));
+        feed(server, second);
+        REQUIRE(server.next(result));
+        CHECK(result == msg);
+    }
+
+    SECTION("coalesced") {
+        feed(server, concat(frame, frame));
+        REQUIRE(server.next(result));
+        CHECK(result == msg);
+        REQUIRE(server.next(result));
+        CHECK(result == msg);
+        CHECK_FALSE(server.next(result));
+    }
+
+    CHECK(server.incoming() == WireProtocol::LEGACY_BASE64);
+    CHECK(server.protocol() == WireProtocol::LEGACY_BASE64);
+    CHECK(server.handshake().empty());
+}
+
+TEST_CASE("Frame codec sending first falls back to legacy") {
+    FrameCodec server;
+    std::vector<unsigned char> frame = server.encode(from_string("abc"));
+    CHECK(server.protocol() == WireProtocol::LEGACY_BASE64);
+
+    FrameCodec client{WireProtocol::BINARY};
+    feed(client, frame);
+    std::vector<unsigned char> result;
+    REQUIRE(client.next(result));
+    CHECK(result == from_string("abc"));
+    CHECK(client.incoming() == WireProtocol::LEGACY_BASE64);
+    CHECK(client.acknowledged());
+    CHECK(client.protocol() == WireProtocol::LEGACY_BASE64);
+}
+
+TEST_CASE("Frame codec binary protocol acknowledged") {
+    FrameCodec client{WireProtocol::BINARY};
+    FrameCodec server;
+    feed(server, client.handshake());
+    CHECK_FALSE(client.acknowledged());
+
+    // the server reacts to the announcement alone
+    REQUIRE(server.protocol() == WireProtocol::BINARY);
+    feed(client, server.handshake());
+    CHECK(client.acknowledged());
+    CHECK(client.incoming() == WireProtocol::BINARY);
+    CHECK(client.protocol() == WireProtocol::BINARY);
+    std::vector<unsigned char> result;
+    CHECK_FALSE(client.next(result));
+    CHECK(client.buffered() == 0);
+}
+
+TEST_CASE("Frame codec rejects oversized frame") {
+    FrameCodec server;
+    feed(server, {FrameCodec::PROTOCOL_MARKER, 0xff, 0xff, 0xff, 0xff});
+    std::vector<unsigned char> result;
+    CHECK_THROWS_AS(server.next(result), Error);
+}
+
+TEST_CASE("Frame codec zero-copy receive") {
+    FrameCodec client{WireProtocol::BINARY};
+    FrameCodec server;
+
+    std::vector<unsigned char> msg = from_string("Hello world!");
+    std::vector<unsigned char> wire =
+        concat(concat(client.handshake(), client.encode(msg)),
+               client.encode(msg));
+
+    // socket read directly into the codec buffer
+    unsigned char *target = server.prepare(wire.size() + 100);
+    std::copy(wire.begin(), wire.end(), target);
+    server.commit(wire.size());
+
+    ByteSpan first, second;
+    REQUIRE(server.next(first));
+    REQUIRE(server.next(second));
+    CHECK_FALSE(server.next(second));
+    // frames point into the receive buffer
+    CHECK(first.data >= target);
+    CHECK(first.data < target + wire.size());
+    CHECK(first.toVector() == msg);
+    CHECK(second.toVector() == msg);
+
+    SECTION("stream over span") {
+        ByteSpanStream stream{first};
+        CHECK(getSize(stream) == msg.size());
+        std::vector<unsigned char> result(msg.size());
+        CHECK(read_n(stream, result.data(), result.size()) == msg.size());
+        CHECK(result == msg);
+        CHECK(getSize(stream) == 0);
+    }
+
+    SECTION("buffer reused after consumed") {
+        CHECK(server.prepare(10) == target);
+        server.commit(0);
+    }
+}
@@ -99,6 +99,11 @@ TEST_CASE("test vectors RFC5869") {
     hkdf test(std::move(hmacFunction), infoString);
     test.setSalt(to_hex(salt));
     CHECK((test.generate(to_hex(IKM), len)) == result);
+
+    zero::bytes_t output(len);
+    test.setSalt(ByteSpan(salt));
+    test.generate(IKM, output);
+    CHECK(to_hex(output) == result);
 }
 
 TEST_CASE("Default salt value test (RFC5869)") {
@@ -35,6 +35,19 @@ TEST_CASE("serialization test") {
     CHECK(keyBundle.preKey == newBundle.preKey);
     CHECK(keyBundle.preKeySingiture == newBundle.preKeySingiture);
     CHECK(keyBundle.oneTimeKeys == newBundle.oneTimeKeys);
+    CHECK(newBundle.firstOneTimeKeyId == 0);
+
+    keyBundle.firstOneTimeKeyId = 300;
+    data = keyBundle.serialize();
+    newBundle = Serializable<KeyBundle<C25519> >::deserialize(data);
+    CHECK(newBundle.firstOneTimeKeyId == 300);
+    CHECK(keyBundle.oneTimeKeys == newBundle.oneTimeKeys);
+
+    // written before the key id was added, two bytes of its varint
+    data.resize(data.size() - 2);
+    newBundle = Serializable<KeyBundle<C25519> >::deserialize(data);
+    CHECK(newBundle.firstOneTimeKeyId == 0);
+    CHECK(keyBundle.oneTimeKeys == newBundle.oneTimeKeys);
 }
 
 // this testing violates the access memory policy...
@@ -0,0 +1,56 @@
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+#include "catch.hpp"
+
+#include "../../src/shared/curve_25519.h"
+#include "../../src/shared/keystore.h"
+
+using namespace helloworld;
+
+TEST_CASE("One-time keystore") {
+    std::vector<zero::bytes_t> keys;
+    for (C25519KeyPair &pair : C25519KeyGen::generate(20))
+        keys.push_back(pair.privateKey);
+
+    OneTimeKeystore::save("test_onetime.keys", "password", keys);
+
+    SECTION("Keys are read back") {
+        std::vector<zero::bytes_t> loaded;
+        REQUIRE(OneTimeKeystore::load("test_onetime.keys", "password", loaded));
+        CHECK(loaded == keys);
+    }
+
+    SECTION("Wrong password is detected") {
+        std::vector<zero::bytes_t> loaded;
+        CHECK_THROWS(
+            OneTimeKeystore::load("test_onetime.keys", "passwort", loaded));
+    }
+
+    SECTION("Each save uses fresh iv") {
+        std::ifstream first{"test_onetime.keys", std::ios::binary};
+        std::vector<unsigned char> before = vector_from_stream(first);
+        first.close();
+        OneTimeKeystore::save("test_onetime.keys", "password", keys);
+        std::ifstream second{"test_onetime.keys", std::ios::binary};
+        std::vector<unsigned char> after = vector_from_stream(second);
+        CHECK(before.size() == after.size());
+        CHECK(before != after);
+    }
+
+    SECTION("Missing keystore") {
+        std::vector<zero::bytes_t> loaded;
+        CHECK_FALSE(OneTimeKeystore::load("missing_onetime.keys", "password",
+                                          loaded));
+    }
+
+    SECTION("Empty key set") {
+        OneTimeKeystore::save("test_onetime.keys", "password", {});
+        std::vector<zero::bytes_t> loaded{keys[0]};
+        REQUIRE(OneTimeKeystore::load("test_onetime.keys", "password", loaded));
+        CHECK(loaded.empty());
+    }
+
+    std::remove("test_onetime.keys");
+}
@@ -1,7 +1,12 @@
 #include "catch.hpp"
 
+#include <list>
 #include <vector>
 
+#include "../../src/shared/double_ratchet_utils.h"
+#include "../../src/shared/request_response.h"
+#include "../../src/shared/requests.h"
+#include "../../src/shared/responses.h"
 #include "../../src/shared/user_data.h"
 
 using namespace helloworld;
@@ -10,23 +15,13 @@ using namespace helloworld;
 #include <stdint.h>
 
 struct X : Serializable<X> {
-    serialize::structure& serialize(
-        serialize::structure& result) const override {
-        result.push_back(0);
-        return result;
+    void write(serialize::Writer& out) const override {
+        out << static_cast<unsigned char>(0);
     }
-    serialize::structure serialize() const override {
-        serialize::structure result;
-        return serialize(result);
-    }
-    static X deserialize(const std::vector<unsigned char>&, uint64_t& from) {
-        ++from;
+    static X read(serialize::Reader& in) {
+        in.bytes(1);
         return {};
     }
-    static X deserialize(const serialize::structure& data) {
-        uint64_t from = 0;
-        return deserialize(data, from);
-    }
     friend bool operator==(const X&, const X&) { return true; }
 };
 
@@ -43,30 +38,13 @@ struct Y : Serializable<Y> {
 
     Y(std::string s = "", int i = 0, std::vector<char> v = {})
         : s(s), i(i), v(v) {}
-    serialize::structure& serialize(
-        serialize::structure& result) const override {
-        serialize::serialize(s, result);
-        serialize::serialize(i, result);
-        serialize::serialize(v, result);
-        return result;
-    }
-    serialize::structure serialize() const override {
-        serialize::structure result;
-        return serialize(result);
-    }
+    void write(serialize::Writer& out) const override { out << s << i << v; }
 
-    static Y deserialize(const std::vector<unsigned char>& data,
-                         uint64_t& from) {
+    static Y read(serialize::Reader& in) {
         Y res;
-        res.s = serialize::deserialize<decltype(s)>(data, from);
-        res.i = serialize::deserialize<decltype(i)>(data, from);
-        res.v = serialize::deserialize<decltype(v)>(data, from);
+        in >> res.s >> res.i >> res.v;
         return res;
     }
-    static Y deserialize(const serialize::structure& data) {
-        uint64_t from = 0;
-        return deserialize(data, from);
-    }
     friend bool operator==(const Y& a, const Y& b) {
         return a.i == b.i && a.s == b.s &&
                std::equal(a.v.begin(), a.v.end(), b.v.begin(), b.v.end());
@@ -77,28 +55,13 @@ struct Z : Serializable<Z> {
     std::vector<X> x;
     std::vector<Y> y;
 
-    serialize::structure& serialize(
-        serialize::structure& result) const override {
-        serialize::serialize(x, result);
-        serialize::serialize(y, result);
-        return result;
-    }
-    serialize::structure serialize() const override {
-        serialize::structure result;
-        return serialize(result);
-    }
+    void write(serialize::Writer& out) const override { out << x << y; }
 
-    static Z deserialize(const std::vector<unsigned char>& data,
-                         uint64_t& from) {
+    static Z read(serialize::Reader& in) {
         Z res;
-        res.x = serialize::deserialize<decltype(x)>(data, from);
-        res.y = serialize::deserialize<decltype(y)>(data, from);
+        in >> res.x >> res.y;
         return res;
     }
-    static Z deserialize(const serialize::structure& data) {
-        uint64_t from = 0;
-        return deserialize(data, from);
-    }
 
     friend bool operator==(const Z& a, const Z& b) {
         return a.x == b.x && a.y == b.y;
@@ -263,3 +226,196 @@ TEST_CASE("invalid deserializations") {
     serialized.pop_back();
     CHECK_THROWS(Y::deserialize(serialized));
 }
+
+TEST_CASE("Bulk containers keep element by element format") {
+    std::vector<uint32_t> values{1, 0xdeadbeef, 7};
+    std::list<uint32_t> list(values.begin(), values.end());
+
+    serialize::structure bulk, elements;
+    serialize::serialize(values, bulk);
+    serialize::serialize(list, elements);
+    CHECK(bulk == elements);
+
+    uint64_t from = 0;
+    CHECK(serialize::deserialize<std::list<uint32_t>>(bulk, from) == list);
+    from = 0;
+    CHECK(serialize::deserialize<std::vector<uint32_t>>(elements, from) ==
+          values);
+    CHECK(from == elements.size());
+
+    bulk.pop_back();
+    from = 0;
+    CHECK_THROWS(serialize::deserialize<std::vector<uint32_t>>(bulk, from));
+
+    // size far beyond the data must not be allocated
+    serialize::structure huge;
+    serialize::serialize(UINT64_MAX / 2, huge);
+    from = 0;
+    CHECK_THROWS(serialize::deserialize<std::vector<uint32_t>>(huge, from));
+}
+
+TEST_CASE("Serialized size matches serialized data") {
+    Request::Header header{Request::Type::SEND, 5, 7};
+    CHECK(serialize::fixed_size<Request::Header>::value ==
+          header.serialize().size());
+    CHECK(serialize::fixed_size<std::string>::value == 0);
+
+    std::vector<std::string> strings{"", "one", "two three"};
+    serialize::structure serialized;
+    serialize::serialize(strings, serialized);
+    CHECK(serialize::serialized_size(strings) == serialized.size());
+
+    DRState state{};
+    state.DHs = {zero::bytes_t(32, 1), zero::bytes_t(32, 2)};
+    state.RK = zero::bytes_t(32, 3);
+    state.AD = zero::bytes_t(64, 4);
+    state.MKSKIPPED.emplace(std::make_pair(zero::bytes_t(32, 5), 3),
+                            zero::bytes_t(32, 6));
+    serialized.clear();
+    CHECK(state.serialized_size() == state.serialize(serialized).size());
+    // top-level objects start with the version
+    CHECK(state.serialized_size() + 2 == state.serialize().size());
+
+    Message message{MessageHeader{zero::bytes_t(32, 7), 1, 2},
+                    CipherHMAC{std::vector<unsigned char>(100, 8),
+                               std::vector<unsigned char>(64, 9)}};
+    serialized = message.serialize();
+    CHECK(message.serialized_size() + 2 == serialized.size());
+    Message copy = Message::deserialize(serialized);
+    CHECK(copy.ciphertext == message.ciphertext);
+    CHECK(copy.header.dh == message.header.dh);
+}
+
+TEST_CASE("Byte view shares the vector format") {
+    std::vector<unsigned char> bytes{1, 2, 3, 4, 5};
+
+    serialize::structure owned, view;
+    serialize::serialize(bytes, owned);
+    serialize::serialize(ByteSpan(bytes), view);
+    CHECK(owned == view);
+    CHECK(serialize::serialized_size(ByteSpan(bytes)) == view.size());
+
+    uint64_t from = 0;
+    ByteSpan result = serialize::deserialize<ByteSpan>(owned, from);
+    CHECK(from == owned.size());
+    CHECK(result.toVector() == bytes);
+    // points into the serialized data, after the length
+    CHECK(result.data == owned.data() + 1);
+
+    owned.pop_back();
+    from = 0;
+    CHECK_THROWS(serialize::deserialize<ByteSpan>(owned, from));
+}
+
+TEST_CASE("Versioned format is little endian with varint lengths") {
+    GetUsers request{"ab", 1, 0x01020304};
+    CHECK(request.serialize() ==
+          serialize::structure{0xfe, 0x01, 0x02, 'a', 'b', 1, 0, 0, 0, 4, 3, 2,
+                               1});
+    GetUsers copy = GetUsers::deserialize(request.serialize());
+    CHECK(copy.query == "ab");
+    CHECK(copy.beforeId == 1);
+    CHECK(copy.limit == 0x01020304);
+
+    for (uint64_t length : {0, 1, 127, 128, 16383, 16384, 70000}) {
+        std::string text(length, 'x');
+        serialize::structure serialized;
+        serialize::serialize(text, serialized);
+        CHECK(serialized.size() ==
+              serialize::varint_size(length) + length);
+        CHECK(serialize::serialized_size(text) == serialized.size());
+        uint64_t from = 0;
+        CHECK(serialize::deserialize<std::string>(serialized, from) == text);
+        CHECK(from == serialized.size());
+    }
+    CHECK(serialize::varint_size(127) == 1);
+    CHECK(serialize::varint_size(128) == 2);
+    CHECK(serialize::varint_size(UINT64_MAX) == 10);
+
+    // longer than 10 bytes or overflowing 64 bits
+    serialize::structure overlong(10, 0x80);
+    overlong.push_back(0);
+    uint64_t from = 0;
+    CHECK_THROWS(serialize::deserialize<std::string>(overlong, from));
+    serialize::structure overflow(9, 0xff);
+    overflow.push_back(0x02);
+    from = 0;
+    CHECK_THROWS(serialize::deserialize<std::string>(overflow, from));
+}
+
+// encoding of the previous release: 8 byte lengths
+
+void legacyInteger(serialize::structure& out, uint64_t value, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        out.push_back(static_cast<unsigned char>(value >> (8 * i)));
+    }
+}
+
+void legacyBytes(serialize::structure& out, const zero::bytes_t& bytes) {
+    legacyInteger(out, bytes.size(), sizeof(uint64_t));
+    out.insert(out.end(), bytes.begin(), bytes.end());
+}
+
+serialize::structure legacyBundle(const KeyBundle<C25519>& bundle) {
+    serialize::structure out;
+    legacyInteger(out, bundle.timestamp, sizeof(uint64_t));
+    legacyBytes(out, bundle.identityKey);
+    legacyBytes(out, bundle.preKey);
+    legacyBytes(out, {bundle.preKeySingiture.begin(),
+                      bundle.preKeySingiture.end()});
+    legacyInteger(out, bundle.oneTimeKeys.size(), sizeof(uint64_t));
+    for (const auto& key : bundle.oneTimeKeys) legacyBytes(out, key);
+    return out;
+}
+
+TEST_CASE("Data written before versioning are read") {
+    KeyBundle<C25519> bundle;
+    bundle.timestamp = 439123;
+    bundle.identityKey = zero::bytes_t(32, 1);
+    bundle.preKey = zero::bytes_t(32, 2);
+    bundle.preKeySingiture = std::vector<unsigned char>(64, 3);
+    for (unsigned char i = 0; i < 20; ++i)
+        bundle.oneTimeKeys.emplace_back(32, i);
+
+    auto check = [&bundle](const KeyBundle<C25519>& read) {
+        CHECK(read.timestamp == bundle.timestamp);
+        CHECK(read.identityKey == bundle.identityKey);
+        CHECK(read.preKey == bundle.preKey);
+        CHECK(read.preKeySingiture == bundle.preKeySingiture);
+        CHECK(read.oneTimeKeys == bundle.oneTimeKeys);
+    };
+
+    serialize::structure legacy = legacyBundle(bundle);
+    check(KeyBundle<C25519>::deserialize(legacy));
+
+    serialize::structure current = bundle.serialize();
+    check(KeyBundle<C25519>::deserialize(current));
+    // 1 byte instead of 8 for lengths of the identity key, pre key,
+    // signature, key count and 20 keys, 2 bytes of version, 1 byte of the
+    // one-time key id
+    CHECK(legacy.size() - current.size() == 24 * 7 - 2 - 1);
+
+    // legacy data starting with the version tag by chance
+    bundle.timestamp = 0x0301fe;
+    legacy = legacyBundle(bundle);
+    REQUIRE(legacy[0] == serialize::VERSION_TAG);
+    REQUIRE(legacy[1] == serialize::VERSION);
+    check(KeyBundle<C25519>::deserialize(legacy));
+
+    // integers of the legacy format are read as well
+    serialize::structure users;
+    legacyInteger(users, 2, sizeof(uint64_t));
+    legacyInteger(users, 7, sizeof(uint32_t));
+    legacyInteger(users, 0x01020304, sizeof(uint32_t));
+    legacyInteger(users, 0, sizeof(uint64_t));
+    legacyInteger(users, 42, sizeof(uint64_t));
+    users.push_back(1);
+    legacyInteger(users, 0, sizeof(uint64_t));
+    UserListReponse list = UserListReponse::deserialize(users);
+    CHECK(list.ids == std::vector<uint32_t>{7, 0x01020304});
+    CHECK(list.version == 42);
+    CHECK(list.delta);
+
+    CHECK_THROWS(KeyBundle<C25519>::deserialize(
+        serialize::structure(legacy.begin(), legacy.end() - 1)));
+}
@@ -8,14 +8,15 @@
 using namespace helloworld;
 
 struct Test
-    : public Callable<void, bool, const std::string&, std::stringstream&&> {
+    : public Callable<void, bool, const std::string&, const ByteSpan&> {
     std::string result;
     explicit Test(std::string expected) : result(std::move(expected)) {}
 
     void callback(bool /*unused*/, const std::string& /*unused*/,
-                  std::stringstream&& data) override {
-        if (data.str() != result) {
-            throw Error("test failed: " + data.str() + " != " + result);
+                  const ByteSpan& data) override {
+        std::string received(data.begin(), data.end());
+        if (received != result) {
+            throw Error("test failed: " + received + " != " + result);
         };
     }
 };
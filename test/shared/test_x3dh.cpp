@@ -1,7 +1,9 @@
+#include <cstdio>
 #include <iostream>
 #include "catch.hpp"
 
 #include "../../src/shared/X3DH.h"
+#include "../../src/shared/keystore.h"
 
 using namespace helloworld;
 
@@ -45,6 +47,16 @@ TEST_CASE("X3DH process test one-time keys present") {
     X3DH::X3DHSecretPubKey secret;
     std::tie(request, secret) = x3dh_alice.setSecret(bundle);
 
+    SECTION("key id sent by the server") {
+        KeyBundle<C25519> claimed = bundle;
+        claimed.oneTimeKeys = {bobOneTime2.getPublicKey()};
+        claimed.firstOneTimeKeyId = 5;
+        X3DHRequest<C25519> claimedRequest;
+        std::tie(claimedRequest, std::ignore) = x3dh_alice.setSecret(claimed);
+        CHECK(claimedRequest.opKeyUsed == 0x01);
+        CHECK(claimedRequest.opKeyId == 5);
+    }
+
     SECTION("SIMULATE receiver") {
         CHECK(secret.sk.size() == 16);
         REQUIRE(request.opKeyUsed == 0x01);
@@ -131,6 +143,38 @@ TEST_CASE("X3DH process test one-time keys present") {
 
         CHECK(bob_secret.sk == secret.sk);
     }
+
+    SECTION("ACTUAL receiver keystore") {
+        std::string bob = "bob";
+        zero::str_t bob_pwd = "bob je svaloun";
+
+        Response r{{Response::Type::RECEIVE, 0}, request.serialize()};
+
+        bobIdentity.savePublicKey(bob + idC25519pub);
+        bobIdentity.savePrivateKeyPassword(bob + idC25519priv, bob_pwd);
+
+        bobPreKey.savePublicKey(bob + preC25519pub);
+        bobPreKey.savePrivateKeyPassword(bob + preC25519priv, bob_pwd);
+
+        // the keystore takes precedence over the key files
+        bobOneTime1.savePrivateKeyPassword(
+            bob + std::to_string(request.opKeyId) + oneTimeC25519priv, bob_pwd);
+        OneTimeKeystore::save(
+            bob + oneTimeKeystore, bob_pwd,
+            {bobOneTime1.getPrivateKey(), bobOneTime2.getPrivateKey()});
+
+        X3DH x3dh_bob(bob, bob_pwd);
+        x3dh_bob.timestamp = bundle.timestamp;
+
+        std::vector<unsigned char> messageEncrypted;
+        X3DH::X3DHSecretKeyPair bob_secret;
+        std::tie(messageEncrypted, bob_secret) = x3dh_bob.getSecret(r.payload);
+        CHECK(bob_secret.sk == secret.sk);
+
+        std::remove((bob + oneTimeKeystore).c_str());
+        std::remove((bob + std::to_string(request.opKeyId) + oneTimeC25519priv)
+                        .c_str());
+    }
 }
 
 TEST_CASE("X3DH process test no one time keys") {